@@ -9,7 +9,10 @@
 
 //#include "key_space.h"
 #include "art/art.h"
+#include "append_log.h"
 #include "art/key_options.h"
+#include "key_filter.h"
+#include "latency.h"
 #include "merge_options.h"
 #include "shared_mutex.h"
 #include "rpc/abstract_session.h"
@@ -23,33 +26,18 @@ namespace barch {
         typedef std::shared_ptr<abstract_shard> shard_ptr;
         typedef abstract_shard* shard_ref;
 
-        // bit-packed, same specialization as std::vector<bool>, through the
-        // tracking allocator. four million bits, 512 KiB, when the filter is on.
-        typedef heap::vector<bool> bloom_t;
-        bloom_t bloom{};
+        // the shard's key filter, see key_filter.h. sized from the shard's keys when
+        // static_bloom_filter is on, and absent when it is off
+        key_filter bloom{};
         void add_bloom(art::value_type key) {
-            if (static_bloom_size != bloom.size()) return;
-            uint64_t ash = ankerl::unordered_dense::detail::wyhash::hash(key.chars(), key.size);
-            bool bval = bloom[ash % static_bloom_size];
-            if (!bval)
-                bloom[ash % static_bloom_size] = true;
+            bloom.add(key);
         }
-
-
         bool is_bloom(art::value_type key) const {
-            if (static_bloom_size != bloom.size()) return true; // yes we assume the key exists
-            uint64_t ash = ankerl::unordered_dense::detail::wyhash::hash(key.chars(), key.size);
-            return bloom[ash % static_bloom_size] ;
+            return bloom.may_contain(key);
         }
         void create_bloom(bool enable) {
             opt_static_bloom_filter = enable;
-            if (enable) {
-                if (bloom.size() != static_bloom_size)
-                    bloom.resize(static_bloom_size);
-            } else if (!bloom.empty()) {
-                bloom_t ebl;
-                bloom = std::move(ebl);
-            }
+            bloom.reset(enable, get_tree_size() + get_hash_size());
         }
     private:
         bool opt_static_bloom_filter = barch::get_static_bloom_filter();
@@ -69,19 +57,61 @@ namespace barch {
         bool opt_drop_on_release = false;
         bool saving = false;
         uint64_t lock_to_ms = 1*1000*60;
+        /**
+         * what maintenance() has cost this shard, for INFO SHARD. urgency is the score the
+         * scheduler last gave it, in thousandths: 1000 is a shard holding exactly its
+         * share of memory with nothing to defragment
+         */
+        struct maintenance_timing {
+            std::atomic<uint64_t> runs{};
+            std::atomic<uint64_t> last_us{};
+            std::atomic<uint64_t> total_us{};
+            std::atomic<uint64_t> max_us{};
+            std::atomic<uint64_t> urgency{};
+            void record(uint64_t us) {
+                ++runs;
+                last_us = us;
+                total_us += us;
+                uint64_t m = max_us;
+                while (us > m && !max_us.compare_exchange_weak(m, us)) {
+                    // m is reloaded by compare_exchange_weak
+                }
+            }
+        };
+        maintenance_timing maintenance_time{};
+
+        /** what a hash or ordered set holds, see shard::count_container_leaf */
+        struct container_size {
+            uint64_t count{};
+            uint64_t bytes{};
+        };
+        /**
+         * the size of the container whose keys begin with prefix - a hash field key or an
+         * ordered set member index key cut off after the container name
+         */
+        virtual container_size get_container_size(art::value_type prefix) const = 0;
 
+        /**
+         * what waits for this shard's latch are recorded under, see latency.h. Only a latch
+         * that could not be had at once is a wait, one that could costs the try and nothing
+         * else
+         */
+        size_t latch_series{~(size_t)0};
         void lock_shared() {
-            if (get_latch().try_lock_shared())
-                return;
+            if (get_latch().try_lock_shared()) return;
+            uint64_t start = latency::on() ? latency::now_ns() : 0;
             if (!get_latch().try_lock_shared_for(std::chrono::milliseconds(lock_to_ms))) {
                 throw_exception<std::runtime_error>("read lock wait time exceeded");
             }
-
+            if (start) latency::record_latch(latch_series, latency::now_ns() - start);
         }
         void lock_unique() {
+            if (get_latch().try_lock()) return;
+            uint64_t start = latency::on() ? latency::now_ns() : 0;
             if (!get_latch().try_lock_for(std::chrono::milliseconds(lock_to_ms))) {
                 throw_exception<std::runtime_error>("write lock wait time exceeded");
             }
+            if (start) latency::record_latch(latch_series, latency::now_ns() - start);
         }
         void unlock_shared() {
             get_latch().unlock_shared();
@@ -131,6 +161,11 @@ namespace barch {
 
         virtual bool retrieve(std::istream& in) = 0;
 
+        /** how far into the append log this shard's files go */
+        virtual append_log::position get_log_position() const = 0;
+        /** true when the shard changed since it was last saved or loaded */
+        virtual bool changed_since_saved() const = 0;
+
         virtual void begin() = 0;
 
         virtual void commit() = 0;
@@ -165,6 +200,11 @@ namespace barch {
          * @return not null key if it exists (incl. pull sources)
          */
         virtual art::node_ptr search(art::value_type key) = 0;
+        /**
+         * search for count keys in one call, found[i] is what search(keys[i]) would give.
+         * the tree is walked for all of them together so their cache misses overlap
+         */
+        virtual void search_batch(const art::value_type* keys, size_t count, art::node_ptr* found) = 0;
         virtual art::node_ptr local_leaf(art::value_type key) = 0;
         virtual bool is_present(art::value_type key) = 0;
         virtual art::node_ptr lower_bound(art::value_type key) = 0;
@@ -274,6 +314,7 @@ struct storage_release {
         t->lock_unique(); // this can throw
         is_locked = true;
         ++statistics::write_locks_active;
+        barch::append_log::latched(*t);
 
     }
     ~storage_release() {
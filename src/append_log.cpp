@@ -0,0 +1,825 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "append_log.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "barch_apis.h"
+#include "configuration.h"
+#include "constants.h"
+#include "key_space.h"
+#include "key_type.h"
+#include "keyspec.h"
+#include "lzr_log.h"
+#include "rpc_caller.h"
+#include "simd.h"
+#include "statistics.h"
+
+namespace barch::append_log {
+    // a segment starts with these and the number of its first entry. every entry after
+    // that is [body size 4][crc32c of the body 4] and a body of [entry number 8][shard 4]
+    // [kind 4][space size 4][space][argument count 4] then each argument as [size 4][bytes]
+    static constexpr uint64_t segment_magic = 0x676f6c6863726162ull; // "barchlog"
+    static constexpr size_t segment_header = 2 * sizeof(uint64_t);
+    static constexpr size_t record_header = 2 * sizeof(uint32_t);
+    static const std::string segment_prefix = "barch_append_";
+    static const std::string segment_suffix = ".log";
+
+    struct segment {
+        std::string path{};
+        uint64_t first{0};
+        // the last entry in it, first - 1 while it has none
+        uint64_t last{0};
+    };
+
+    // what an entry is. a command replays through the command table, the others are
+    // what a command that writes more than one shard did to the entry's shard
+    enum record_kind : uint32_t {
+        record_command = 0,
+        // key, value, flags and expiry deadline, as shard::insert takes them
+        record_put = 1,
+        record_remove = 2,
+        record_remove_prefix = 3,
+        record_clear = 4
+    };
+
+    struct entry {
+        uint64_t number{0};
+        uint32_t shard{0};
+        uint32_t kind{record_command};
+        std::string space{};
+        heap::vector<std::string> args{};
+    };
+
+    struct log_state {
+        std::mutex lock{};
+        std::condition_variable wake{};
+        std::condition_variable flushed{};
+        std::atomic<bool> open{false};
+        bool stopping{false};
+        bool flush_now{false};
+        // the number the next entry gets, and whether the segments were read for it
+        uint64_t next{1};
+        bool scanned{false};
+        heap::vector<uint8_t> pending{};
+        uint64_t pending_last{0};
+        uint64_t durable{0};
+        // set while the last write or fsync of the log failed, and the last entry of a
+        // batch whose write failed, see flush_loop
+        std::atomic<bool> broken{false};
+        uint64_t failed{0};
+        heap::vector<segment> closed{};
+        segment active{};
+        int fd{-1};
+        uint64_t active_bytes{0};
+        int64_t fsync_ms{1000};
+        uint64_t segment_size{64 * 1024 * 1024};
+        // how far each shard's files go, by "space:shard", for deleting segments
+        heap::string_map<uint64_t> saved{};
+        std::thread flusher{};
+
+        std::mutex recovery_lock{};
+        std::condition_variable recovered{};
+        bool recovering{false};
+        // one open or close at a time
+        std::mutex switching{};
+
+        ~log_state() {
+            std::thread t;
+            {
+                std::lock_guard lk(lock);
+                stopping = true;
+                t = std::move(flusher);
+            }
+            wake.notify_all();
+            if (t.joinable()) t.join();
+            if (fd >= 0) ::close(fd);
+        }
+    };
+
+    static log_state& st() {
+        static log_state s{};
+        return s;
+    }
+
+    static thread_local bool replaying_here = false;
+    thread_local ticket* running = nullptr;
+
+    template<typename T>
+    static void put(heap::vector<uint8_t>& out, T value) {
+        auto at = out.size();
+        out.resize(at + sizeof(T));
+        memcpy(out.data() + at, &value, sizeof(T));
+    }
+
+    static void put(heap::vector<uint8_t>& out, std::string_view bytes) {
+        put(out, (uint32_t) bytes.size());
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    // everything but the entry number and the shard, which are only known under the latch
+    static void encode(heap::vector<uint8_t>& out, std::string_view space, uint32_t kind,
+                       const heap::vector<std::string_view>& args) {
+        auto at = out.size();
+        put(out, uint32_t{0});
+        put(out, uint32_t{0});
+        put(out, uint64_t{0});
+        put(out, uint32_t{0});
+        put(out, kind);
+        put(out, space);
+        put(out, (uint32_t) args.size());
+        for (auto a: args) {
+            put(out, a);
+        }
+        auto body = (uint32_t) (out.size() - at - record_header);
+        memcpy(out.data() + at, &body, sizeof(body));
+    }
+
+    static void number(heap::vector<uint8_t>& out, size_t at, uint64_t n, uint32_t shard) {
+        uint32_t body = 0;
+        memcpy(&body, out.data() + at, sizeof(body));
+        memcpy(out.data() + at + record_header, &n, sizeof(n));
+        memcpy(out.data() + at + record_header + sizeof(n), &shard, sizeof(shard));
+        uint32_t crc = simd::crc32c(out.data() + at + record_header, body, 0);
+        memcpy(out.data() + at + sizeof(uint32_t), &crc, sizeof(crc));
+    }
+
+    static bool to_i64(std::string_view v, int64_t& out) {
+        auto r = std::from_chars(v.data(), v.data() + v.size(), out);
+        return r.ec == std::errc() && r.ptr == v.data() + v.size();
+    }
+
+    static bool is_option(std::string_view v, std::string_view name) {
+        return v.size() == name.size() && std::equal(v.begin(), v.end(), name.begin(), [](char a, char b) {
+            return std::toupper((unsigned char) a) == b;
+        });
+    }
+
+    // SET k v EX 10 means ten seconds from when it ran, not from when it is replayed, so
+    // relative expiries are logged as the deadlines they came to. false when args are
+    // logged as they are
+    static bool absolute_expiry(const heap::vector<std::string_view>& args, heap::vector<std::string>& held) {
+        auto deadline = [](std::string_view given, bool seconds, std::string& out) {
+            int64_t v = 0, ms = 0;
+            if (!to_i64(given, v) || !art::expiry_ms(v, seconds, true, ms)) return false;
+            out = std::to_string(ms);
+            return true;
+        };
+        std::string ms;
+        auto cmd = args[0];
+        if ((cmd == "SET" || cmd == "GETEX") && args.size() > 3) {
+            for (size_t i = cmd == "SET" ? 3 : 2; i + 1 < args.size(); ++i) {
+                bool ex = is_option(args[i], "EX");
+                if (!ex && !is_option(args[i], "PX")) continue;
+                if (!deadline(args[i + 1], ex, ms)) return false;
+                held.assign(args.begin(), args.end());
+                held[i] = "PXAT";
+                held[i + 1] = ms;
+                return true;
+            }
+            return false;
+        }
+        if ((cmd == "SETEX" || cmd == "PSETEX") && args.size() == 4) {
+            if (!deadline(args[2], cmd == "SETEX", ms)) return false;
+            held = {"SET", std::string(args[1]), std::string(args[3]), "PXAT", ms};
+            return true;
+        }
+        if ((cmd == "EXPIRE" || cmd == "PEXPIRE") && args.size() >= 3) {
+            if (!deadline(args[2], cmd == "EXPIRE", ms)) return false;
+            held.assign(args.begin(), args.end());
+            held[0] = "PEXPIREAT";
+            held[2] = ms;
+            return true;
+        }
+        return false;
+    }
+
+    static std::string segment_path(uint64_t first) {
+        char digits[24];
+        snprintf(digits, sizeof(digits), "%020llu", (unsigned long long) first);
+        return segment_prefix + digits + segment_suffix;
+    }
+
+    static heap::vector<segment> list_segments() {
+        heap::vector<segment> r;
+        std::error_code ec;
+        for (auto& f: std::filesystem::directory_iterator(".", ec)) {
+            auto name = f.path().filename().string();
+            if (!name.starts_with(segment_prefix) || !name.ends_with(segment_suffix)) continue;
+            std::string_view digits(name);
+            digits = digits.substr(segment_prefix.size(), digits.size() - segment_prefix.size() - segment_suffix.size());
+            int64_t first = 0;
+            if (!to_i64(digits, first) || first <= 0) continue;
+            r.push_back({name, (uint64_t) first, (uint64_t) first - 1});
+        }
+        std::sort(r.begin(), r.end(), [](const segment& a, const segment& b) {
+            return a.first < b.first;
+        });
+        return r;
+    }
+
+    // every whole entry in the segment, in order. a torn or damaged one ends it
+    static void read_segment(segment& g, const std::function<void(entry&&)>& cb) {
+        std::ifstream in(g.path, std::ios::binary);
+        heap::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        uint64_t header[2] = {0, 0};
+        if (data.size() < segment_header) return;
+        memcpy(header, data.data(), segment_header);
+        if (header[0] != segment_magic) {
+            barch::err({"not an append log segment", g.path});
+            return;
+        }
+        size_t at = segment_header;
+        while (at + record_header <= data.size()) {
+            uint32_t body = 0, crc = 0;
+            memcpy(&body, data.data() + at, sizeof(body));
+            memcpy(&crc, data.data() + at + sizeof(body), sizeof(crc));
+            const uint8_t* p = data.data() + at + record_header;
+            if (body > data.size() - at - record_header || simd::crc32c(p, body, 0) != crc) break;
+            const uint8_t* end = p + body;
+            entry e;
+            auto take = [&](void* to, size_t size) {
+                if ((size_t) (end - p) < size) return false;
+                memcpy(to, p, size);
+                p += size;
+                return true;
+            };
+            auto text = [&](std::string& to) {
+                uint32_t size = 0;
+                if (!take(&size, sizeof(size)) || (size_t) (end - p) < size) return false;
+                to.assign((const char*) p, size);
+                p += size;
+                return true;
+            };
+            uint32_t argc = 0;
+            bool whole = take(&e.number, sizeof(e.number)) && take(&e.shard, sizeof(e.shard))
+                         && take(&e.kind, sizeof(e.kind)) && text(e.space) && take(&argc, sizeof(argc));
+            for (uint32_t i = 0; whole && i < argc; ++i) {
+                whole = text(e.args.emplace_back());
+            }
+            if (!whole) break;
+            at += record_header + body;
+            g.last = e.number;
+            cb(std::move(e));
+        }
+    }
+
+    static bool write_all(int fd, const uint8_t* data, size_t size) {
+        while (size > 0) {
+            auto w = ::write(fd, data, size);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += w;
+            size -= w;
+        }
+        return true;
+    }
+
+    static void sync_directory() {
+        int dir = ::open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir < 0) return;
+        ::fsync(dir);
+        ::close(dir);
+    }
+
+    // the caller holds the lock
+    static void start_segment(log_state& s, uint64_t first) {
+        s.active = {segment_path(first), first, first - 1};
+        s.fd = ::open(s.active.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (s.fd < 0) {
+            barch::err({"could not create append log segment", s.active.path, strerror(errno)});
+            return;
+        }
+        uint64_t header[2] = {segment_magic, first};
+        if (!write_all(s.fd, (const uint8_t*) header, sizeof(header)) || ::fdatasync(s.fd) != 0) {
+            barch::err({"could not write append log segment", s.active.path, strerror(errno)});
+        }
+        sync_directory();
+        s.active_bytes = sizeof(header);
+    }
+
+    // the caller holds the lock
+    static void end_segment(log_state& s) {
+        if (s.fd < 0) return;
+        if (s.fsync_ms >= 0 && ::fdatasync(s.fd) == 0) {
+            ++statistics::append_log_fsyncs;
+        }
+        ::close(s.fd);
+        s.fd = -1;
+        s.closed.push_back(s.active);
+    }
+
+    // delete the segments every shard's files are saved past. the caller holds the lock
+    static void prune(log_state& s) {
+        if (s.saved.empty()) return;
+        uint64_t low = std::numeric_limits<uint64_t>::max();
+        for (auto& p: s.saved) {
+            low = std::min(low, p.second);
+        }
+        auto gone = std::find_if(s.closed.begin(), s.closed.end(), [low](const segment& g) {
+            return g.last >= low;
+        });
+        for (auto g = s.closed.begin(); g != gone; ++g) {
+            std::error_code ec;
+            std::filesystem::remove(g->path, ec);
+        }
+        s.closed.erase(s.closed.begin(), gone);
+    }
+
+    static void flush_loop() {
+        auto& s = st();
+        heap::vector<uint8_t> batch;
+        std::unique_lock lk(s.lock);
+        while (true) {
+            auto every = std::chrono::milliseconds(s.fsync_ms > 0 ? s.fsync_ms : (int64_t) append_log_idle_ms);
+            // a log that could not be written is tried again once a round, not as fast as
+            // it fails
+            s.wake.wait_for(lk, every, [&] {
+                return s.stopping || s.flush_now
+                       || (!s.broken && ((s.fsync_ms == 0 && !s.pending.empty())
+                                         || s.pending.size() >= append_log_flush_bytes));
+            });
+            s.flush_now = false;
+            if (s.pending.empty()) {
+                if (s.stopping) break;
+                continue;
+            }
+            batch.swap(s.pending);
+            uint64_t last = s.pending_last;
+            int fd = s.fd;
+            bool sync = s.fsync_ms >= 0;
+            uint64_t written = s.active_bytes;
+            lk.unlock();
+            // the appenders fill the next batch while this one is written
+            bool ok = fd >= 0 && write_all(fd, batch.data(), batch.size());
+            if (ok && sync) {
+                ok = ::fdatasync(fd) == 0;
+                if (ok) ++statistics::append_log_fsyncs;
+            }
+            if (!ok) {
+                barch::err({"could not write the append log", strerror(errno)});
+                ++statistics::append_log_write_errors;
+                // what part of the batch did reach the segment would end it at a torn
+                // entry, and hide every entry written after it from a replay
+                if (fd >= 0 && (::ftruncate(fd, (off_t) written) != 0 || ::lseek(fd, (off_t) written, SEEK_SET) < 0)) {
+                    barch::err({"could not cut the append log back", strerror(errno)});
+                }
+            }
+            lk.lock();
+            if (!ok) {
+                // nothing of the batch is durable, and its commands have already run. The
+                // ones waiting for it with append_fsync always answer an error, and the
+                // batch is written again ahead of what came since on the next round -
+                // until then the log takes no more
+                s.broken = true;
+                s.failed = last;
+                if (s.stopping) {
+                    barch::err({"the append log is closed with entries it could not write"});
+                } else {
+                    batch.insert(batch.end(), s.pending.begin(), s.pending.end());
+                    s.pending.swap(batch);
+                }
+                batch.clear();
+                s.flushed.notify_all();
+                if (s.stopping && s.pending.empty()) break;
+                continue;
+            }
+            statistics::append_log_bytes += batch.size();
+            s.broken = false;
+            s.active.last = last;
+            s.active_bytes += batch.size();
+            batch.clear();
+            s.durable = last;
+            s.flushed.notify_all();
+            if (s.active_bytes >= s.segment_size) {
+                end_segment(s);
+                start_segment(s, last + 1);
+                prune(s);
+            }
+        }
+    }
+
+    // the caller holds the lock
+    static void enqueue(log_state& s, const heap::vector<uint8_t>& record, uint64_t last) {
+        s.pending.insert(s.pending.end(), record.begin(), record.end());
+        s.pending_last = last;
+        ++statistics::append_log_entries;
+        if (s.fsync_ms == 0 || s.pending.size() >= append_log_flush_bytes) {
+            s.wake.notify_one();
+        }
+    }
+
+    void on_latch(ticket& t, const abstract_shard& shard) {
+        if (t.effects || t.record.empty() || t.last) return;
+        auto& s = st();
+        std::lock_guard lk(s.lock);
+        if (!s.open) return;
+        t.last = s.next++;
+        number(t.record, 0, t.last, (uint32_t) shard.get_shard_number());
+        enqueue(s, t.record, t.last);
+    }
+
+    void log_effect(ticket& t, const std::string& space, size_t shard, uint32_t kind,
+                    const heap::vector<std::string_view>& args) {
+        heap::vector<uint8_t> record;
+        encode(record, space, kind, args);
+        auto& s = st();
+        std::lock_guard lk(s.lock);
+        if (!s.open) return;
+        t.last = s.next++;
+        number(record, 0, t.last, (uint32_t) shard);
+        enqueue(s, record, t.last);
+    }
+
+    static ticket* effects_ticket() {
+        return recording() ? running : nullptr;
+    }
+
+    void wrote(const std::string& space, size_t shard, std::string_view key, std::string_view value,
+               uint8_t flags, uint64_t expiry) {
+        auto* t = effects_ticket();
+        if (!t) return;
+        auto f = std::to_string(flags);
+        auto x = std::to_string(expiry);
+        log_effect(*t, space, shard, record_put, {key, value, f, x});
+    }
+
+    void removed(const std::string& space, size_t shard, std::string_view key) {
+        if (auto* t = effects_ticket()) log_effect(*t, space, shard, record_remove, {key});
+    }
+
+    void removed_prefix(const std::string& space, size_t shard, std::string_view prefix) {
+        if (auto* t = effects_ticket()) log_effect(*t, space, shard, record_remove_prefix, {prefix});
+    }
+
+    void cleared(const std::string& shard_name, size_t shard) {
+        if (auto* t = effects_ticket()) log_effect(*t, ks_undecorate(shard_name), shard, record_clear, {});
+    }
+
+    void ran(const std::string& space, size_t shard, const heap::vector<std::string_view>& args) {
+        if (auto* t = effects_ticket()) log_effect(*t, space, shard, record_command, args);
+    }
+
+    active::active(ticket* t) : t(t), outer(running) {
+        // a call without a ticket of its own, or one that is not logged, runs as part
+        // of whatever called it
+        if (t && *t) running = t;
+    }
+
+    active::~active() {
+        running = outer;
+    }
+
+    void active::wait() const {
+        if (!t || !t->last) return;
+        auto& s = st();
+        std::unique_lock lk(s.lock);
+        if (s.fsync_ms != 0) return;
+        uint64_t last = t->last;
+        s.flushed.wait(lk, [&] {
+            return s.durable >= last || s.failed >= last || !s.open;
+        });
+        if (s.durable < last && s.failed >= last) {
+            throw_exception<std::runtime_error>("the append log could not be written");
+        }
+    }
+
+    bool is_open() {
+        return st().open.load(std::memory_order_acquire);
+    }
+
+    bool logs(const barch_info& info, std::string_view name) {
+        if (name == "FLUSHDB" || name == "CLEAR" || name == "FLUSHALL" || name == "CLEARALL") return true;
+        if (!info.is_write() || !info.is_data()) return false;
+        // what the blocking pops take depends on when it arrived, and the foreign cache
+        // fills can be fetched again
+        static constexpr std::array<std::string_view, 10> left_out = {
+            "BLPOP", "BRPOP", "BLMPOP", "BLMOVE", "BRPOPLPUSH", "BZMPOP", "BZPOPMIN", "BZPOPMAX",
+            "FOREIGN", "FOREIGN_MISS"
+        };
+        if (std::find(left_out.begin(), left_out.end(), name) != left_out.end()) return false;
+        // START, STOP and RETRIEVE talk to other servers and IMPORT reads a file
+        static const size_t connection = get_category_map().at("connection");
+        static const size_t dangerous = get_category_map().at("dangerous");
+        return !info.cats[connection] && !info.cats[dangerous];
+    }
+
+    // the commands that write more than one shard, which log what they did to each
+    // instead of themselves. DEL is one even with one key, since a key's list, hash or
+    // ordered set can be on another shard than its string
+    static bool logs_effects(std::string_view name) {
+        static constexpr std::array<std::string_view, 20> spanning = {
+            "MSET", "MSETNX", "DEL", "UNLINK", "RENAME", "RENAMENX", "COPY", "MOVE", "LMOVE",
+            "RPOPLPUSH", "LMPOP", "ZMPOP", "ZUNIONSTORE", "ZINTERSTORE", "ZDIFFSTORE", "ZRANGESTORE",
+            "FLUSHDB", "FLUSHALL", "CLEAR", "CLEARALL"
+        };
+        return std::find(spanning.begin(), spanning.end(), name) != spanning.end();
+    }
+
+    ticket append(const std::string& space, const heap::vector<std::string_view>& args) {
+        auto& s = st();
+        ticket t;
+        if (!is_open() || args.empty()) return t;
+        if (s.broken) {
+            // the commands before this one ran without being logged yet, this one would
+            // run and be lost with them
+            throw_exception<std::runtime_error>("the append log cannot be written, writes are refused until it can");
+        }
+        if (logs_effects(args[0])) {
+            t.effects = true;
+            return t;
+        }
+        heap::vector<std::string> held;
+        if (absolute_expiry(args, held)) {
+            heap::vector<std::string_view> rewritten(held.begin(), held.end());
+            encode(t.record, space, record_command, rewritten);
+        } else {
+            encode(t.record, space, record_command, args);
+        }
+        return t;
+    }
+
+    ticket append_if_logged(const std::string& space, const std::vector<std::string>& params) {
+        if (!is_open() || params.empty()) return {};
+        auto functions = functions_by_name();
+        auto f = functions->find(params[0]);
+        if (f == functions->end() || !logs(f->second, params[0])) return {};
+        return append(space, params[0], params);
+    }
+
+    // the number after the last entry in the segments on disk. the caller holds the lock
+    static void scan(log_state& s) {
+        if (s.scanned) return;
+        s.scanned = true;
+        for (auto& g: list_segments()) {
+            read_segment(g, [](entry&&) {});
+            s.next = std::max(s.next, std::max(g.first, g.last + 1));
+        }
+    }
+
+    position current() {
+        auto& s = st();
+        std::lock_guard lk(s.lock);
+        if (!s.open) {
+            // a snapshot taken while the log is closed holds all that is in it
+            scan(s);
+        }
+        return {s.next};
+    }
+
+    void saved(const std::string& space, size_t shard, uint64_t next) {
+        auto& s = st();
+        std::lock_guard lk(s.lock);
+        s.saved[space + ":" + std::to_string(shard)] = next;
+        if (s.open) prune(s);
+    }
+
+    static void begin_recovery() {
+        auto& s = st();
+        std::unique_lock lk(s.recovery_lock);
+        s.recovered.wait(lk, [&] { return !s.recovering; });
+        s.recovering = true;
+        replaying_here = true;
+    }
+
+    static void end_recovery() {
+        auto& s = st();
+        {
+            std::lock_guard lk(s.recovery_lock);
+            s.recovering = false;
+        }
+        replaying_here = false;
+        s.recovered.notify_all();
+    }
+
+    void wait_for_recovery() {
+        if (replaying_here) return;
+        auto& s = st();
+        std::unique_lock lk(s.recovery_lock);
+        s.recovered.wait(lk, [&] { return !s.recovering; });
+    }
+
+    // what the entry did, done again to its shard
+    static void apply(rpc_caller& c, const shard_ptr& shard, const entry& e, const function_map& functions) {
+        switch (e.kind) {
+            case record_command: {
+                if (e.args.empty()) return;
+                auto f = functions.find(e.args[0]);
+                if (f == functions.end()) return;
+                c.call(e.args, f->second.call);
+                return;
+            }
+            case record_put: {
+                int64_t flags = 0, expiry = 0;
+                if (e.args.size() != 4 || !to_i64(e.args[2], flags) || !to_i64(e.args[3], expiry)) return;
+                art::key_options opts((art::flags_t) flags, (uint64_t) expiry);
+                storage_release held(shard);
+                shard->insert(opts, art::value_type{e.args[0]}, art::value_type{e.args[1]}, true,
+                              [](const art::node_ptr&) {});
+                return;
+            }
+            case record_remove: {
+                if (e.args.size() != 1) return;
+                storage_release held(shard);
+                shard->remove(art::value_type{e.args[0]});
+                return;
+            }
+            case record_remove_prefix: {
+                if (e.args.size() != 1) return;
+                storage_release held(shard);
+                remove_prefix_held(shard, art::value_type{e.args[0]});
+                return;
+            }
+            case record_clear:
+                shard->clear();
+                return;
+            default:
+                return;
+        }
+    }
+
+    // entries is in log order and all for space. each shard's entries run in order on
+    // their own thread, and an entry only ever wrote its own shard
+    static void replay(const key_space_ptr& space, const heap::vector<entry>& entries) {
+        auto shards = space->get_shards();
+        heap::vector<position> at;
+        for (auto& shard: shards) {
+            at.push_back(shard->get_log_position());
+        }
+        auto functions = functions_by_name();
+        heap::vector<heap::vector<const entry*>> queues(shards.size());
+        uint64_t replayed = 0, lost = 0;
+        for (auto& e: entries) {
+            if (e.shard >= shards.size()) {
+                ++lost;
+                continue;
+            }
+            if (at[e.shard].holds(e.number)) continue;
+            queues[e.shard].push_back(&e);
+            ++replayed;
+        }
+        if (lost) {
+            barch::err({std::to_string(lost), "append log entries are for shards", space->get_canonical_name(),
+                        "no longer has, and are not replayed"});
+        }
+        heap::vector<size_t> busy;
+        for (size_t q = 0; q < queues.size(); ++q) {
+            if (!queues[q].empty()) busy.push_back(q);
+        }
+        std::atomic<size_t> next_queue{0};
+        auto work = [&] {
+            replaying_here = true;
+            rpc_caller c;
+            c.set_kspace(space);
+            for (size_t q; (q = next_queue++) < busy.size();) {
+                for (auto* e: queues[busy[q]]) apply(c, shards[busy[q]], *e, *functions);
+            }
+        };
+        size_t threads = replayed < append_log_parallel_entries
+                             ? 1
+                             : std::min<size_t>(busy.size(), std::max(1u, std::thread::hardware_concurrency()));
+        heap::vector<std::thread> helpers;
+        for (size_t t = 1; t < threads; ++t) {
+            helpers.emplace_back(work);
+        }
+        work();
+        for (auto& t: helpers) t.join();
+        statistics::append_log_replayed += replayed;
+        if (replayed) {
+            barch::log({"replayed", std::to_string(replayed), "append log entries into", space->get_canonical_name()});
+        }
+    }
+
+    static void replay_all(heap::string_map<heap::vector<entry>>& by_space) {
+        for (auto& [name, entries]: by_space) {
+            try {
+                replay(get_keyspace(ks_undecorate(name)), entries);
+            } catch (const std::exception& e) {
+                barch::err({"could not replay the append log into", name, e.what()});
+            }
+        }
+    }
+
+    static void open_log() {
+        auto& s = st();
+        begin_recovery();
+        auto segments = list_segments();
+        heap::string_map<heap::vector<entry>> by_space;
+        uint64_t next = 1;
+        for (auto& g: segments) {
+            read_segment(g, [&](entry&& e) {
+                auto& to = by_space[e.space];
+                to.push_back(std::move(e));
+            });
+            next = std::max(next, std::max(g.first, g.last + 1));
+        }
+        {
+            std::lock_guard lk(s.lock);
+            s.next = std::max(s.next, next);
+            s.scanned = true;
+            s.closed = std::move(segments);
+            s.durable = s.pending_last = s.next - 1;
+            s.broken = false;
+            s.stopping = false;
+            start_segment(s, s.next);
+            s.open = true;
+            s.flusher = std::thread(flush_loop);
+        }
+        // a shard written to while the log was closed is saved first, so that what it
+        // holds now is where the log starts for it
+        all_spaces([](const std::string&, const key_space_ptr& ks) {
+            for (auto& shard: ks->get_shards()) {
+                if (shard->changed_since_saved()) shard->save(true);
+            }
+        });
+        replay_all(by_space);
+        end_recovery();
+        barch::log({"append log opened at entry", std::to_string(next)});
+    }
+
+    static void close_log() {
+        auto& s = st();
+        std::thread t;
+        {
+            std::lock_guard lk(s.lock);
+            s.open = false;
+            s.stopping = true;
+            t = std::move(s.flusher);
+        }
+        s.wake.notify_all();
+        if (t.joinable()) t.join();
+        std::lock_guard lk(s.lock);
+        end_segment(s);
+        s.stopping = false;
+        s.flushed.notify_all();
+        barch::log({"append log closed at entry", std::to_string(s.next)});
+    }
+
+    void apply_configuration() {
+        auto& s = st();
+        std::lock_guard switching(s.switching);
+        {
+            std::lock_guard lk(s.lock);
+            s.fsync_ms = get_append_fsync_ms();
+            s.segment_size = get_append_segment_size();
+        }
+        s.wake.notify_all();
+        bool wanted = get_append_log();
+        if (wanted && !is_open()) {
+            open_log();
+        } else if (!wanted && is_open()) {
+            close_log();
+        }
+    }
+
+    void recover(const std::shared_ptr<key_space>& space) {
+        auto& s = st();
+        if (!is_open()) return;
+        begin_recovery();
+        {
+            // what is still in memory goes to the segment first, so it is read below
+            std::unique_lock lk(s.lock);
+            uint64_t want = s.pending_last;
+            uint64_t failures = statistics::append_log_write_errors;
+            s.flush_now = true;
+            s.wake.notify_all();
+            s.flushed.wait(lk, [&] {
+                return s.durable >= want || statistics::append_log_write_errors > failures || !s.open;
+            });
+            if (s.durable < want) {
+                barch::err({"the append log could not be written, what it did not take is not replayed"});
+            }
+        }
+        heap::vector<segment> segments;
+        {
+            std::lock_guard lk(s.lock);
+            segments = s.closed;
+            segments.push_back(s.active);
+        }
+        heap::string_map<heap::vector<entry>> by_space;
+        auto name = space->get_canonical_name();
+        for (auto& g: segments) {
+            read_segment(g, [&](entry&& e) {
+                if (e.space == name) by_space[name].push_back(std::move(e));
+            });
+        }
+        replay_all(by_space);
+        end_recovery();
+    }
+}
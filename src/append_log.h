@@ -0,0 +1,177 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_APPEND_LOG_H
+#define BARCH_APPEND_LOG_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "sastam.h"
+
+struct barch_info;
+namespace barch {
+    class key_space;
+    class abstract_shard;
+}
+/**
+ * The append log: every write, in the order it ran, between one snapshot and the next.
+ *
+ * A shard is only as durable as its last save, which save_interval and
+ * max_modifications_before_save put minutes and many thousands of writes apart, and a
+ * crash lost all of that. With append_log on, the writes replication is fed are also
+ * written to a log and a flusher thread writes them out behind the callers. append_fsync
+ * says how often that reaches the disk: after every write, with the callers waiting
+ * before they answer and one fsync for all of them that arrived together; every so many
+ * milliseconds; or never, leaving it to the os.
+ *
+ * An entry belongs to one shard and is numbered under that shard's write latch, when the
+ * command first takes it, so the entries of a shard are in the order its writes ran. A
+ * snapshot takes the latch too, and every entry of its shard numbered below where the log
+ * was then is in it, and none after. A command that writes more than one shard - MSET,
+ * RENAME, LMOVE, the stores, FLUSHDB and the rest - is not logged as itself: what it did
+ * to each shard is, under that shard's latch, as the keys it wrote and removed or as
+ * a command that touches only that shard. Shards are saved apart, and a replay of
+ * "RENAME a b" into a shard that already held the rename would find nothing to move.
+ *
+ * Opening the log reads what is in it, loads every key space it names and replays what
+ * their snapshots do not hold yet, each shard's entries on their own thread. LOAD does
+ * the same for its space. The log is written in segments of append_segment_size, and a
+ * segment goes once every shard is saved past its end.
+ *
+ * Expiries are logged as deadlines, so a replay does not restart a key's time to live.
+ * The blocking pops are left out: what they take depends on when something arrives, and
+ * a replay would wait for it. So are the foreign cache fills, which can be fetched again.
+ */
+namespace barch::append_log {
+    /** how far into the log a snapshot goes: every entry of its shard numbered below next */
+    struct position {
+        uint64_t next{0};
+        [[nodiscard]] bool holds(uint64_t entry) const {
+            return entry < next;
+        }
+    };
+
+    /**
+     * one command on its way into the log, encoded ahead of running and numbered when it
+     * runs. see active
+     */
+    class ticket {
+    public:
+        ticket() = default;
+        ticket(const ticket&) = delete;
+        ticket& operator=(const ticket&) = delete;
+        ticket(ticket&&) noexcept = default;
+        ticket& operator=(ticket&&) noexcept = default;
+        explicit operator bool() const {
+            return effects || !record.empty();
+        }
+        /** its command logs what it does to each shard instead of itself */
+        [[nodiscard]] bool logs_effects() const {
+            return effects;
+        }
+    private:
+        friend class active;
+        friend void on_latch(ticket& t, const abstract_shard& shard);
+        friend ticket append(const std::string& space, const heap::vector<std::string_view>& args);
+        friend void log_effect(ticket& t, const std::string& space, size_t shard, uint32_t kind,
+                               const heap::vector<std::string_view>& args);
+        // the command, numbered once it takes a write latch. empty for one that logs
+        // what it does instead
+        heap::vector<uint8_t> record{};
+        bool effects{false};
+        // the last entry it was logged as, which append_fsync always waits for
+        uint64_t last{0};
+    };
+
+    /**
+     * While it lives, the writes this thread makes are logged under t. The session, the
+     * swig calls and EXEC run a command inside one, see rpc_caller::call
+     */
+    class active {
+    public:
+        explicit active(ticket* t);
+        active(const active&) = delete;
+        active& operator=(const active&) = delete;
+        ~active();
+        /**
+         * with append_fsync always, wait until the command's entries are on disk. throws
+         * when they could not be written - the command has run, but it is not durable
+         */
+        void wait() const;
+    private:
+        ticket* t;
+        ticket* outer;
+    };
+
+    // the ticket of the command running on this thread, see active
+    extern thread_local ticket* running;
+    void on_latch(ticket& t, const abstract_shard& shard);
+
+    /**
+     * storage_release calls this once it holds a shard's write latch. A command is logged
+     * under the first one it takes, which is the one it writes under - the commands that
+     * write more than one shard log what they did instead
+     */
+    inline void latched(const abstract_shard& shard) {
+        if (running) on_latch(*running, shard);
+    }
+
+    /** true while writes are logged */
+    bool is_open();
+    /** open or close the log as the append_log setting says. opening replays what is in it */
+    void apply_configuration();
+    /** true when the command named name, described by info, goes into the log */
+    bool logs(const barch_info& info, std::string_view name);
+    /**
+     * args, the command name first, as a write to the space with canonical name space,
+     * to be logged when it runs. throws when the log cannot be written and append_fsync
+     * is not always, since the commands before this one ran without being logged
+     */
+    ticket append(const std::string& space, const heap::vector<std::string_view>& args);
+    template<typename PT>
+    ticket append(const std::string& space, std::string_view command, const PT& params) {
+        heap::vector<std::string_view> args;
+        args.reserve(params.size());
+        args.emplace_back(command);
+        for (size_t i = 1; i < params.size(); ++i) {
+            args.emplace_back(params[i]);
+        }
+        return append(space, args);
+    }
+    /** params[0] is the command name. nothing when the log is closed or it is not a logged write */
+    ticket append_if_logged(const std::string& space, const std::vector<std::string>& params);
+
+    /**
+     * What a command that writes more than one shard did to one of them, with that
+     * shard's write latch held. Nothing unless such a command runs on this thread, so
+     * the helpers every command shares can call these.
+     *
+     * wrote: key was written with value, flags and an expiry deadline, as shard::insert
+     * takes them. removed: key went. removed_prefix: every key starting with prefix went.
+     * cleared: the whole shard went, and shard_name is the shard's own. ran: a command
+     * that writes only this shard, which replays as it ran here. recording says whether
+     * any of them would log anything, before their arguments are put together
+     */
+    inline bool recording() {
+        return running && running->logs_effects();
+    }
+    void wrote(const std::string& space, size_t shard, std::string_view key, std::string_view value,
+               uint8_t flags, uint64_t expiry);
+    void removed(const std::string& space, size_t shard, std::string_view key);
+    void removed_prefix(const std::string& space, size_t shard, std::string_view prefix);
+    void cleared(const std::string& shard_name, size_t shard);
+    void ran(const std::string& space, size_t shard, const heap::vector<std::string_view>& args);
+
+    /** where the log is now, for a snapshot being taken. the caller holds the shard's latch */
+    position current();
+    /** a shard's files now hold everything its position says */
+    void saved(const std::string& space, size_t shard, uint64_t next);
+    /** replay what space's snapshots do not hold, after LOAD */
+    void recover(const std::shared_ptr<key_space>& space);
+    /** wait for a replay to finish, unless this thread is the one running it */
+    void wait_for_recovery();
+}
+#endif //BARCH_APPEND_LOG_H
@@ -12,6 +12,7 @@
 #include "../logical_allocator.h"
 #include "../keys.h"
 #include "../lzr_log.h"
+#include "../simd.h"
 #include "../module.h"
 
 // Recursively destroys the tree
@@ -634,6 +635,82 @@ art::node_ptr art::find(const tree* t, value_type key) {
     }
     return nullptr;
 }
+namespace {
+    struct find_cursor {
+        art::node_ptr n{};
+        unsigned depth{};
+        size_t at{};
+    };
+
+    // start loading what n points to, the walk comes back to it after the other lookups
+    void prefetch_node(const art::tree* t, const art::node_ptr& n) {
+        if (n.null()) return;
+        const uint8_t* p = n.is_leaf ? t->get_leaves().read<uint8_t>(n.logical)
+                                     : t->get_nodes().read<uint8_t>(n.logical);
+        if (!p) return;
+        __builtin_prefetch(p);
+        __builtin_prefetch(p + 64);
+    }
+
+    // one level of the walk art::find makes, true once the lookup has its answer
+    bool find_step(const art::tree* t, find_cursor& c, art::value_type key, art::node_ptr& found) {
+        if (c.n.null()) return true;
+        if (c.n.is_leaf) {
+            if (c.n.const_leaf()->get_key() == key) {
+                ++statistics::keys_found;
+                found = c.n;
+            }
+            return true;
+        }
+        const auto &d = c.n->data();
+        if (d.partial_len) {
+            unsigned prefix_len = c.n->check_prefix(key.bytes, key.length(), c.depth);
+            if (prefix_len != std::min<unsigned>(art::max_prefix_llength, d.partial_len))
+                return true;
+            c.depth += d.partial_len;
+        }
+        if (c.depth >= key.length()) return true;
+        c.n = c.n->get_child(c.n->index(key[c.depth]));
+        ++c.depth;
+        prefetch_node(t, c.n);
+        return c.n.null();
+    }
+}
+
+void art::find_batch(const tree* t, const value_type* keys, size_t count, node_ptr* found) {
+    statistics::get_ops += count;
+    for (size_t i = 0; i < count; ++i) found[i] = nullptr;
+    try {
+        // every cursor is one lookup in flight, a finished one takes the next key so the
+        // group stays full until the keys run out
+        find_cursor cursors[lookup_batch_width];
+        size_t next = 0, active = 0;
+        for (auto& c : cursors) {
+            if (next < count) {
+                c = {t->root, 0, next++};
+                ++active;
+            } else {
+                c.at = count;
+            }
+        }
+        while (active) {
+            for (auto& c : cursors) {
+                if (c.at == count) continue;
+                if (find_step(t, c, keys[c.at], found[c.at])) {
+                    if (next < count) {
+                        c = {t->root, 0, next++};
+                    } else {
+                        c.at = count;
+                        --active;
+                    }
+                }
+            }
+        }
+    } catch (std::exception &e) {
+        barch::err({e.what(), __FILE__, __LINE__});
+        ++statistics::exceptions_raised;
+    }
+}
 #include "iterator.h"
 
 art::iterator::iterator(barch::shard_ptr t) : t(t) {
@@ -918,6 +995,45 @@ int64_t art::iterator::fast_distance(const iterator &other) const {
     return art::fast_distance(this->tl, other.tl);
 }
 
+int64_t art::iterator::position() const {
+    if (!t) return 0;
+    if (end()) return (int64_t)t->get_tree_size();
+    int64_t r = 0;
+    for (const auto &te: tl) {
+        r += total(first(te), te);
+    }
+    return r;
+}
+
+bool art::iterator::seek(int64_t position) {
+    tl.clear();
+    c = nullptr;
+    if (!t || position < 0 || position >= (int64_t)t->get_tree_size()) return false;
+    node_ptr n = t->get_root();
+    if (n.is_leaf) {
+        // a tree of one key has no trace, see the lower bound constructor
+        c = n;
+        return true;
+    }
+    while (!n.is_leaf) {
+        trace_element te = first({n, nullptr, 0});
+        while (!te.empty() && position >= descendants(te)) {
+            position -= descendants(te);
+            te = ::next(te);
+        }
+        if (te.empty()) {
+            // the counts do not add up to the tree size, update_trace would have
+            // caught that on the last write
+            tl.clear();
+            return false;
+        }
+        tl.push_back(te);
+        n = te.child;
+    }
+    c = n;
+    return true;
+}
+
 void art::iterator::log_trace() const {
     size_t ctr = 0;
     barch::log({"=======-iterator trace-========"});
@@ -983,21 +1099,23 @@ static unsigned longest_common_prefix(const art::leaf *l1, const art::leaf *l2,
 static int prefix_mismatch(const art::node_ptr &n, art::value_type key, unsigned depth) {
     int kd = key.length() - depth; // this can be negative ?
     int max_cmp = std::min<int>(std::min<int>(art::max_prefix_llength, n->data().partial_len), kd);
-    int idx;
+    int idx = 0;
     auto &dat = n->data();
-    for (idx = 0; idx < max_cmp; idx++) {
-        if (dat.partial[idx] != key[depth + idx])
+    if (max_cmp > 0) {
+        idx = (int) simd::first_mismatch(dat.partial, key.bytes + depth, max_cmp);
+        if (idx < max_cmp)
             return idx;
     }
 
     // If the prefix is short we can avoid finding a leaf
     if (dat.partial_len > art::max_prefix_llength) {
-        // Prefix is longer than what we've checked, find a leaf
+        // Prefix is longer than what we've checked, find a leaf. This is the comparison
+        // that can run the length of a key, so it goes a vector at a time
         const art::leaf *l = inner_minimum(n).const_leaf();
         max_cmp = std::min<unsigned>(l->key_len(), key.length()) - depth; // may be negative
-        for (; idx < max_cmp; idx++) {
-            if (l->key()[idx + depth] != key[depth + idx])
-                return idx;
+        if (idx < max_cmp) {
+            idx += (int) simd::first_mismatch((const uint8_t *) l->key() + depth + idx,
+                                              key.bytes + depth + idx, max_cmp - idx);
         }
     }
     return idx;
@@ -1049,6 +1167,9 @@ static art::node_ptr handle_leaf_replacement(
         {
             dl->set_value(value);
             dl->set_expiry(options.is_keep_ttl() ? dl->expiry_ms() : options.get_expiry());
+            if (!options.is_keep_ttl() && options.get_expiry() > 0) {
+                t->schedule_expiry(key, (int64_t)options.get_expiry());
+            }
             dl->set_compressed(options.is_compressed());
             options.is_volatile() ? dl->set_volatile() : dl->unset_volatile();
             t->last_leaf_added = n; // tje
@@ -1580,21 +1701,34 @@ void art::tree::update_trace(int direction) {
     }
 #endif
 }
-// because we reserve a number of threads for glob matching
-// we don't want to concurrently start too many globs
-static std::mutex glob_queue{};
+// how many pages a glob's workers get through between looks at whether its client is
+// still there. The look can be a system call, so it is not made on every page
+enum {
+    abandon_check_pages = 16
+};
 
+// the threads a glob scans with are handed out by barch::admit_glob before it gets here
+// (see glob_admission.h), so globs run side by side. What they share is kept atomic
 void art::glob(tree * t, const keys_spec &spec, value_type pattern, bool value,
                const std::function<bool(const leaf &l)> &cb,
                const glob_page_list *only, glob_page_list *hits) {
     try {
-        // make sure only one call can use the intensive KEYS without blocking other requests
-        std::unique_lock guard(glob_queue);
-        int64_t counter = 0;
+        std::atomic<int64_t> counter = 0;
+        std::atomic<uint64_t> pages_seen = 0;
         std::mutex hit_lock{};
+        // compiled once and shared by every worker: match does not change it
+        glob::compiled own{};
+        const glob::compiled *matcher = spec.matcher;
+        if (!matcher) {
+            own = glob::compiled(pattern);
+            matcher = &own;
+        }
         // this is a multi-threaded iterator and care should be taken
         auto on_page = [&](size_t size, size_t page, const heap::buffer<uint8_t> &data)-> bool {
                 if (!size) return true;
+                if (spec.abandoned && ++pages_seen % abandon_check_pages == 0 && spec.abandoned()) {
+                    return false;
+                }
                 auto i = data.begin();
                 auto e = i + size;
                 uint64_t misses = 0;
@@ -1644,7 +1778,7 @@ void art::glob(tree * t, const keys_spec &spec, value_type pattern, bool value,
                                 td = tmp;
                             }
                         }
-                        if (1 == glob::stringmatchlen(pattern, td, 0)) {
+                        if (1 == matcher->match(td)) {
                             page_hit = true;
                             if (!cb(*l)) {
                                 if (hits) {
@@ -1667,9 +1801,9 @@ void art::glob(tree * t, const keys_spec &spec, value_type pattern, bool value,
                 return true;
             };
         if (only)
-            t->get_leaves().iterate_pages(t->latch, *only, on_page);
+            t->get_leaves().iterate_pages(t->latch, *only, on_page, spec.workers);
         else
-            t->get_leaves().iterate_pages(t->latch, on_page);
+            t->get_leaves().iterate_pages(t->latch, on_page, spec.workers);
     } catch (std::exception &e) {
         barch::err({e.what(), __FILE__, __LINE__});
         ++statistics::exceptions_raised;
@@ -1678,13 +1812,21 @@ void art::glob(tree * t, const keys_spec &spec, value_type pattern, bool value,
 void art::values(tree * t, const keys_spec &spec, value_type pattern,
                const std::function<bool(const leaf &l)> &cb) {
     try {
-        // make sure only one call can use the intensive KEYS without blocking other requests
-        std::unique_lock guard(glob_queue);
-        int64_t counter = 0;
+        std::atomic<int64_t> counter = 0;
+        std::atomic<uint64_t> pages_seen = 0;
+        glob::compiled own{};
+        const glob::compiled *matcher = spec.matcher;
+        if (!matcher) {
+            own = glob::compiled(pattern);
+            matcher = &own;
+        }
         // this is a multi-threaded iterator and care should be taken
         t->get_leaves().iterate_pages(t->latch,
             [&](size_t size, size_t unused(padd), const heap::buffer<uint8_t> &page)-> bool {
                 if (!size) return true;
+                if (spec.abandoned && ++pages_seen % abandon_check_pages == 0 && spec.abandoned()) {
+                    return false;
+                }
                 auto i = page.begin();
                 auto e = i + size;
                 uint64_t misses = 0;
@@ -1698,7 +1840,7 @@ void art::values(tree * t, const keys_spec &spec, value_type pattern,
                             return false;
                         }
 
-                        if (1 == glob::stringmatchlen(pattern, l->get_value(), 0)) {
+                        if (1 == matcher->match(l->get_value())) {
                             if (!cb(*l)) {
                                 return false;
                             }
@@ -1710,7 +1852,7 @@ void art::values(tree * t, const keys_spec &spec, value_type pattern,
                 }
 
                 return true;
-            });
+            }, spec.workers);
     } catch (std::exception &e) {
         barch::err({e.what(), __FILE__, __LINE__});
         ++statistics::exceptions_raised;
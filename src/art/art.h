@@ -36,6 +36,8 @@ struct art_statistics {
     int64_t leaf_nodes_replaced {};
     int64_t pages_evicted {};
     int64_t keys_evicted {};
+    int64_t keys_evicted_lfu {};
+    int64_t keys_expired {};
     int64_t pages_defragged {};
     int64_t vmm_pages_defragged {};
     int64_t vmm_pages_popped {};
@@ -85,6 +87,13 @@ struct art_repl_statistics {
     int64_t redis_sessions{};
     int64_t attempted_routes{};
     int64_t routes_succeeded{};
+    // summed over the replication destinations, lag is the worst of them
+    int64_t repl_backlog{};
+    int64_t repl_in_flight{};
+    int64_t repl_batches_sent{};
+    int64_t repl_commands_acked{};
+    int64_t repl_lag_ms{};
+    int64_t repl_dropped{};
 };
 
 namespace art {
@@ -289,6 +298,14 @@ namespace art {
 namespace art {
 
     node_ptr find(const art::tree* t, value_type key);
+    /**
+     * look up count keys at once, found[i] is the leaf for keys[i] or null, same as
+     * search would give. The lookups are walked a level at a time in groups of
+     * lookup_batch_width, prefetching the next node of each one before moving on to the
+     * others, so the cache misses of one key are paid while the rest are being walked
+     * instead of one after the other
+     */
+    void find_batch(const art::tree* t, const value_type* keys, size_t count, node_ptr* found);
 
     int range(const tree *t, value_type key, value_type key_end, CallBack cb, void *data);
 #if 0
@@ -72,6 +72,22 @@ namespace art {
 
         [[nodiscard]] int64_t fast_distance(const iterator &other) const;
 
+        /**
+         * how many keys in the tree sort before the current one, or the size of the tree
+         * when the iterator is at the end. Every inner node knows how many leaves are
+         * below it, so this adds up the siblings to the left of each node on the trace
+         * instead of counting the keys themselves
+         */
+        [[nodiscard]] int64_t position() const;
+
+        /**
+         * moves to the key at position, zero based, in the whole tree. It goes down from
+         * the root, skipping over the children whose leaves all lie before position, so
+         * it visits one node per level rather than every key before it
+         * @return false if position is not in the tree, the iterator is at the end then
+         */
+        bool seek(int64_t position);
+
         void log_trace() const;
 
     };
@@ -412,6 +412,9 @@ namespace art {
                 return dat.occupants;
             }
             auto at = (const uint8_t*)memchr(dat.keys, c, dat.occupants);
+            if (!at) {
+                return SIZE; // get_node gives null past the end
+            }
             return at - dat.keys;
         }
 
@@ -16,6 +16,15 @@ namespace art {
     void set_leaf_lru(art::leaf * l) {
         l->set_lru();
     }
+    void touch_leaf_lfu(const abstract_leaf_pair& ap, const art::leaf * l) {
+        // xorshift, the counter only needs a coin that is cheap to toss
+        thread_local uint32_t state = 2463534242u ^ (uint32_t)(uintptr_t)&state;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        ap.lfu_counts.touch(l->get_key(), ap.lfu_clock.load(std::memory_order_relaxed),
+                            ap.lfu_log_factor.load(std::memory_order_relaxed), state);
+    }
     node_ptr tree::tree_make_leaf(value_type key, value_type v, key_options options) {
         return art::make_leaf(*this, key, v, options.get_expiry(), options.is_volatile(), options.is_compressed());
     }
@@ -65,6 +74,12 @@ namespace art {
         if (is_volatile && alloc.opt_volatile_keys_lru ) {
             l->set_lru();
         }
+        if (ttl > 0) {
+            alloc.schedule_expiry(key, ttl);
+        }
+        if (key.size && is_container_lead(key.bytes[0])) {
+            alloc.count_container_leaf(key, leaf_size, 1);
+        }
         if (l->byte_size() != leaf_size) {
             abort_with("invalid leaf size");
         }
@@ -81,6 +96,10 @@ void art::free_leaf_node(leaf *l, logical_address logical) {
     }
     auto &ap = logical.get_ap<alloc_pair>();
     ap.remove_leaf(logical);
+    auto key = l->get_key();
+    if (key.size && art::is_container_lead(key.bytes[0])) {
+        ap.count_container_leaf(key, l->byte_size(), -1);
+    }
     l->set_deleted();
     logical.get_ap<alloc_pair>().get_leaves().free(logical, l->byte_size());
     --statistics::leaf_nodes;
@@ -200,13 +219,8 @@ unsigned art::node::check_prefix(const unsigned char *key, unsigned key_len, uns
     auto &d = data();
     unsigned max_cmp = std::min<int>(std::min<int>(d.partial_len, max_prefix_llength),
                                      (int) key_len - (int) depth);
-    unsigned idx;
-
-    for (idx = 0; idx < max_cmp; idx++) {
-        if (d.partial[idx] != key[depth + idx])
-            return idx;
-    }
-    return idx;
+    if ((int) max_cmp <= 0) return 0;
+    return simd::first_mismatch(d.partial, key + depth, max_cmp);
 }
 
 
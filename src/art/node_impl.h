@@ -269,9 +269,10 @@ namespace art {
             }
 #else
             auto &d = this->nd();
-
-            for (unsigned i = 0; i < d.occupants; i++) {
-                if (d.keys[i] >= c && d.children[i].exists()) {
+            // the keys are ordered, so the first one not less than c is where to start
+            // looking, and all sixteen are compared in one go
+            for (unsigned i = simd::first_key_ge16(d.keys, d.occupants, c); i < d.occupants; i++) {
+                if (d.children[i].exists()) {
                     return {{this, this->get_child(i), i, d.keys[i]}, d.keys[i] == c};
                 }
             }
@@ -391,7 +392,7 @@ namespace art {
             // I leave the original here for reference or if
             // some bug emerges
             //while (dat.children[pos].exists()) pos++;
-            pos = simd::first_byte_eq(dat.types, node48::KEY_COUNT, 0);
+            pos = simd::node48_byte_eq(dat.types, node48::KEY_COUNT, 0);
 
             // not we do not need to call insert_type an empty child is found
             set_child(pos, child);
@@ -444,14 +445,10 @@ namespace art {
         }
 
         [[nodiscard]] std::pair<unsigned, uint8_t> first_index() const override {
-            unsigned uc = 0; // ?
-            unsigned i;
             auto &dat = nd();
-            for (; uc < 256; uc++) {
-                i = dat.keys[uc];
-                if (i > 0) {
-                    return {i - 1, uc};
-                }
+            unsigned uc = simd::node48_byte_gt(dat.keys, 256, 0);
+            if (uc < 256) {
+                return {dat.keys[uc] - 1, uc};
             }
             return {256, uc}; // ??
         }
@@ -464,11 +461,13 @@ namespace art {
             unsigned uc = c;
             unsigned i = 0;
             auto &dat = this->nd();
-            int test = simd::first_byte_gt(dat.keys + uc, 256 - uc, 0) + uc;
+            int test = simd::node48_byte_gt(dat.keys + uc, 256 - uc, 0) + uc;
             if (test < 256) {
                 i = dat.keys[test];
                 trace_element te = {this, get_child(i - 1), i - 1, (uint8_t) test};
-                return {te, (i == c)};
+                // equal when the key found is the one asked for - i is a slot number, and
+                // comparing that to c sent the lower bound back a child it did not need to
+                return {te, (test == (int) uc)};
             }
 #if 0
             for (; uc < 256; uc++)
@@ -503,9 +502,11 @@ namespace art {
         [[nodiscard]] trace_element next(const trace_element &te) const override {
             unsigned uc = te.k + 1, i;
             auto &dat = this->nd();
-            for (; uc < 256; uc++) {
-                i = dat.keys[uc];
-                if (i > 0) {
+            if (uc < 256) {
+                // the key index is zero where there is no child, as in lower_bound_child
+                uc += simd::node48_byte_gt(dat.keys + uc, 256 - uc, 0);
+                if (uc < 256) {
+                    i = dat.keys[uc];
                     return {this, get_child(i - 1), i - 1, (uint8_t) uc};
                 }
             }
@@ -633,21 +634,31 @@ namespace art {
 
         [[nodiscard]] std::pair<unsigned, uint8_t> first_index() const override {
             auto &dat = nd();
-            unsigned uc = 0; // ?
-            for (; uc < 256; uc++) {
-                if (dat.types[uc] > 0) {
-                    return {(unsigned) uc, uc};
-                }
-            }
+            unsigned uc = simd::node256_byte_gt(dat.types, 256, 0);
             return {uc, uc}; // ?
         }
 
+        /**
+         * the first occupied slot from start on, or 256. A slot's type is cleared when its
+         * child is removed, so the type array is a byte per slot that is zero where there
+         * is nothing - which a vector compare skips over 16 slots at a time. The
+         * child is still checked, a type is only ever a hint here
+         */
+        [[nodiscard]] unsigned next_occupied(unsigned start) const {
+            auto &dat = nd();
+            for (unsigned i = start; i < 256; ++i) {
+                i += simd::node256_byte_gt(dat.types + i, 256 - i, 0);
+                if (i >= 256) break;
+                if (has_child(i)) return i;
+            }
+            return 256;
+        }
+
         [[nodiscard]] std::pair<trace_element, bool> lower_bound_child(unsigned char c) const override {
-            for (unsigned i = c; i < 256; ++i) {
-                if (has_child(i)) {
-                    // because nodes are ordered accordingly
-                    return {{this, get_child(i), i, (uint8_t) i}, (i == c)};
-                }
+            unsigned i = next_occupied(c);
+            if (i < 256) {
+                // because nodes are ordered accordingly
+                return {{this, get_child(i), i, (uint8_t) i}, (i == c)};
             }
 
             return {{nullptr, nullptr, 256}, false};
@@ -656,12 +667,9 @@ namespace art {
         [[nodiscard]] trace_element next(const trace_element &te) const override {
             if (te.child_ix > 255) return {};
 
-            //auto& dat = nd();
-            //auto r = //simd::first_byte_gt(dat.keys+te.child_ix+1,256-te.child_ix-1,0);
-            for (unsigned i = te.child_ix + 1; i < 256; ++i) {
-                if (has_child(i)) {
-                    return {this, get_child(i), i, (uint8_t) i};
-                }
+            unsigned i = next_occupied(te.child_ix + 1);
+            if (i < 256) {
+                return {this, get_child(i), i, (uint8_t) i};
             }
             return {};
         }
@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <limits>
 #include <array>
@@ -21,6 +22,7 @@ namespace art {
         return std::numeric_limits<I>::min();
     }
     extern void set_leaf_lru(art::leaf * l);
+    extern void touch_leaf_lfu(const abstract_leaf_pair& ap, const art::leaf * l);
     enum key_types {
         tinteger = 1u,
         tdouble = 2u,
@@ -317,6 +319,9 @@ namespace art {
             if (ap.opt_all_keys_lru) {
                 set_leaf_lru(l);
             }
+            if (ap.opt_keys_lfu) {
+                touch_leaf_lfu(ap, l);
+            }
             return l;
         }
 
@@ -342,6 +347,9 @@ namespace art {
             if (l == nullptr) {
                 abort_with("invalid leaf address");
             }
+            if (ap.opt_keys_lfu) {
+                touch_leaf_lfu(ap, l);
+            }
             return l;
         }
 
@@ -24,6 +24,7 @@
 #endif
 %template(Strings) std::vector<std::string>;
 %template(Values) std::vector<Value>;
+%template(LatencyStatistics) std::vector<latency_statistics>;
 %include "swig_api.h"
 
 
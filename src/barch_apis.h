@@ -39,6 +39,10 @@ struct barch_info {
     heap::vector<bool> cats{};
     uint64_t calls {0};
     bool is_asynch{false};
+    // touches the key in argv[1] and nothing else, and never blocks. A pipeline of
+    // these can run a shard at a time in parallel, because only requests for the same
+    // key have an order to keep, and those land on the same shard
+    bool single_key{false};
     int dp = 0;
     int wr = 0;
     uint64_t total_nanos{};
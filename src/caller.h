@@ -154,6 +154,13 @@ public:
     virtual bool write_socket_array(size_t) {
         return false;
     }
+    /**
+     * true once the client has hung up. A long KEYS polls it so it can stop scanning for
+     * nobody; where there is no connection to look at there is no one to hang up.
+     */
+    [[nodiscard]] virtual bool peer_closed() const {
+        return false;
+    }
     /**
      * a map and a set are arrays that carry their own RESP3 wire type. On a RESP2
      * connection they are written as a flat array, so the default just opens one and
@@ -280,6 +287,8 @@ struct command {
     call_type call{};
     heap::vector<std::string> args{};
     barch::key_space_ptr space{};
+    // logged when EXEC runs it, shared so that a copied caller keeps its queue
+    std::shared_ptr<barch::append_log::ticket> logged{};
 };
 typedef heap::vector<command> commands_t;
 #endif //CALLER_H
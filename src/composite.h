@@ -117,4 +117,34 @@ struct composite {
         return build_prefix(length, key_buffer, comp);
     }
 };
+
+/**
+ * copies of keys made one at a time by a composite, whose buffer each create() reuses,
+ * so they can be looked up together with search_batch
+ */
+struct key_batch {
+    heap::vector<uint8_t> bytes{};
+    heap::vector<size_t> ends{};
+
+    void add(art::value_type key) {
+        bytes.insert(bytes.end(), key.bytes, key.bytes + key.size);
+        ends.push_back(bytes.size());
+    }
+
+    [[nodiscard]] size_t size() const {
+        return ends.size();
+    }
+
+    /** the keys added so far, only good until the next add */
+    [[nodiscard]] heap::vector<art::value_type> keys() const {
+        heap::vector<art::value_type> r;
+        r.reserve(ends.size());
+        size_t start = 0;
+        for (auto end : ends) {
+            r.emplace_back((const char *) bytes.data() + start, end - start);
+            start = end;
+        }
+        return r;
+    }
+};
 #endif //COMPOSITE_H
@@ -29,6 +29,9 @@
 #include "keyspace_locks.h"
 #include "dictionary_compressor.h"
 #include "statistics.h"
+#include "latency.h"
+#include "lock_profile.h"
+#include "rpc/buffer_pool.h"
 #include "swig_api.h"
 #include "thread_pool.h"
 #include "auth_api.h"
@@ -99,9 +102,13 @@ int CONFIG(caller& call, const arg_t& argv) {
     if (keyword_is("resetstat", "RESETSTAT")) {
         if (argv.size() != 2)
             return call.wrong_arity();
-        // the counters that count events, and the per command call counts INFO reports
-        // as commandstats. Gauges are left alone - see statistics::reset_statistics
+        // the counters that count events, the latency histograms, what the shard latches
+        // counted, what the read buffer pool lent, and the per command call counts INFO
+        // reports as commandstats. Gauges are left alone - see statistics::reset_statistics
         statistics::reset_statistics();
+        barch::latency::reset();
+        barch::lock_profile::reset();
+        barch::buffer_pool::reset();
         for (auto& f : *functions_by_name()) {
             f.second.calls = 0;
             f.second.total_nanos = 0;
@@ -4,6 +4,9 @@
 
 #include "../external/include/valkeymodule.h"
 #include "configuration.h"
+#include "append_log.h"
+#include "latency.h"
+#include "lock_profile.h"
 #include "sharded_store.h"
 #include <cstdlib>
 #include <algorithm>
@@ -51,6 +54,16 @@ struct config_state {
     heap::string pre_evict_thresh{};
     heap::string max_defrag_page_count{};
     heap::string max_scan_iterators{};
+    heap::string max_glob_workers{};
+    heap::string max_glob_queue{};
+    heap::string max_save_deltas{};
+    heap::string save_compression_level{};
+    heap::string append_log{"off"};
+    heap::string append_fsync{"1000"};
+    heap::string append_segment_size{};
+    heap::string latency_tracking{"off"};
+    heap::string lock_profiling{"off"};
+    heap::string verify_mapped_pages{"off"};
     heap::string iteration_worker_count{};
     heap::string maintenance_poll_delay{};
     heap::string active_defrag{};
@@ -66,6 +79,12 @@ struct config_state {
     heap::string foreign_timeout_ms{};
     heap::string foreign_pool_max_age_ms{};
     heap::string foreign_script_insns{};
+    heap::string repl_queue_max{};
+    heap::string repl_backpressure{"resync"};
+    heap::string repl_backoff_max_ms{};
+    heap::string maintenance_threads{};
+    heap::string lfu_log_factor{};
+    heap::string lfu_decay_time{};
     heap::string jump_factor{};
     heap::string ordered_keys{};
     heap::string server_port{};
@@ -76,6 +95,7 @@ struct config_state {
     };
     heap::vector<std::string> valid_on_off = {"on", "true", "off", "yes", "no", "null", "nil", "false"};
 
+    heap::vector<std::string> valid_repl_backpressure = {"block", "drop-oldest", "resync"};
     heap::vector<std::string> valid_compression = {"zstd", "none", "off", "no", "null", "nil"};
     heap::vector<std::string> valid_use_vmm_mem = valid_on_off;
     heap::vector<std::string> valid_defrag = valid_on_off;
@@ -695,6 +715,282 @@ static int ApplyMaxScanIterators(ValkeyModuleCtx *unused_arg, void *unused_arg,
     return VALKEYMODULE_OK;
 }
 
+// ===========================================================================================================
+static ValkeyModuleString *GetMaxGlobWorkers(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().max_glob_workers.c_str(), state().max_glob_workers.length());
+}
+
+static int SetMaxGlobWorkers(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().max_glob_workers = val;
+    char *ep = nullptr;
+    config().max_glob_workers = std::strtoull(val.c_str(), &ep, 10);
+    return VALKEYMODULE_OK;
+}
+static int SetMaxGlobWorkers(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                             ValkeyModuleString **unused_arg) {
+    return SetMaxGlobWorkers(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyMaxGlobWorkers(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetMaxGlobQueue(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().max_glob_queue.c_str(), state().max_glob_queue.length());
+}
+
+static int SetMaxGlobQueue(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().max_glob_queue = val;
+    char *ep = nullptr;
+    config().max_glob_queue = std::strtoull(val.c_str(), &ep, 10);
+    return VALKEYMODULE_OK;
+}
+static int SetMaxGlobQueue(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                           ValkeyModuleString **unused_arg) {
+    return SetMaxGlobQueue(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyMaxGlobQueue(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetMaxSaveDeltas(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().max_save_deltas.c_str(), state().max_save_deltas.length());
+}
+
+static int SetMaxSaveDeltas(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().max_save_deltas = val;
+    char *ep = nullptr;
+    config().max_save_deltas = std::strtoull(val.c_str(), &ep, 10);
+    return VALKEYMODULE_OK;
+}
+static int SetMaxSaveDeltas(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                            ValkeyModuleString **unused_arg) {
+    return SetMaxSaveDeltas(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyMaxSaveDeltas(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetSaveCompressionLevel(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().save_compression_level.c_str(), state().save_compression_level.length());
+}
+
+static int SetSaveCompressionLevel(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    char *ep = nullptr;
+    auto level = std::strtoull(val.c_str(), &ep, 10);
+    if (level > 22) { // the highest level zstd has
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().save_compression_level = val;
+    config().save_compression_level = level;
+    return VALKEYMODULE_OK;
+}
+static int SetSaveCompressionLevel(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                   ValkeyModuleString **unused_arg) {
+    return SetSaveCompressionLevel(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplySaveCompressionLevel(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetAppendLog(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().append_log.c_str(), state().append_log.length());
+}
+
+static int SetAppendLog(const std::string& valu) {
+    std::string val = valu;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    if (val.empty() || !check_type(val, state().valid_on_off)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().append_log = val;
+    config().append_log = is_on(val);
+    return VALKEYMODULE_OK;
+}
+static int SetAppendLog(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                        ValkeyModuleString **unused_arg) {
+    return SetAppendLog(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyAppendLog(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    // opening the log replays it, which takes the key spaces it names - so not under the
+    // configuration lock
+    barch::append_log::apply_configuration();
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetLatencyTracking(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().latency_tracking.c_str(), state().latency_tracking.length());
+}
+
+static int SetLatencyTracking(const std::string& valu) {
+    std::string val = valu;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    if (val.empty() || !check_type(val, state().valid_on_off)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().latency_tracking = val;
+    config().latency_tracking = is_on(val);
+    return VALKEYMODULE_OK;
+}
+static int SetLatencyTracking(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                              ValkeyModuleString **unused_arg) {
+    return SetLatencyTracking(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyLatencyTracking(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    // read on every call, so it is kept where reading it takes no lock
+    barch::latency::tracking = barch::get_latency_tracking();
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetLockProfiling(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().lock_profiling.c_str(), state().lock_profiling.length());
+}
+
+static int SetLockProfiling(const std::string& valu) {
+    std::string val = valu;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    if (val.empty() || !check_type(val, state().valid_on_off)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().lock_profiling = val;
+    config().lock_profiling = is_on(val);
+    return VALKEYMODULE_OK;
+}
+static int SetLockProfiling(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                            ValkeyModuleString **unused_arg) {
+    return SetLockProfiling(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyLockProfiling(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    // every latch reads it on every acquisition
+    barch::lock_profile::set_profiling(barch::get_lock_profiling());
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetVerifyMappedPages(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().verify_mapped_pages.c_str(), state().verify_mapped_pages.length());
+}
+
+static int SetVerifyMappedPages(const std::string& valu) {
+    std::string val = valu;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    if (val.empty() || !check_type(val, state().valid_on_off)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().verify_mapped_pages = val;
+    config().verify_mapped_pages = is_on(val);
+    return VALKEYMODULE_OK;
+}
+static int SetVerifyMappedPages(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                ValkeyModuleString **unused_arg) {
+    return SetVerifyMappedPages(ValkeyModule_StringPtrLen(val, nullptr));
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetAppendFsync(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().append_fsync.c_str(), state().append_fsync.length());
+}
+
+// always, off or a number of milliseconds, as in redis's appendfsync with everysec
+// made any interval
+static int SetAppendFsync(const std::string& valu) {
+    std::string val = valu;
+    std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+    int64_t ms = 0;
+    if (val == "always") {
+        ms = 0;
+    } else if (val == "off" || val == "no") {
+        val = "off";
+        ms = -1;
+    } else {
+        std::regex check("[1-9][0-9]{0,8}");
+        if (!std::regex_match(val, check)) {
+            return VALKEYMODULE_ERR;
+        }
+        ms = std::strtoll(val.c_str(), nullptr, 10);
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().append_fsync = val;
+    config().append_fsync_ms = ms;
+    return VALKEYMODULE_OK;
+}
+static int SetAppendFsync(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                          ValkeyModuleString **unused_arg) {
+    return SetAppendFsync(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyAppendFsync(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    barch::append_log::apply_configuration();
+    return VALKEYMODULE_OK;
+}
+
+// ===========================================================================================================
+static ValkeyModuleString *GetAppendSegmentSize(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().append_segment_size.c_str(), state().append_segment_size.length());
+}
+
+static int SetAppendSegmentSize(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    char *ep = nullptr;
+    auto size = std::strtoull(val.c_str(), &ep, 10);
+    if (size < 4096) { // a segment holds at least a few entries
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().append_segment_size = val;
+    config().append_segment_size = size;
+    return VALKEYMODULE_OK;
+}
+static int SetAppendSegmentSize(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                ValkeyModuleString **unused_arg) {
+    return SetAppendSegmentSize(ValkeyModule_StringPtrLen(val, nullptr));
+}
+static int ApplyAppendSegmentSize(ValkeyModuleCtx *unused_arg, void *unused_arg, ValkeyModuleString **unused_arg) {
+    barch::append_log::apply_configuration();
+    return VALKEYMODULE_OK;
+}
+
 // ===========================================================================================================
 static ValkeyModuleString *GetMaxDefragPageCount(const char *unused_arg, void *unused_arg) {
     std::lock_guard lock(state().config_mutex);
@@ -1100,6 +1396,12 @@ static int ApplyEvictionType(ValkeyModuleCtx *unused_arg, void *unused_arg, Valk
     store.each_shard_write([&](const barch::shard_ptr& t) {
         t->get_ap().get_nodes().set_opt_enable_lfu(lfu);
         t->get_ap().get_leaves().set_opt_enable_lfu(lfu);
+        t->get_ap().opt_keys_lfu = lfu;
+        // the counters are only kept while something weighs keys by them
+        if (lfu)
+            t->get_ap().lfu_counts.fit(t->get_size());
+        else
+            t->get_ap().lfu_counts.clear();
         t->opt_evict_all_keys_lru = config().evict_allkeys_lru;
         t->opt_evict_volatile_keys_lru = config().evict_volatile_lru;
         t->opt_evict_all_keys_lfu = config().evict_allkeys_lfu;
@@ -1109,6 +1411,172 @@ static int ApplyEvictionType(ValkeyModuleCtx *unused_arg, void *unused_arg, Valk
     return VALKEYMODULE_OK;
 }
 
+static ValkeyModuleString *GetReplQueueMax(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().repl_queue_max.c_str(),
+                                     state().repl_queue_max.length());
+}
+
+static int SetReplQueueMax(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().repl_queue_max = val;
+    char *end = nullptr;
+    config().repl_queue_max = std::strtoull(val.c_str(), &end, 10);
+    return VALKEYMODULE_OK;
+}
+
+static int SetReplQueueMax(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                  ValkeyModuleString **unused_arg) {
+    return SetReplQueueMax(ValkeyModule_StringPtrLen(val, nullptr));
+}
+
+static int ApplyReplQueueMax(ValkeyModuleCtx *unused(ctx), void *unused(priv), ValkeyModuleString **unused(vks)) {
+    return VALKEYMODULE_OK;
+}
+
+static ValkeyModuleString *GetReplBackoffMaxMs(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().repl_backoff_max_ms.c_str(),
+                                     state().repl_backoff_max_ms.length());
+}
+
+static int SetReplBackoffMaxMs(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().repl_backoff_max_ms = val;
+    char *end = nullptr;
+    config().repl_backoff_max_ms = std::strtoull(val.c_str(), &end, 10);
+    return VALKEYMODULE_OK;
+}
+
+static int SetReplBackoffMaxMs(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                  ValkeyModuleString **unused_arg) {
+    return SetReplBackoffMaxMs(ValkeyModule_StringPtrLen(val, nullptr));
+}
+
+static int ApplyReplBackoffMaxMs(ValkeyModuleCtx *unused(ctx), void *unused(priv), ValkeyModuleString **unused(vks)) {
+    return VALKEYMODULE_OK;
+}
+
+static ValkeyModuleString *GetReplBackpressure(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().repl_backpressure.c_str(),
+                                     state().repl_backpressure.length());
+}
+
+static int SetReplBackpressure(const std::string& val) {
+    std::lock_guard lock(state().config_mutex);
+    const auto& valid = state().valid_repl_backpressure;
+    auto at = std::find(valid.begin(), valid.end(), val);
+    if (at == valid.end()) {
+        return VALKEYMODULE_ERR;
+    }
+    state().repl_backpressure = val.c_str();
+    config().repl_backpressure = (int)(at - valid.begin());
+    return VALKEYMODULE_OK;
+}
+
+static int SetReplBackpressure(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                               ValkeyModuleString **unused_arg) {
+    size_t len = 0;
+    const char *s = ValkeyModule_StringPtrLen(val, &len);
+    return SetReplBackpressure(std::string(s, len));
+}
+
+static int ApplyReplBackpressure(ValkeyModuleCtx *unused(ctx), void *unused(priv), ValkeyModuleString **unused(vks)) {
+    return VALKEYMODULE_OK;
+}
+
+static ValkeyModuleString *GetMaintenanceThreads(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().maintenance_threads.c_str(),
+                                     state().maintenance_threads.length());
+}
+
+static int SetMaintenanceThreads(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().maintenance_threads = val;
+    char *end = nullptr;
+    config().maintenance_threads = std::strtoull(val.c_str(), &end, 10);
+    return VALKEYMODULE_OK;
+}
+
+static int SetMaintenanceThreads(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                  ValkeyModuleString **unused_arg) {
+    return SetMaintenanceThreads(ValkeyModule_StringPtrLen(val, nullptr));
+}
+
+static int ApplyMaintenanceThreads(ValkeyModuleCtx *unused(ctx), void *unused(priv), ValkeyModuleString **unused(vks)) {
+    return VALKEYMODULE_OK;
+}
+
+static ValkeyModuleString *GetLfuLogFactor(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().lfu_log_factor.c_str(),
+                                     state().lfu_log_factor.length());
+}
+
+static int SetLfuLogFactor(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().lfu_log_factor = val;
+    char *end = nullptr;
+    config().lfu_log_factor = std::strtoull(val.c_str(), &end, 10);
+    return VALKEYMODULE_OK;
+}
+
+static int SetLfuLogFactor(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                  ValkeyModuleString **unused_arg) {
+    return SetLfuLogFactor(ValkeyModule_StringPtrLen(val, nullptr));
+}
+
+static int ApplyLfuLogFactor(ValkeyModuleCtx *unused(ctx), void *unused(priv), ValkeyModuleString **unused(vks)) {
+    // picked up by each shard on its next maintenance pass
+    return VALKEYMODULE_OK;
+}
+
+static ValkeyModuleString *GetLfuDecayTime(const char *unused_arg, void *unused_arg) {
+    std::lock_guard lock(state().config_mutex);
+    return ValkeyModule_CreateString(nullptr, state().lfu_decay_time.c_str(),
+                                     state().lfu_decay_time.length());
+}
+
+static int SetLfuDecayTime(const std::string& val) {
+    std::regex check("[0-9]+");
+    if (!std::regex_match(val, check)) {
+        return VALKEYMODULE_ERR;
+    }
+    std::lock_guard lock(state().config_mutex);
+    state().lfu_decay_time = val;
+    char *end = nullptr;
+    config().lfu_decay_time = std::strtoull(val.c_str(), &end, 10);
+    return VALKEYMODULE_OK;
+}
+
+static int SetLfuDecayTime(const char *unused_arg, ValkeyModuleString *val, void *unused_arg,
+                                  ValkeyModuleString **unused_arg) {
+    return SetLfuDecayTime(ValkeyModule_StringPtrLen(val, nullptr));
+}
+
+static int ApplyLfuDecayTime(ValkeyModuleCtx *unused(ctx), void *unused(priv), ValkeyModuleString **unused(vks)) {
+    // picked up by each shard on its next maintenance pass
+    return VALKEYMODULE_OK;
+}
+
 int barch::register_valkey_configuration(ValkeyModuleCtx *ctx) {
     int ret = 0;
     ret |= ValkeyModule_RegisterStringConfig(ctx, "compression", "none", VALKEYMODULE_CONFIG_DEFAULT,
@@ -1146,6 +1614,41 @@ int barch::register_valkey_configuration(ValkeyModuleCtx *ctx) {
                                              GetMaxScanIterators, SetMaxScanIterators, ApplyMaxScanIterators,
                                              nullptr);
 
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "max_glob_workers", "0", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetMaxGlobWorkers, SetMaxGlobWorkers, ApplyMaxGlobWorkers,
+                                             nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "max_glob_queue", "64", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetMaxGlobQueue, SetMaxGlobQueue, ApplyMaxGlobQueue,
+                                             nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "max_save_deltas", "0", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetMaxSaveDeltas, SetMaxSaveDeltas, ApplyMaxSaveDeltas,
+                                             nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "save_compression_level", "0", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetSaveCompressionLevel, SetSaveCompressionLevel,
+                                             ApplySaveCompressionLevel, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "append_fsync", "1000", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetAppendFsync, SetAppendFsync, ApplyAppendFsync, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "append_segment_size", "67108864", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetAppendSegmentSize, SetAppendSegmentSize,
+                                             ApplyAppendSegmentSize, nullptr);
+
+    // after the two above, so the log opens with them already set
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "append_log", "off", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetAppendLog, SetAppendLog, ApplyAppendLog, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "latency_tracking", "off", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetLatencyTracking, SetLatencyTracking, ApplyLatencyTracking,
+                                             nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "lock_profiling", "off", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetLockProfiling, SetLockProfiling, ApplyLockProfiling,
+                                             nullptr);
+
     ret |= ValkeyModule_RegisterStringConfig(ctx, "max_defrag_page_count", "10", VALKEYMODULE_CONFIG_DEFAULT,
                                              GetMaxDefragPageCount, SetMaxDefragPageCount, ApplyMaxDefragPageCount,
                                              nullptr);
@@ -1175,6 +1678,9 @@ int barch::register_valkey_configuration(ValkeyModuleCtx *ctx) {
                                              GetUseVMMemory, SetUseVMMemory,
                                              ApplyUseVMMemory, nullptr);
 
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "verify_mapped_pages", "off", VALKEYMODULE_CONFIG_DEFAULT,
+                                             GetVerifyMappedPages, SetVerifyMappedPages, nullptr, nullptr);
+
     ret |= ValkeyModule_RegisterStringConfig(ctx, "static_bloom_filter", "no", VALKEYMODULE_CONFIG_DEFAULT,
                                          GetStaticBloomFilter, SetStaticBloomFilter,
                                          ApplyStaticBloomFilter, nullptr);
@@ -1207,6 +1713,30 @@ int barch::register_valkey_configuration(ValkeyModuleCtx *ctx) {
                                                  GetForeignScriptInsns, SetForeignScriptInsns,
                                                  ApplyForeignScriptInsns, nullptr);
 
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "repl_queue_max", "1000000", VALKEYMODULE_CONFIG_DEFAULT,
+                                                 GetReplQueueMax, SetReplQueueMax,
+                                                 ApplyReplQueueMax, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "repl_backpressure", "resync", VALKEYMODULE_CONFIG_DEFAULT,
+                                                 GetReplBackpressure, SetReplBackpressure,
+                                                 ApplyReplBackpressure, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "repl_backoff_max_ms", "5000", VALKEYMODULE_CONFIG_DEFAULT,
+                                                 GetReplBackoffMaxMs, SetReplBackoffMaxMs,
+                                                 ApplyReplBackoffMaxMs, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "maintenance_threads", "0", VALKEYMODULE_CONFIG_DEFAULT,
+                                                 GetMaintenanceThreads, SetMaintenanceThreads,
+                                                 ApplyMaintenanceThreads, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "lfu_log_factor", "10", VALKEYMODULE_CONFIG_DEFAULT,
+                                                 GetLfuLogFactor, SetLfuLogFactor,
+                                                 ApplyLfuLogFactor, nullptr);
+
+    ret |= ValkeyModule_RegisterStringConfig(ctx, "lfu_decay_time", "1", VALKEYMODULE_CONFIG_DEFAULT,
+                                                 GetLfuDecayTime, SetLfuDecayTime,
+                                                 ApplyLfuDecayTime, nullptr);
+
     ret |= ValkeyModule_RegisterStringConfig(ctx, "ordered_keys", "yes", VALKEYMODULE_CONFIG_DEFAULT,
                                                      GetOrderedKeys, SetOrderedKeys,
                                                      ApplyOrderedKeys, nullptr);
@@ -1253,8 +1783,10 @@ int barch::set_configuration_value(ValkeyModuleString *Name, ValkeyModuleString
 //  - an alias needing a value translated, where the meaning matches but the spelling
 //    of a value does not: redis says noeviction where barch says none.
 //  - a fixed answer, where barch has no such setting but can say something true about
-//    it. appendonly is no because there is no append only file at all. These read, and
-//    refuse to be set, rather than accepting a write that would quietly do nothing.
+//    it. appendonly and appendfsync say what append_log and append_fsync are doing, but
+//    a barch append log is not redis's file and is switched by its own names. These
+//    read, and refuse to be set, rather than accepting a write that would quietly do
+//    nothing.
 //
 // A redis name that is none of those is deliberately absent. CONFIG GET then returns
 // nothing for it, which is what redis does for a parameter it does not know, and is a
@@ -1275,8 +1807,8 @@ namespace {
     };
     struct redis_fixed { const char* redis_name; const char* value; const char* why; };
     const redis_fixed redis_fixed_values[] = {
-        {"appendonly",      "no", "there is no append only file"},
-        {"appendfsync",     "no", "there is no append only file"},
+        {"appendonly",      "no", "set append_log instead"},
+        {"appendfsync",     "no", "set append_fsync instead"},
         {"cluster-enabled", "no", "barch is not a cluster member"},
         {"daemonize",       "no", "barch runs inside its host server"},
         {"timeout",         "0",  "idle connections are not closed on a timer"},
@@ -1396,6 +1928,15 @@ bool barch::get_redis_configuration_value(const std::string& name, std::string&
             return true;
         }
     }
+    if (name == "appendonly") {
+        value = get_append_log() ? "yes" : "no";
+        return true;
+    }
+    if (name == "appendfsync") {
+        auto ms = get_append_fsync_ms();
+        value = ms == 0 ? "always" : ms < 0 ? "no" : "everysec";
+        return true;
+    }
     for (const auto& f : redis_fixed_values) {
         if (name == f.redis_name) { value = f.value; return true; }
     }
@@ -1466,6 +2007,44 @@ int barch::set_configuration_value(const std::string& name, const std::string &v
         return SetMaxDefragPageCount(val);
     } else if (name == "max_scan_iterators") {
         return SetMaxScanIterators(val);
+    } else if (name == "max_glob_workers") {
+        return SetMaxGlobWorkers(val);
+    } else if (name == "max_glob_queue") {
+        return SetMaxGlobQueue(val);
+    } else if (name == "max_save_deltas") {
+        return SetMaxSaveDeltas(val);
+    } else if (name == "save_compression_level") {
+        return SetSaveCompressionLevel(val);
+    } else if (name == "append_log") {
+        auto r = SetAppendLog(val);
+        if (VALKEYMODULE_OK == r) {
+            return ApplyAppendLog(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "latency_tracking") {
+        auto r = SetLatencyTracking(val);
+        if (VALKEYMODULE_OK == r) {
+            return ApplyLatencyTracking(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "lock_profiling") {
+        auto r = SetLockProfiling(val);
+        if (VALKEYMODULE_OK == r) {
+            return ApplyLockProfiling(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "append_fsync") {
+        auto r = SetAppendFsync(val);
+        if (VALKEYMODULE_OK == r) {
+            return ApplyAppendFsync(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "append_segment_size") {
+        auto r = SetAppendSegmentSize(val);
+        if (VALKEYMODULE_OK == r) {
+            return ApplyAppendSegmentSize(nullptr, nullptr, nullptr);
+        }
+        return r;
     } else if (name == "save_interval") {
         return SetSaveInterval(val);
     } else if (name == "max_modifications_before_save") {
@@ -1474,6 +2053,8 @@ int barch::set_configuration_value(const std::string& name, const std::string &v
         return SetExternalHost(val);
     } else if (name == "use_vmm_mem") {
         return SetUseVMMemory(val);
+    } else if (name == "verify_mapped_pages") {
+        return SetVerifyMappedPages(val);
     } else if (name == "static_bloom_filter") {
         auto r = SetStaticBloomFilter(val);
         if ( VALKEYMODULE_OK == r) {
@@ -1518,6 +2099,42 @@ int barch::set_configuration_value(const std::string& name, const std::string &v
             return ApplyForeignScriptInsns(nullptr, nullptr, nullptr);
         }
         return r;
+    } else if (name == "repl_queue_max") {
+        auto r = SetReplQueueMax(val);
+        if (r == VALKEYMODULE_OK) {
+            return ApplyReplQueueMax(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "repl_backpressure") {
+        auto r = SetReplBackpressure(val);
+        if (r == VALKEYMODULE_OK) {
+            return ApplyReplBackpressure(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "repl_backoff_max_ms") {
+        auto r = SetReplBackoffMaxMs(val);
+        if (r == VALKEYMODULE_OK) {
+            return ApplyReplBackoffMaxMs(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "maintenance_threads") {
+        auto r = SetMaintenanceThreads(val);
+        if (r == VALKEYMODULE_OK) {
+            return ApplyMaintenanceThreads(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "lfu_log_factor") {
+        auto r = SetLfuLogFactor(val);
+        if (r == VALKEYMODULE_OK) {
+            return ApplyLfuLogFactor(nullptr, nullptr, nullptr);
+        }
+        return r;
+    } else if (name == "lfu_decay_time") {
+        auto r = SetLfuDecayTime(val);
+        if (r == VALKEYMODULE_OK) {
+            return ApplyLfuDecayTime(nullptr, nullptr, nullptr);
+        }
+        return r;
     }else if (name == "ordered_keys") {
         auto r = SetOrderedKeys(val);
         if (r == VALKEYMODULE_OK) {
@@ -1671,6 +2288,56 @@ uint64_t barch::get_max_scan_iterators() {
     return config().max_scan_iterators;
 }
 
+uint64_t barch::get_max_glob_workers() {
+    std::lock_guard lock(state().config_mutex);
+    return config().max_glob_workers;
+}
+
+uint64_t barch::get_max_glob_queue() {
+    std::lock_guard lock(state().config_mutex);
+    return config().max_glob_queue;
+}
+
+uint64_t barch::get_max_save_deltas() {
+    std::lock_guard lock(state().config_mutex);
+    return config().max_save_deltas;
+}
+
+uint64_t barch::get_save_compression_level() {
+    std::lock_guard lock(state().config_mutex);
+    return config().save_compression_level;
+}
+
+bool barch::get_append_log() {
+    std::lock_guard lock(state().config_mutex);
+    return config().append_log;
+}
+
+bool barch::get_latency_tracking() {
+    std::lock_guard lock(state().config_mutex);
+    return config().latency_tracking;
+}
+
+bool barch::get_lock_profiling() {
+    std::lock_guard lock(state().config_mutex);
+    return config().lock_profiling;
+}
+
+bool barch::get_verify_mapped_pages() {
+    std::lock_guard lock(state().config_mutex);
+    return config().verify_mapped_pages;
+}
+
+int64_t barch::get_append_fsync_ms() {
+    std::lock_guard lock(state().config_mutex);
+    return config().append_fsync_ms;
+}
+
+uint64_t barch::get_append_segment_size() {
+    std::lock_guard lock(state().config_mutex);
+    return config().append_segment_size;
+}
+
 uint64_t barch::get_max_defrag_page_count() {
     std::lock_guard lock(state().config_mutex);
     return config().max_defrag_page_count;
@@ -1717,6 +2384,36 @@ uint64_t barch::get_foreign_script_insns() {
     return config().foreign_script_insns;
 }
 
+uint64_t barch::get_lfu_decay_time() {
+    std::lock_guard lock(state().config_mutex);
+    return config().lfu_decay_time;
+}
+
+uint64_t barch::get_lfu_log_factor() {
+    std::lock_guard lock(state().config_mutex);
+    return config().lfu_log_factor;
+}
+
+uint64_t barch::get_maintenance_threads() {
+    std::lock_guard lock(state().config_mutex);
+    return config().maintenance_threads;
+}
+
+uint64_t barch::get_repl_backoff_max_ms() {
+    std::lock_guard lock(state().config_mutex);
+    return config().repl_backoff_max_ms;
+}
+
+uint64_t barch::get_repl_queue_max() {
+    std::lock_guard lock(state().config_mutex);
+    return config().repl_queue_max;
+}
+
+int barch::get_repl_backpressure() {
+    std::lock_guard lock(state().config_mutex);
+    return config().repl_backpressure;
+}
+
 bool barch::get_log_page_access_trace() {
     //std::lock_guard lock(state().config_mutex);
     return config().log_page_access_trace;
@@ -1748,6 +2445,11 @@ uint64_t barch::get_server_port() {
     return config().server_port;
 }
 
+std::string barch::get_external_host() {
+    std::lock_guard lock(state().config_mutex);
+    return config().external_host;
+}
+
 std::string barch::get_server_binding() {
     std::lock_guard lock(state().config_mutex);
     return config().server_binding;
@@ -1811,17 +2513,22 @@ static std::string cfg_float(F v) {
 
 const std::vector<std::string>& barch::configuration_names() {
     static const std::vector<std::string> names = {
-        "active_defrag", "compression", "db_number_prefix", "eviction_policy",
+        "active_defrag", "append_fsync", "append_log", "append_segment_size",
+        "compression", "db_number_prefix", "eviction_policy",
         "external_host", "foreign_pool_max_age_ms", "foreign_script_insns",
         "foreign_timeout_ms",
-        "iteration_worker_count", "listen_port", "log_page_access_trace",
-        "maintenance_poll_delay", "max_defrag_page_count", "max_memory_bytes",
-        "max_modifications_before_save", "max_resp_connections", "max_scan_iterators",
-        "min_compressed_size", "min_fragmentation_ratio", "ordered_keys",
-        "pre_evict_thresh", "rpc_client_max_wait_ms", "rpc_max_buffer", "save_interval",
-        "server_binding", "server_port", "static_bloom_filter",
+        "iteration_worker_count", "latency_tracking", "lfu_decay_time", "lfu_log_factor",
+        "listen_port", "lock_profiling", "log_page_access_trace",
+        "maintenance_poll_delay", "maintenance_threads", "max_defrag_page_count",
+        "max_glob_queue", "max_glob_workers", "max_memory_bytes",
+        "max_modifications_before_save", "max_resp_connections", "max_save_deltas",
+        "max_scan_iterators", "min_compressed_size", "min_fragmentation_ratio",
+        "ordered_keys",
+        "pre_evict_thresh", "repl_backoff_max_ms", "repl_backpressure", "repl_queue_max",
+        "rpc_client_max_wait_ms", "rpc_max_buffer", "save_compression_level",
+        "save_interval", "server_binding", "server_port", "static_bloom_filter",
         "tls_pem_certificate_chain_file", "tls_private_key_file", "tls_tmp_dh_file",
-        "use_vmm_mem"
+        "use_vmm_mem", "verify_mapped_pages"
     };
     return names;
 }
@@ -1830,6 +2537,11 @@ static bool get_native_configuration_value(const std::string& name, std::string&
     std::lock_guard lock(state().config_mutex);
     const auto& c = config();
     if (name == "active_defrag")                    value = cfg_bool(c.active_defrag);
+    else if (name == "append_fsync")                value = state().append_fsync.c_str();
+    else if (name == "append_log")                  value = cfg_bool(c.append_log);
+    else if (name == "append_segment_size")         value = std::to_string(c.append_segment_size);
+    else if (name == "latency_tracking")            value = cfg_bool(c.latency_tracking);
+    else if (name == "lock_profiling")              value = cfg_bool(c.lock_profiling);
     else if (name == "compression")                 value = state().compression_type.c_str();
     else if (name == "db_number_prefix")            value = state().db_number_prefix.c_str();
     else if (name == "eviction_policy")             value = state().eviction_type.c_str();
@@ -1838,18 +2550,28 @@ static bool get_native_configuration_value(const std::string& name, std::string&
     else if (name == "foreign_script_insns")        value = std::to_string(c.foreign_script_insns);
     else if (name == "foreign_timeout_ms")          value = std::to_string(c.foreign_timeout_ms);
     else if (name == "iteration_worker_count")      value = std::to_string(c.iteration_worker_count);
+    else if (name == "lfu_decay_time")              value = std::to_string(c.lfu_decay_time);
+    else if (name == "lfu_log_factor")              value = std::to_string(c.lfu_log_factor);
     else if (name == "listen_port")                 value = std::to_string(c.listen_port);
     else if (name == "log_page_access_trace")       value = cfg_bool(c.log_page_access_trace);
     else if (name == "maintenance_poll_delay")      value = std::to_string(c.maintenance_poll_delay);
+    else if (name == "maintenance_threads")         value = std::to_string(c.maintenance_threads);
     else if (name == "max_defrag_page_count")       value = std::to_string(c.max_defrag_page_count);
+    else if (name == "max_glob_queue")              value = std::to_string(c.max_glob_queue);
+    else if (name == "max_glob_workers")            value = std::to_string(c.max_glob_workers);
     else if (name == "max_memory_bytes")            value = std::to_string(c.n_max_memory_bytes);
     else if (name == "max_modifications_before_save") value = std::to_string(c.max_modifications_before_save);
     else if (name == "max_resp_connections")        value = std::to_string(c.max_resp_connections);
+    else if (name == "max_save_deltas")             value = std::to_string(c.max_save_deltas);
+    else if (name == "save_compression_level")      value = std::to_string(c.save_compression_level);
     else if (name == "max_scan_iterators")          value = std::to_string(c.max_scan_iterators);
     else if (name == "min_compressed_size")         value = std::to_string(c.min_compressed_size);
     else if (name == "min_fragmentation_ratio")     value = cfg_float(c.min_fragmentation_ratio);
     else if (name == "ordered_keys")                value = cfg_bool(c.ordered_keys);
     else if (name == "pre_evict_thresh")            value = cfg_float(c.pre_evict_thresh);
+    else if (name == "repl_backoff_max_ms")         value = std::to_string(c.repl_backoff_max_ms);
+    else if (name == "repl_backpressure")           value = state().repl_backpressure.c_str();
+    else if (name == "repl_queue_max")              value = std::to_string(c.repl_queue_max);
     else if (name == "rpc_client_max_wait_ms")      value = std::to_string(c.rpc_client_max_wait_ms);
     else if (name == "rpc_max_buffer")              value = std::to_string(c.rpc_max_buffer);
     else if (name == "save_interval")               value = std::to_string(c.save_interval);
@@ -1860,6 +2582,7 @@ static bool get_native_configuration_value(const std::string& name, std::string&
     else if (name == "tls_private_key_file")        value = c.tls_private_key_file;
     else if (name == "tls_tmp_dh_file")             value = c.tls_tmp_dh_file;
     else if (name == "use_vmm_mem")                 value = cfg_bool(c.use_vmm_memory);
+    else if (name == "verify_mapped_pages")         value = cfg_bool(c.verify_mapped_pages);
     else return false;
     return true;
 }
@@ -19,6 +19,16 @@ namespace barch {
         compression_none = 0,
         compression_zstd = 1
     };
+    /**
+     * what a replication destination does when its queue is full: make the writer wait,
+     * throw away the oldest queued command, or drop the whole queue and have the
+     * destination load everything again once it is reachable
+     */
+    enum repl_backpressure_type {
+        repl_backpressure_block = 0,
+        repl_backpressure_drop_oldest = 1,
+        repl_backpressure_resync = 2
+    };
 
     struct configuration_record {
         int compression = compression_none;
@@ -27,13 +37,47 @@ namespace barch {
         uint64_t max_defrag_page_count{8};
         // how many SCAN cursors one connection may hold open at once
         uint64_t max_scan_iterators{128};
+        // page scanning threads all running KEYS/VALUES share, 0 for one per core
+        uint64_t max_glob_workers{0};
+        // KEYS/VALUES that may wait for a scanning thread before the next is refused
+        uint64_t max_glob_queue{64};
         uint64_t save_interval{3000 * 1000};
         uint64_t max_modifications_before_save{10000000};
+        // saves that write only the pages changed since the last one before a full
+        // snapshot is written again, 0 to write every save in full
+        uint64_t max_save_deltas{0};
+        // the zstd level a full snapshot's pages are compressed at, 0 to write them as a
+        // page image instead, which takes more room but maps on load
+        uint64_t save_compression_level{0};
+        // whether writes go to the append log as well, how often it is fsynced - 0 after
+        // every write, -1 never, otherwise every so many milliseconds - and the bytes a
+        // segment of it grows to before the next is started
+        bool append_log{false};
+        int64_t append_fsync_ms{1000};
+        uint64_t append_segment_size{64*1024*1024};
+        // whether calls and shard latch waits are timed for INFO latencystats
+        bool latency_tracking{false};
+        // whether shard latches time their waits and holds and sample who holds them
+        bool lock_profiling{false};
         uint64_t rpc_max_buffer{32768*4};
         uint64_t rpc_client_max_wait_ms{30000};
         uint64_t foreign_timeout_ms{300000};
         uint64_t foreign_pool_max_age_ms{30000};
         uint64_t foreign_script_insns{1000000};
+        // commands one replication destination may have queued before repl_backpressure applies
+        uint64_t repl_queue_max{1000000};
+        // the longest a replication sender waits between reconnect attempts
+        uint64_t repl_backoff_max_ms{5000};
+        // resync by default: with block, one replica that is away stalls every writer
+        // once its queue is full
+        int repl_backpressure = repl_backpressure_resync;
+        // workers in the shared shard maintenance pool, 0 for a quarter of the cores
+        uint64_t maintenance_threads{0};
+        // how many hits it takes to move an lfu counter, as in redis: higher spreads the counter
+        // over more accesses
+        uint64_t lfu_log_factor{10};
+        // minutes an lfu counter takes to drop by one while its key is idle, 0 never decays
+        uint64_t lfu_decay_time{1};
         uint64_t rpc_connect_to_s{30};
         uint64_t rpc_read_to_s{30};
         uint64_t rpc_write_to_s{30};
@@ -52,6 +96,9 @@ namespace barch {
         uint64_t min_compressed_size {64};
         bool ordered_keys{true};
         bool use_vmm_memory{true};
+        // whether a mapped snapshot load reads every page to check its crc32c, which
+        // loads the whole image instead of leaving the pages in the file until used
+        bool verify_mapped_pages{false};
         bool static_bloom_filter{false};
         bool active_defrag{true};
         bool evict_volatile_lru{false};
@@ -87,6 +134,24 @@ namespace barch {
 
     uint64_t get_max_scan_iterators();
 
+    uint64_t get_max_glob_workers();
+
+    uint64_t get_max_glob_queue();
+
+    uint64_t get_max_save_deltas();
+
+    uint64_t get_save_compression_level();
+
+    bool get_append_log();
+
+    int64_t get_append_fsync_ms();
+
+    uint64_t get_append_segment_size();
+
+    bool get_latency_tracking();
+
+    bool get_lock_profiling();
+
     uint64_t get_max_resp_connections();
 
     unsigned get_iteration_worker_count();
@@ -116,6 +181,8 @@ namespace barch {
 
     bool get_use_vmm_memory();
 
+    bool get_verify_mapped_pages();
+
     bool get_ordered_keys();
 
     bool get_static_bloom_filter();
@@ -127,6 +194,20 @@ namespace barch {
     /** what SELECT <n> puts before the number to name the space it selects; "db" by default */
     std::string get_db_number_prefix();
     uint64_t get_internal_shards();
+    /** lfu decay period in minutes */
+    uint64_t get_lfu_decay_time();
+    /** lfu counter log factor */
+    uint64_t get_lfu_log_factor();
+    /** workers in the shared maintenance pool; 0 picks a quarter of the cores */
+    uint64_t get_maintenance_threads();
+    /** the host name other servers reach this one by */
+    std::string get_external_host();
+    /** the ceiling on a replication sender's reconnect backoff */
+    uint64_t get_repl_backoff_max_ms();
+    /** how many commands one replication destination may queue */
+    uint64_t get_repl_queue_max();
+    /** one of repl_backpressure_type */
+    int get_repl_backpressure();
 
     uint64_t get_rpc_max_buffer();
 
@@ -185,8 +266,8 @@ namespace barch {
     bool get_redis_configuration_value(const std::string& name, std::string& value);
 
     /**
-     * True for a setting barch reports but cannot change - appendonly, because there is
-     * no append only file to turn on. `why` is filled in with a reason fit to send back
+     * True for a setting barch reports but cannot change - appendonly, because barch's
+     * append log is switched by append_log rather than by redis's name. `why` is filled in with a reason fit to send back
      * to whoever asked, so a refusal says something more useful than that it failed.
      */
     bool is_read_only_configuration(const std::string& name, std::string& why);
@@ -30,13 +30,50 @@ enum {
     // 14 is the member index marker (DONE 62): it used to encode as a component with no
     // separator, which made an ordered set's index key identical to the key of a set whose
     // name began with an 0x03, so the two could not be told apart at all
-    storage_version = page_size + 15 + test_memory,
+    // 16 puts a crc32c behind every page of an image and of a page record, where a page
+    // record had an unused word, so a page written at 15 would fail its check
+    storage_version = page_size + 16 + test_memory,
     ticker_size = 16,
     numeric_key_size = 12,
     num32_key_size = 6,
     composite_key_size = 2,
     max_queries_per_call = 32,
-    static_bloom_size = 32768*128,
+    // a shard's key filter is sized at this many bits a key, about a 1% false positive
+    // rate, and for no fewer keys than bloom_min_keys
+    bloom_bits_per_key = 10,
+    bloom_min_keys = 1024,
+    // what a new key's lfu counter starts at, so it is not the first thing evicted
+    lfu_init_count = 5,
+    // the fewest and the most slots a shard's lfu counters have, whatever its key count
+    lfu_counters_min = 1024,
+    lfu_counters_max = 1 << 22,
+    // the lowest frequency keys a shard remembers between eviction rounds
+    lfu_pool_size = 128,
+    // random leaf pages each lfu round samples to refill that pool
+    lfu_sample_pages = 2,
+    // rounds one maintenance pass may take before it lets the shard go
+    lfu_eviction_rounds = 8,
+    // expired keys one maintenance pass reclaims from a shard, the rest wait for the next
+    expiry_sweep_limit = 65536,
+    // lookups a batched search keeps in flight at once, each waiting on its own prefetch
+    lookup_batch_width = 8,
+    // the bytes of logged writes that wake the append log's flusher before its interval is
+    // up, how long it sleeps with append_fsync off, and the entries a replay runs on one
+    // thread before it spreads them over a thread per shard
+    append_log_flush_bytes = 1 << 20,
+    append_log_idle_ms = 1000,
+    append_log_parallel_entries = 1024,
+    // threads that compress a snapshot's pages while it is written, the pages each takes
+    // at a time, and the batches that may wait for the writer before they stop
+    save_workers = 4,
+    save_batch_pages = 16,
+    save_batches_in_flight = 2 * save_workers,
+    // leaves a glob walking the tree copies out under one read lock before matching them
+    glob_walk_chunk = 1024,
+    // a mapped snapshot reserves this many times its size in address space, and no less
+    // than mapped_reserve_min bytes, to grow into before its pages have to be copied out
+    mapped_reserve_factor = 4,
+    mapped_reserve_min = 1 << 30,
     leaf_type = 1,
     non_leaf_type = 2,
     comparable_key_static_size = 64,
@@ -4,6 +4,7 @@
 
 #ifndef BARCH_DEBUGGABLE_SERVER_LOCK_H
 #define BARCH_DEBUGGABLE_SERVER_LOCK_H
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -14,6 +15,10 @@
 #include <thread>
 #include <vector>
 
+#if defined(__linux__) && defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
 #ifdef BARCH_LOCK_DEBUG
 #include <cstdio>
 #include <cstdlib>
@@ -23,9 +28,6 @@
 #ifdef __linux__
 #include <unistd.h>
 #include <sys/syscall.h>
-#ifdef __GLIBC__
-#include <execinfo.h>
-#endif
 #endif
 #if __has_include(<stacktrace>) && __cplusplus >= 202302L
 #include <stacktrace>
@@ -35,6 +37,9 @@
 
 struct alignas(64) CoreReaderSlot {
     std::atomic<int32_t> reader_count{0};
+    // shared acquisitions counted where the reader already writes, not in one
+    // counter every reader would fight over, and only while profiling
+    std::atomic<uint64_t> acquired{0};
 #ifdef BARCH_LOCK_DEBUG
     std::atomic<uint32_t> last_tid{0};
 #endif
@@ -53,6 +58,45 @@ struct LockDiagnostics {
 };
 #endif
 
+/**
+ * What a lock has cost the threads that used it, for INFO locks. Most counts are
+ * always kept: waits and failures are only counted on paths that already wait, and
+ * unique acquisitions under the mutex the writer holds anyway. Shared acquisitions,
+ * which would be a write on every read, wait and hold times, and where the writers that
+ * hold it come from are only taken while profiling is on.
+ */
+struct LockContention {
+    std::atomic<uint64_t> shared_waits{0};
+    std::atomic<uint64_t> unique_acquired{0};
+    std::atomic<uint64_t> unique_waits{0};
+    std::atomic<uint64_t> upgrades{0};
+    std::atomic<uint64_t> upgrade_failures{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> wait_ns{0};
+    std::atomic<uint64_t> max_wait_ns{0};
+    std::atomic<uint64_t> hold_ns{0};
+    std::atomic<uint64_t> max_hold_ns{0};
+};
+
+// one place writers were seen taking the lock from, by the stack they had
+struct LockHoldSite {
+    static constexpr int max_frames = 12;
+    void* frames[max_frames]{};
+    int nframes{0};
+    uint64_t samples{0};
+    uint64_t wait_ns{0};
+    uint64_t hold_ns{0};
+};
+
+// the sampled sites, kept to the ones seen most. made on the first sample so locks
+// that are never profiled do not carry them
+struct LockHoldSites {
+    static constexpr int max_sites = 8;
+    std::mutex m{};
+    LockHoldSite sites[max_sites]{};
+    int n{0};
+};
+
 /**
  * Reader/writer lock with per-thread reader slots. Upgradable holds are
  * readers plus the exclusive right to become unique later, so compress
@@ -65,6 +109,8 @@ public:
     // DEPENDS takes every shard of two spaces, then storage_release
     // nested-shared-locks the source again. 16 hid most of the list.
     static constexpr int max_held = 2048;
+    // one in this many unique acquisitions of a thread records its stack while profiling
+    static constexpr uint64_t site_sample_every = 64;
 #ifdef BARCH_LOCK_DEBUG
     static constexpr int label_cap = 80;
     static constexpr auto dump_every = std::chrono::seconds(15);
@@ -76,6 +122,25 @@ public:
         int rec;
     };
 
+    /** times waits and holds, and samples hold sites, on every lock. lock_profiling sets it */
+    static inline std::atomic<bool> profiling{false};
+
+    /** a copy of what LockContention and the sites held when it was taken */
+    struct contention_report {
+        uint64_t shared_acquired{0};
+        uint64_t shared_waits{0};
+        uint64_t unique_acquired{0};
+        uint64_t unique_waits{0};
+        uint64_t upgrades{0};
+        uint64_t upgrade_failures{0};
+        uint64_t timeouts{0};
+        uint64_t wait_ns{0};
+        uint64_t max_wait_ns{0};
+        uint64_t hold_ns{0};
+        uint64_t max_hold_ns{0};
+        std::vector<LockHoldSite> sites{};
+    };
+
 private:
     std::vector<CoreReaderSlot> core_slots;
     std::timed_mutex upgrade_write_mtx;
@@ -86,6 +151,13 @@ private:
     size_t num_slots{1};
     mutable std::atomic<size_t> slot_ticket{0};
 
+    LockContention contention_{};
+    std::atomic<LockHoldSites*> sites_{nullptr};
+    // when the writer that holds it now took it, and the site it was sampled at. only
+    // the writer reads or writes these
+    int64_t write_from_ns{0};
+    int write_site{-1};
+
 #ifdef BARCH_LOCK_DEBUG
     char label_[label_cap]{"(unnamed)"};
     LockDiagnostics diags;
@@ -200,6 +272,127 @@ private:
         }
     }
 
+    static int64_t now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // when a wait started, or 0 when nothing is timed
+    static int64_t profile_clock() noexcept {
+        return profiling.load(std::memory_order_relaxed) ? now_ns() : 0;
+    }
+
+    static void raise(std::atomic<uint64_t>& to, uint64_t v) noexcept {
+        uint64_t was = to.load(std::memory_order_relaxed);
+        while (v > was && !to.compare_exchange_weak(was, v, std::memory_order_relaxed)) {}
+    }
+
+    void count_shared(size_t s) noexcept {
+        if (profiling.load(std::memory_order_relaxed))
+            core_slots[s].acquired.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void count_wait(int64_t wait_from) noexcept {
+        if (!wait_from)
+            return;
+        auto waited = static_cast<uint64_t>(now_ns() - wait_from);
+        contention_.wait_ns.fetch_add(waited, std::memory_order_relaxed);
+        raise(contention_.max_wait_ns, waited);
+    }
+
+    // a wait that gave up. try_lock() giving up at once is not a timeout
+    template <typename Rep, typename Period>
+    void count_failure(const std::chrono::duration<Rep, Period>& timeout_duration, int64_t wait_from) noexcept {
+        if (timeout_duration.count() > 0)
+            contention_.timeouts.fetch_add(1, std::memory_order_relaxed);
+        count_wait(wait_from);
+    }
+
+    // one in site_sample_every writes of a thread while profiling takes its stack, before
+    // it waits for the lock: the walk is slow, and nobody should wait on it
+    static LockHoldSite writer_stack() noexcept {
+        LockHoldSite seen{};
+        if (!profiling.load(std::memory_order_relaxed))
+            return seen;
+        static thread_local uint64_t writes = 0;
+        if (++writes % site_sample_every != 0)
+            return seen;
+#if defined(__linux__) && defined(__GLIBC__)
+        seen.nframes = backtrace(seen.frames, LockHoldSite::max_frames);
+#endif
+        return seen;
+    }
+
+    // count the writer whose stack was taken against the site it came from
+    int sample_site(const LockHoldSite& seen, uint64_t waited) noexcept {
+        if (seen.nframes <= 0)
+            return -1;
+        auto* sites = sites_.load(std::memory_order_acquire);
+        if (!sites) {
+            // only the writer that holds the lock gets here, so there is one of it
+            sites = new LockHoldSites();
+            sites_.store(sites, std::memory_order_release);
+        }
+        std::lock_guard<std::mutex> guard(sites->m);
+        int at = -1;
+        for (int i = 0; i < sites->n && at < 0; ++i) {
+            auto& site = sites->sites[i];
+            if (site.nframes == seen.nframes &&
+                std::equal(site.frames, site.frames + site.nframes, seen.frames))
+                at = i;
+        }
+        if (at < 0) {
+            if (sites->n < LockHoldSites::max_sites) {
+                at = sites->n++;
+            } else {
+                // the least seen site makes room, as a space saving top k would
+                at = 0;
+                for (int i = 1; i < sites->n; ++i) {
+                    if (sites->sites[i].samples < sites->sites[at].samples)
+                        at = i;
+                }
+            }
+            sites->sites[at] = seen;
+            sites->sites[at].samples = 0;
+            sites->sites[at].wait_ns = 0;
+            sites->sites[at].hold_ns = 0;
+        }
+        ++sites->sites[at].samples;
+        sites->sites[at].wait_ns += waited;
+        return at;
+    }
+
+    void count_unique(bool waited, int64_t wait_from, const LockHoldSite& seen) noexcept {
+        contention_.unique_acquired.fetch_add(1, std::memory_order_relaxed);
+        if (waited)
+            contention_.unique_waits.fetch_add(1, std::memory_order_relaxed);
+        write_site = -1;
+        write_from_ns = 0;
+        if (!wait_from)
+            return;
+        write_from_ns = now_ns();
+        auto wait = static_cast<uint64_t>(write_from_ns - wait_from);
+        contention_.wait_ns.fetch_add(wait, std::memory_order_relaxed);
+        raise(contention_.max_wait_ns, wait);
+        write_site = sample_site(seen, wait);
+    }
+
+    void count_release() noexcept {
+        if (!write_from_ns)
+            return;
+        auto held_for = static_cast<uint64_t>(now_ns() - write_from_ns);
+        write_from_ns = 0;
+        contention_.hold_ns.fetch_add(held_for, std::memory_order_relaxed);
+        raise(contention_.max_hold_ns, held_for);
+        if (write_site >= 0) {
+            auto* sites = sites_.load(std::memory_order_acquire);
+            std::lock_guard<std::mutex> guard(sites->m);
+            sites->sites[write_site].hold_ns += held_for;
+            write_site = -1;
+        }
+    }
+
 #ifdef BARCH_LOCK_DEBUG
     static uint32_t native_tid() noexcept {
         static thread_local uint32_t cached = 0;
@@ -213,12 +406,6 @@ private:
         return cached;
     }
 
-    static int64_t now_ns() noexcept {
-        return std::chrono::duration_cast<std::chrono::nanoseconds>(
-                   std::chrono::steady_clock::now().time_since_epoch())
-            .count();
-    }
-
     static void fmt_ns(std::ostream& os, int64_t ns) {
         if (ns <= 0) {
             os << "n/a";
@@ -335,9 +522,50 @@ public:
         core_slots = std::vector<CoreReaderSlot>(num_slots);
     }
 
+    ~debuggable_server_lock() {
+        delete sites_.load(std::memory_order_acquire);
+    }
+
     debuggable_server_lock(const debuggable_server_lock&) = delete;
     debuggable_server_lock& operator=(const debuggable_server_lock&) = delete;
 
+    contention_report contention() const {
+        contention_report r;
+        for (size_t i = 0; i < num_slots; ++i)
+            r.shared_acquired += core_slots[i].acquired.load(std::memory_order_relaxed);
+        r.shared_waits = contention_.shared_waits.load(std::memory_order_relaxed);
+        r.unique_acquired = contention_.unique_acquired.load(std::memory_order_relaxed);
+        r.unique_waits = contention_.unique_waits.load(std::memory_order_relaxed);
+        r.upgrades = contention_.upgrades.load(std::memory_order_relaxed);
+        r.upgrade_failures = contention_.upgrade_failures.load(std::memory_order_relaxed);
+        r.timeouts = contention_.timeouts.load(std::memory_order_relaxed);
+        r.wait_ns = contention_.wait_ns.load(std::memory_order_relaxed);
+        r.max_wait_ns = contention_.max_wait_ns.load(std::memory_order_relaxed);
+        r.hold_ns = contention_.hold_ns.load(std::memory_order_relaxed);
+        r.max_hold_ns = contention_.max_hold_ns.load(std::memory_order_relaxed);
+        if (auto* sites = sites_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(sites->m);
+            r.sites.assign(sites->sites, sites->sites + sites->n);
+        }
+        return r;
+    }
+
+    void reset_contention() noexcept {
+        for (size_t i = 0; i < num_slots; ++i)
+            core_slots[i].acquired.store(0, std::memory_order_relaxed);
+        for (auto* c : {&contention_.shared_waits, &contention_.unique_acquired, &contention_.unique_waits,
+                        &contention_.upgrades, &contention_.upgrade_failures, &contention_.timeouts,
+                        &contention_.wait_ns, &contention_.max_wait_ns, &contention_.hold_ns,
+                        &contention_.max_hold_ns})
+            c->store(0, std::memory_order_relaxed);
+        if (auto* sites = sites_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(sites->m);
+            for (auto& site : sites->sites)
+                site = LockHoldSite{};
+            sites->n = 0;
+        }
+    }
+
 #ifdef BARCH_LOCK_DEBUG
     void set_label(std::string_view s) noexcept {
         size_t n = s.size();
@@ -431,6 +659,7 @@ public:
         mark_reader(s);
 #endif
         if (!write_intent.load(std::memory_order_seq_cst)) {
+            count_shared(s);
             push_hold('R');
             return true;
         }
@@ -440,6 +669,8 @@ public:
 #ifdef BARCH_LOCK_DEBUG
         int64_t started = now_ns();
 #endif
+        contention_.shared_waits.fetch_add(1, std::memory_order_relaxed);
+        int64_t wait_from = profile_clock();
 
         while (true) {
             core_slots[s].reader_count.fetch_add(1, std::memory_order_seq_cst);
@@ -448,6 +679,8 @@ public:
 #endif
 
             if (!write_intent.load(std::memory_order_seq_cst)) {
+                count_shared(s);
+                count_wait(wait_from);
                 push_hold('R');
                 return true;
             }
@@ -459,6 +692,7 @@ public:
 #ifdef BARCH_LOCK_DEBUG
                 log_if_slow_timeout(timeout_duration, "Shared Read Acquisition", started);
 #endif
+                count_failure(timeout_duration, wait_from);
                 return false;
             }
 #ifdef BARCH_LOCK_DEBUG
@@ -477,6 +711,7 @@ public:
 #ifdef BARCH_LOCK_DEBUG
                     log_if_slow_timeout(timeout_duration, "Shared Read Acquisition", started);
 #endif
+                    count_failure(timeout_duration, wait_from);
                     return false;
                 }
 #ifdef BARCH_LOCK_DEBUG
@@ -505,6 +740,7 @@ public:
         mark_reader(s);
 #endif
         if (!write_intent.load(std::memory_order_seq_cst)) {
+            count_shared(s);
             push_hold('R');
             return true;
         }
@@ -518,16 +754,25 @@ public:
             return;
         }
         const size_t s = slot();
+        int64_t wait_from = 0;
+        bool waited = false;
         while (true) {
             core_slots[s].reader_count.fetch_add(1, std::memory_order_seq_cst);
 #ifdef BARCH_LOCK_DEBUG
             mark_reader(s);
 #endif
             if (!write_intent.load(std::memory_order_seq_cst)) {
+                count_shared(s);
+                count_wait(wait_from);
                 push_hold('R');
                 return;
             }
             backoff_reader(s);
+            if (!waited) {
+                waited = true;
+                contention_.shared_waits.fetch_add(1, std::memory_order_relaxed);
+                wait_from = profile_clock();
+            }
             std::unique_lock<std::mutex> lock(cv_mtx);
 #ifdef BARCH_LOCK_DEBUG
             int64_t started = now_ns();
@@ -555,8 +800,12 @@ public:
         int64_t started = now_ns();
 #endif
 
+        const LockHoldSite seen = writer_stack();
+        int64_t wait_from = profile_clock();
         std::unique_lock<std::timed_mutex> lock(upgrade_write_mtx, std::defer_lock);
-        while (true) {
+        // a writer that finds the mutex free and no readers did not wait
+        bool waited = !lock.try_lock();
+        while (!lock.owns_lock()) {
             auto now = std::chrono::steady_clock::now();
 #ifdef BARCH_LOCK_DEBUG
             auto slice = now + dump_every;
@@ -573,6 +822,7 @@ public:
 #ifdef BARCH_LOCK_DEBUG
                 log_if_slow_timeout(timeout_duration, "Write Mutex Contention", started);
 #endif
+                count_failure(timeout_duration, wait_from);
                 return false;
             }
 #ifdef BARCH_LOCK_DEBUG
@@ -584,6 +834,7 @@ public:
 
         std::unique_lock<std::mutex> cv_lock(cv_mtx);
         while (!readers_drained()) {
+            waited = true;
             auto now = std::chrono::steady_clock::now();
             if (now >= deadline) {
                 write_intent.store(false, std::memory_order_seq_cst);
@@ -591,6 +842,7 @@ public:
 #ifdef BARCH_LOCK_DEBUG
                 log_if_slow_timeout(timeout_duration, "Draining Readers During Write", started);
 #endif
+                count_failure(timeout_duration, wait_from);
                 return false;
             }
 #ifdef BARCH_LOCK_DEBUG
@@ -602,6 +854,7 @@ public:
                     write_intent.store(false, std::memory_order_seq_cst);
                     cv.notify_all();
                     log_if_slow_timeout(timeout_duration, "Draining Readers During Write", started);
+                    count_failure(timeout_duration, wait_from);
                     return false;
                 }
                 log_if_slow_timeout(dump_every, "Draining Readers During Write", started);
@@ -610,6 +863,7 @@ public:
             if (!cv.wait_until(cv_lock, deadline, [this] { return readers_drained(); })) {
                 write_intent.store(false, std::memory_order_seq_cst);
                 cv.notify_all();
+                count_failure(timeout_duration, wait_from);
                 return false;
             }
 #endif
@@ -618,6 +872,7 @@ public:
 #ifdef BARCH_LOCK_DEBUG
         note_writer();
 #endif
+        count_unique(waited, wait_from, seen);
         push_hold('W');
         lock.release();
         return true;
@@ -641,8 +896,11 @@ public:
         // try_lock_for() used to drop both every 15s, so readers flooded
         // back in and the writer never drained.
         int64_t started = now_ns();
+        const LockHoldSite seen = writer_stack();
+        int64_t wait_from = profile_clock();
         std::unique_lock<std::timed_mutex> ul(upgrade_write_mtx, std::defer_lock);
-        while (!ul.try_lock_for(dump_every)) {
+        bool waited = !ul.try_lock();
+        while (!ul.owns_lock() && !ul.try_lock_for(dump_every)) {
             log_if_slow_timeout(dump_every, "Write Mutex Contention", started);
         }
 
@@ -651,6 +909,7 @@ public:
         {
             std::unique_lock<std::mutex> cv_lock(cv_mtx);
             while (!readers_drained()) {
+                waited = true;
                 if (!cv.wait_for(cv_lock, dump_every, [this] { return readers_drained(); })) {
                     log_if_slow_timeout(dump_every, "Draining Readers During Write", started);
                 }
@@ -658,15 +917,25 @@ public:
         }
 
         note_writer();
+        count_unique(waited, wait_from, seen);
         push_hold('W');
         ul.release();
 #else
-        std::unique_lock<std::timed_mutex> ul(upgrade_write_mtx);
+        const LockHoldSite seen = writer_stack();
+        int64_t wait_from = profile_clock();
+        std::unique_lock<std::timed_mutex> ul(upgrade_write_mtx, std::try_to_lock);
+        bool waited = !ul.owns_lock();
+        if (waited)
+            ul.lock();
         write_intent.store(true, std::memory_order_seq_cst);
         {
             std::unique_lock<std::mutex> cv_lock(cv_mtx);
-            cv.wait(cv_lock, [this] { return readers_drained(); });
+            if (!readers_drained()) {
+                waited = true;
+                cv.wait(cv_lock, [this] { return readers_drained(); });
+            }
         }
+        count_unique(waited, wait_from, seen);
         push_hold('W');
         ul.release();
 #endif
@@ -674,6 +943,7 @@ public:
 
     void unlock() noexcept {
         pop_hold();
+        count_release();
 #ifdef BARCH_LOCK_DEBUG
         clear_writer();
 #endif
@@ -701,8 +971,10 @@ public:
         // already a shared reader: must not block on the mutex. a unique
         // waiter already holds it and is draining us — waiting would deadlock.
         if (have == 'R') {
-            if (!lock.try_lock())
+            if (!lock.try_lock()) {
+                contention_.upgrade_failures.fetch_add(1, std::memory_order_relaxed);
                 return false;
+            }
             set_our_hold('U');
 #ifdef BARCH_LOCK_DEBUG
             diags.active_upgrader_id.store(std::this_thread::get_id(), std::memory_order_relaxed);
@@ -715,6 +987,7 @@ public:
 #ifdef BARCH_LOCK_DEBUG
             log_if_slow_timeout(timeout_duration, "Upgrade Mutex Contention", started);
 #endif
+            contention_.upgrade_failures.fetch_add(1, std::memory_order_relaxed);
             return false;
         }
         take_upgradable_reader();
@@ -754,14 +1027,22 @@ public:
 #ifdef BARCH_LOCK_DEBUG
         int64_t started = now_ns();
 #endif
+        const LockHoldSite seen = writer_stack();
+        int64_t wait_from = profile_clock();
+        bool waited = false;
 
         if (have == 'R') {
             std::unique_lock<std::timed_mutex> lock(upgrade_write_mtx, std::defer_lock);
-            if (!lock.try_lock_until(deadline)) {
+            if (!lock.try_lock()) {
+                waited = true;
+                if (!lock.try_lock_until(deadline)) {
 #ifdef BARCH_LOCK_DEBUG
-                log_if_slow_timeout(timeout_duration, "Upgrade Mutex Contention", started);
+                    log_if_slow_timeout(timeout_duration, "Upgrade Mutex Contention", started);
 #endif
-                return false;
+                    contention_.upgrade_failures.fetch_add(1, std::memory_order_relaxed);
+                    count_wait(wait_from);
+                    return false;
+                }
             }
             set_our_hold('U');
 #ifdef BARCH_LOCK_DEBUG
@@ -775,6 +1056,7 @@ public:
 
         std::unique_lock<std::mutex> cv_lock(cv_mtx);
         while (!readers_drained()) {
+            waited = true;
             auto now = std::chrono::steady_clock::now();
             if (now >= deadline) {
                 write_intent.store(false, std::memory_order_seq_cst);
@@ -787,6 +1069,8 @@ public:
                 mark_reader(s);
                 log_if_slow_timeout(timeout_duration, "Draining Readers During Upgrade Escalation", started);
 #endif
+                contention_.upgrade_failures.fetch_add(1, std::memory_order_relaxed);
+                count_wait(wait_from);
                 return false;
             }
 #ifdef BARCH_LOCK_DEBUG
@@ -802,6 +1086,8 @@ public:
                     core_slots[s].reader_count.fetch_add(1, std::memory_order_seq_cst);
                     mark_reader(s);
                     log_if_slow_timeout(timeout_duration, "Draining Readers During Upgrade Escalation", started);
+                    contention_.upgrade_failures.fetch_add(1, std::memory_order_relaxed);
+                    count_wait(wait_from);
                     return false;
                 }
                 log_if_slow_timeout(dump_every, "Draining Readers During Upgrade Escalation", started);
@@ -812,6 +1098,8 @@ public:
                 cv.notify_all();
                 cv_lock.unlock();
                 core_slots[slot()].reader_count.fetch_add(1, std::memory_order_seq_cst);
+                contention_.upgrade_failures.fetch_add(1, std::memory_order_relaxed);
+                count_wait(wait_from);
                 return false;
             }
 #endif
@@ -821,6 +1109,8 @@ public:
         note_writer();
         diags.active_upgrader_id.store(std::thread::id(), std::memory_order_relaxed);
 #endif
+        contention_.upgrades.fetch_add(1, std::memory_order_relaxed);
+        count_unique(waited, wait_from, seen);
         set_our_hold('W');
         return true;
     }
@@ -835,10 +1125,14 @@ public:
 #ifdef BARCH_LOCK_DEBUG
         int64_t started = now_ns();
 #endif
+        const LockHoldSite seen = writer_stack();
+        int64_t wait_from = profile_clock();
         write_intent.store(true, std::memory_order_seq_cst);
         backoff_reader(slot());
+        bool waited = false;
         {
             std::unique_lock<std::mutex> cv_lock(cv_mtx);
+            waited = !readers_drained();
 #ifdef BARCH_LOCK_DEBUG
             while (!readers_drained()) {
                 if (!cv.wait_for(cv_lock, dump_every, [this] { return readers_drained(); }))
@@ -852,6 +1146,8 @@ public:
         note_writer();
         diags.active_upgrader_id.store(std::thread::id(), std::memory_order_relaxed);
 #endif
+        contention_.upgrades.fetch_add(1, std::memory_order_relaxed);
+        count_unique(waited, wait_from, seen);
         set_our_hold('W');
     }
 
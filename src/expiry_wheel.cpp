@@ -0,0 +1,106 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "expiry_wheel.h"
+#include "keyspec.h"
+
+namespace barch {
+    void expiry_wheel::place(entry&& e) {
+        // the tick after the one the deadline falls in, so the key has expired by the
+        // time its entry comes up rather than being a few milliseconds short of it
+        int64_t tick = e.deadline / tick_ms + 1;
+        if (tick <= current) {
+            ready.emplace_back(std::move(e));
+            return;
+        }
+        int64_t delta = tick - current;
+        for (unsigned level = 0; level < levels; ++level) {
+            if (delta < (int64_t(1) << (slot_bits * (level + 1)))) {
+                wheel[level][(tick >> (slot_bits * level)) & (slots - 1)].emplace_back(std::move(e));
+                return;
+            }
+        }
+        overflow.emplace_back(std::move(e));
+    }
+
+    void expiry_wheel::cascade(unsigned level) {
+        bucket moving;
+        moving.swap(wheel[level][(current >> (slot_bits * level)) & (slots - 1)]);
+        for (auto& e : moving) {
+            place(std::move(e));
+        }
+    }
+
+    void expiry_wheel::add(const char* key, size_t size, int64_t deadline) {
+        std::lock_guard l(m);
+        if (current < 0) current = art::now() / tick_ms;
+        place({deadline, heap::string(key, size)});
+        ++count;
+    }
+
+    void expiry_wheel::advance(int64_t now, size_t limit, const std::function<void(const entry&)>& due) {
+        bucket out;
+        {
+            std::lock_guard l(m);
+            int64_t target = now / tick_ms;
+            if (current < 0) current = target;
+            if (target - current > (int64_t)(slots * slots)) {
+                // a long sleep or a clock that stepped forward: turning tick by tick would
+                // take longer than placing everything again from where the wheel is now
+                bucket all;
+                for (auto& level : wheel) {
+                    for (auto& b : level) {
+                        for (auto& e : b) all.emplace_back(std::move(e));
+                        b.clear();
+                    }
+                }
+                for (auto& e : overflow) all.emplace_back(std::move(e));
+                overflow.clear();
+                current = target;
+                for (auto& e : all) place(std::move(e));
+            }
+            while (current < target) {
+                ++current;
+                unsigned level = 1;
+                for (; level < levels; ++level) {
+                    if (current & ((int64_t(1) << (slot_bits * level)) - 1)) break;
+                    cascade(level);
+                }
+                if (level == levels && (current & ((int64_t(1) << (slot_bits * levels)) - 1)) == 0) {
+                    bucket far;
+                    far.swap(overflow);
+                    for (auto& e : far) place(std::move(e));
+                }
+                auto& b = wheel[0][current & (slots - 1)];
+                for (auto& e : b) ready.emplace_back(std::move(e));
+                b.clear();
+            }
+            size_t n = std::min(limit, ready.size());
+            out.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                out.emplace_back(std::move(ready.back()));
+                ready.pop_back();
+            }
+            count -= n;
+        }
+        for (auto& e : out) {
+            due(e);
+        }
+    }
+
+    void expiry_wheel::clear() {
+        std::lock_guard l(m);
+        for (auto& level : wheel) {
+            for (auto& b : level) b.clear();
+        }
+        overflow.clear();
+        ready.clear();
+        count = 0;
+    }
+
+    size_t expiry_wheel::size() const {
+        std::lock_guard l(m);
+        return count;
+    }
+}
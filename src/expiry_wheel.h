@@ -0,0 +1,69 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_EXPIRY_WHEEL_H
+#define BARCH_EXPIRY_WHEEL_H
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "sastam.h"
+
+namespace barch {
+    /**
+     * When the keys of one shard expire, so that maintenance can reclaim them close to their
+     * deadline without looking at keys that have not.
+     *
+     * Expired keys used to be found by sweeping one random leaf page per maintenance pass,
+     * which reclaims a page worth of memory from a shard with millions of short lived keys
+     * about as often as it finds nothing at all. This is a hierarchical timing wheel instead:
+     * four levels of 64 slots, the first a tick of tick_ms wide and every next one 64 times
+     * wider. A deadline goes in the level whose span covers how far away it is; as the wheel
+     * turns past the start of a wider slot its keys are put back in, which lands them a level
+     * lower, until they reach the first level and are handed out on their tick. Adding is
+     * O(1) and turning is proportional to the ticks passed plus the keys that came due.
+     * Deadlines further out than the top level covers wait in an overflow list that is
+     * looked at every time the top level turns over.
+     *
+     * The wheel keeps copies of keys, not leaves: a leaf moves when it is rewritten or
+     * defragmented. An entry is only a hint that a key may have expired - a key that was
+     * given a later deadline, deleted or replaced since is simply not expired when its
+     * entry comes up, and the later deadline has an entry of its own.
+     */
+    class expiry_wheel {
+    public:
+        struct entry {
+            int64_t deadline{};
+            heap::string key{};
+        };
+        static constexpr int64_t tick_ms = 16;
+        static constexpr unsigned slot_bits = 6;
+        static constexpr unsigned slots = 1u << slot_bits;
+        static constexpr unsigned levels = 4;
+
+        /** a key that expires at deadline, milliseconds since the epoch */
+        void add(const char* key, size_t size, int64_t deadline);
+        /**
+         * turn the wheel up to now, giving every entry that came due to due. At most limit
+         * entries are handed out; the rest are kept for the next call
+         */
+        void advance(int64_t now, size_t limit, const std::function<void(const entry&)>& due);
+        void clear();
+        [[nodiscard]] size_t size() const;
+
+    private:
+        typedef heap::vector<entry> bucket;
+        void place(entry&& e);
+        void cascade(unsigned level);
+
+        mutable std::mutex m{};
+        std::array<std::array<bucket, slots>, levels> wheel{};
+        bucket overflow{};
+        bucket ready{};
+        int64_t current{-1};
+        size_t count{};
+    };
+}
+#endif //BARCH_EXPIRY_WHEEL_H
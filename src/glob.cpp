@@ -4,8 +4,10 @@
 
 #include "glob.h"
 #include <ctype.h>
+#include <cstring>
 #include <iostream>
 #include <ostream>
+#include "simd.h"
 // if there's only asterisks in the glob (a very common pattern)
 template<int N>
 inline bool no_token(const char* pattern) {
@@ -325,3 +327,179 @@ int glob::stringmatchlen(art::value_type pattern, art::value_type string, int no
     return stringmatchlen_impl(pattern.chars(), pattern.size, string.chars(), string.size, nocase,
                                &skipLongerMatches, 0);
 }
+
+// ------------------------------------------------------------------------ glob::compiled
+// a class is read the way stringmatchlen_impl reads one, so the two agree on where it
+// ends. false when it runs off the end of the pattern
+static bool class_end(const char *p, size_t n, size_t at, size_t &end) {
+    size_t i = at + 1;
+    if (i < n && p[i] == '^') ++i;
+    while (i < n) {
+        if (p[i] == '\\' && n - i >= 2) {
+            i += 2;
+        } else if (p[i] == ']') {
+            end = i;
+            return true;
+        } else if (n - i >= 3 && p[i + 1] == '-') {
+            i += 3;
+        } else {
+            ++i;
+        }
+    }
+    return false;
+}
+
+glob::compiled::compiled(art::value_type pattern, int nocase)
+    : source(pattern.chars(), pattern.size), nocase(nocase) {
+    const char *p = source.data();
+    size_t n = source.size();
+    size_t stars = 0;
+    segment open{};
+    auto close_segment = [&]() {
+        if (open.length) {
+            // the longest run of elements that accept one byte each
+            size_t run = 0;
+            for (uint32_t i = 0; i <= open.length; ++i) {
+                int only = -1;
+                if (i < open.length) {
+                    const auto &set = sets[open.first + i];
+                    int count = 0;
+                    for (int w = 0; w < 4; ++w) count += __builtin_popcountll(set[w]);
+                    if (count == 1) {
+                        for (int b = 0; b < 256; ++b) {
+                            if (set[b >> 6] >> (b & 63) & 1) only = b;
+                        }
+                    }
+                }
+                if (only >= 0) {
+                    ++run;
+                    continue;
+                }
+                if (run > open.literal.size()) {
+                    open.literal_at = i - run;
+                    open.literal.clear();
+                    for (uint32_t j = open.literal_at; j < i; ++j) {
+                        const auto &set = sets[open.first + j];
+                        for (int b = 0; b < 256; ++b) {
+                            if (set[b >> 6] >> (b & 63) & 1) open.literal.push_back((char) b);
+                        }
+                    }
+                }
+                run = 0;
+            }
+            segments.push_back(open);
+        }
+        open = segment{};
+        open.first = sets.size();
+    };
+    size_t i = 0;
+    while (i < n) {
+        if (p[i] == '*') {
+            while (i < n && p[i] == '*') ++i;
+            if (sets.empty()) leading_star = true;
+            any_star = true;
+            ++stars;
+            close_segment();
+            trailing_star = i == n;
+            continue;
+        }
+        byte_set set{};
+        if (p[i] == '?') {
+            set.fill(~0ull);
+            ++i;
+        } else if (p[i] == '[') {
+            size_t end = 0;
+            if (!class_end(p, n, i, end)) return; // left to stringmatchlen
+            // each byte is put to the reference matcher, so what the class accepts is
+            // exactly what it would have accepted there, ranges and escapes included
+            for (int b = 0; b < 256; ++b) {
+                char c = (char) b;
+                int skip = 0;
+                if (stringmatchlen_impl(p + i, (int) (end - i + 1), &c, 1, nocase, &skip, 0)) {
+                    set[b >> 6] |= 1ull << (b & 63);
+                }
+            }
+            i = end + 1;
+        } else {
+            if (p[i] == '\\' && i + 1 < n) ++i;
+            char literal = p[i++];
+            for (int b = 0; b < 256; ++b) {
+                bool eq = nocase ? tolower((int) (char) b) == tolower((int) literal) : (char) b == literal;
+                if (eq) set[b >> 6] |= 1ull << (b & 63);
+            }
+        }
+        sets.push_back(set);
+        ++open.length;
+        trailing_star = false;
+    }
+    close_segment();
+    // stringmatchlen gives up past this many nested stars, so it is left to say so
+    if (stars > 1000) return;
+    interpreted = false;
+}
+
+bool glob::compiled::fits(const segment &seg, const uint8_t *at) const {
+    const byte_set *set = sets.data() + seg.first;
+    for (uint32_t i = 0; i < seg.length; ++i) {
+        uint8_t b = at[i];
+        if (!(set[i][b >> 6] >> (b & 63) & 1)) return false;
+    }
+    return true;
+}
+
+size_t glob::compiled::find(const segment &seg, const uint8_t *data, size_t from, size_t last_start) const {
+    if (seg.literal.empty()) {
+        for (size_t at = from; at <= last_start; ++at) {
+            if (fits(seg, data + at)) return at;
+        }
+        return std::string::npos;
+    }
+    const auto *literal = (const uint8_t *) seg.literal.data();
+    size_t at = from;
+    while (at <= last_start) {
+        size_t window = last_start - at + seg.literal.size();
+        size_t hit = simd::find_literal(data + at + seg.literal_at, window, literal, seg.literal.size());
+        if (hit == window) break;
+        if (fits(seg, data + at + hit)) return at + hit;
+        at += hit + 1;
+    }
+    return std::string::npos;
+}
+
+int glob::compiled::match(art::value_type subject) const {
+    if (interpreted) {
+        return stringmatchlen(art::value_type{source}, subject, nocase);
+    }
+    const uint8_t *s = subject.bytes;
+    size_t n = subject.size;
+    if (!any_star) {
+        if (segments.empty()) return n == 0;
+        const auto &only = segments[0];
+        return n == only.length && fits(only, s);
+    }
+    if (n == 0) return 0; // as stringmatchlen: a star needs something to start on
+    size_t from = 0;
+    size_t end = n;
+    size_t lo = 0;
+    size_t hi = segments.size();
+    if (!leading_star) {
+        const auto &first = segments[0];
+        if (first.length > n || !fits(first, s)) return 0;
+        from = first.length;
+        lo = 1;
+    }
+    if (!trailing_star && hi > lo) {
+        const auto &last = segments[hi - 1];
+        if (last.length > end - from || !fits(last, s + n - last.length)) return 0;
+        end = n - last.length;
+        --hi;
+    }
+    for (size_t k = lo; k < hi; ++k) {
+        const auto &seg = segments[k];
+        if (seg.length > end - from) return 0;
+        size_t at = find(seg, s, from, end - seg.length);
+        if (at == std::string::npos) return 0;
+        from = at + seg.length;
+    }
+    return 1;
+}
@@ -35,8 +35,66 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include "value_type.h"
+#include <array>
+#include <string>
+#include <vector>
 
 struct glob {
+    /**
+     * A pattern read once and kept in a form that is quick to apply to many subjects -
+     * what KEYS, VALUES and SCAN MATCH do, where stringmatchlen used to re-read the
+     * pattern for every key of every page.
+     *
+     * The stars cut the pattern into segments. Every other element of it - a literal, a
+     * '?', a class - stands for one byte, so it is compiled to the set of bytes it
+     * accepts, with case folding and negation already applied. A segment before the
+     * first star has to match at the start of the subject, one after the last star at
+     * the end, and those in between are each found leftmost after the one before, which
+     * is all the backtracking a glob ever needs. Inside a segment the longest run of
+     * elements that each accept one byte only is searched for with simd::find_literal,
+     * and the rest of the segment is checked around what it finds.
+     *
+     * It answers what stringmatchlen answers for every pattern, including its quirks:
+     * an empty subject only matches an empty pattern. The few patterns it cannot say
+     * the same about - an unterminated class, or more stars than the reference's
+     * nesting limit - are left to stringmatchlen. It is not changed by match, so one
+     * instance can be shared by every thread of a scan.
+     */
+    class compiled {
+    public:
+        compiled() = default;
+        explicit compiled(art::value_type pattern, int nocase = 0);
+
+        /** 1 for a match, as stringmatchlen */
+        [[nodiscard]] int match(art::value_type subject) const;
+        /** false when match hands the pattern to stringmatchlen */
+        [[nodiscard]] bool is_compiled() const {
+            return !interpreted;
+        }
+
+    private:
+        typedef std::array<uint64_t, 4> byte_set;
+        struct segment {
+            // element range in sets
+            uint32_t first = 0;
+            uint32_t length = 0;
+            // the longest run of one byte elements and where it sits in the segment
+            uint32_t literal_at = 0;
+            std::string literal{};
+        };
+        [[nodiscard]] bool fits(const segment& seg, const uint8_t *at) const;
+        [[nodiscard]] size_t find(const segment& seg, const uint8_t *data, size_t from, size_t last_start) const;
+
+        std::string source{};
+        int nocase = 0;
+        bool interpreted = true;
+        bool leading_star = false;
+        bool trailing_star = false;
+        bool any_star = false;
+        std::vector<byte_set> sets{};
+        std::vector<segment> segments{};
+    };
+
 private:
     /* Glob-style pattern matching. */
     static int stringmatchlen_impl(const char *pattern,
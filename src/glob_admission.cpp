@@ -0,0 +1,83 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "glob_admission.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "configuration.h"
+#include "statistics.h"
+
+namespace barch {
+    static std::mutex admission_lock{};
+    static std::condition_variable admission_changed{};
+    static unsigned workers_in_use = 0;
+    static uint64_t globs_waiting = 0;
+
+    static unsigned worker_limit() {
+        auto limit = get_max_glob_workers();
+        if (!limit) limit = std::thread::hardware_concurrency();
+        return std::max<unsigned>(limit, 1);
+    }
+
+    glob_ticket& glob_ticket::operator=(glob_ticket&& other) noexcept {
+        if (this != &other) {
+            release();
+            granted = other.granted;
+            other.granted = 0;
+        }
+        return *this;
+    }
+
+    glob_ticket::~glob_ticket() {
+        release();
+    }
+
+    void glob_ticket::release() {
+        if (!granted) return;
+        {
+            std::lock_guard lk(admission_lock);
+            workers_in_use -= granted;
+        }
+        granted = 0;
+        --statistics::globs_running;
+        admission_changed.notify_all();
+    }
+
+    glob_ticket admit_glob(unsigned wanted, const std::function<bool()>& abandoned) {
+        wanted = std::max<unsigned>(wanted, 1);
+        std::unique_lock lk(admission_lock);
+        unsigned limit = worker_limit();
+        if (workers_in_use >= limit) {
+            if (globs_waiting >= get_max_glob_queue()) {
+                ++statistics::globs_refused;
+                return {};
+            }
+            ++globs_waiting;
+            while (workers_in_use >= limit) {
+                admission_changed.wait_for(lk, std::chrono::milliseconds(100));
+                if (abandoned) {
+                    // the check can be a system call, so it is not made under the lock
+                    lk.unlock();
+                    bool gone = abandoned();
+                    lk.lock();
+                    if (gone) {
+                        --globs_waiting;
+                        return {};
+                    }
+                }
+                limit = worker_limit();
+            }
+            --globs_waiting;
+        }
+        unsigned granted = std::min(wanted, limit - workers_in_use);
+        workers_in_use += granted;
+        ++statistics::globs_running;
+        return glob_ticket{granted};
+    }
+}
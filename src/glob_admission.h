@@ -0,0 +1,55 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_GLOB_ADMISSION_H
+#define BARCH_GLOB_ADMISSION_H
+#include <functional>
+
+namespace barch {
+    /**
+     * The page scanning threads KEYS and VALUES run on, shared out between the globs that
+     * want them.
+     *
+     * A glob used to hold one process wide mutex for as long as it ran, so a second KEYS
+     * waited for the first to finish however few threads the first was using. Now each
+     * glob is admitted with as many of the max_glob_workers threads as are free, up to the
+     * iteration_worker_count it asks for, and gives them back when it is done. A glob that
+     * finds none free waits for some; max_glob_queue of them may wait at once and the
+     * next one is refused, so a burst of pattern scans turns into errors rather than an
+     * unbounded queue of stalled connections.
+     *
+     * A waiting glob polls its abandoned check, and gives up its place once the client
+     * that asked has gone.
+     */
+    class glob_ticket {
+    public:
+        glob_ticket() = default;
+        explicit glob_ticket(unsigned granted) : granted(granted) {}
+        glob_ticket(const glob_ticket&) = delete;
+        glob_ticket& operator=(const glob_ticket&) = delete;
+        glob_ticket(glob_ticket&& other) noexcept : granted(other.granted) {
+            other.granted = 0;
+        }
+        glob_ticket& operator=(glob_ticket&& other) noexcept;
+        ~glob_ticket();
+
+        /** false when the glob was refused or abandoned while it waited */
+        explicit operator bool() const {
+            return granted > 0;
+        }
+        /** threads the glob may scan pages with */
+        [[nodiscard]] unsigned workers() const {
+            return granted;
+        }
+    private:
+        void release();
+        unsigned granted = 0;
+    };
+
+    /**
+     * wait for scanning threads, wanting up to `wanted` of them. abandoned may be empty
+     */
+    glob_ticket admit_glob(unsigned wanted, const std::function<bool()>& abandoned);
+}
+#endif //BARCH_GLOB_ADMISSION_H
@@ -0,0 +1,145 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "glob_plan.h"
+
+#include <cstring>
+
+#include "art/nodes.h"
+#include "constants.h"
+
+namespace barch {
+    // the first character of anything a number renders as, or of a string that reads as one
+    static bool may_start_number(uint8_t c) {
+        return (c >= '0' && c <= '9') || strchr("+-.iInN", c) != nullptr;
+    }
+
+    // a byte the encodings store as it is: no terminator, no control and no separator
+    static bool plain_byte(uint8_t c) {
+        return c > ' ';
+    }
+
+    /**
+     * the bounds of a class that starts at pattern[at], which is '['. false when the class
+     * is negated, unterminated or holds anything but plain ascii, since those do not give
+     * a range the tree can seek to
+     */
+    static bool class_bounds(art::value_type pattern, size_t at, uint8_t& lo, uint8_t& hi) {
+        size_t i = at + 1;
+        if (i < pattern.size && pattern[i] == '^') return false;
+        lo = 0xff;
+        hi = 0;
+        auto take = [&](uint8_t c) {
+            lo = std::min(lo, c);
+            hi = std::max(hi, c);
+            return plain_byte(c) && c < 0x80;
+        };
+        // the same reading of a class glob::stringmatchlen makes
+        while (i < pattern.size) {
+            uint8_t c = pattern[i];
+            if (c == '\\' && i + 1 < pattern.size) {
+                if (!take(pattern[i + 1])) return false;
+                i += 2;
+            } else if (c == ']') {
+                return lo <= hi;
+            } else if (i + 2 < pattern.size && pattern[i + 1] == '-') {
+                if (!take(c) || !take(pattern[i + 2])) return false;
+                i += 3;
+            } else {
+                if (!take(c)) return false;
+                ++i;
+            }
+        }
+        return false;
+    }
+
+    glob_plan plan_glob(art::value_type pattern, bool split_keys) {
+        glob_plan plan;
+        size_t i = 0;
+        for (; i < pattern.size; ++i) {
+            uint8_t c = pattern[i];
+            if (c == '*' || c == '?' || c == '[') break;
+            if (c == '\\' && i + 1 < pattern.size) c = pattern[++i];
+            plan.prefix.push_back((char) c);
+        }
+        if (i < pattern.size && pattern[i] == '[') {
+            plan.bounded = class_bounds(pattern, i, plan.lo, plan.hi);
+        }
+
+        if (split_keys) {
+            plan.reason = "the key space splits keys with key_split";
+            return plan;
+        }
+        if (plan.prefix.empty() && !plan.bounded) {
+            plan.reason = "the pattern starts with a wildcard";
+            return plan;
+        }
+        for (auto c : plan.prefix) {
+            if (!plain_byte(c)) {
+                plan.reason = "the prefix holds a space or a control character";
+                return plan;
+            }
+        }
+        bool numeric = false;
+        if (!plan.prefix.empty()) {
+            numeric = may_start_number(plan.prefix[0]);
+        } else {
+            for (unsigned c = plan.lo; c <= plan.hi && !numeric; ++c) {
+                numeric = may_start_number(c);
+            }
+        }
+        if (numeric) {
+            plan.reason = "the prefix could start a number";
+            return plan;
+        }
+
+        plan.walk = true;
+        plan.ranges.push_back(std::string(1, (char) art::tstring) + plan.prefix);
+        const uint8_t leads[] = {
+            art::tcomposite, art::tplain, art::tcomposite_list, art::tcomposite_hash,
+            art::tcomposite_ordered_map, art::tcomposite_extend
+        };
+        for (auto lead : leads) {
+            std::string r;
+            r.push_back((char) lead);
+            r.push_back((char) key_terminator);
+            r.push_back((char) art::tstring);
+            r += plan.prefix;
+            plan.ranges.push_back(std::move(r));
+        }
+        return plan;
+    }
+
+    std::string glob_plan::seek(const std::string& start) const {
+        return bounded ? start + (char) lo : start;
+    }
+
+    bool glob_plan::in_range(art::value_type key, const std::string& start) const {
+        if (key.size < start.size() || memcmp(key.bytes, start.data(), start.size()) != 0) {
+            return false;
+        }
+        if (!bounded) return true;
+        if (key.size == start.size()) return false;
+        uint8_t next = key.bytes[start.size()];
+        return next >= lo && next <= hi;
+    }
+
+    std::string glob_plan::describe() const {
+        std::string r;
+        if (!walk) {
+            r = "scan all pages: ";
+            r += reason;
+            return r;
+        }
+        r = "walk " + std::to_string(ranges.size()) + " key ranges with prefix '" + prefix + "'";
+        if (bounded) {
+            r += " next byte in [";
+            r.push_back((char) lo);
+            r += "-";
+            r.push_back((char) hi);
+            r += "]";
+        }
+        return r;
+    }
+}
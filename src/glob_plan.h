@@ -0,0 +1,63 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_GLOB_PLAN_H
+#define BARCH_GLOB_PLAN_H
+#include <string>
+
+#include "sastam.h"
+#include "value_type.h"
+
+namespace barch {
+    /**
+     * How a KEYS or SCAN MATCH pattern is answered: by walking the few key ranges its
+     * literal prefix pins down, or by scanning every leaf page.
+     *
+     * The page scan looks at every key in the space whatever the pattern. That is the only
+     * way to answer `*foo`, and a waste for `user:1234:*`, where every match starts with
+     * the same bytes and the tree keeps those together. The prefix is the pattern up to
+     * its first wildcard with escapes resolved; a `[...]` class straight after it narrows
+     * the next byte to between the class's lowest and highest member.
+     *
+     * A key is matched by what it renders as rather than by its stored bytes, so the walk
+     * is only taken where the prefix says which stored keys can render that way:
+     *
+     *  - a string key is stored as its bytes behind the string type: one range.
+     *  - a container is matched by its name, which is the first component behind the
+     *    lead byte of its kind, and a caller's multi part key by its first part: one range
+     *    per lead.
+     *  - a key that reads as a number is stored as one and renders as digits, a sign, a
+     *    point, inf or nan. A prefix that could start one of those is scanned.
+     *  - a prefix holding a space could straddle two parts of a multi part key, and a key
+     *    space with a key_split of its own renders keys in a way the prefix cannot
+     *    predict, so both of those are scanned too.
+     */
+    struct glob_plan {
+        bool walk = false;
+        /** what every match starts with, as the caller wrote it */
+        std::string prefix{};
+        /** set when a class after the prefix bounds the next byte to [lo, hi] */
+        bool bounded = false;
+        uint8_t lo = 0;
+        uint8_t hi = 0xff;
+        /** the encoded start of every range that can hold a match, when walking */
+        heap::vector<std::string> ranges{};
+        /** why every page is scanned instead, when not */
+        std::string reason{};
+
+        /** where a walk of the range beginning with start seeks to first */
+        [[nodiscard]] std::string seek(const std::string& start) const;
+        /** true while key is still inside the range beginning with start */
+        [[nodiscard]] bool in_range(art::value_type key, const std::string& start) const;
+        /** the plan in one line, for KEYS and SCAN ... EXPLAIN */
+        [[nodiscard]] std::string describe() const;
+    };
+
+    /**
+     * plan a pattern that is matched against key names. split_keys is set when the space
+     * splits its keys on something of its own (key_split) rather than on a space
+     */
+    glob_plan plan_glob(art::value_type pattern, bool split_keys);
+}
+#endif //BARCH_GLOB_PLAN_H
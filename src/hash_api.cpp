@@ -561,22 +561,33 @@ int HQUERY(caller& call,const arg_t& argv, bool fancy,
             return;
         }
     }
-    if (as_array) call.start_array();
+    // the field keys are all built first so the shard can look them up in one go
+    key_batch fields;
+    heap::vector<size_t> args;
     for (size_t arg = fields_start; arg < argv.size(); ++arg) {
         auto k = argv[arg];
-        if (key_ok(k) != 0) {
+        if (key_ok(k) == 0) {
+            query.push(conversion::convert(k));
+            fields.add(query.create());
+            query.pop_back();
+            args.push_back(arg);
+        }
+    }
+    auto keys = fields.keys();
+    heap::vector<art::node_ptr> found(keys.size());
+    t->search_batch(keys.data(), keys.size(), found.data());
+    if (as_array) call.start_array();
+    size_t at = 0;
+    for (size_t arg = fields_start; arg < argv.size(); ++arg) {
+        if (at == args.size() || args[at] != arg) {
             call.push_null();
         } else {
-            auto converted = conversion::convert(k);
-            query.push(converted);
-            art::value_type search_key = query.create();
-            art::node_ptr r = t->search(search_key);
+            const auto& r = found[at++];
             if (r.null()) {
                 nullreporter();
             } else {
                 reporter(r);
             }
-            query.pop_back();
             ++responses;
         }
     }
@@ -673,30 +684,20 @@ int HLEN(caller& call, const arg_t& argv) {
             return call.push_error(barch::wrong_type_message());
         }
     }
-    int responses = 0;
-    size_t nlen = 0;
+    uint64_t responses = 0;
     auto n = argv[1];
     if (key_ok(n) != 0) {
         return call.push_null();
     }
 
+    // the shard keeps the count as fields come and go, so this is a lookup rather than a
+    // walk over every field under the write lock
     barch::sharded_store store(call.kspace());
-    store.with_container_write(argv[1], [&](const barch::shard_ptr& t) {
-        query.create(art::ts_hash, {conversion::convert(n, nlen), art::ts_end});
-        auto search_end = query.end();
-        auto search_start = query.prefix(2);
-        auto table_key = query.prefix(2);
-        auto table_iter = [&](void *, art::value_type key, art::value_type unused(value))-> int {
-            if (!key.starts_with(table_key.pref(1))) {
-                return -1;
-            }
-            ++responses;
-
-            return 0;
-        };
-        t->range(search_start, search_end, table_iter, nullptr);
+    store.with_container_read(argv[1], [&](const barch::shard_ptr& t) {
+        auto prefix = query.create(art::ts_hash, {conversion::convert(n)}, false);
+        responses = t->get_container_size(prefix).count;
     });
-    return call.push_ll(responses);
+    return call.push_ll((int64_t)responses);
 }
 int cmd_HLEN(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
     vk_caller call;
@@ -1008,6 +1009,7 @@ int HSCAN(caller& call, const arg_t& argv) {
     if (barch::kind_of(store, n) == barch::key_kind::string) {
         return call.push_error(barch::wrong_type_message());
     }
+    glob::compiled matcher(art::value_type{match});
 
     caller::iteration_ptr cursor;
     if (given != 0) {
@@ -1057,7 +1059,7 @@ int HSCAN(caller& call, const arg_t& argv) {
                 decodable.push_back('\x01');
                 decodable.append(field);
                 std::string text = encoded_key_as_string(art::value_type{decodable});
-                if (1 != glob::stringmatchlen(art::value_type{match}, art::value_type{text}, 0)) {
+                if (1 != matcher.match(art::value_type{text})) {
                     continue;
                 }
             }
@@ -3,11 +3,42 @@
 //
 #include "hash_arena.h"
 
+#include <condition_variable>
+#include <fcntl.h>
 #include <filesystem>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <zstd.h>
 
 #include "art/art.h"
 #include "rpc/server.h"
 #include "module.h"
+#include "simd.h"
+
+// the first word of a snapshot written as a page image rather than as a stream of page
+// records. it moves with storage_version, so an image of an older format is refused too
+static constexpr uint64_t image_version = ((uint64_t)1 << 40) + storage_version;
+// and of one written as compressed pages, each behind its crc32c
+static constexpr uint64_t packed_version = ((uint64_t)2 << 40) + storage_version;
+
+// so that what was written is on the disk before it is renamed over the last good copy,
+// and the rename is before the copy is removed. a directory syncs the same way
+static bool sync_file(const std::string &name) {
+    int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+static void sync_directory_of(const std::string &name) {
+    auto dir = std::filesystem::path(name).parent_path();
+    sync_file(dir.empty() ? "." : dir.string());
+}
 
 void append(std::ostream &out, size_t page, const storage &s, const uint8_t *data) {
     if (out.fail()) {
@@ -21,7 +52,8 @@ void append(std::ostream &out, size_t page, const storage &s, const uint8_t *dat
     }
     writep(out, page); //8
     writep(out, s.fragmentation); //4
-    writep(out, (uint32_t)0);//4
+    // the crc32c of the page, checked before a load uses it
+    writep(out, simd::crc32c(data, page_size));//4
     writep(out, s.size);//4
     writep(out, s.ticker);//8
     writep(out, s.write_position);//4
@@ -37,6 +69,27 @@ void append(std::ostream &out, size_t page, const storage &s, const uint8_t *dat
 /// file io
 bool arena::base_hash_arena::save(const std::string &filename,
                                   const std::function<void(std::ostream &)> &extra) const {
+    auto max_deltas = barch::get_max_save_deltas();
+    if (max_deltas > 0 && checkpoint_id != 0 && checkpoint_deltas < max_deltas) {
+        heap::std_vector<size_t> changed;
+        heap::std_vector<size_t> removed;
+        for (auto &[page, str]: hidden_arena) {
+            uint64_t was = page < checkpoint.size() ? checkpoint[page] : 0;
+            if (fingerprint(page) != was) {
+                changed.push_back(page);
+            }
+        }
+        for (size_t page = 0; page < checkpoint.size(); ++page) {
+            if (checkpoint[page] != 0 && !hidden_arena.contains(page)) {
+                removed.push_back(page);
+            }
+        }
+        // when most pages changed anyway a snapshot is hardly bigger, and it leaves one
+        // file less to read back
+        if (changed.size() * 2 <= hidden_arena.size()) {
+            return save_delta(filename, extra, changed, removed);
+        }
+    }
     if (log_saving_messages == 1)
         barch::log({"writing to " + filename});
     std::string wal_filename = filename + ".wal";
@@ -47,29 +100,359 @@ bool arena::base_hash_arena::save(const std::string &filename,
 
         return false;
     }
+    auto started = std::chrono::steady_clock::now();
+    auto level = (int)barch::get_save_compression_level();
     uint64_t completed = 0;
-
-    if (!send(out, extra, false)) {
+    heap::std_vector<uint64_t> fingerprints;
+    // the deltas written after this snapshot carry its id, so that one left over from
+    // an older snapshot is never read on top of a newer one
+    std::random_device rd;
+    uint64_t id = ((uint64_t) rd() << 32 | rd()) | 1;
+    auto* prints = max_deltas > 0 ? &fingerprints : nullptr;
+    if (level > 0 ? !write_packed(out, wal_filename, extra, id, prints, level)
+                  : !write_image(out, extra, id, prints)) {
         return false;
     }
     out.seekp(0);
-    completed = storage_version;
+    completed = level > 0 ? packed_version : image_version;
     writep(out, completed);
     out.flush();
     out.close();
+    if (out.fail() || !sync_file(wal_filename)) {
+        barch::err({std::runtime_error("out of disk space or device error").what(), __FILE__, __LINE__});
+        return false;
+    }
     std::string bak = filename + ".back";
     std::remove(bak.c_str()); // make sure back file is gone
     std::rename(filename.c_str(), bak.c_str());
     std::rename(wal_filename.c_str(), filename.c_str());
+    sync_directory_of(filename);
     std::remove(bak.c_str()); // remove the old version
+    remove_deltas(filename);
+    checkpoint = std::move(fingerprints);
+    checkpoint_id = max_deltas > 0 ? id : 0;
+    checkpoint_deltas = 0;
+
+    std::error_code ec;
+    uint64_t raw = hidden_arena.size() * page_size;
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    ++statistics::snapshots_written;
+    statistics::snapshot_bytes_raw += raw;
+    uint64_t written = std::filesystem::file_size(filename, ec);
+    statistics::snapshot_bytes_written += ec ? 0 : written;
+    statistics::snapshot_write_us += us;
+    statistics::snapshot_last_bytes_per_sec = us ? (uint64_t)((double)raw * 1000000.0 / (double)us) : 0;
     if (log_saving_messages == 1)
         barch::log({"completed writing to " + filename});
 
-    return !out.fail();
+    return true;
+}
+
+bool arena::base_hash_arena::save_delta(const std::string &filename,
+                                        const std::function<void(std::ostream &)> &extra,
+                                        const heap::std_vector<size_t>& changed,
+                                        const heap::std_vector<size_t>& removed) const {
+    size_t seq = checkpoint_deltas + 1;
+    std::string delta = delta_name(filename, seq);
+    if (log_saving_messages == 1)
+        barch::log({"writing", changed.size(), "changed pages of", hidden_arena.size(), "to", delta});
+    std::string wal_filename = delta + ".wal";
+    std::remove(wal_filename.c_str());
+    std::ofstream out{wal_filename, std::ios::out | std::ios::binary};
+    if (!out.is_open()) {
+        barch::err({std::runtime_error("file could not be opened").what(), __FILE__, __LINE__});
+        return false;
+    }
+    // the same header a snapshot starts with, behind the snapshot's id and the delta's
+    // place after it, then the changed pages as a snapshot writes them and the pages
+    // that are gone
+    uint64_t completed = 0;
+    writep(out, completed);
+    writep(out, checkpoint_id);
+    writep(out, (uint64_t)seq);
+    writep(out, max_accessible_page());
+    writep(out, last_allocated);
+    writep(out, free_pages);
+    writep(out, top);
+    extra(out);
+    heap::std_vector<uint64_t> fingerprints(changed.size());
+    writep(out, changed.size());
+    for (size_t i = 0; i < changed.size(); ++i) {
+        size_t page = changed[i];
+        const storage& st = *(const storage*)get_page_data({page, page_size - sizeof(storage), nullptr},false);
+        const uint8_t* data = get_page_data({page, 0, nullptr},false);
+        fingerprints[i] = fingerprint(page);
+        append(out, page, st, data);
+    }
+    writep(out, removed.size());
+    for (auto page : removed) {
+        writep(out, page);
+    }
+    out.seekp(0);
+    completed = storage_version;
+    writep(out, completed);
+    out.flush();
+    out.close();
+    if (out.fail() || !sync_file(wal_filename)) {
+        barch::err({std::runtime_error("out of disk space or device error").what(), __FILE__, __LINE__});
+        return false;
+    }
+    std::rename(wal_filename.c_str(), delta.c_str());
+    sync_directory_of(delta);
+
+    for (size_t i = 0; i < changed.size(); ++i) {
+        if (checkpoint.size() <= changed[i]) checkpoint.resize(changed[i] + 1);
+        checkpoint[changed[i]] = fingerprints[i];
+    }
+    for (auto page : removed) {
+        checkpoint[page] = 0;
+    }
+    checkpoint_deltas = seq;
+    ++statistics::save_deltas;
+    statistics::save_pages_unchanged += hidden_arena.size() - changed.size();
+    if (log_saving_messages == 1)
+        barch::log({"completed writing to " + delta});
+    return true;
+}
+
+std::string arena::base_hash_arena::delta_name(const std::string &filename, size_t seq) {
+    return filename + "." + std::to_string(seq) + ".delta";
+}
+
+void arena::base_hash_arena::remove_deltas(const std::string &filename) {
+    for (size_t seq = 1; std::filesystem::exists(delta_name(filename, seq)); ++seq) {
+        std::remove(delta_name(filename, seq).c_str());
+    }
+}
+
+uint64_t arena::base_hash_arena::fingerprint(size_t page) const {
+    const uint8_t* data = get_page_data({page, 0, nullptr}, false);
+    uint64_t h = ankerl::unordered_dense::detail::wyhash::hash(data, page_size);
+    return h ? h : 1; // 0 is a page that is not there
+}
+
+void arena::base_hash_arena::take_checkpoint() const {
+    checkpoint.clear();
+    for (auto &[page, str]: hidden_arena) {
+        if (checkpoint.size() <= page) checkpoint.resize(page + 1);
+        checkpoint[page] = fingerprint(page);
+    }
+}
+
+
+bool arena::base_hash_arena::write_image(std::ostream &out, const std::function<void(std::ostream &)> &extra,
+                                         uint64_t id, heap::std_vector<uint64_t>* fingerprints) const {
+    uint64_t completed = 0;
+    uint64_t size = hidden_arena.size();
+    uint64_t image_size = page_data_size;
+    for (auto &[page, str]: hidden_arena) {
+        image_size = std::max<uint64_t>(image_size, (page + 1) * page_size);
+    }
+    writep(out, completed);
+    writep(out, id);
+    writep(out, image_size);
+    writep(out, last_allocated);
+    writep(out, free_pages);
+    writep(out, top);
+    extra(out);
+    // the pages there are, what each held if deltas are kept, so that a load knows that
+    // without reading the pages themselves, and the crc32c each is checked against
+    writep(out, size);
+    for (auto &[page, str]: hidden_arena) {
+        if (free_address_list.contains(page)) {
+            abort_with("free page accounting error");
+        }
+        uint64_t print = 0;
+        if (fingerprints) {
+            print = fingerprint(page);
+            if (fingerprints->size() <= page) fingerprints->resize(page + 1);
+            (*fingerprints)[page] = print;
+        }
+        writep(out, (uint64_t)page);
+        writep(out, print);
+        writep(out, simd::crc32c(get_page_data({page, 0, nullptr},false), page_size));
+    }
+    // the image starts on a page_size boundary, which is a multiple of whatever page
+    // size mmap wants its offset in
+    uint64_t data_offset = ((uint64_t)out.tellp() + sizeof(uint64_t) + page_size - 1) / page_size * page_size;
+    writep(out, data_offset);
+    if (out.fail()) {
+        return false;
+    }
+    // free pages are not written, and stay holes in the file
+    for (auto &[page, str]: hidden_arena) {
+        out.seekp(data_offset + page * page_size);
+        writep(out, get_page_data({page, 0, nullptr},false), page_size);
+    }
+    if (image_size && !hidden_arena.contains(image_size / page_size - 1)) {
+        // the file reaches the end of the image even when the last page is free, or
+        // allocating it once mapped would touch memory past the end of the file
+        out.seekp(data_offset + image_size - 1);
+        writep(out, (uint8_t)0);
+    }
+    if (log_loading_messages == 1) {
+        barch::log({"saved [",size,"] pages as an image of [",image_size,"] bytes"});
+    }
+    if (out.fail()) {
+        barch::err({std::runtime_error("out of disk space or device error").what(), __FILE__, __LINE__});
+        return false;
+    }
+    return true;
 }
 
+bool arena::base_hash_arena::write_packed(std::ofstream &out, const std::string &filename,
+                                          const std::function<void(std::ostream &)> &extra, uint64_t id,
+                                          heap::std_vector<uint64_t>* fingerprints, int level) const {
+    uint64_t completed = 0;
+    uint64_t size = hidden_arena.size();
+    uint64_t image_size = page_data_size;
+    // the pointers are taken here rather than by the workers, since a page read in a
+    // transaction is copied out first and that is not something two threads can do
+    heap::std_vector<std::pair<size_t, const uint8_t*>> pages;
+    pages.reserve(size);
+    for (auto &[page, str]: hidden_arena) {
+        if (free_address_list.contains(page)) {
+            abort_with("free page accounting error");
+        }
+        image_size = std::max<uint64_t>(image_size, (page + 1) * page_size);
+        pages.emplace_back(page, get_page_data({page, 0, nullptr},false));
+    }
+    std::sort(pages.begin(), pages.end());
+    writep(out, completed);
+    writep(out, id);
+    writep(out, image_size);
+    writep(out, last_allocated);
+    writep(out, free_pages);
+    writep(out, top);
+    extra(out);
+    writep(out, size);
+    out.flush();
+    if (out.fail()) {
+        return false;
+    }
+    // the header went through the stream, the pages go straight to the file in the
+    // large writes the workers hand over, in page order
+    int fd = open(filename.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || lseek(fd, out.tellp(), SEEK_SET) < 0) {
+        if (fd >= 0) close(fd);
+        barch::err({std::runtime_error("file could not be opened").what(), __FILE__, __LINE__});
+        return false;
+    }
+    struct batch {
+        heap::std_vector<uint8_t> bytes{};
+        bool ready = false;
+    };
+    size_t batches = (pages.size() + save_batch_pages - 1) / save_batch_pages;
+    heap::std_vector<batch> done(batches);
+    std::mutex lock;
+    std::condition_variable changed;
+    size_t next = 0;
+    size_t written = 0;
+    bool failed = false;
+
+    auto compress = [&]() {
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+        heap::std_vector<uint8_t> packed(ZSTD_compressBound(page_size));
+        for (;;) {
+            size_t b;
+            {
+                std::unique_lock lk(lock);
+                changed.wait(lk, [&] {
+                    return failed || next >= batches || next < written + save_batches_in_flight;
+                });
+                if (failed || next >= batches) break;
+                b = next++;
+            }
+            heap::std_vector<uint8_t> bytes;
+            size_t end = std::min(pages.size(), (b + 1) * save_batch_pages);
+            for (size_t i = b * save_batch_pages; i < end; ++i) {
+                auto [page, data] = pages[i];
+                uint64_t print = fingerprints ? fingerprint(page) : 0;
+                size_t stored = cctx ? ZSTD_compressCCtx(cctx, packed.data(), packed.size(), data, page_size, level) : 0;
+                const uint8_t* from = packed.data();
+                if (!cctx || ZSTD_isError(stored) || stored >= page_size) {
+                    // a page that does not get smaller is stored as it is
+                    stored = page_size;
+                    from = data;
+                }
+                uint32_t crc = simd::crc32c(from, stored);
+                uint32_t stored32 = stored;
+                uint64_t page64 = page;
+                size_t at = bytes.size();
+                bytes.resize(at + 24 + stored);
+                memcpy(bytes.data() + at, &page64, 8);
+                memcpy(bytes.data() + at + 8, &print, 8);
+                memcpy(bytes.data() + at + 16, &crc, 4);
+                memcpy(bytes.data() + at + 20, &stored32, 4);
+                memcpy(bytes.data() + at + 24, from, stored);
+            }
+            {
+                std::unique_lock lk(lock);
+                done[b].bytes = std::move(bytes);
+                done[b].ready = true;
+            }
+            changed.notify_all();
+        }
+        if (cctx) ZSTD_freeCCtx(cctx);
+    };
+    std::vector<std::thread> workers;
+    size_t worker_count = std::min<size_t>(save_workers, std::max<size_t>(batches, 1));
+    for (size_t w = 0; w < worker_count; ++w) {
+        workers.emplace_back(compress);
+    }
+    for (size_t b = 0; b < batches; ++b) {
+        heap::std_vector<uint8_t> bytes;
+        {
+            std::unique_lock lk(lock);
+            changed.wait(lk, [&] { return done[b].ready; });
+            bytes = std::move(done[b].bytes);
+        }
+        const uint8_t* at = bytes.data();
+        size_t left = bytes.size();
+        while (left > 0) {
+            ssize_t w = ::write(fd, at, left);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) break;
+            at += w;
+            left -= w;
+        }
+        if (fingerprints) {
+            // the fingerprint is the second word of every record
+            for (size_t off = 0; off < bytes.size();) {
+                uint64_t page, print;
+                uint32_t stored;
+                memcpy(&page, bytes.data() + off, 8);
+                memcpy(&print, bytes.data() + off + 8, 8);
+                memcpy(&stored, bytes.data() + off + 20, 4);
+                if (fingerprints->size() <= page) fingerprints->resize(page + 1);
+                (*fingerprints)[page] = print;
+                off += 24 + stored;
+            }
+        }
+        {
+            std::unique_lock lk(lock);
+            ++written;
+            failed = failed || left > 0;
+        }
+        changed.notify_all();
+        if (left > 0) break;
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    close(fd);
+    if (failed) {
+        barch::err({std::runtime_error("out of disk space or device error").what(), __FILE__, __LINE__});
+        return false;
+    }
+    if (log_loading_messages == 1) {
+        barch::log({"saved [",size,"] pages compressed at level [",level,"]"});
+    }
+    return true;
+}
 
-bool arena::base_hash_arena::send(std::ostream &out, const std::function<void(std::ostream &)> &extra, bool write_version) const {
+bool arena::base_hash_arena::send(std::ostream &out, const std::function<void(std::ostream &)> &extra, bool write_version,
+                                  heap::std_vector<uint64_t>* fingerprints) const {
     uint64_t completed = write_version ? (int)storage_version : 0;
     size_t size = hidden_arena.size();
     writep(out, completed);
@@ -89,6 +472,10 @@ bool arena::base_hash_arena::send(std::ostream &out, const std::function<void(st
         }
         const storage& s = *(const storage*)get_page_data({page, page_size - sizeof(storage), nullptr},false);
         append(out, page, s, get_page_data({page, 0, nullptr},false));
+        if (fingerprints) {
+            if (fingerprints->size() <= page) fingerprints->resize(page + 1);
+            (*fingerprints)[page] = fingerprint(page);
+        }
         ++record_pos;
     });
     if (log_loading_messages == 1) {
@@ -113,15 +500,385 @@ bool arena::base_hash_arena::arena_read(base_hash_arena &arena, const std::funct
     }
     if (log_loading_messages == 1)
         barch::log({"reading from",std::filesystem::current_path().c_str(),filename});
-    in.seekg(0, std::ios::end);
-    //uint64_t eof = in.tellg();
+    // the snapshot and its deltas are read into an arena of their own, which only
+    // replaces this one once every page of them was read and passed its checksum. A
+    // failure anywhere leaves the arena as it was rather than half loaded
+    base_hash_arena loading;
+    loading.set_check_mem(arena.is_check_mem());
+    uint64_t format = 0;
+    readp(in, format);
     in.seekg(0, std::ios::beg);
-    arena_retrieve(arena, in, extra);
+    uint64_t id = 0;
+    bool loaded = false;
+    try {
+        if (format == image_version || format == packed_version) {
+            loaded = format == image_version ? arena_map(loading, in, extra, filename, id)
+                                             : arena_unpack(loading, in, extra, id);
+        } else if (arena_retrieve(loading, in, extra)) {
+            // a snapshot written as page records, before the page image. its id follows
+            // its last page, and one written before there were deltas ends there
+            loaded = true;
+            in.read(reinterpret_cast<char *>(&id), sizeof(id));
+            if (in.gcount() != sizeof(id)) {
+                id = 0;
+            }
+        }
+        if (loaded) {
+            size_t applied = id ? apply_deltas(loading, extra, filename, id) : 0;
+            if (barch::get_max_save_deltas() > 0 && id) {
+                // so that the next save can write what changed since this one. an image
+                // brings what its pages held along, and the deltas kept it up to date
+                if (loading.checkpoint.empty()) loading.take_checkpoint();
+                loading.checkpoint_id = id;
+                loading.checkpoint_deltas = applied;
+            }
+        }
+    } catch (std::exception& e) {
+        barch::err({e.what(), __FILE__, __LINE__});
+        loaded = false;
+    }
+    if (!loaded) {
+        barch::err({"could not load", filename});
+        return false;
+    }
+    arena = std::move(loading);
     if (log_loading_messages == 1)
         barch::log({"complete reading from",std::filesystem::current_path().c_str(),filename});
     return true;
 }
 
+size_t arena::base_hash_arena::apply_deltas(base_hash_arena &arena, const std::function<void(std::istream &)> &extra,
+                                            const std::string &filename, uint64_t id) {
+    size_t seq = 1;
+    for (; ; ++seq) {
+        std::string delta = delta_name(filename, seq);
+        std::ifstream in{delta, std::ios::in | std::ios::binary};
+        if (!in.is_open()) break;
+        uint64_t completed = 0, delta_id = 0, delta_seq = 0;
+        readp(in, completed);
+        readp(in, delta_id);
+        readp(in, delta_seq);
+        if (completed != storage_version || delta_id != id || delta_seq != seq) {
+            // left over from an older snapshot, which the next save removes
+            barch::log({"ignoring", delta, "- it does not follow the snapshot in", filename});
+            break;
+        }
+        size_t max_address_accessed = 0;
+        readp(in, max_address_accessed);
+        readp(in, arena.last_allocated);
+        readp(in, arena.free_pages);
+        readp(in, arena.top);
+        extra(in);
+        size_t changed = 0;
+        readp(in, changed);
+        for (size_t i = 0; i < changed; ++i) {
+            size_t page = 0;
+            if (!read_page(arena, in, max_address_accessed, true, &page)) {
+                throw_exception<std::runtime_error>("invalid delta page");
+            }
+            if (!arena.checkpoint.empty()) {
+                if (arena.checkpoint.size() <= page) arena.checkpoint.resize(page + 1);
+                arena.checkpoint[page] = arena.fingerprint(page);
+            }
+        }
+        size_t removed = 0;
+        readp(in, removed);
+        for (size_t i = 0; i < removed; ++i) {
+            size_t page = 0;
+            readp(in, page);
+            arena.hidden_arena.erase(page);
+            if (page < arena.checkpoint.size()) arena.checkpoint[page] = 0;
+        }
+        if (log_loading_messages == 1)
+            barch::log({"applied", changed, "pages from", delta});
+    }
+    arena.max_allocated_page = arena.find_max_allocated_page_num();
+    arena.reconcile_free_list();
+    return seq - 1;
+}
+
+bool arena::base_hash_arena::read_page(base_hash_arena &arena, std::istream& in, size_t max_address_accessed, bool replace,
+                                       size_t* loaded) {
+    storage s{};
+    size_t page = 0;
+    uint32_t bsize = 0;
+
+    readp(in, page);
+    if (page > max_address_accessed) {
+        barch::err({"invalid page"});
+        return false;
+    }
+    if (!replace && arena.hidden_arena.contains(page)) {
+        barch::err({"invalid page - already loaded"});
+        return false;
+    }
+    readp(in, s.fragmentation);
+    uint32_t crc = 0;
+    readp(in, crc);
+    readp(in, s.size);
+    readp(in, s.ticker);
+    readp(in, s.write_position);
+    readp(in, bsize);
+    if (bsize) {
+        abort_with("invalid file");
+    }
+    if (s.fragmentation > s.write_position) {
+        abort_with("invalid write position or fragmentation");
+    }
+
+    readp(in, bsize);
+    if (bsize != page_size) {
+        abort_with("invalid page size");
+    }
+    uint8_t* data = arena.get_alloc_page_data({page, 0, nullptr}, bsize);
+    readp(in, data, bsize);
+    arena.hidden_arena[page] = page;
+    arena.max_allocated_page = std::max<size_t>(arena.max_allocated_page, page);
+    if (in.fail()) {
+        barch::err({std::runtime_error("file could not be accessed").what(), __FILE__, __LINE__});
+        return false;
+    }
+    if (simd::crc32c(data, bsize) != crc) {
+        barch::err({"page", page, "failed its checksum"});
+        return false;
+    }
+    storage& ps = *(storage*)arena.get_page_data({page,LPageSize,nullptr}, false);
+    ps.lru = lru_list::iterator();
+    if (loaded) *loaded = page;
+    return true;
+}
+
+bool arena::base_hash_arena::arena_map(base_hash_arena &arena, std::istream& in, const std::function<void(std::istream &)> &extra,
+                                       const std::string &filename, uint64_t& id) {
+    uint64_t completed = 0;
+    uint64_t image_size = 0;
+    uint64_t size = 0;
+    readp(in, completed);
+    if (completed != image_version) {
+        barch::err({std::runtime_error("data format is invalid").what(), __FILE__, __LINE__});
+        return false;
+    }
+    readp(in, id);
+    readp(in, image_size);
+    readp(in, arena.last_allocated);
+    readp(in, arena.free_pages);
+    readp(in, arena.top);
+    extra(in);
+    readp(in, size);
+    if (in.fail() || image_size % page_size != 0) {
+        barch::err({std::runtime_error("data could not be accessed").what(), __FILE__, __LINE__});
+        return false;
+    }
+    // a snapshot saved with deltas off has no fingerprints, and the load takes them
+    heap::std_vector<uint64_t> prints;
+    heap::std_vector<std::pair<uint64_t, uint32_t>> sums;
+    sums.reserve(size);
+    bool printed = size > 0;
+    for (uint64_t i = 0; i < size; ++i) {
+        uint64_t page = 0;
+        uint64_t print = 0;
+        uint32_t crc = 0;
+        readp(in, page);
+        readp(in, print);
+        readp(in, crc);
+        if (in.fail() || (page + 1) * page_size > image_size || arena.hidden_arena.contains(page)) {
+            barch::err({"invalid page"});
+            return false;
+        }
+        sums.emplace_back(page, crc);
+        arena.hidden_arena[page] = page;
+        arena.max_allocated_page = std::max<size_t>(arena.max_allocated_page, page);
+        if (print && printed) {
+            if (prints.size() <= page) prints.resize(page + 1);
+            prints[page] = print;
+        } else {
+            printed = false;
+        }
+    }
+    uint64_t data_offset = 0;
+    readp(in, data_offset);
+    std::error_code ec;
+    uint64_t file_size = std::filesystem::file_size(filename, ec);
+    if (in.fail() || ec || data_offset % page_size != 0 || file_size < data_offset + image_size) {
+        barch::err({std::runtime_error("data could not be accessed").what(), __FILE__, __LINE__});
+        return false;
+    }
+    if (image_size == 0) {
+        arena.reconcile_free_list();
+        return true;
+    }
+    if (arena.opt_use_vmmap) {
+        // the pages stay in the file until they are touched, and the first write to one
+        // copies it. the address range behind the image is reserved and never backed by
+        // the file, so the arena grows into it without writing the snapshot (resize_mapped)
+        size_t reserved = std::max<size_t>(image_size * mapped_reserve_factor, mapped_reserve_min);
+        void* range = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        int fd = range == MAP_FAILED ? -1 : open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        void* mapped = fd < 0 ? MAP_FAILED : mmap(range, image_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t)data_offset);
+        // a private mapping keeps what it needs of the file, it does not need the descriptor
+        if (fd >= 0) close(fd);
+        if (mapped == MAP_FAILED) {
+            if (range != MAP_FAILED) munmap(range, reserved);
+            barch::err({std::runtime_error("snapshot could not be mapped").what(), __FILE__, __LINE__});
+            return false;
+        }
+        arena.page_data = (uint8_t*)mapped;
+        arena.page_data_size = image_size;
+        arena.mapped_reserved = reserved;
+        heap::allocated += image_size;
+        heap::vmm_allocated += image_size;
+        page_modifications::inc_all_tickers();
+        // checking every page reads the whole image, which is what mapping it avoids, so
+        // only verify_mapped_pages does. without it a damaged page is not caught on load
+        if (barch::get_verify_mapped_pages()) {
+            for (auto [page, crc] : sums) {
+                uint8_t* at = arena.page_data + page * page_size;
+                bool intact = simd::crc32c(at, page_size) == crc;
+                // nothing wrote to it yet, so the page goes back to being read from the file
+                // when it is first used, rather than staying in memory from the check
+                madvise(at, page_size, MADV_DONTNEED);
+                if (!intact) {
+                    barch::err({"page", page, "of", filename, "failed its checksum"});
+                    return false;
+                }
+            }
+        }
+        statistics::load_pages_mapped += size;
+    } else {
+        arena.alloc_page_data(image_size);
+        for (auto [page, crc] : sums) {
+            in.seekg(data_offset + page * page_size);
+            readp(in, arena.page_data + page * page_size, page_size);
+            if (simd::crc32c(arena.page_data + page * page_size, page_size) != crc) {
+                barch::err({"page", page, "of", filename, "failed its checksum"});
+                return false;
+            }
+        }
+        if (in.fail()) {
+            barch::err({std::runtime_error("data could not be accessed").what(), __FILE__, __LINE__});
+            return false;
+        }
+    }
+    if (printed && barch::get_max_save_deltas() > 0) {
+        arena.checkpoint = std::move(prints);
+    }
+    arena.reconcile_free_list();
+    if (log_loading_messages == 1) {
+        barch::log({"loaded [",size,"] pages from an image of [",image_size,"] bytes"});
+    }
+    return true;
+}
+
+bool arena::base_hash_arena::arena_unpack(base_hash_arena &arena, std::istream& in, const std::function<void(std::istream &)> &extra,
+                                          uint64_t& id) {
+    uint64_t completed = 0;
+    uint64_t image_size = 0;
+    uint64_t size = 0;
+    readp(in, completed);
+    if (completed != packed_version) {
+        barch::err({std::runtime_error("data format is invalid").what(), __FILE__, __LINE__});
+        return false;
+    }
+    readp(in, id);
+    readp(in, image_size);
+    readp(in, arena.last_allocated);
+    readp(in, arena.free_pages);
+    readp(in, arena.top);
+    extra(in);
+    readp(in, size);
+    if (in.fail() || image_size % page_size != 0) {
+        barch::err({std::runtime_error("data could not be accessed").what(), __FILE__, __LINE__});
+        return false;
+    }
+    if (image_size) {
+        arena.alloc_page_data(image_size);
+    }
+    heap::std_vector<uint64_t> prints;
+    bool printed = size > 0;
+    heap::std_vector<uint8_t> packed(ZSTD_compressBound(page_size));
+    std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx{ZSTD_createDCtx(), ZSTD_freeDCtx};
+    for (uint64_t i = 0; i < size; ++i) {
+        uint64_t page = 0;
+        uint64_t print = 0;
+        uint32_t crc = 0;
+        uint32_t stored = 0;
+        readp(in, page);
+        readp(in, print);
+        readp(in, crc);
+        readp(in, stored);
+        if (in.fail() || (page + 1) * page_size > image_size || arena.hidden_arena.contains(page)
+            || stored > packed.size()) {
+            barch::err({"invalid page"});
+            return false;
+        }
+        readp(in, packed.data(), stored);
+        if (in.fail() || simd::crc32c(packed.data(), stored) != crc) {
+            barch::err({"page [", page, "] of the snapshot is damaged, its checksum does not match"});
+            return false;
+        }
+        uint8_t* data = arena.page_data + page * page_size;
+        if (stored == page_size) {
+            memcpy(data, packed.data(), page_size);
+        } else if (ZSTD_decompressDCtx(dctx.get(), data, page_size, packed.data(), stored) != page_size) {
+            barch::err({"page [", page, "] of the snapshot could not be decompressed"});
+            return false;
+        }
+        arena.hidden_arena[page] = page;
+        arena.max_allocated_page = std::max<size_t>(arena.max_allocated_page, page);
+        if (print && printed) {
+            if (prints.size() <= page) prints.resize(page + 1);
+            prints[page] = print;
+        } else {
+            printed = false;
+        }
+    }
+    if (printed && barch::get_max_save_deltas() > 0) {
+        arena.checkpoint = std::move(prints);
+    }
+    arena.reconcile_free_list();
+    if (log_loading_messages == 1) {
+        barch::log({"loaded [",size,"] compressed pages"});
+    }
+    return true;
+}
+
+bool arena::base_hash_arena::resize_mapped(size_t new_size) {
+    if (new_size > mapped_reserved) {
+        return false;
+    }
+    if (new_size > page_data_size) {
+        // pages past the end of the image are anonymous and read as zeroes
+        void* grown = mmap(page_data + page_data_size, new_size - page_data_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        return grown != MAP_FAILED;
+    }
+    if (new_size < page_data_size) {
+        // handed back to the reservation rather than unmapped, so nothing else is put there
+        void* released = mmap(page_data + new_size, page_data_size - new_size, PROT_NONE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        return released != MAP_FAILED;
+    }
+    return true;
+}
+
+void arena::base_hash_arena::detach_mapped() {
+    auto* copy = (uint8_t *) mmap(nullptr, page_data_size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (copy == MAP_FAILED) {
+        abort_with("failed to allocate virtual page data");
+    }
+    memcpy(copy, page_data, page_data_size);
+    unmap_page_data();
+    page_data = copy;
+    page_modifications::inc_all_tickers();
+    barch::log({"the mapped snapshot outgrew its reserved range, copied [", page_data_size, "] bytes of it to memory"});
+}
+
+void arena::base_hash_arena::unmap_page_data() {
+    munmap(page_data, mapped_reserved > 0 ? mapped_reserved : page_data_size);
+    mapped_reserved = 0;
+}
+
 bool arena::base_hash_arena::arena_retrieve(base_hash_arena &arena, std::istream& in, const std::function<void(std::istream &)> &extra) {
     uint64_t completed = 0;
     size_t size = 0;
@@ -149,52 +906,14 @@ bool arena::base_hash_arena::arena_retrieve(base_hash_arena &arena, std::istream
     // TODO: the free page list is never recovered
     bool oom = false;
     for (size_t i = 0; i < size; i++) {
-        storage s{};
-        size_t page = 0;
         if (arena.is_check_mem() && (statistics::logical_allocated > barch::get_max_module_memory() || heap::get_physical_memory_ratio() > 0.99)) {
             //arena.clear();
             //return false;
             oom = true;
         }
-        uint32_t bsize = 0;
-
-        readp(in, page);
-        if (page > max_address_accessed) {
-            barch::err({"invalid page"});
-            return false;
-        }
-        if (arena.hidden_arena.contains(page)) {
-            barch::err({"invalid page - already loaded"});
-            return false;
-        }
-        readp(in, s.fragmentation);
-        uint32_t mods = 0;
-        readp(in, mods);
-        readp(in, s.size);
-        readp(in, s.ticker);
-        readp(in, s.write_position);
-        readp(in, bsize);
-        if (bsize) {
-            abort_with("invalid file");
-        }
-        if (s.fragmentation > s.write_position) {
-            abort_with("invalid write position or fragmentation");
-        }
-
-        readp(in, bsize);
-        if (bsize != page_size) {
-            abort_with("invalid page size");
-        }
-        uint8_t* data = arena.get_alloc_page_data({page, 0, nullptr}, bsize);
-        readp(in, data, bsize);
-        arena.hidden_arena[page] = page;
-        arena.max_allocated_page = std::max<size_t>(arena.max_allocated_page, page);
-        if (in.fail()) {
-            barch::err({std::runtime_error("file could not be accessed").what(), __FILE__, __LINE__});
+        if (!read_page(arena, in, max_address_accessed, false)) {
             return false;
         }
-        storage& ps = *(storage*)arena.get_page_data({page,LPageSize,nullptr}, false);
-        ps.lru = lru_list::iterator();
     };
 
     if (!in.eof() && in.fail()) {
@@ -214,13 +933,7 @@ bool arena::base_hash_arena::arena_retrieve(base_hash_arena &arena, std::istream
 
 
 bool arena::base_hash_arena::load(const std::string &filename, const std::function<void(std::istream &)> &extra) {
-    base_hash_arena anew_one;
-    anew_one.set_check_mem(this->is_check_mem());
-    if (arena_read(anew_one, extra, filename)) {
-        *this = std::move(anew_one); // only update if successful
-        return true;
-    }
-    return false;
+    return arena_read(*this, extra, filename); // only updates this if successful
 }
 bool arena::base_hash_arena::retrieve(std::istream &in, const std::function<void(std::istream &)> &extra) {
     base_hash_arena anew_one;
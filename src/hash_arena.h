@@ -45,6 +45,17 @@ namespace arena {
         mutable size_t cow_alllocated{};
         bool borrowed{false};
         bool opt_check_mem = true;
+        // what every page held when the last snapshot or delta was written, by page number,
+        // so that the next save can tell which pages changed since. 0 is a page that was
+        // not there. only kept while max_save_deltas is on
+        mutable heap::std_vector<uint64_t> checkpoint{};
+        // the snapshot the deltas written since belong to, and how many there are
+        mutable uint64_t checkpoint_id{0};
+        mutable size_t checkpoint_deltas{0};
+        // when page_data is the snapshot's page image mapped copy on write, rather than
+        // memory the pages were read into: the address range reserved behind it, which
+        // the arena grows into without touching the file. 0 otherwise
+        size_t mapped_reserved{0};
 
         void reconcile_free_list() {
             free_address_list.clear();
@@ -97,8 +108,13 @@ namespace arena {
                 cow = other.cow;
                 cow_size = other.cow_size;
                 cow_alllocated = other.cow_alllocated;
+                checkpoint = std::move(other.checkpoint);
+                checkpoint_id = other.checkpoint_id;
+                checkpoint_deltas = other.checkpoint_deltas;
+                mapped_reserved = other.mapped_reserved;
                 other.page_data = nullptr;
                 other.page_data_size = 0;
+                other.mapped_reserved = 0;
 
                 other.clear();
 
@@ -124,6 +140,9 @@ namespace arena {
                 max_allocated_page = other.max_allocated_page;
                 hidden_arena = other.hidden_arena;
                 free_address_list = other.free_address_list;
+                checkpoint = other.checkpoint;
+                checkpoint_id = other.checkpoint_id;
+                checkpoint_deltas = other.checkpoint_deltas;
             }
             return *this;
         };
@@ -174,9 +193,15 @@ namespace arena {
                     return r;
                 }
 
-                page_data = (uint8_t*) mremap(page_data, page_data_size, new_size, MREMAP_MAYMOVE);
-                if (page_data == MAP_FAILED) {
-                    abort_with("failed to allocate virtual page data");
+                if (mapped_reserved > 0) {
+                    if (!resize_mapped(new_size)) {
+                        abort_with("failed to release virtual page data");
+                    }
+                } else {
+                    page_data = (uint8_t*) mremap(page_data, page_data_size, new_size, MREMAP_MAYMOVE);
+                    if (page_data == MAP_FAILED) {
+                        abort_with("failed to allocate virtual page data");
+                    }
                 }
 
                 heap::allocated -=  physical_page_size ;
@@ -218,7 +243,7 @@ namespace arena {
                     memcpy(npd, page_data, new_page_data_size);
                     heap::allocated += new_page_data_size;
                     heap::vmm_allocated += new_page_data_size;
-                    munmap(page_data, page_data_size);
+                    unmap_page_data();
                     heap::allocated -= page_data_size;
                     heap::vmm_allocated -= page_data_size;
                     page_data_size = new_page_data_size;
@@ -238,10 +263,14 @@ namespace arena {
             top = max_top;
             free_pages = top;
             last_allocated = 0;
+            // nothing the file holds is here any more, so the next save writes it all
+            checkpoint = heap::std_vector<uint64_t>{};
+            checkpoint_id = 0;
+            checkpoint_deltas = 0;
             if (!borrowed) {
                 if (page_data != nullptr) {
                     if (opt_use_vmmap) {
-                        munmap(page_data, page_data_size);
+                        unmap_page_data();
                         heap::allocated -= page_data_size;
                         heap::vmm_allocated -= page_data_size;
                     } else {
@@ -513,7 +542,14 @@ namespace arena {
                 new_size = physical_page_size;
             }
             if (opt_use_vmmap) {
-                if (page_data_size > 0) {
+                if (mapped_reserved > 0 && !resize_mapped(new_size)) {
+                    detach_mapped();
+                }
+                if (mapped_reserved > 0) {
+                    heap::allocated += new_size - page_data_size;
+                    heap::vmm_allocated += new_size - page_data_size;
+                    page_data_size = new_size;
+                } else if (page_data_size > 0) {
                     page_data = (uint8_t*) mremap(page_data, page_data_size, new_size, MREMAP_MAYMOVE);
                     if (page_data == MAP_FAILED) {
                         abort_with("failed to allocate virtual page data");
@@ -669,17 +705,66 @@ namespace arena {
         bool is_check_mem() const {
             return opt_check_mem;
         }
+        /**
+         * write the arena to filename. With max_save_deltas on, a save after the first
+         * writes only the pages that changed since the save before it, to a delta file
+         * next to the snapshot, and the snapshot is written in full again once there are
+         * max_save_deltas of them or when most pages changed anyway.
+         * The snapshot is a page image: every page at its page number times page_size,
+         * after the header, so that a load can map it instead of reading it. With
+         * save_compression_level set it is a stream of zstd compressed pages instead,
+         * compressed by save_workers threads while it is written. Every page of either,
+         * and of a delta, is written with its crc32c
+         */
         bool save(const std::string &filename, const std::function<void(std::ostream &)> &extra) const;
 
+        /**
+         * read the snapshot in filename and every delta written after it. With
+         * use_vmm_memory on the snapshot's pages are mapped copy on write rather than read,
+         * so they are not kept in memory once their checksum was checked, and a page is
+         * only copied once it is changed. The file must then not be written over in place
+         * while it is loaded - a save writes a new one and renames it over, which is fine.
+         * A page that fails its checksum fails the whole load, and leaves this as it was
+         */
         bool load(const std::string &filename, const std::function<void(std::istream &)> &extra);
 
         bool retrieve(std::istream& in, const std::function<void(std::istream &)> &extra);
 
-        bool send(std::ostream &out, const std::function<void(std::ostream &)> &extra, bool write_version) const ;
+        bool send(std::ostream &out, const std::function<void(std::ostream &)> &extra, bool write_version,
+                  heap::std_vector<uint64_t>* fingerprints = nullptr) const ;
 
         static bool arena_read(base_hash_arena &arena, const std::function<void(std::istream &)> &extra,
                                const std::string &filename);
         static bool arena_retrieve(base_hash_arena &arena, std::istream& in, const std::function<void(std::istream &)> &exre);
+
+        /** the file the seq'th delta after the snapshot in filename is written to */
+        static std::string delta_name(const std::string &filename, size_t seq);
+        /** remove the deltas of the snapshot in filename */
+        static void remove_deltas(const std::string &filename);
+    private:
+        [[nodiscard]] uint64_t fingerprint(size_t page) const;
+        void take_checkpoint() const;
+        bool save_delta(const std::string &filename, const std::function<void(std::ostream &)> &extra,
+                        const heap::std_vector<size_t>& changed, const heap::std_vector<size_t>& removed) const;
+        static bool read_page(base_hash_arena &arena, std::istream& in, size_t max_address_accessed, bool replace,
+                              size_t* loaded = nullptr);
+        bool write_image(std::ostream &out, const std::function<void(std::ostream &)> &extra, uint64_t id,
+                         heap::std_vector<uint64_t>* fingerprints) const;
+        bool write_packed(std::ofstream &out, const std::string &filename, const std::function<void(std::ostream &)> &extra,
+                          uint64_t id, heap::std_vector<uint64_t>* fingerprints, int level) const;
+        static bool arena_unpack(base_hash_arena &arena, std::istream& in, const std::function<void(std::istream &)> &extra,
+                                 uint64_t& id);
+        static bool arena_map(base_hash_arena &arena, std::istream& in, const std::function<void(std::istream &)> &extra,
+                              const std::string &filename, uint64_t& id);
+        // a mapped arena grows and shrinks inside the range reserved behind it, with
+        // anonymous memory past the end of the image - the snapshot file is never written.
+        // false when new_size does not fit, and the pages are copied out instead
+        bool resize_mapped(size_t new_size);
+        void detach_mapped();
+        // unmap page_data, and the reservation behind it when it is mapped
+        void unmap_page_data();
+        static size_t apply_deltas(base_hash_arena &arena, const std::function<void(std::istream &)> &extra,
+                                   const std::string &filename, uint64_t id);
         //static bool arena_send(base_hash_arena &arena, std::istream& in);
     };
 
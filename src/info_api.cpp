@@ -18,9 +18,14 @@
 #include "asio/detail/chrono.hpp"
 #include "version.h"
 #include "configuration.h"
+#include "append_log.h"
+#include "latency.h"
+#include "lock_profile.h"
+#include "rpc/buffer_pool.h"
 #include "key_space.h"
 #include "sastam.h"
 #include "statistics.h"
+#include "rpc/server.h"
 #include <fstream>
 #include <unistd.h>
 auto start_time = std::chrono::high_resolution_clock::now();
@@ -122,7 +127,37 @@ int INFO(caller& call, const arg_t& argv) {
         "size:"+tos(s->get_size())+"\n"
         "bytes_allocated:"+tos(s->get_ap().get_leaves().get_bytes_allocated() + s->get_ap().get_nodes().get_bytes_allocated()) + "\n"
         "virtual_allocated:"+tos(s->get_ap().get_leaves().get_allocated() + s->get_ap().get_nodes().get_allocated()) + "\n"
-        "foreign_flights:"+tos(static_cast<const barch::shard*>(s.get())->flights.size())+"\n";
+        "foreign_flights:"+tos(static_cast<const barch::shard*>(s.get())->flights.size())+"\n"
+        // what the maintenance pool has spent on this shard, and how urgent it was last
+        // judged - urgency is in thousandths, 1000 is a fair share of memory unfragmented
+        "maintenance_runs:"+tos(s->maintenance_time.runs.load())+"\n"
+        "maintenance_last_us:"+tos(s->maintenance_time.last_us.load())+"\n"
+        "maintenance_total_us:"+tos(s->maintenance_time.total_us.load())+"\n"
+        "maintenance_max_us:"+tos(s->maintenance_time.max_us.load())+"\n"
+        "maintenance_urgency:"+tos(s->maintenance_time.urgency.load())+"\n"
+        // deadlines waiting in the expiry wheel, and the keys it has reclaimed
+        "expiry_scheduled:"+tos(static_cast<const barch::shard*>(s.get())->expiries.size())+"\n"
+        "expiry_reclaimed:"+tos(static_cast<const barch::shard*>(s.get())->expiries_reclaimed.load())+"\n"
+        // the key filter: the keys it is sized for, what it holds, and the lookups it
+        // answered without the tree. a false positive is a key it passed that was not there
+        "bloom_capacity:"+tos(s->bloom.capacity())+"\n"
+        "bloom_bytes:"+tos(s->bloom.byte_size())+"\n"
+        "bloom_added:"+tos(s->bloom.added())+"\n"
+        "bloom_rebuilds:"+tos(s->bloom.rebuilds.load())+"\n"
+        "bloom_ruled_out:"+tos(s->bloom.ruled_out.load())+"\n"
+        "bloom_passed:"+tos(s->bloom.passed.load())+"\n"
+        "bloom_false_positives:"+tos(s->bloom.false_positives.load())+"\n";
+        // what the shard's latch has cost, as INFO locks has it for every shard. the
+        // times stay 0 unless lock_profiling is on
+        auto latch = s->get_latch().contention();
+        response +=
+        "latch_acquired_shared:"+tos(latch.shared_acquired)+"\n"
+        "latch_acquired_unique:"+tos(latch.unique_acquired)+"\n"
+        "latch_waits:"+tos(latch.shared_waits + latch.unique_waits)+"\n"
+        "latch_timeouts:"+tos(latch.timeouts)+"\n"
+        "latch_upgrade_failures:"+tos(latch.upgrade_failures)+"\n"
+        "latch_wait_us:"+tos(latch.wait_ns / 1000)+"\n"
+        "latch_hold_us:"+tos(latch.hold_ns / 1000)+"\n";
 
         call.push_vt(response);
         return 0;
@@ -178,6 +213,7 @@ int INFO(caller& call, const arg_t& argv) {
             policy = "noeviction";
         }
         std::string allocator = barch::get_use_vmm_memory() ? "barch-vmm" : "barch-heap";
+        auto buffers = barch::buffer_pool::get_usage();
 
         std::string response =
         "# Memory\n\n"
@@ -226,7 +262,7 @@ int INFO(caller& call, const arg_t& argv) {
         "mem_replication_backlog:0\n"
         "mem_total_replication_buffers:0\n"
         "mem_clients_slaves:0\n"
-        "mem_clients_normal:0\n"
+        "mem_clients_normal:"+tos(buffers.lent_bytes)+"\n"
         "mem_cluster_links:0\n"
         "mem_aof_buffer:0\n"
         "mem_allocator:"+allocator+"\n"
@@ -253,12 +289,20 @@ int INFO(caller& call, const arg_t& argv) {
         "barch_size_256_nodes:"+tos(as.node256_nodes)+"\n"
         "barch_pages_evicted:"+tos(as.pages_evicted)+"\n"
         "barch_keys_evicted:"+tos(as.keys_evicted)+"\n"
+        "barch_keys_evicted_lfu:"+tos(as.keys_evicted_lfu)+"\n"
+        "barch_keys_expired:"+tos(as.keys_expired)+"\n"
         "barch_pages_defragged:"+tos(as.pages_defragged)+"\n"
         "barch_vmm_pages_defragged:"+tos(as.vmm_pages_defragged)+"\n"
         "barch_vmm_pages_popped:"+tos(as.vmm_pages_popped)+"\n"
         "barch_oom_avoided_inserts:"+tos(as.oom_avoided_inserts)+"\n"
         "barch_vacuum_count:"+tos(as.vacuums_performed)+"\n"
-        "barch_last_vacuum_time:"+tos(as.last_vacuum_time)+"\n";
+        "barch_last_vacuum_time:"+tos(as.last_vacuum_time)+"\n"
+        // the read buffers connections borrow while they have a request half read: what
+        // is lent and what waits in the pool, and how often a loan came from the pool
+        "barch_read_buffers_lent_bytes:"+tos(buffers.lent_bytes)+"\n"
+        "barch_read_buffers_pooled_bytes:"+tos(buffers.pooled_bytes)+"\n"
+        "barch_read_buffers_taken:"+tos(buffers.taken)+"\n"
+        "barch_read_buffers_reused:"+tos(buffers.reused)+"\n";
 
         call.push_vt(response);
         return 0;
@@ -343,11 +387,104 @@ int INFO(caller& call, const arg_t& argv) {
         "executable:_barch.so or liblbarch.so\n"
         "config_file:NONE/RESP\n"
         "io_threads_active:"+tos(std::thread::hardware_concurrency())+"\n"
+        // the connections on io_uring rings, and how many submits their reads and
+        // writes took - completions per submit is what the rings are saving
+        "io_uring_sessions:"+tos(statistics::repl::uring_sessions.load())+"\n"
+        "io_uring_submits:"+tos(statistics::repl::uring_submits.load())+"\n"
+        "io_uring_completions:"+tos(statistics::repl::uring_completions.load())+"\n"
+        // large GET values that went from the leaf to the socket without a copy, and
+        // what was copied anyway because the socket was full
+        "scattered_replies:"+tos(statistics::repl::scattered_replies.load())+"\n"
+        "scattered_bytes_copied:"+tos(statistics::repl::scattered_bytes_copied.load())+"\n"
+        // pipelines whose single key requests ran a group of shards per worker
+        "parallel_pipelines:"+tos(statistics::repl::parallel_pipelines.load())+"\n"
+        "parallel_requests:"+tos(statistics::repl::parallel_requests.load())+"\n"
+        // started per core: the cores owning shards, the requests run by another core
+        // than the one that read them, and the mailbox traffic between cores for them
+        "shard_cores:"+tos(statistics::repl::shard_cores.load())+"\n"
+        "core_forwarded_requests:"+tos(statistics::repl::core_forwarded_requests.load())+"\n"
+        "core_mailbox_sends:"+tos(statistics::repl::core_mailbox_sends.load())+"\n"
+        "core_mailbox_full:"+tos(statistics::repl::core_mailbox_full.load())+"\n"
         "listener0:name=tcp,bind=*,bind=-::*,port="+port+"\n";
 
         call.push_vt(response);
         return 0;
     }
+    if (argv.size() == 2 && lower(text, argv[1].to_string()) == "persistence") {
+        uint64_t raw = statistics::snapshot_bytes_raw.load();
+        uint64_t us = statistics::snapshot_write_us.load();
+        std::string response =
+        "# Persistence\n\n"
+        "snapshots_written:"+tos(statistics::snapshots_written.load())+"\n"
+        "snapshot_compression_level:"+tos(barch::get_save_compression_level())+"\n"
+        "snapshot_bytes_raw:"+tos(raw)+"\n"
+        "snapshot_bytes_written:"+tos(statistics::snapshot_bytes_written.load())+"\n"
+        "snapshot_write_us:"+tos(us)+"\n"
+        // page bytes a second, over every snapshot and over the last one
+        "snapshot_bytes_per_sec:"+tos(us ? (uint64_t)((double)raw * 1000000.0 / (double)us) : 0)+"\n"
+        "snapshot_last_bytes_per_sec:"+tos(statistics::snapshot_last_bytes_per_sec.load())+"\n"
+        "save_deltas:"+tos(statistics::save_deltas.load())+"\n"
+        "save_pages_unchanged:"+tos(statistics::save_pages_unchanged.load())+"\n"
+        "load_pages_mapped:"+tos(statistics::load_pages_mapped.load())+"\n"
+        "append_log_enabled:"+tos(barch::append_log::is_open() ? 1 : 0)+"\n"
+        "append_log_entries:"+tos(statistics::append_log_entries.load())+"\n"
+        "append_log_bytes:"+tos(statistics::append_log_bytes.load())+"\n"
+        "append_log_fsyncs:"+tos(statistics::append_log_fsyncs.load())+"\n"
+        "append_log_write_errors:"+tos(statistics::append_log_write_errors.load())+"\n"
+        "append_log_replayed:"+tos(statistics::append_log_replayed.load())+"\n";
+        call.push_vt(response);
+        return 0;
+    }
+    if (argv.size() == 2 && lower(text, argv[1].to_string()) == "latencystats") {
+        // redis's own lines for the commands, in microseconds with three decimals, and
+        // the same for the waits on each shard's latch, the most waited on first
+        auto usec = [](uint64_t ns) {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%.3f", (double) ns / 1000.0);
+            return std::string(buffer);
+        };
+        auto percentiles = [&usec](const barch::latency::summary& s) {
+            return "p50="+usec(s.p50_ns)+",p99="+usec(s.p99_ns)+",p99.9="+usec(s.p999_ns);
+        };
+        std::string response = "# Latencystats\n"
+        "latency_tracking:"+tos(barch::latency::on() ? 1 : 0)+"\n";
+        for (auto& s : barch::latency::commands()) {
+            response += "latency_percentiles_usec_"+s.name+":"+percentiles(s)+"\n";
+        }
+        for (auto& s : barch::latency::latches()) {
+            response += "latch_wait_usec_"+s.name+":waits="+tos(s.count)+","+percentiles(s)
+                     +",max="+usec(s.max_ns)+",total="+usec(s.total_ns)+"\n";
+        }
+        call.push_vt(response);
+        return 0;
+    }
+    if (argv.size() == 2 && lower(text, argv[1].to_string()) == "locks") {
+        // every shard latch that was used, the most waited on first, and for each the
+        // places writers held it from that the sampling caught, the longest held first
+        auto usec = [](uint64_t ns) {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%.3f", (double) ns / 1000.0);
+            return std::string(buffer);
+        };
+        auto latches = barch::lock_profile::hottest();
+        std::string response = "# Locks\n"
+        "lock_profiling:"+tos(barch::lock_profile::on() ? 1 : 0)+"\n"
+        "latches_used:"+tos(latches.size())+"\n";
+        for (auto& l : latches) {
+            response += "latch_"+l.name+":shared="+tos(l.shared_acquired)+",unique="+tos(l.unique_acquired)
+                     +",waits="+tos(l.waits)+",wait_usec="+usec(l.wait_ns)+",max_wait_usec="+usec(l.max_wait_ns)
+                     +",hold_usec="+usec(l.hold_ns)+",max_hold_usec="+usec(l.max_hold_ns)
+                     +",upgrades="+tos(l.upgrades)+",upgrade_failures="+tos(l.upgrade_failures)
+                     +",timeouts="+tos(l.timeouts)+"\n";
+            for (size_t i = 0; i < l.sites.size(); ++i) {
+                auto& site = l.sites[i];
+                response += "latch_site_"+l.name+"_"+tos(i)+":samples="+tos(site.samples)
+                         +",wait_usec="+usec(site.wait_ns)+",hold_usec="+usec(site.hold_ns)+",at="+site.where+"\n";
+            }
+        }
+        call.push_vt(response);
+        return 0;
+    }
     if (argv.size() == 2 && lower(text, argv[1].to_string()) == "foreign") {
         uint64_t inflight = 0;
         barch::all_spaces([&](const std::string&, const barch::key_space_ptr& ks) {
@@ -366,6 +503,39 @@ int INFO(caller& call, const arg_t& argv) {
         call.push_vt(response);
         return 0;
     }
+    if (argv.size() == 2 && lower(text, argv[1].to_string()) == "replication") {
+        // one line per PUBLISH destination. backlog is what has been queued for it and
+        // not acknowledged yet, in_flight the part of that already on the wire
+        auto rs = barch::get_repl_statistics();
+        auto dests = barch::repl::get_destination_statistics();
+        std::string response =
+        "# Replication\n\n"
+        "role:master\n"
+        "connected_slaves:"+tos(dests.size())+"\n"
+        "repl_backlog:"+tos(rs.repl_backlog)+"\n"
+        "repl_in_flight:"+tos(rs.repl_in_flight)+"\n"
+        "repl_batches_sent:"+tos(rs.repl_batches_sent)+"\n"
+        "repl_commands_acked:"+tos(rs.repl_commands_acked)+"\n"
+        "repl_lag_ms:"+tos(rs.repl_lag_ms)+"\n"
+        "repl_dropped:"+tos(rs.repl_dropped)+"\n";
+        size_t n = 0;
+        for (const auto& d : dests) {
+            response += "slave"+tos(n++)+":addr="+d.name+
+            ",backlog="+tos(d.backlog)+
+            ",in_flight="+tos(d.in_flight)+
+            ",acked="+tos(d.acked)+
+            ",batches="+tos(d.batches)+
+            ",call_errors="+tos(d.call_errors)+
+            ",failures="+tos(d.failures)+
+            ",dropped="+tos(d.dropped)+
+            ",blocked="+tos(d.blocked)+
+            ",resyncs="+tos(d.resyncs)+
+            ",reconnects="+tos(d.reconnects)+
+            ",lag_ms="+tos(d.lag_ms)+"\n";
+        }
+        call.push_vt(response);
+        return 0;
+    }
     return call.push_error("not implemented");
 }
 }
@@ -395,6 +565,8 @@ int STATS(caller& call, const arg_t& argv) {
     call.push_values({ "leaf_nodes_replaced", as.leaf_nodes_replaced});
     call.push_values({ "pages_evicted", as.pages_evicted});
     call.push_values({ "keys_evicted", as.keys_evicted});
+    call.push_values({ "keys_evicted_lfu", as.keys_evicted_lfu});
+    call.push_values({ "keys_expired", as.keys_expired});
     call.push_values({ "pages_defragged", as.pages_defragged});
     call.push_values({ "vmm_pages_defragged", as.vmm_pages_defragged});
     call.push_values({ "vmm_pages_popped", as.vmm_pages_popped});
@@ -417,6 +589,30 @@ int STATS(caller& call, const arg_t& argv) {
     call.push_values({"foreign_overloaded", statistics::foreign_overloaded.load()});
     call.push_values({"foreign_cancelled", statistics::foreign_cancelled.load()});
     call.push_values({"foreign_slow", statistics::foreign_slow.load()});
+    call.push_values({"globs_running", statistics::globs_running.load()});
+    call.push_values({"globs_refused", statistics::globs_refused.load()});
+    call.push_values({"globs_abandoned", statistics::globs_abandoned.load()});
+    uint64_t bloom_ruled_out = 0, bloom_passed = 0, bloom_false_positives = 0;
+    barch::all_shards([&](const barch::shard_ptr& s) {
+        bloom_ruled_out += s->bloom.ruled_out.load();
+        bloom_passed += s->bloom.passed.load();
+        bloom_false_positives += s->bloom.false_positives.load();
+    });
+    call.push_values({"bloom_ruled_out", bloom_ruled_out});
+    call.push_values({"bloom_passed", bloom_passed});
+    call.push_values({"bloom_false_positives", bloom_false_positives});
+    call.push_values({"save_deltas", statistics::save_deltas.load()});
+    call.push_values({"save_pages_unchanged", statistics::save_pages_unchanged.load()});
+    call.push_values({"load_pages_mapped", statistics::load_pages_mapped.load()});
+    call.push_values({"snapshots_written", statistics::snapshots_written.load()});
+    call.push_values({"snapshot_bytes_raw", statistics::snapshot_bytes_raw.load()});
+    call.push_values({"snapshot_bytes_written", statistics::snapshot_bytes_written.load()});
+    call.push_values({"snapshot_write_us", statistics::snapshot_write_us.load()});
+    call.push_values({"append_log_entries", statistics::append_log_entries.load()});
+    call.push_values({"append_log_bytes", statistics::append_log_bytes.load()});
+    call.push_values({"append_log_fsyncs", statistics::append_log_fsyncs.load()});
+    call.push_values({"append_log_write_errors", statistics::append_log_write_errors.load()});
+    call.push_values({"append_log_replayed", statistics::append_log_replayed.load()});
     call.end_array();
     return 0;
 }
@@ -462,6 +658,38 @@ int cmd_OPS(ValkeyModuleCtx *ctx, ValkeyModuleString ** argv, int argc) {
     vk_caller call;
     return call.vk_call(ctx, argv, argc, OPS);
 }
+/**
+ * LOCKS [count]
+ * the hottest shard latches, as INFO locks ranks them, one array of name/value pairs
+ * each, so a client can decide what internal_shards should be without parsing INFO
+ */
+int LOCKS(caller& call, const arg_t& argv) {
+    if (argv.size() > 2)
+        return call.wrong_arity();
+    uint64_t count = 10;
+    if (argv.size() == 2 && !conversion::to_ui64(argv[1], count))
+        return call.push_error("count must be a number");
+
+    call.start_array();
+    for (auto& l : barch::lock_profile::hottest(count)) {
+        call.start_array();
+        call.push_values({"latch", l.name, "shared", l.shared_acquired, "unique", l.unique_acquired,
+                          "waits", l.waits, "wait_us", l.wait_ns / 1000, "max_wait_us", l.max_wait_ns / 1000,
+                          "hold_us", l.hold_ns / 1000, "max_hold_us", l.max_hold_ns / 1000,
+                          "upgrades", l.upgrades, "upgrade_failures", l.upgrade_failures,
+                          "timeouts", l.timeouts, "site", l.sites.empty() ? std::string() : l.sites[0].where});
+        call.end_array();
+    }
+    call.end_array();
+    return 0;
+}
+/* B.LOCKS [count]
+ *
+ * the hottest shard latches. */
+int cmd_LOCKS(ValkeyModuleCtx *ctx, ValkeyModuleString ** argv, int argc) {
+    vk_caller call;
+    return call.vk_call(ctx, argv, argc, LOCKS);
+}
 int HEAPBYTES(caller& call, const arg_t& argv) {
     //compressed_release release;
     if (argv.size() != 1)
@@ -499,6 +727,9 @@ int add_info_api(ValkeyModuleCtx *ctx) {
     if (ValkeyModule_CreateCommand(ctx, NAME(OPS), "readonly", 0, 0, 0) == VALKEYMODULE_ERR)
         return VALKEYMODULE_ERR;
 
+    if (ValkeyModule_CreateCommand(ctx, NAME(LOCKS), "readonly", 0, 0, 0) == VALKEYMODULE_ERR)
+        return VALKEYMODULE_ERR;
+
     if (ValkeyModule_CreateCommand(ctx, NAME(MILLIS), "readonly", 0, 0, 0) == VALKEYMODULE_ERR)
         return VALKEYMODULE_ERR;
 
@@ -518,4 +749,5 @@ void register_info_api(function_map& r) {
     r["INFO"] = {::INFO,{"read","stats"}};
     r["STATS"] = {::STATS,{"read","stats"}};
     r["OPS"] = {::OPS,{"read","stats"}};
+    r["LOCKS"] = {::LOCKS,{"read","stats"}};
 }
@@ -12,6 +12,7 @@ extern "C" {
     int INFO(caller& call, const arg_t& argv);
     int STATS(caller& call, const arg_t& argv);
     int OPS(caller& call, const arg_t& argv);
+    int LOCKS(caller& call, const arg_t& argv);
     int HEAPBYTES(caller& call, const arg_t& argv);
 }
 
@@ -0,0 +1,302 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "key_filter.h"
+
+#include <algorithm>
+#include <deque>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <ankerl/unordered_dense.h>
+
+#include "constants.h"
+#include "ioutil.h"
+
+namespace barch {
+    // a line is one cache line, eight words, and a key sets probes bits in it. six probes
+    // of nine bits each come out of one mixed 64 bit hash
+    enum {
+        line_words = 8,
+        line_bits = line_words * 64,
+        line_bytes = line_words * sizeof(uint64_t),
+        probes = 6,
+        probe_shift = 9,
+        header_bytes = 3 * sizeof(uint64_t)
+    };
+
+    struct key_filter::bits {
+        explicit bits(size_t lines, size_t capacity) :
+        lines(lines), capacity(capacity), storage(lines * line_words + line_words) {
+            // start at a cache line boundary, so that no line straddles two of them
+            auto at = reinterpret_cast<uintptr_t>(storage.data());
+            offset = ((line_bytes - at % line_bytes) % line_bytes) / sizeof(uint64_t);
+        }
+        std::atomic<uint64_t>* line(uint64_t hash) {
+            auto index = (uint64_t) (((unsigned __int128) hash * lines) >> 64);
+            return storage.data() + offset + index * line_words;
+        }
+        const std::atomic<uint64_t>* line(uint64_t hash) const {
+            return const_cast<bits*>(this)->line(hash);
+        }
+        size_t lines;
+        size_t capacity;
+        std::atomic<uint64_t> added{};
+        heap::vector<std::atomic<uint64_t>> storage;
+        size_t offset = 0;
+    };
+
+    /**
+     * When a filter that was replaced may be freed. A reader announces the epoch it
+     * started in, in a slot of its own thread's, for as long as it looks at a filter, and
+     * takes it down again after. A writer that has swapped a filter out moves the epoch
+     * on and waits until no slot is still in an epoch from before, after which nobody can
+     * be looking at the old filter: a reader that started later loads the new one. The
+     * reader only ever writes its own cache line, so lookups on many threads do not
+     * contend with each other, and the wait is as long as a few lookups take.
+     */
+    namespace reclaim {
+        struct slot {
+            alignas(64) std::atomic<uint64_t> epoch{0};
+            std::atomic<bool> taken{false};
+        };
+        static std::atomic<uint64_t> epoch{1};
+        static std::mutex slots_lock{};
+        // never shrinks, so a slot stays where it is while a writer looks at it
+        static std::deque<slot> slots{};
+
+        // gives the thread's slot back when the thread ends
+        struct owner {
+            slot* s = nullptr;
+            ~owner() {
+                if (s) s->taken.store(false, std::memory_order_release);
+            }
+        };
+
+        static slot& mine() {
+            thread_local owner o;
+            if (!o.s) {
+                std::lock_guard lk(slots_lock);
+                for (auto& s : slots) {
+                    bool free = false;
+                    if (s.taken.compare_exchange_strong(free, true)) {
+                        o.s = &s;
+                        break;
+                    }
+                }
+                if (!o.s) {
+                    o.s = &slots.emplace_back();
+                    o.s->taken = true;
+                }
+            }
+            return *o.s;
+        }
+
+        struct reading {
+            slot& s = mine();
+            reading() {
+                s.epoch.store(epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            }
+            ~reading() {
+                s.epoch.store(0, std::memory_order_release);
+            }
+        };
+
+        static void wait_for_readers() {
+            uint64_t before = epoch.fetch_add(1, std::memory_order_seq_cst);
+            std::lock_guard lk(slots_lock);
+            for (auto& s : slots) {
+                for (;;) {
+                    uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+                    if (e == 0 || e > before) break;
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    static uint64_t key_hash(art::value_type key) {
+        return ankerl::unordered_dense::detail::wyhash::hash(key.chars(), key.size);
+    }
+
+    // the line is picked with the high bits of the key's hash, so the probes come from
+    // another mix of it rather than from what is left over
+    static uint64_t probe_hash(uint64_t hash) {
+        return ankerl::unordered_dense::detail::wyhash::hash(hash);
+    }
+
+    key_filter::key_filter() = default;
+    key_filter::~key_filter() = default;
+
+    std::unique_ptr<key_filter::bits> key_filter::make(size_t keys) {
+        size_t capacity = std::max<size_t>(keys, bloom_min_keys);
+        size_t lines = (capacity * bloom_bits_per_key + line_bits - 1) / line_bits;
+        return std::make_unique<bits>(lines, capacity);
+    }
+
+    void key_filter::set(bits& b, uint64_t hash) {
+        auto* words = b.line(hash);
+        uint64_t p = probe_hash(hash);
+        bool fresh = false;
+        for (unsigned i = 0; i < probes; ++i, p >>= probe_shift) {
+            unsigned bit = p & (line_bits - 1);
+            uint64_t mask = 1ull << (bit & 63);
+            auto& word = words[bit >> 6];
+            // most keys added are already there, so look before writing the line dirty
+            if (!(word.load(std::memory_order_relaxed) & mask)) {
+                word.fetch_or(mask, std::memory_order_relaxed);
+                fresh = true;
+            }
+        }
+        if (fresh) b.added.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void key_filter::publish(std::unique_ptr<bits> next_bits) {
+        auto retired = std::move(owned);
+        owned = std::move(next_bits);
+        current.store(owned.get(), std::memory_order_seq_cst);
+        if (retired) reclaim::wait_for_readers();
+    }
+
+    void key_filter::reset(bool on, size_t keys) {
+        next.reset();
+        pending = false;
+        publish(on ? make(keys) : nullptr);
+    }
+
+    void key_filter::defer() {
+        next.reset();
+        publish(nullptr);
+        pending = true;
+    }
+
+    void key_filter::add(art::value_type key) {
+        if (!owned && !next) return;
+        uint64_t hash = key_hash(key);
+        if (owned) set(*owned, hash);
+        if (next) set(*next, hash);
+    }
+
+    bool key_filter::may_contain(art::value_type key) const {
+        reclaim::reading guard;
+        const bits* b = current.load(std::memory_order_seq_cst);
+        if (!b) return true; // yes we assume the key exists
+        uint64_t hash = key_hash(key);
+        const auto* words = b->line(hash);
+        uint64_t p = probe_hash(hash);
+        for (unsigned i = 0; i < probes; ++i, p >>= probe_shift) {
+            unsigned bit = p & (line_bits - 1);
+            if (!(words[bit >> 6].load(std::memory_order_relaxed) & (1ull << (bit & 63)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool key_filter::needs_rebuild(size_t live) const {
+        if (!owned || next) return false;
+        size_t wanted = std::max<size_t>(live, bloom_min_keys);
+        // too full, full of keys that were deleted since, or far too big for what is left
+        return live > owned->capacity
+               || owned->added.load(std::memory_order_relaxed) > 2 * wanted
+               || owned->capacity > 8 * wanted;
+    }
+
+    void key_filter::start_rebuild(size_t live) {
+        if (!owned && !pending) return;
+        // room to grow into, so a growing shard is not rebuilt again straight away
+        next = make(live * 2);
+    }
+
+    void key_filter::add_rebuilt(art::value_type key) {
+        if (next) set(*next, key_hash(key));
+    }
+
+    void key_filter::finish_rebuild() {
+        if (!next || (!owned && !pending)) {
+            next.reset();
+            return;
+        }
+        publish(std::move(next));
+        // the first filter of a deferred one is not a replacement
+        if (pending) pending = false;
+        else ++rebuilds;
+    }
+
+    uint32_t key_filter::stored_size() const {
+        if (!owned) return 0;
+        uint64_t size = header_bytes + owned->lines * line_bytes;
+        // a filter of more than 4GB is not stored, and rebuilt from the keys on load
+        return size > std::numeric_limits<uint32_t>::max() ? 0 : (uint32_t) size;
+    }
+
+    void key_filter::write(std::ostream& of) const {
+        if (!stored_size()) return;
+        uint64_t lines = owned->lines;
+        uint64_t capacity = owned->capacity;
+        uint64_t added = owned->added.load(std::memory_order_relaxed);
+        writep(of, lines);
+        writep(of, capacity);
+        writep(of, added);
+        uint64_t line[line_words];
+        const auto* words = owned->storage.data() + owned->offset;
+        for (uint64_t l = 0; l < lines; ++l) {
+            for (unsigned w = 0; w < line_words; ++w) {
+                line[w] = words[l * line_words + w].load(std::memory_order_relaxed);
+            }
+            writep(of, line, sizeof(line));
+        }
+    }
+
+    bool key_filter::read(std::istream& in, uint32_t size) {
+        auto skip = [&in](uint64_t bytes) {
+            uint8_t x;
+            for (; bytes > 0; --bytes) readp(in, x);
+        };
+        if (size < header_bytes) {
+            skip(size);
+            return false;
+        }
+        uint64_t lines = 0, capacity = 0, added = 0;
+        readp(in, lines);
+        readp(in, capacity);
+        readp(in, added);
+        uint64_t rest = size - header_bytes;
+        if (lines == 0 || rest != lines * line_bytes) {
+            skip(rest);
+            return false;
+        }
+        auto loaded = std::make_unique<bits>(lines, capacity);
+        loaded->added = added;
+        uint64_t line[line_words];
+        auto* words = loaded->storage.data() + loaded->offset;
+        for (uint64_t l = 0; l < lines; ++l) {
+            readp(in, line, sizeof(line));
+            for (unsigned w = 0; w < line_words; ++w) {
+                words[l * line_words + w].store(line[w], std::memory_order_relaxed);
+            }
+        }
+        next.reset();
+        publish(std::move(loaded));
+        return true;
+    }
+
+    size_t key_filter::capacity() const {
+        return owned ? owned->capacity : 0;
+    }
+
+    size_t key_filter::byte_size() const {
+        size_t r = 0;
+        for (auto* b : {owned.get(), next.get()}) {
+            if (b) r += b->storage.size() * sizeof(uint64_t);
+        }
+        return r;
+    }
+
+    uint64_t key_filter::added() const {
+        return owned ? owned->added.load(std::memory_order_relaxed) : 0;
+    }
+}
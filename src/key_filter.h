@@ -0,0 +1,103 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_KEY_FILTER_H
+#define BARCH_KEY_FILTER_H
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+#include "sastam.h"
+#include "value_type.h"
+
+namespace barch {
+    /**
+     * The bloom filter a shard reads before it looks for a key, so that most lookups of a
+     * key it does not have never take its lock or walk its tree.
+     *
+     * It used to be four million bits with one hash per key, whatever the shard held. An
+     * empty shard paid 512 KiB for it, and a shard of ten million keys had every bit set
+     * and passed everything. This one is sized from the keys the shard holds, about ten
+     * bits a key, and blocked: every key sets its bits in one 64 byte line, so a lookup
+     * touches one cache line however many probes it makes.
+     *
+     * A bloom filter cannot forget a key, so deletes leave their bits behind and the
+     * filter only ever grows more permissive. It counts the keys that set new bits; once
+     * that is well past what the shard holds, or the shard holds more than the filter was
+     * sized for, maintenance builds a replacement from the leaves and swaps it in. Keys
+     * added while the replacement is being built go into both.
+     *
+     * Readers may look without the shard lock, so a filter that is replaced is only freed
+     * once every reader that could have loaded it is done, see reclaim in key_filter.cpp.
+     */
+    class key_filter {
+    public:
+        key_filter();
+        key_filter(const key_filter&) = delete;
+        key_filter& operator=(const key_filter&) = delete;
+        ~key_filter();
+
+        /** on or off, and when on empty and sized for `keys`. the caller holds the write lock */
+        void reset(bool on, size_t keys);
+        /**
+         * on, but passing everything until a filter is built for the keys already there -
+         * so that a load need not read every leaf before it returns. The build is a
+         * start_rebuild, add_rebuilt, finish_rebuild like any other. the caller holds the
+         * write lock
+         */
+        void defer();
+        [[nodiscard]] bool deferred() const {
+            return pending;
+        }
+        [[nodiscard]] bool enabled() const {
+            return current.load(std::memory_order_acquire) != nullptr;
+        }
+        /** the caller holds the write lock */
+        void add(art::value_type key);
+        /** false only when the key was never added. true when the filter is off */
+        [[nodiscard]] bool may_contain(art::value_type key) const;
+
+        /** true when a filter for `live` keys would pass noticeably less */
+        [[nodiscard]] bool needs_rebuild(size_t live) const;
+        /** start a replacement sized for `live` keys. the caller holds the write lock */
+        void start_rebuild(size_t live);
+        /** add a key to the replacement only. the caller holds at least the read lock */
+        void add_rebuilt(art::value_type key);
+        /** swap the replacement in. the caller holds the write lock */
+        void finish_rebuild();
+
+        /** the filter as write_extra stores it, and its size in bytes */
+        void write(std::ostream& of) const;
+        [[nodiscard]] uint32_t stored_size() const;
+        /**
+         * read what write() stored, of `size` bytes, and turn the filter on with it. false
+         * when it cannot be used, with the bytes read past all the same
+         */
+        bool read(std::istream& in, uint32_t size);
+
+        [[nodiscard]] size_t capacity() const;
+        [[nodiscard]] size_t byte_size() const;
+        [[nodiscard]] uint64_t added() const;
+
+        // what the filter saved, for INFO SHARD and STATS. counted by the callers, which
+        // are the ones that know whether a key that passed was really there
+        mutable std::atomic<uint64_t> ruled_out{};
+        mutable std::atomic<uint64_t> passed{};
+        mutable std::atomic<uint64_t> false_positives{};
+        std::atomic<uint64_t> rebuilds{};
+
+    private:
+        struct bits;
+        static std::unique_ptr<bits> make(size_t keys);
+        static void set(bits& b, uint64_t hash);
+        void publish(std::unique_ptr<bits> next_bits);
+
+        std::atomic<bits*> current{nullptr};
+        std::unique_ptr<bits> owned{};
+        std::unique_ptr<bits> next{};
+        bool pending{false};
+    };
+}
+#endif //BARCH_KEY_FILTER_H
@@ -11,6 +11,7 @@
 #include "module.h"
 #include "swig_api.h"
 #include "thread_pool.h"
+#include "maintenance_pool.h"
 #include "rpc/server.h"
 #include "a5hash.h"
 #include "configuration.h"
@@ -400,6 +401,49 @@ namespace barch {
         }
     }
 
+    /**
+     * How urgently a shard wants maintenance is its share of the space's memory against
+     * an even split, scaled up by how fragmented its leaves are. A shard holding twice
+     * its share, or half of whose leaf memory is free space, is worth reaching before one
+     * that is small and tidy - the first is where eviction finds something to take and
+     * the second is where defrag gives something back.
+     */
+    void key_space::maintain_shards(const heap::vector<shard_ptr>& tshards) {
+        if (tshards.empty()) return;
+        struct ranked {
+            shard_ptr s;
+            double urgency;
+        };
+        heap::vector<ranked> order;
+        order.reserve(tshards.size());
+        double total = 0;
+        for (auto& s : tshards) {
+            auto& ap = s->get_ap();
+            double bytes = (double)(ap.get_leaves().get_bytes_allocated() + ap.get_nodes().get_bytes_allocated());
+            order.push_back({s, bytes});
+            total += bytes;
+        }
+        double fair = total / (double)tshards.size();
+        for (auto& r : order) {
+            double share = fair > 0 ? r.urgency / fair : 1.0;
+            double frag = std::min<double>(r.s->get_ap().get_leaves().fragmentation_ratio(), 1.0);
+            r.urgency = share * (1.0 + frag);
+            r.s->maintenance_time.urgency = (uint64_t)(r.urgency * 1000.0);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const ranked& a, const ranked& b) {
+            return a.urgency > b.urgency;
+        });
+        heap::vector<maintenance_pool::task> tasks;
+        tasks.reserve(order.size());
+        for (auto& r : order) {
+            tasks.emplace_back([this, s = r.s]() {
+                if (exiting) return;
+                s->maintenance();
+            });
+        }
+        get_maintenance_pool()->run(tasks);
+    }
+
     void key_space::start_maintain() {
         exiting = false;
         tmaintain = std::thread([&]() -> void {
@@ -409,7 +453,6 @@ namespace barch {
 
                 while (!this->thread_control.wait((int64_t)get_maintenance_poll_delay()*1000ll)) {
                    tshards = this->get_shards();
-                   repl::distribute();
                     ++statistics::maintenance_cycles;
 
                    if (opt_range_sharded) {
@@ -431,14 +474,7 @@ namespace barch {
                        }
                    }
 
-                   for (auto s : tshards) {
-                       try {
-                           s->maintenance();
-                       }catch (std::exception& e) {
-                           barch::err({"exception in maintenance:",e.what()});
-                       }
-                       if (exiting) break;
-                   }
+                   maintain_shards(tshards);
 
                    try {
                        drop_idle_sql();
@@ -626,7 +662,7 @@ namespace barch {
             auto fc = [&](const art::node_ptr &) -> void {};
             auto k = encode_key(art::value_type{key});
             auto v = art::value_type{value};
-            auto t = this->get(v);
+            auto t = this->get(k.get_value());
             key_options spec;
             spec.set_hashed(!opt_ordered_keys);
             storage_release r(t);
@@ -99,6 +99,11 @@ namespace barch {
         std::mutex lock{};
 
         void start_maintain();
+        /**
+         * one round of maintenance over shards, most urgent first, on the shared
+         * maintenance pool. Returns when every shard has had its turn
+         */
+        void maintain_shards(const heap::vector<shard_ptr>& shards);
         /** build rindex from the loaded shards, repartitioning them first if they need it */
         void build_range_index();
 
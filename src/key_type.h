@@ -153,6 +153,29 @@ namespace barch {
         return container_kind::none;
     }
 
+    /**
+     * remove_prefix, below, on one shard whose write latch the caller holds. Replaying
+     * the append log calls this for the ranges a DEL took out.
+     */
+    inline size_t remove_prefix_held(const shard_ptr& t, art::value_type prefix) {
+        size_t removed = 0;
+        heap::std_vector<std::string> doomed;
+        art::node_ptr lb = t->lower_bound(prefix);
+        if (lb.null()) return 0;
+        if (lb.is_leaf && lb.const_leaf()->prefix(prefix) != 0) return 0;
+        for (art::iterator i(t, lb.const_leaf()->get_key()); i.ok(); i.next()) {
+            auto k = i.key();
+            if (!k.starts_with(prefix)) break;
+            doomed.emplace_back(k.chars(), k.size);
+        }
+        for (const auto& k : doomed) {
+            if (t->remove(art::value_type{k})) {
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
     /**
      * Remove everything stored under `name` as a list, hash or ordered set.
      *
@@ -170,19 +193,10 @@ namespace barch {
     inline size_t remove_prefix(sharded_store& store, art::value_type name, art::value_type prefix) {
         size_t removed = 0;
         store.with_container_write(name, [&](const shard_ptr& t) {
-            heap::std_vector<std::string> doomed;
-            art::node_ptr lb = t->lower_bound(prefix);
-            if (lb.null()) return;
-            if (lb.is_leaf && lb.const_leaf()->prefix(prefix) != 0) return;
-            for (art::iterator i(t, lb.const_leaf()->get_key()); i.ok(); i.next()) {
-                auto k = i.key();
-                if (!k.starts_with(prefix)) break;
-                doomed.emplace_back(k.chars(), k.size);
-            }
-            for (const auto& k : doomed) {
-                if (t->remove(art::value_type{k})) {
-                    ++removed;
-                }
+            removed = remove_prefix_held(t, prefix);
+            if (removed && append_log::recording()) {
+                append_log::removed_prefix(store.space()->get_canonical_name(), t->get_shard_number(),
+                                           prefix.to_view());
             }
         });
         return removed;
@@ -331,6 +331,26 @@ bool is_container_internal(art::value_type key) {
     return encoded_container_name_len(key) == 0;
 }
 
+bool glob_subject(const art::leaf& l, std::string& tmp, art::value_type& subject) {
+    if (art::tstring == *l.key()) {
+        subject = l.get_clean_key();
+        // get_clean_key steps over the leading type byte but keeps the stored length, so
+        // the trailing terminator is still on the end - leaving it there stops any pattern
+        // anchored at the end of the key from matching
+        if (subject.size) --subject.size;
+        return true;
+    }
+    tmp = encoded_container_name(l.get_key());
+    if (tmp.empty()) {
+        if (art::is_container_lead(*l.get_key().bytes)) {
+            return false;
+        }
+        tmp = encoded_key_as_string(l.get_key());
+    }
+    subject = tmp;
+    return true;
+}
+
 std::string encoded_key_as_string(art::value_type key, char sep) {
     Variable v = encoded_key_as_variant(key, sep);
     return v.s();
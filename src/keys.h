@@ -55,6 +55,12 @@ std::string encoded_key_as_string(art::value_type key, char sep = ' ');
 std::string encoded_container_name(art::value_type key);
 /** true for a container's internal bookkeeping keys, which name nothing a caller wrote */
 bool is_container_internal(art::value_type key);
+/**
+ * what a KEYS or SCAN MATCH pattern is matched against for a leaf: a string key's own
+ * bytes, a container's name, or any other key as it renders. tmp holds the rendering when
+ * there is one. false for an ordered set's member index, which names nothing
+ */
+bool glob_subject(const art::leaf& l, std::string& tmp, art::value_type& subject);
 /** the length of the lead plus the name component of a container key, 0 if not one */
 unsigned encoded_container_name_len(art::value_type key);
 
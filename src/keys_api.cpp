@@ -25,6 +25,7 @@
 #include "conversion.h"
 #include "composite.h"
 #include "glob.h"
+#include "glob_admission.h"
 #include "keys.h"
 #include "keyspec.h"
 #include "keyspace_locks.h"
@@ -187,7 +188,7 @@ int cmd_COUNT(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
 * */
 static int glob_command(caller& call, const arg_t& argv, bool by_value) {
 
-    if (argv.size() < 2 || argv.size() > 4)
+    if (argv.size() < 2 || argv.size() > 6)
         return call.wrong_arity();
 
     art::keys_spec spec(argv);
@@ -198,6 +199,29 @@ static int glob_command(caller& call, const arg_t& argv, bool by_value) {
     std::atomic<int64_t> replies = 0;
     art::value_type pattern = argv[1];
     barch::sharded_store store(call.kspace());
+    if (spec.explain) {
+        // VALUES matches what the keys hold, which no key range can narrow down
+        auto how = by_value ? std::string("scan all pages: matching values") : store.plan(pattern).describe();
+        return call.push_simple(how);
+    }
+    // globs run side by side on the scanning threads admit_glob hands out, and stop
+    // when the client that asked hangs up - by then there is no one to answer
+    std::atomic<bool> hung_up = false;
+    spec.abandoned = [&call, &hung_up]() -> bool {
+        if (hung_up) return true;
+        if (call.peer_closed() && !hung_up.exchange(true)) {
+            ++statistics::globs_abandoned;
+        }
+        return hung_up;
+    };
+    auto ticket = barch::admit_glob(barch::get_iteration_worker_count(), spec.abandoned);
+    if (!ticket) {
+        return call.push_error("too many KEYS/VALUES waiting to scan, try again later");
+    }
+    spec.workers = ticket.workers();
+    // read once here rather than again for every key by every worker
+    glob::compiled matcher(pattern);
+    spec.matcher = &matcher;
 
     // A container is answered by name, once - and the cost of working that out is kept
     // off the keys that are not containers.
@@ -1262,6 +1286,7 @@ int MSETNX(caller& call, const arg_t& argv) {
             if (store.shard_for(converted.get_value()) != t) continue;
             art::key_options opts;
             t->insert(opts, converted.get_value(), argv[n + 1], true, fc);
+            barch::log_written(call.kspace(), t, opts, converted.get_value(), argv[n + 1]);
         }
     });
     return call.push_ll(1);
@@ -1351,8 +1376,9 @@ static int move_value(barch::sharded_store& store, art::value_type from,
         std::string held(cl->get_value().chars(), cl->get_value().size);
         auto fc = [&](const art::node_ptr &) -> void {};
         st->insert(opts, to, art::value_type{held}, true, fc);
-        if (!keep_source) {
-            sf->remove(from);
+        barch::log_written(store.space(), st, opts, to, art::value_type{held});
+        if (!keep_source && sf->remove(from)) {
+            barch::log_removed(store.space(), sf, from);
         }
         result = 1;
     });
@@ -1476,6 +1502,7 @@ int COPY(caller& call, const arg_t& argv) {
             std::string value(cl->get_value().chars(), cl->get_value().size);
             auto fc = [&](const art::node_ptr &) -> void {};
             st->insert(opts, ct.get_value(), art::value_type{value}, true, fc);
+            barch::log_written(there, st, opts, ct.get_value(), art::value_type{value});
             result = 1;
         }
     }
@@ -1524,7 +1551,9 @@ int MOVE(caller& call, const arg_t& argv) {
     std::string value(cl->get_value().chars(), cl->get_value().size);
     auto fc = [&](const art::node_ptr &) -> void {};
     st->insert(opts, converted.get_value(), art::value_type{value}, true, fc);
+    barch::log_written(there, st, opts, converted.get_value(), art::value_type{value});
     sf->remove(converted.get_value());
+    barch::log_removed(here, sf, converted.get_value());
     return call.push_ll(1);
 }
 
@@ -1683,7 +1712,6 @@ int MSET(caller& call, const arg_t& argv) {
     if (argv.size() < 3 || (argv.size() % 2) == 0)
         return call.wrong_arity();
     int r = call.ok();
-    barch::sharded_store store(call.kspace());
     // every pair is measured before any is written. MSET answers OK or an error, with no
     // room in that reply to say "most of them" - so a pair that cannot fit stops the whole
     // command rather than leaving the caller with a success and a gap
@@ -1693,6 +1721,9 @@ int MSET(caller& call, const arg_t& argv) {
             return call.push_error(too_large_message());
         }
     }
+    // one lock per shard rather than per key, though still not atomic across shards -
+    // MSET never has been
+    barch::write_batch batch(call.kspace());
     for (size_t n = 1; n < argv.size(); n += 2) {
         auto k = argv[n];
         auto v = argv[n + 1];
@@ -1704,14 +1735,9 @@ int MSET(caller& call, const arg_t& argv) {
 
         auto converted = call.kspace()->encode_key(k);
         art::key_spec spec; //(argv, argc);
-        auto fc = [&](art::node_ptr) -> void {
-        };
-        // one lock per key, as before: MSET has never been atomic across keys
-        store.with_key_write(converted.get_value(), [&](const barch::shard_ptr& t) {
-            t->insert( spec, converted.get_value(), v, true, fc);
-        });
-
+        batch.put(converted.get_value(), v, spec);
     }
+    batch.commit([](const art::node_ptr&) -> void {});
 
     if (r != call.ok()) {
         return call.push_error("one or more keys were rejected");
@@ -1802,6 +1828,11 @@ int SCAN(caller& call, const arg_t& argv) {
         return call.syntax_error();
     }
     barch::sharded_store store(call.kspace());
+    if (spec.explain) {
+        auto how = spec.is_match ? store.plan(spec.glob_expr).describe()
+                                 : std::string("scan all pages: no MATCH pattern");
+        return call.push_simple(how);
+    }
     // a cursor is dropped when the scan runs out of shards, so one that is followed to
     // the end costs nothing. An abandoned one stays until the connection closes, and it
     // holds a page buffer, so a connection is only allowed so many at a time -
@@ -2189,28 +2220,39 @@ int MGET(caller& call, const arg_t& argv) {
             return call.push_error("FOREIGN MGET inside MULTI is not supported");
         return barch::foreign::mget(call, argv);
     }
-    int responses = 0;
     barch::sharded_store store(call.kspace());
-    call.start_array();
+    heap::vector<conversion::comparable_key> converted;
+    heap::vector<art::value_type> keys;
+    heap::vector<size_t> args;
+    converted.reserve(argv.size());
     for (size_t arg = 1; arg < argv.size(); ++arg) {
-        auto k = argv[arg];
-        if (key_ok(k) != 0) {
+        if (key_ok(argv[arg]) == 0) {
+            converted.emplace_back(call.kspace()->encode_key(argv[arg]));
+            args.push_back(arg);
+        }
+    }
+    keys.reserve(converted.size());
+    for (auto& c : converted) {
+        keys.push_back(c.get_value());
+    }
+    call.start_array();
+    size_t arg = 1;
+    // not store.search: MGET has never decompressed the way GET does. left as it was
+    // rather than quietly aligned. the leaves are only good inside the callback, so the
+    // reply is written there, with a null for every bad key in between
+    store.search_many(keys.data(), keys.size(), [&](size_t i, const art::node_ptr& r) {
+        for (; arg < args[i]; ++arg) {
+            call.push_null();
+        }
+        ++arg;
+        if (r.null()) {
             call.push_null();
         } else {
-            auto converted = call.kspace()->encode_key(k);
-            // not store.search: MGET has never decompressed, nor skipped tombstones,
-            // the way GET does. left as it was rather than quietly aligned
-            store.with_key_read(converted.get_value(), [&](const barch::shard_ptr& t) {
-                art::node_ptr r = t->search(converted.get_value());
-                if (r.null()) {
-                    call.push_null();
-                } else {
-                    auto vt = r.const_leaf()->get_value();
-                    call.push_vt(vt);
-                }
-            });
-            ++responses;
+            call.push_vt(r.const_leaf()->get_value());
         }
+    });
+    for (; arg < argv.size(); ++arg) {
+        call.push_null();
     }
     call.end_array();
     return call.ok();
@@ -2532,4 +2574,10 @@ void register_keys_api(function_map& r) {
     r["EXPIRETIME"] = {::EXPIRETIME,{"read","keys","data"}};
     r["PEXPIRETIME"] = {::PEXPIRETIME,{"read","keys","data"}};
     r["PERSIST"] = {::PERSIST,{"write","keys","data"}};
+    for (auto name : {"GET","SET","SETNX","SETEX","PSETEX","GETSET","GETDEL","GETEX","APPEND","PREPEND",
+                      "SETRANGE","GETRANGE","SUBSTR","STRLEN","INCR","INCRBY","DECR","DECRBY","UINCRBY",
+                      "UDECRBY","INCRBYFLOAT","TTL","PTTL","EXPIRE","PEXPIRE","EXPIREAT","PEXPIREAT",
+                      "EXPIRETIME","PEXPIRETIME","PERSIST"}) {
+        r[name].single_key = true;
+    }
 }
@@ -10,6 +10,7 @@ extern "C" {
     #include "../external/include/valkeymodule.h"
 }
 
+#include <functional>
 #include <string>
 #include <regex>
 #include <chrono>
@@ -399,7 +400,15 @@ inline bool expiry_ms(int64_t given, bool seconds, bool relative, int64_t& out)
         }
 
         bool count = false;
+        /** reply with how the pattern would be answered instead of answering it */
+        bool explain = false;
         int64_t max_count{std::numeric_limits<int64_t>::max()};
+        /** page scanning threads the glob was admitted with, 0 for iteration_worker_count */
+        unsigned workers{0};
+        /** polled while the glob runs. true stops it: whoever asked is no longer listening */
+        std::function<bool()> abandoned{};
+        /** the pattern compiled once for the whole command. A glob compiles its own without it */
+        const glob::compiled *matcher{nullptr};
 
         int parse_keys_options() {
             unsigned spos = 2; // the pattern is the first one
@@ -414,6 +423,10 @@ inline bool expiry_ms(int64_t given, bool seconds, bool relative, int64_t& out)
                 max_count = tol(++spos);
                 ++spos;
             }
+            if (has("explain", spos)) {
+                explain = true;
+                ++spos;
+            }
 
             if (argc == spos) // all known arguments should be consumed
                 return VALKEYMODULE_OK;
@@ -996,10 +1009,14 @@ inline bool expiry_ms(int64_t given, bool seconds, bool relative, int64_t& out)
         uint64_t scan_id{0};
         uint64_t count{128};
         std::string glob_expr{};
+        /** glob_expr compiled, once per call rather than once per key */
+        glob::compiled matcher{};
         std::string type_expr{};
         bool is_count{false};
         bool is_match{false};
         bool is_type{false};
+        /** reply with how the match would be answered instead of scanning */
+        bool explain{false};
         int parse_options() {
             unsigned spos = 1; // the command is the first one
 
@@ -1015,6 +1032,7 @@ inline bool expiry_ms(int64_t given, bool seconds, bool relative, int64_t& out)
                 if (syntax_error) {
                     return VALKEYMODULE_ERR;
                 }
+                matcher = glob::compiled(art::value_type{glob_expr});
             }
 
             if (has_one({"count","c"},spos)) {
@@ -1035,6 +1053,11 @@ inline bool expiry_ms(int64_t given, bool seconds, bool relative, int64_t& out)
                 }
             }
 
+            if (has("explain", spos)) {
+                explain = true;
+                ++spos;
+            }
+
             if (argv.size() > spos) {
                 return VALKEYMODULE_ERR;
             }
@@ -0,0 +1,240 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "latency.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <memory>
+#include <mutex>
+#include <ankerl/unordered_dense.h>
+
+namespace barch::latency {
+    std::atomic<bool> tracking{false};
+
+    struct histogram {
+        std::array<std::atomic<uint64_t>, bucket_count> counts{};
+        std::atomic<uint64_t> total_ns{};
+        std::atomic<uint64_t> max_ns{};
+        // only the thread that owns the histogram adds to it, so the increments are
+        // never contended and the maximum needs no compare and swap
+        void add(uint64_t ns) {
+            counts[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+            total_ns.fetch_add(ns, std::memory_order_relaxed);
+            if (ns > max_ns.load(std::memory_order_relaxed)) max_ns.store(ns, std::memory_order_relaxed);
+        }
+        void add(const histogram& other) {
+            for (size_t b = 0; b < bucket_count; ++b) {
+                auto c = other.counts[b].load(std::memory_order_relaxed);
+                if (c) counts[b].fetch_add(c, std::memory_order_relaxed);
+            }
+            total_ns.fetch_add(other.total_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            max_ns.store(std::max(max_ns.load(std::memory_order_relaxed), other.max_ns.load(std::memory_order_relaxed)),
+                         std::memory_order_relaxed);
+        }
+        void clear() {
+            for (auto& c: counts) c.store(0, std::memory_order_relaxed);
+            total_ns.store(0, std::memory_order_relaxed);
+            max_ns.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    typedef std::unique_ptr<histogram> histogram_ptr;
+
+    // looked up by the name as it arrived without making a string of it first
+    struct name_hash {
+        using is_transparent = void;
+        using is_avalanching = void;
+        size_t operator()(std::string_view k) const {
+            return ankerl::unordered_dense::detail::wyhash::hash(k.data(), k.size());
+        }
+    };
+    typedef ankerl::unordered_dense::map<std::string, histogram*, name_hash, std::equal_to<>,
+        heap::allocator<std::pair<std::string, histogram*>>> name_map;
+
+    struct thread_histograms {
+        // taken by the owner only to add a histogram, and by whoever merges them
+        std::mutex lock{};
+        // by the command's name as INFO shows it, lower case without a space prefix
+        heap::string_map<histogram_ptr> commands{};
+        // by the series latch_series() gave out
+        heap::vector<histogram_ptr> latches{};
+        // the names as they arrived, to the histogram they are recorded in. read and
+        // written by the owner only
+        name_map seen{};
+
+        void merge_into(thread_histograms& to) {
+            std::lock_guard lk(lock);
+            for (auto& [name, h]: commands) {
+                auto& t = to.commands[name];
+                if (!t) t = std::make_unique<histogram>();
+                t->add(*h);
+            }
+            if (to.latches.size() < latches.size()) to.latches.resize(latches.size());
+            for (size_t s = 0; s < latches.size(); ++s) {
+                if (!latches[s]) continue;
+                if (!to.latches[s]) to.latches[s] = std::make_unique<histogram>();
+                to.latches[s]->add(*latches[s]);
+            }
+        }
+        void clear() {
+            std::lock_guard lk(lock);
+            for (auto& c: commands) c.second->clear();
+            for (auto& l: latches) {
+                if (l) l->clear();
+            }
+        }
+    };
+
+    struct registry {
+        std::mutex lock{};
+        heap::vector<thread_histograms*> threads{};
+        // what threads that have ended recorded
+        thread_histograms retired{};
+        heap::vector<std::string> series_names{};
+        heap::string_map<size_t> series{};
+    };
+
+    static registry& reg() {
+        static registry r{};
+        return r;
+    }
+
+    struct thread_entry {
+        thread_histograms histograms{};
+        thread_entry() {
+            auto& r = reg();
+            std::lock_guard lk(r.lock);
+            r.threads.push_back(&histograms);
+        }
+        ~thread_entry() {
+            auto& r = reg();
+            std::lock_guard lk(r.lock);
+            histograms.merge_into(r.retired);
+            r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &histograms));
+        }
+    };
+
+    static thread_histograms& mine() {
+        static thread_local thread_entry entry{};
+        return entry.histograms;
+    }
+
+    static std::string command_name(std::string_view raw) {
+        auto colon = raw.find_last_of(':');
+        if (colon != std::string_view::npos && colon + 1 < raw.size()) raw = raw.substr(colon + 1);
+        std::string name(raw);
+        for (auto& ch: name) ch = (char) tolower((unsigned char) ch);
+        return name;
+    }
+
+    void record_command(std::string_view name, uint64_t ns) {
+        auto& t = mine();
+        auto s = t.seen.find(name);
+        if (s == t.seen.end()) {
+            std::lock_guard lk(t.lock);
+            auto& h = t.commands[command_name(name)];
+            if (!h) h = std::make_unique<histogram>();
+            s = t.seen.emplace(std::string(name), h.get()).first;
+        }
+        s->second->add(ns);
+    }
+
+    size_t latch_series(const std::string& space, size_t shard) {
+        auto& r = reg();
+        auto name = space + "#" + std::to_string(shard);
+        std::lock_guard lk(r.lock);
+        auto s = r.series.find(name);
+        if (s != r.series.end()) return s->second;
+        r.series_names.push_back(name);
+        return r.series[name] = r.series_names.size() - 1;
+    }
+
+    void record_latch(size_t series, uint64_t ns) {
+        if (series == ~(size_t) 0) return; // a shard that was never given one
+        auto& t = mine();
+        if (series >= t.latches.size() || !t.latches[series]) {
+            std::lock_guard lk(t.lock);
+            if (series >= t.latches.size()) t.latches.resize(series + 1);
+            t.latches[series] = std::make_unique<histogram>();
+        }
+        t.latches[series]->add(ns);
+    }
+
+    static uint64_t percentile(const histogram& h, uint64_t count, double p) {
+        auto rank = (uint64_t) (p * (double) count);
+        if (rank >= count) rank = count - 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < bucket_count; ++b) {
+            seen += h.counts[b].load(std::memory_order_relaxed);
+            // the middle of the bucket, which is as close as it can say
+            if (seen > rank) return (bucket_floor(b) + bucket_floor(b + 1)) / 2;
+        }
+        return h.max_ns.load(std::memory_order_relaxed);
+    }
+
+    static summary summarize(const std::string& name, const histogram& h) {
+        summary s;
+        s.name = name;
+        for (auto& c: h.counts) s.count += c.load(std::memory_order_relaxed);
+        if (!s.count) return s;
+        s.total_ns = h.total_ns.load(std::memory_order_relaxed);
+        s.max_ns = h.max_ns.load(std::memory_order_relaxed);
+        s.p50_ns = std::min(percentile(h, s.count, 0.5), s.max_ns);
+        s.p99_ns = std::min(percentile(h, s.count, 0.99), s.max_ns);
+        s.p999_ns = std::min(percentile(h, s.count, 0.999), s.max_ns);
+        return s;
+    }
+
+    static thread_histograms& merged(thread_histograms& into) {
+        auto& r = reg();
+        std::lock_guard lk(r.lock);
+        r.retired.merge_into(into);
+        for (auto* t: r.threads) t->merge_into(into);
+        return into;
+    }
+
+    heap::vector<summary> commands() {
+        thread_histograms all;
+        merged(all);
+        heap::vector<summary> r;
+        for (auto& [name, h]: all.commands) {
+            auto s = summarize(name, *h);
+            if (s.count) r.push_back(std::move(s));
+        }
+        std::sort(r.begin(), r.end(), [](const summary& a, const summary& b) {
+            return a.name < b.name;
+        });
+        return r;
+    }
+
+    heap::vector<summary> latches() {
+        thread_histograms all;
+        merged(all);
+        heap::vector<std::string> names;
+        {
+            std::lock_guard lk(reg().lock);
+            names = reg().series_names;
+        }
+        heap::vector<summary> r;
+        for (size_t s = 0; s < all.latches.size() && s < names.size(); ++s) {
+            if (!all.latches[s]) continue;
+            auto sum = summarize(names[s], *all.latches[s]);
+            if (sum.count) r.push_back(std::move(sum));
+        }
+        // the shards callers waited on longest first
+        std::sort(r.begin(), r.end(), [](const summary& a, const summary& b) {
+            return a.total_ns > b.total_ns;
+        });
+        return r;
+    }
+
+    void reset() {
+        auto& r = reg();
+        std::lock_guard lk(r.lock);
+        r.retired.clear();
+        for (auto* t: r.threads) t->clear();
+    }
+}
@@ -0,0 +1,96 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_LATENCY_H
+#define BARCH_LATENCY_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "sastam.h"
+
+/**
+ * How long commands take, and how long they wait for a shard's latch, as distributions
+ * rather than the totals statistics.h keeps, so that INFO latencystats can say what p99
+ * and p99.9 are and which shard is the one callers queue behind.
+ *
+ * Every thread records into histograms of its own, so recording is an increment of a
+ * counter no other thread writes and nothing is locked. INFO merges them when it is
+ * asked. The histograms are log linear, sixteen buckets for every power of two of
+ * nanoseconds, so a percentile reads back within about 6% of what was measured.
+ *
+ * latency_tracking turns it on. While it is off a call pays for one relaxed load.
+ */
+namespace barch::latency {
+    enum {
+        sub_bits = 4,
+        sub_buckets = 1 << sub_bits,
+        // 2^40ns is about 18 minutes, and anything longer is counted as that
+        max_power = 40,
+        bucket_count = (max_power - sub_bits + 2) * sub_buckets
+    };
+
+    inline size_t bucket_of(uint64_t ns) {
+        if (ns < sub_buckets) return ns;
+        unsigned power = 63 - __builtin_clzll(ns);
+        if (power > max_power) return bucket_count - 1;
+        return (power - sub_bits + 1) * sub_buckets + ((ns >> (power - sub_bits)) & (sub_buckets - 1));
+    }
+
+    /** the smallest value counted in bucket b */
+    inline uint64_t bucket_floor(size_t b) {
+        if (b < sub_buckets) return b;
+        unsigned power = b / sub_buckets + sub_bits - 1;
+        return (uint64_t) (sub_buckets + b % sub_buckets) << (power - sub_bits);
+    }
+
+    extern std::atomic<bool> tracking;
+
+    inline bool on() {
+        return tracking.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t now_ns() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** record a call to the command named name, which may still have a space: prefix */
+    void record_command(std::string_view name, uint64_t ns);
+    /** the series a shard's latch waits are recorded under */
+    size_t latch_series(const std::string& space, size_t shard);
+    void record_latch(size_t series, uint64_t ns);
+
+    /** the calls to a command or the waits for a latch, merged over every thread */
+    struct summary {
+        std::string name{};
+        uint64_t count{};
+        uint64_t total_ns{};
+        uint64_t max_ns{};
+        uint64_t p50_ns{};
+        uint64_t p99_ns{};
+        uint64_t p999_ns{};
+    };
+    heap::vector<summary> commands();
+    heap::vector<summary> latches();
+    /** forget everything recorded, for CONFIG RESETSTAT */
+    void reset();
+
+    /** times a command from here to where it goes out of scope, when tracking is on */
+    class command_timer {
+    public:
+        explicit command_timer(std::string_view name) : name(name), start(on() ? now_ns() : 0) {}
+        command_timer(const command_timer&) = delete;
+        command_timer& operator=(const command_timer&) = delete;
+        ~command_timer() {
+            if (start) record_command(name, now_ns() - start);
+        }
+    private:
+        std::string_view name;
+        uint64_t start;
+    };
+}
+#endif //BARCH_LATENCY_H
@@ -0,0 +1,75 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "lfu_counters.h"
+
+#include <algorithm>
+#include <ankerl/unordered_dense.h>
+
+#include "constants.h"
+#include "value_type.h"
+
+namespace barch {
+    static uint64_t key_hash(art::value_type key) {
+        return ankerl::unordered_dense::detail::wyhash::hash(key.chars(), key.size);
+    }
+
+    size_t lfu_counters::slots_for(size_t keys) {
+        size_t want = lfu_counters_min;
+        while (want < keys * 2 && want < lfu_counters_max) want <<= 1;
+        return want;
+    }
+
+    void lfu_counters::fit(size_t keys) {
+        size_t want = slots_for(keys);
+        if (want <= slots.size()) return;
+        heap::vector<slot> grown(want);
+        if (!slots.empty()) {
+            // a key's slot is its hash masked by the size, so in a table twice the size it
+            // is in one of the two slots whose lower bits are where it was
+            size_t mask = slots.size() - 1;
+            for (size_t i = 0; i < want; ++i) {
+                grown[i].store(slots[i & mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+        slots.swap(grown);
+    }
+
+    void lfu_counters::clear() {
+        heap::vector<slot> none;
+        slots.swap(none);
+    }
+
+    const lfu_counters::slot* lfu_counters::find(art::value_type key) const {
+        if (slots.empty()) return nullptr;
+        return &slots[key_hash(key) & (slots.size() - 1)];
+    }
+
+    unsigned lfu_counters::decayed(uint16_t value, uint8_t period) {
+        if (value == 0) return lfu_init_count;
+        unsigned count = (value >> 8) - 1;
+        uint8_t elapsed = period - (uint8_t)(value & 0xff);
+        return count > elapsed ? count - elapsed : 0;
+    }
+
+    unsigned lfu_counters::count(art::value_type key, uint8_t period) const {
+        auto s = find(key);
+        if (!s) return lfu_init_count;
+        return decayed(s->load(std::memory_order_relaxed), period);
+    }
+
+    void lfu_counters::touch(art::value_type key, uint8_t period, unsigned log_factor, uint32_t random) const {
+        auto s = const_cast<slot*>(find(key));
+        if (!s) return;
+        uint16_t was = s->load(std::memory_order_relaxed);
+        unsigned count = decayed(was, period);
+        // one short of what a byte holds, since the count is kept one up
+        if (count < 254) {
+            unsigned base = count > lfu_init_count ? count - lfu_init_count : 0;
+            if (random % (base * log_factor + 1) == 0) ++count;
+        }
+        uint16_t now = (uint16_t)((count + 1) << 8 | period);
+        if (was != now) s->store(now, std::memory_order_relaxed);
+    }
+}
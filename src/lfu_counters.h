@@ -0,0 +1,79 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_LFU_COUNTERS_H
+#define BARCH_LFU_COUNTERS_H
+#include <atomic>
+#include <cstdint>
+
+#include "sastam.h"
+
+namespace art {
+    struct value_type;
+}
+namespace barch {
+    /**
+     * The access counts lfu eviction weighs keys by, for one shard.
+     *
+     * They used to be two bytes in every leaf, which meant a read of a hot key wrote to
+     * the leaf page holding it: the page went dirty, a delta snapshot had it to write again
+     * and a mapped snapshot had to copy it. The counts live in this table instead, a slot
+     * per key hash, so the pages are only written when a key is.
+     *
+     * A slot is found by the key and not by where its leaf is, so a key keeps its count when
+     * its leaf is rewritten or moved by defrag. Two keys sharing a slot share a count, which
+     * can only make the colder of them look warmer than it is - it is evicted a little
+     * later, never the hotter one sooner. The table is kept at about two slots a key.
+     *
+     * Readers share the shard latch and update slots as relaxed atomics. fit replaces the
+     * slots and must have the latch to itself.
+     */
+    class lfu_counters {
+    public:
+        lfu_counters() = default;
+        lfu_counters(const lfu_counters&) = delete;
+        lfu_counters& operator=(const lfu_counters&) = delete;
+
+        /**
+         * make room for about keys keys. Only ever grows, and a grown table starts every
+         * slot at the count of the slot its keys were in before, so nothing is forgotten
+         */
+        void fit(size_t keys);
+        /** true when fit(keys) has nothing to do, and the latch need not be taken for it */
+        [[nodiscard]] bool fits(size_t keys) const {
+            return slots_for(keys) <= slots.size();
+        }
+        void clear();
+        [[nodiscard]] bool empty() const {
+            return slots.empty();
+        }
+        [[nodiscard]] size_t size() const {
+            return slots.size();
+        }
+        /**
+         * how often key is used, after decaying by one for every period that went by since
+         * it was last touched. period is the shard's lfu clock, which counts decay periods
+         * modulo 256 - a key left alone for 256 of them is cold whatever the clock says
+         */
+        [[nodiscard]] unsigned count(art::value_type key, uint8_t period) const;
+        /**
+         * count one access, the way redis does: the counter goes up with a probability of
+         * 1/((count - lfu_init_count) * log_factor + 1), so a byte covers millions of hits
+         * and a key has to keep being used to stay near the top. A lost increment is a
+         * rounding error in a probabilistic counter. Nothing is written when nothing
+         * changed, which is most of the time for a hot key. const since readers count
+         * with the shard only shared, the slots are atomics
+         */
+        void touch(art::value_type key, uint8_t period, unsigned log_factor, uint32_t random) const;
+
+    private:
+        // (count + 1) << 8 | period, so that 0 is a key that was never touched
+        typedef std::atomic<uint16_t> slot;
+        [[nodiscard]] const slot* find(art::value_type key) const;
+        static size_t slots_for(size_t keys);
+        static unsigned decayed(uint16_t value, uint8_t period);
+        heap::vector<slot> slots{};
+    };
+}
+#endif //BARCH_LFU_COUNTERS_H
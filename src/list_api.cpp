@@ -543,6 +543,12 @@ extern "C"{
             }
             heap::std_vector<std::string> popped;
             if (lmpop_one(t, name, at_tail, count, popped)) {
+                // replays as a pop of just this list, on the shard it came from
+                if (barch::append_log::recording()) {
+                    auto n = std::to_string(popped.size());
+                    barch::append_log::ran(spc->get_canonical_name(), t->get_shard_number(),
+                                           {"LMPOP", "1", name.to_view(), at_tail ? "RIGHT" : "LEFT", "COUNT", n});
+                }
                 cc.start_array();
                 cc.push_vt(name);
                 cc.start_array();
@@ -687,8 +693,18 @@ extern "C"{
         bool had = false;
         store.with_two_keys_write(src, dst, [&](const barch::shard_ptr& sf,
                                                 const barch::shard_ptr& st) {
+            // logged as the pop and the push, each on its own shard
+            bool logging = barch::append_log::recording();
+            auto space = logging ? cc.kspace()->get_canonical_name() : std::string{};
             if (!list_pop_one(sf, src, from_tail, moved)) return;
+            if (logging) {
+                barch::append_log::ran(space, sf->get_shard_number(), {from_tail ? "RPOP" : "LPOP", src.to_view()});
+            }
             if (!list_push_one(st, dst, to_tail, art::value_type{moved})) return;
+            if (logging) {
+                barch::append_log::ran(space, st->get_shard_number(),
+                                       {to_tail ? "RPUSH" : "LPUSH", dst.to_view(), moved});
+            }
             had = true;
         });
         if (had) {
@@ -0,0 +1,130 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "lock_profile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <dlfcn.h>
+#endif
+
+#include "key_space.h"
+
+namespace barch::lock_profile {
+    bool on() {
+        return latch_t::profiling.load(std::memory_order_relaxed);
+    }
+
+    void set_profiling(bool on) {
+        latch_t::profiling.store(on, std::memory_order_relaxed);
+    }
+
+    // the lock's own frames, and the guards and shard helpers that take it for someone
+    // else, say nothing about who that someone was
+    static bool is_locking(const std::string& fn) {
+        static const char* plumbing[] = {
+            "debuggable_server_lock", "lock_shared", "lock_unique", "storage_release",
+            "read_lock", "write_lock", "unique_lock", "lock_guard", "shared_latch",
+            "unique_latch", "backtrace"
+        };
+        for (auto p: plumbing) {
+            if (fn.find(p) != std::string::npos) return true;
+        }
+        return false;
+    }
+
+    // the function without its arguments, and without the commas INFO lines split on
+    static std::string function_at(void* frame) {
+#if defined(__linux__) || defined(__APPLE__)
+        Dl_info info{};
+        if (!dladdr(frame, &info)) return {};
+        if (!info.dli_sname) {
+            // not exported, so all there is is where in which object
+            if (!info.dli_fname) return {};
+            std::string object = info.dli_fname;
+            auto slash = object.find_last_of('/');
+            if (slash != std::string::npos) object = object.substr(slash + 1);
+            char offset[32];
+            snprintf(offset, sizeof(offset), "+0x%lx",
+                     (unsigned long) ((char*) frame - (char*) info.dli_fbase));
+            return object + offset;
+        }
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string fn = status == 0 && demangled ? demangled : info.dli_sname;
+        free(demangled);
+        auto args = fn.find('(');
+        if (args != std::string::npos && args > 0) fn.resize(args);
+        std::replace(fn.begin(), fn.end(), ',', ';');
+        std::replace(fn.begin(), fn.end(), ' ', '_');
+        return fn;
+#else
+        (void) frame;
+        return {};
+#endif
+    }
+
+    static std::string describe(const LockHoldSite& site) {
+        std::string where;
+        int named = 0;
+        for (int f = 0; f < site.nframes && named < 2; ++f) {
+            auto fn = function_at(site.frames[f]);
+            if (fn.empty() || is_locking(fn)) continue;
+            if (named++) where += "<";
+            where += fn;
+        }
+        return where.empty() ? "unknown" : where;
+    }
+
+    static latch_summary summarize(const std::string& name, const latch_t::contention_report& r) {
+        latch_summary s;
+        s.name = name;
+        s.shared_acquired = r.shared_acquired;
+        s.unique_acquired = r.unique_acquired;
+        s.waits = r.shared_waits + r.unique_waits;
+        s.upgrades = r.upgrades;
+        s.upgrade_failures = r.upgrade_failures;
+        s.timeouts = r.timeouts;
+        s.wait_ns = r.wait_ns;
+        s.max_wait_ns = r.max_wait_ns;
+        s.hold_ns = r.hold_ns;
+        s.max_hold_ns = r.max_hold_ns;
+        for (auto& site: r.sites) {
+            if (!site.samples) continue;
+            s.sites.push_back({describe(site), site.samples, site.wait_ns, site.hold_ns});
+        }
+        std::sort(s.sites.begin(), s.sites.end(), [](const hold_site& a, const hold_site& b) {
+            return a.hold_ns != b.hold_ns ? a.hold_ns > b.hold_ns : a.samples > b.samples;
+        });
+        return s;
+    }
+
+    heap::vector<latch_summary> hottest(size_t count) {
+        heap::vector<latch_summary> r;
+        all_spaces([&](const std::string& space, const key_space_ptr& ks) {
+            size_t shard = 0;
+            for (auto& s: ks->get_shards()) {
+                auto report = s->get_latch().contention();
+                if (report.shared_acquired || report.unique_acquired || report.timeouts || report.upgrade_failures)
+                    r.push_back(summarize(space + "#" + std::to_string(shard), report));
+                ++shard;
+            }
+        });
+        std::sort(r.begin(), r.end(), [](const latch_summary& a, const latch_summary& b) {
+            if (a.wait_ns != b.wait_ns) return a.wait_ns > b.wait_ns;
+            if (a.waits != b.waits) return a.waits > b.waits;
+            return a.shared_acquired + a.unique_acquired > b.shared_acquired + b.unique_acquired;
+        });
+        if (count && r.size() > count) r.resize(count);
+        return r;
+    }
+
+    void reset() {
+        all_shards([](const shard_ptr& s) {
+            s->get_latch().reset_contention();
+        });
+    }
+}
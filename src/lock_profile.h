@@ -0,0 +1,60 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_LOCK_PROFILE_H
+#define BARCH_LOCK_PROFILE_H
+#include <cstdint>
+#include <string>
+
+#include "sastam.h"
+
+/**
+ * What every shard's latch has cost, read from the counters debuggable_server_lock keeps,
+ * so that INFO locks and LOCKS can say which shards callers queue behind and why -
+ * readers waiting out writers, writers draining readers, or upgrades that gave up. That
+ * is what internal_shards and the sharding mode are tuned with.
+ *
+ * Acquisitions, waits and failures are always counted. Wait and hold times, and the
+ * sampled stacks writers held the latch from, only while lock_profiling is on.
+ */
+namespace barch::lock_profile {
+    /** where a sampled writer took the latch from, and what it cost there */
+    struct hold_site {
+        std::string where{};
+        uint64_t samples{};
+        uint64_t wait_ns{};
+        uint64_t hold_ns{};
+    };
+
+    struct latch_summary {
+        // space#shard, as INFO latencystats names it
+        std::string name{};
+        uint64_t shared_acquired{};
+        uint64_t unique_acquired{};
+        // acquisitions that had to wait, shared and unique together
+        uint64_t waits{};
+        uint64_t upgrades{};
+        uint64_t upgrade_failures{};
+        uint64_t timeouts{};
+        uint64_t wait_ns{};
+        uint64_t max_wait_ns{};
+        uint64_t hold_ns{};
+        uint64_t max_hold_ns{};
+        // the most held from first
+        heap::vector<hold_site> sites{};
+    };
+
+    bool on();
+    /** lock_profiling sets this */
+    void set_profiling(bool on);
+
+    /**
+     * the latches that were used, the hottest first: the longest waited on, or while
+     * nothing is timed the most waited on. at most count of them, 0 for all
+     */
+    heap::vector<latch_summary> hottest(size_t count = 0);
+    /** forget what every latch has counted, for CONFIG RESETSTAT */
+    void reset();
+}
+#endif //BARCH_LOCK_PROFILE_H
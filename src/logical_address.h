@@ -9,6 +9,7 @@
 #include <atomic>
 #include "sastam.h"
 #include "constants.h"
+#include "lfu_counters.h"
 #define _CHECK_AP_ 0
 /**
  * What one shard's tree actually holds.
@@ -170,6 +171,13 @@ private:
 struct abstract_leaf_pair : public abstract_alloc_pair {
     bool opt_all_keys_lru{false};
     bool opt_volatile_keys_lru{false};
+    // leaves count their accesses when an lfu eviction policy is on, in lfu_counts and
+    // not in the leaf pages. The clock and the log factor are refreshed by shard
+    // maintenance so the read path never asks the configuration for them
+    bool opt_keys_lfu{false};
+    std::atomic<uint8_t> lfu_clock{0};
+    std::atomic<uint32_t> lfu_log_factor{10};
+    barch::lfu_counters lfu_counts{};
     virtual void remove_leaf(const logical_address& at) = 0;
 };
 #endif //COMPRESSED_ADDRESS_H
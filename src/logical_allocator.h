@@ -936,10 +936,14 @@ public:
             found_page(pb.second, page, pb.first);
         });
     }
-    // this function locks (but only a small time)  and doesnt require further locking outside
-    void iterate_pages(barch::latch_t& latch, const std::function<bool(size_t, size_t, const heap::buffer<uint8_t> &)> &found_page) {
-        opt_iterate_workers = barch::get_iteration_worker_count();
-        std::vector<std::thread> workers{opt_iterate_workers};
+    // this function locks (but only a small time)  and doesnt require further locking outside.
+    // workers is how many threads copy and visit pages, 0 for iteration_worker_count
+    void iterate_pages(barch::latch_t& latch, const std::function<bool(size_t, size_t, const heap::buffer<uint8_t> &)> &found_page,
+                       unsigned workers_wanted = 0) {
+        // kept local: globs run side by side now, and each splits the pages its own way
+        unsigned n = workers_wanted ? workers_wanted : barch::get_iteration_worker_count();
+        if (!n) n = 1;
+        std::vector<std::thread> workers{n};
         std::atomic<bool> stop = false;
         arena::hash_type arena;
         {
@@ -948,13 +952,13 @@ public:
             arena = main.get_arena(); // the arena is a relatively small object which does not take long to copy
         }
 
-        for (unsigned iwork = 0; iwork < opt_iterate_workers; iwork++) {
-            workers[iwork] = std::thread([this,&arena,&latch,iwork,&found_page,&stop]() {
+        for (unsigned iwork = 0; iwork < n; iwork++) {
+            workers[iwork] = std::thread([this,&arena,&latch,iwork,n,&found_page,&stop]() {
                 // safely iterate over arena
                 iterate_arena(arena, [&]( size_t page, size_t) -> void {
                     if (stop) return;
                     if (is_null_base(page)) return;
-                    if (page % opt_iterate_workers == iwork) {
+                    if (page % n == iwork) {
                         unsigned wp = 0;
                         heap::buffer<uint8_t> pdata;
                         {
@@ -979,10 +983,11 @@ public:
      * after the first walk recorded which pages matched.
      */
     void iterate_pages(barch::latch_t& latch, const heap::vector<size_t>& only,
-                       const std::function<bool(size_t, size_t, const heap::buffer<uint8_t> &)> &found_page) {
+                       const std::function<bool(size_t, size_t, const heap::buffer<uint8_t> &)> &found_page,
+                       unsigned workers_wanted = 0) {
         if (only.empty()) return;
-        opt_iterate_workers = barch::get_iteration_worker_count();
-        unsigned n = opt_iterate_workers ? opt_iterate_workers : 1;
+        unsigned n = workers_wanted ? workers_wanted : barch::get_iteration_worker_count();
+        if (!n) n = 1;
         std::vector<std::thread> workers{n};
         std::atomic<bool> stop = false;
         for (unsigned iwork = 0; iwork < n; iwork++) {
@@ -1040,6 +1045,7 @@ public:
     }
     bool delete_files(const std::string &filename) const {
         std::string fname = main.name+filename;
+        arena::base_hash_arena::remove_deltas(fname);
         return std::remove(fname.c_str())==0;
     }
     void write_emancipated(std::ostream& of) const {
@@ -1138,6 +1144,9 @@ public:
             readp(in, allocated);
             readp(in, fragmentation);
             last_page_allocated = 0;
+            // read once for the snapshot and again for every delta after it, and only
+            // the last one read describes the pages that were loaded
+            emancipated.clear();
             read_emancipated(in);
             extra1(in);
         };
@@ -1283,6 +1292,12 @@ struct alloc_pair : public abstract_leaf_pair{
         leaves.shrinkLast();
         nodes.shrinkLast();
     }
+    /** a leaf for key was given a deadline, see expiry_wheel */
+    virtual void schedule_expiry(art::value_type unused(key), int64_t unused(deadline)) {
+    }
+    /** a leaf of bytes under a container key was created (+1) or freed (-1) */
+    virtual void count_container_leaf(art::value_type unused(key), size_t unused(bytes), int unused(direction)) {
+    }
 
     virtual ~alloc_pair() = default;
 
@@ -0,0 +1,140 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "maintenance_pool.h"
+#include "configuration.h"
+#include "lzr_log.h"
+
+namespace barch {
+    maintenance_pool::maintenance_pool(size_t count) {
+        count = std::max<size_t>(count, 1);
+        queues.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            queues.emplace_back(std::make_unique<worker_queue>());
+        }
+        workers.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back([this, i]() {
+                work(i);
+            });
+        }
+    }
+
+    maintenance_pool::~maintenance_pool() {
+        {
+            std::lock_guard l(idle_mutex);
+            exit = true;
+        }
+        idle.notify_all();
+        for (auto& t : workers) {
+            if (t.joinable()) t.join();
+        }
+    }
+
+    void maintenance_pool::execute(job& j) {
+        try {
+            j.fn();
+        } catch (std::exception& e) {
+            barch::err({"exception in maintenance task:", e.what()});
+        }
+        if (--j.owner->remaining == 0) {
+            std::lock_guard l(j.owner->m);
+            j.owner->done.notify_all();
+        }
+    }
+
+    bool maintenance_pool::take(size_t self, job& j) {
+        {
+            auto& own = *queues[self % queues.size()];
+            std::lock_guard l(own.m);
+            if (!own.jobs.empty()) {
+                j = std::move(own.jobs.front());
+                own.jobs.pop_front();
+                --pending;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto& other = *queues[(self + i) % queues.size()];
+            std::lock_guard l(other.m);
+            if (!other.jobs.empty()) {
+                j = std::move(other.jobs.back());
+                other.jobs.pop_back();
+                --pending;
+                ++steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void maintenance_pool::work(size_t self) {
+        while (true) {
+            job j;
+            if (take(self, j)) {
+                execute(j);
+                continue;
+            }
+            std::unique_lock l(idle_mutex);
+            idle.wait(l, [this]() {
+                return exit || pending > 0;
+            });
+            if (exit) return;
+        }
+    }
+
+    void maintenance_pool::run(heap::vector<task>& tasks) {
+        if (tasks.empty()) return;
+        auto b = std::make_shared<batch>();
+        b->remaining = tasks.size();
+        // dealt so that every queue has the most urgent of its share at the front.
+        // Starting where the last batch stopped keeps two key spaces from both
+        // loading worker 0 with their most urgent shard
+        size_t at = next_queue.fetch_add(tasks.size());
+        for (auto& t : tasks) {
+            auto& q = *queues[at++ % queues.size()];
+            std::lock_guard l(q.m);
+            q.jobs.push_back({std::move(t), b});
+            ++pending;
+        }
+        tasks.clear();
+        {
+            std::lock_guard l(idle_mutex);
+        }
+        idle.notify_all();
+
+        // help out instead of waiting idle
+        job j;
+        size_t self = at;
+        while (b->remaining > 0 && take(self, j)) {
+            execute(j);
+        }
+        std::unique_lock l(b->m);
+        b->done.wait(l, [&b]() {
+            return b->remaining == 0;
+        });
+    }
+
+    static size_t configured_maintenance_threads() {
+        if (get_use_minimum_threads()) return 1;
+        size_t n = get_maintenance_threads();
+        if (n == 0) {
+            // a quarter of the machine by default: enough to keep up with eviction
+            // under pressure without taking the cores the requests are served on
+            n = std::max<size_t>(1, std::thread::hardware_concurrency() / 4);
+        }
+        return n;
+    }
+
+    std::shared_ptr<maintenance_pool> get_maintenance_pool() {
+        static std::mutex m;
+        static std::shared_ptr<maintenance_pool> pool;
+        std::lock_guard l(m);
+        size_t wanted = configured_maintenance_threads();
+        if (!pool || pool->size() != wanted) {
+            pool = std::make_shared<maintenance_pool>(wanted);
+        }
+        return pool;
+    }
+}
@@ -0,0 +1,91 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_MAINTENANCE_POOL_H
+#define BARCH_MAINTENANCE_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "sastam.h"
+
+namespace barch {
+    /**
+     * The workers shard maintenance runs on, shared by every key space.
+     *
+     * Maintenance used to be one thread per key space walking all of its shards in
+     * turn, so reclaiming memory went at the speed of one core however many there were.
+     * A key space now hands the pool one task per shard, ordered most urgent first, and
+     * waits for the lot. The tasks are dealt round robin onto a queue per worker; a
+     * worker takes from the front of its own queue and, when that is empty, steals from
+     * the back of someone else's. The front of every queue is the urgent end, so the
+     * work that matters most is started first and a thief takes what matters least.
+     *
+     * The thread that submitted a batch works on it too rather than sitting idle, which
+     * also means a batch always finishes even when the pool has a single worker busy
+     * with another key space.
+     */
+    class maintenance_pool {
+    public:
+        typedef std::function<void()> task;
+
+        explicit maintenance_pool(size_t workers);
+        ~maintenance_pool();
+        maintenance_pool(const maintenance_pool&) = delete;
+        maintenance_pool& operator=(const maintenance_pool&) = delete;
+
+        /**
+         * run every task in tasks and return once they are all done. tasks[0] is the
+         * most urgent. A task should not throw; one that does is logged and counted
+         * as done.
+         */
+        void run(heap::vector<task>& tasks);
+
+        [[nodiscard]] size_t size() const {
+            return queues.size();
+        }
+        /** tasks taken from another worker's queue, for INFO */
+        [[nodiscard]] uint64_t get_steals() const {
+            return steals;
+        }
+
+    private:
+        struct batch {
+            std::atomic<size_t> remaining{};
+            std::mutex m{};
+            std::condition_variable done{};
+        };
+        struct job {
+            task fn{};
+            std::shared_ptr<batch> owner{};
+        };
+        struct worker_queue {
+            std::mutex m{};
+            std::deque<job> jobs{};
+        };
+
+        bool take(size_t self, job& j);
+        static void execute(job& j);
+        void work(size_t self);
+
+        heap::vector<std::unique_ptr<worker_queue>> queues{};
+        heap::vector<std::thread> workers{};
+        std::mutex idle_mutex{};
+        std::condition_variable idle{};
+        std::atomic<size_t> pending{};
+        std::atomic<uint64_t> steals{};
+        std::atomic<size_t> next_queue{};
+        bool exit{false};
+    };
+    /**
+     * the shared pool, sized by maintenance_threads. It is replaced when that setting
+     * changes; a batch already running keeps the pool it started on alive until it ends.
+     */
+    std::shared_ptr<maintenance_pool> get_maintenance_pool();
+}
+#endif //BARCH_MAINTENANCE_POOL_H
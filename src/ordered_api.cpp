@@ -113,8 +113,10 @@ static void insert_ordered(caller& call, composite &score_key, composite &member
     // this only takes it when nobody else has
     bool locked = t->get_latch().try_lock();
     try {
-        t->insert(sk, value, update);
-        t->insert(mk, sk, update);
+        // the stores, which write a shard apart from their sources, log what they wrote
+        art::key_options opts;
+        if (t->insert(sk, value, update) || update) barch::log_written(call.kspace(), t, opts, sk, value);
+        if (t->insert(mk, sk, update) || update) barch::log_written(call.kspace(), t, opts, mk, sk);
     }catch (const std::exception& e) {
         barch::err({e.what()});
     }
@@ -140,8 +142,8 @@ static void remove_ordered(caller& call, composite &score_key, composite &member
     bool locked = t->get_latch().try_lock();
     //write_lock release(t->get_latch()); // the shard should be latched
     try {
-        t->remove(sk);
-        t->remove(mk);
+        if (t->remove(sk)) barch::log_removed(call.kspace(), t, sk);
+        if (t->remove(mk)) barch::log_removed(call.kspace(), t, mk);
     }catch (const std::exception& e) {
         barch::err({e.what()});
     }
@@ -507,7 +509,7 @@ int ZCOUNT(caller& call, const arg_t& argv) {
     if (argv.size() < 4)
         return call.wrong_arity();
     barch::sharded_store kstore(call.kspace());
-    auto t = kstore.write_locked(argv[1]);
+    auto t = kstore.read_locked(argv[1]);
     size_t nlen, minlen, maxlen;
     const char *n = argv[1].chars(); nlen = argv[1].size;
     const char *smin = argv[2].chars(); minlen = argv[2].size;
@@ -526,28 +528,34 @@ int ZCOUNT(caller& call, const arg_t& argv) {
     if (!read_score(art::value_type{min_s}, lo) || !read_score(art::value_type{max_s}, hi)) {
         return call.push_error("min or max is not a float");
     }
-    auto mn = conversion::convert(min_s, true);
-    auto mx = conversion::convert(max_s, true);
+    // the bounds are encoded from the numbers already read, the way ZADD encodes a score -
+    // the text reader does not take "inf", and "-inf" and "+inf" are the usual bounds
+    auto mn = conversion::comparable_key(lo);
+    auto mx = conversion::comparable_key(hi);
     query lq, uq, pq;
-    auto lower = lq->create(art::ts_ordered_map, {container, mn});
+    auto lower = lq->create(art::ts_ordered_map, {container, mn}, false);
     auto prefix = pq->create(art::ts_ordered_map, {container}, false);
     auto upper = uq->create(art::ts_ordered_map, {container, mx}, false);
-    long long count = 0;
-    art::iterator ai(t, lower);
-    while (ai.ok()) {
-        auto ik = ai.key();
-        if (!ik.starts_with(prefix)) break;
-        if (ik.sub(0, prefix.size + numeric_key_size) <= upper) {
-            double sc = conversion::enc_bytes_to_dbl(ik.sub(prefix.size, numeric_key_size));
-            if (open_min && sc == lo) { ai.next(); continue; }
-            if (open_max && sc == hi) break;
-            ++count;
-        } else {
-            break;
-        }
-        ai.next();
+    // the count is the distance between the first member at or above min and the first
+    // above max, and a distance is the difference of two positions the tree can give
+    // without visiting the members between them. Only members that share an open bound's
+    // score are stepped over one at a time
+    auto on_score = [&](const art::iterator& i, double sc) -> bool {
+        if (!i.ok()) return false;
+        auto ik = i.key();
+        if (!ik.starts_with(prefix) || ik.size < prefix.size + numeric_key_size) return false;
+        return conversion::enc_bytes_to_dbl(ik.sub(prefix.size, numeric_key_size)) == sc;
+    };
+    art::iterator from(t, lower);
+    if (open_min) {
+        while (on_score(from, lo)) from.next();
     }
-    return call.push_ll(count);
+    art::iterator to(t, upper);
+    if (!open_max) {
+        while (on_score(to, hi)) to.next();
+    }
+    long long count = to.position() - from.position();
+    return call.push_ll(count > 0 ? count : 0);
 }
 int cmd_ZCOUNT(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
     vk_caller call;
@@ -584,52 +592,50 @@ static int zrange_by_index(caller& call, barch::shard_ptr t, const art::zrange_s
     }
 
     auto container = conversion::convert(spec.key);
-    query lq, pq;
+    query lq, pq, ixq;
     auto lower = lq->create(art::ts_ordered_map, {container});
     auto prefix = pq->create(art::ts_ordered_map, {container}, false);
-
-    // one pass in key order, which is score order. The members are held as they are
-    // found, the way the existing REV path already does, and the shard stays locked
-    // for the whole call
-    // score and member are kept separately because only the score has a fixed width. The
-    // pair used to be held as one slice of numeric_key_size * 2 and the member read back
-    // out of its second half, which silently cut every member to ten characters - a
-    // member is whatever length the caller gave it, and there is no bound to slice at
-    struct scored { art::value_type score, member; };
-    heap::std_vector<scored> found;
-    art::iterator ai(t, lower);
-    while (ai.ok()) {
-        auto v = ai.key();
-        if (!v.starts_with(prefix)) break;
-        if (v.size <= prefix.size + numeric_key_size) { ai.next(); continue; }
-        found.push_back({v.sub(prefix.size, numeric_key_size),
-                         v.sub(prefix.size + numeric_key_size,
-                               v.size - prefix.size - numeric_key_size)});
-        ai.next();
-    }
-    const int64_t n = (int64_t) found.size();
+    auto members = ixq->create(art::ts_ordered_map, {IX_MEMBER, container}, false);
+
+    // the set's size is counted as it is written (see shard::count_container_leaf), and a
+    // position in the set is a position in the shard's tree less that of its first key. So
+    // the iterator is put on the first member wanted straight from the leaf counts of the
+    // nodes above it rather than by stepping over every member before it - a page from the
+    // end of a large set used to read the whole set into a vector first
+    const int64_t n = (int64_t) t->get_container_size(members).count;
     if (start < 0) start += n;
     if (stop < 0) stop += n;
     if (start < 0) start = 0;
     if (stop >= n) stop = n - 1;
 
-    auto emit_one = [&](const scored& rec) {
+    auto emit_one = [&](art::value_type v) {
+        // score and member are taken apart because only the score has a fixed width - a
+        // member is whatever length the caller gave it, and there is no bound to slice at
+        auto score = v.sub(prefix.size, numeric_key_size);
+        auto member = v.sub(prefix.size + numeric_key_size, v.size - prefix.size - numeric_key_size);
         if (collect) {
-            collect->push_back({std::string(rec.member.chars(), rec.member.size),
-                                conversion::enc_bytes_to_dbl(rec.score)});
+            collect->push_back({std::string(member.chars(), member.size),
+                                conversion::enc_bytes_to_dbl(score)});
             return;
         }
-        call.push_encoded_key(rec.member);
+        call.push_encoded_key(member);
         if (spec.has_withscores) {
-            call.push_encoded_key(rec.score);
+            call.push_encoded_key(score);
         }
     };
     if (!collect)
         call.start_array();
     if (n > 0 && start <= stop && start < n) {
-        for (int64_t i = start; i <= stop; ++i) {
-            // REV counts positions from the high score end
-            emit_one(spec.REV ? found[(size_t) (n - 1 - i)] : found[(size_t) i]);
+        const int64_t base = art::iterator(t, lower).position();
+        // REV counts positions from the high score end, so it starts at the other end of
+        // the same span and goes backwards
+        art::iterator ai(t);
+        bool at = ai.seek(base + (spec.REV ? n - 1 - start : start));
+        for (int64_t i = start; at && i <= stop && ai.ok(); ++i) {
+            auto v = ai.key();
+            if (!v.starts_with(prefix) || v.size <= prefix.size + numeric_key_size) break;
+            emit_one(v);
+            at = spec.REV ? ai.previous() : ai.next();
         }
     }
     if (!collect)
@@ -1000,29 +1006,18 @@ int ZCARD(caller& call, const arg_t& argv) {
     if (argv.size() < 2)
         return call.wrong_arity();
     barch::sharded_store kstore(call.kspace());
-    auto t = kstore.write_locked(argv[1]);
+    auto t = kstore.read_locked(argv[1]);
     auto n = argv[1];
 
     if (key_ok(n) != 0) {
         return call.push_null();
     }
 
-    auto container = conversion::convert(n);
-    query lq, uq;
-    auto lower = lq->create(art::ts_ordered_map, {container});
-    auto upper = uq->create(art::ts_ordered_map, {container, art::ts_end});
-    long long count = 0;
-    art::iterator ai(t, lower);
-    while (ai.ok()) {
-        if (!ai.key().starts_with(lower.pref(1))) break;
-        if (ai.key() <= upper) {
-            ++count;
-        } else {
-            break;
-        }
-        ai.next();
-    }
-    return call.push_ll(count);
+    // one member index key per member, counted by the shard as they are written and
+    // removed - see shard::count_container_leaf
+    query pq;
+    auto prefix = pq->create(art::ts_ordered_map, {IX_MEMBER, conversion::convert(n)}, false);
+    return call.push_ll((long long)t->get_container_size(prefix).count);
 }
 
 int cmd_ZCARD(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
@@ -1051,6 +1046,18 @@ static double rnd(float f) {
  * score", and two sets sharing a score looked like a match whatever their members were.
  * That is why an intersection came back looking like a union.
  */
+/** the score a member index leaf points at, false when it has none */
+static bool indexed_score(const art::node_ptr& n, art::value_type prefix, double& out) {
+    if (n.null() || !n.is_leaf) return false;
+    auto l = n.const_leaf();
+    if (l->is_tomb() || l->deleted() || l->expired()) return false;
+    // the index holds the score key, and the score is the component after the name
+    auto sk = l->get_value();
+    if (sk.size < prefix.size + numeric_key_size) return false;
+    out = conversion::enc_bytes_to_dbl(sk.sub(prefix.size, numeric_key_size));
+    return true;
+}
+
 static bool member_score(barch::sharded_store& kstore, const std::string& set,
                          art::value_type member, double& out) {
     composite mq, cq;
@@ -1060,19 +1067,41 @@ static bool member_score(barch::sharded_store& kstore, const std::string& set,
     art::value_type prefix = cq.create(art::ts_ordered_map, {container}, false);
     bool found = false;
     kstore.with_container_read(art::value_type{set}, [&](const barch::shard_ptr& t) {
-        auto n = t->search(mkey);
-        if (n.null() || !n.is_leaf) return;
-        auto l = n.const_leaf();
-        if (l->is_tomb() || l->deleted() || l->expired()) return;
-        // the index holds the score key, and the score is the component after the name
-        auto sk = l->get_value();
-        if (sk.size < prefix.size + numeric_key_size) return;
-        out = conversion::enc_bytes_to_dbl(sk.sub(prefix.size, numeric_key_size));
-        found = true;
+        found = indexed_score(t->search(mkey), prefix, out);
     });
     return found;
 }
 
+/**
+ * the scores of several members of one set, all looked up in one search_batch. scores[i]
+ * is only set where has[i] is
+ */
+static void member_scores(barch::sharded_store& kstore, const std::string& set,
+                          const heap::vector<art::value_type>& members,
+                          heap::vector<double>& scores, heap::vector<bool>& has) {
+    composite mq, cq;
+    auto container = conversion::convert(art::value_type{set});
+    art::value_type prefix = cq.create(art::ts_ordered_map, {container}, false);
+    key_batch index;
+    for (auto m : members) {
+        index.add(mq.create(art::ts_ordered_map, {IX_MEMBER, container, conversion::comparable_key(m)}));
+    }
+    auto keys = index.keys();
+    scores.assign(members.size(), 0);
+    has.assign(members.size(), false);
+    kstore.with_container_read(art::value_type{set}, [&](const barch::shard_ptr& t) {
+        heap::vector<art::node_ptr> found(keys.size());
+        t->search_batch(keys.data(), keys.size(), found.data());
+        for (size_t i = 0; i < found.size(); ++i) {
+            double score = 0;
+            if (indexed_score(found[i], prefix, score)) {
+                scores[i] = score;
+                has[i] = true;
+            }
+        }
+    });
+}
+
 /** every member of one ordered set, with its score */
 static void each_member(barch::sharded_store& kstore, const std::string& set,
                         const std::function<void(art::value_type, double)>& cb) {
@@ -1460,12 +1489,22 @@ int ZMSCORE(caller& call, const arg_t& argv) {
         return call.push_error(barch::wrong_type_message());
     }
     std::string set(argv[1].chars(), argv[1].size);
-    call.start_array();
+    heap::vector<conversion::comparable_key> wanted;
+    heap::vector<art::value_type> members;
+    wanted.reserve(argv.size());
     for (size_t i = 2; i < argv.size(); ++i) {
-        auto wanted = conversion::convert(argv[i]);
-        double score = 0;
-        if (member_score(kstore, set, wanted.get_value(), score)) {
-            call.push_double(score);
+        wanted.emplace_back(conversion::convert(argv[i]));
+    }
+    for (auto& w : wanted) {
+        members.push_back(w.get_value());
+    }
+    heap::vector<double> scores;
+    heap::vector<bool> has;
+    member_scores(kstore, set, members, scores, has);
+    call.start_array();
+    for (size_t i = 0; i < members.size(); ++i) {
+        if (has[i]) {
+            call.push_double(scores[i]);
         } else {
             call.push_null();
         }
@@ -1794,6 +1833,12 @@ static int zmpop(caller& call, const arg_t& argv, bool blocking) {
         }
         heap::std_vector<zpopped> popped;
         if (zmpop_one(t, name, want_max, count, popped)) {
+            // replays as a pop of just this set, on the shard it came from
+            if (barch::append_log::recording()) {
+                auto n = std::to_string(popped.size());
+                barch::append_log::ran(spc->get_canonical_name(), t->get_shard_number(),
+                                       {"ZMPOP", "1", name.to_view(), want_max ? "MAX" : "MIN", "COUNT", n});
+            }
             reply_zmpop(call, name, popped);
             return call.ok();
         }
@@ -2016,16 +2061,36 @@ int cmd_ZREVRANGEBYLEX(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc
     vk_caller call;
     return call.vk_call(ctx, argv, argc, ZREVRANGEBYLEX);
 }
-extern "C"
 /**
- * ZRANK key member [WITHSCORE]
+ * where a member sits in its set, counting from the lowest score, zero based.
  *
- * redis's ZRANK: the position of one member counting from the lowest score, zero based,
- * and nil when the member is not in the set. It used to take two bounds and answer how
- * many members fell between them, which is a different question - ZFASTRANK still answers
- * that one, in constant time, and is the right command for it. See TODO 38.
+ * The member index holds the member's score key. Its position in the shard's tree less
+ * the position of the first key of the set is the rank, and both positions are read off
+ * the leaf counts the inner nodes above them keep - so this visits a few nodes per level
+ * of the tree instead of every member that sorts before it, which is what ZRANK used to
+ * do, and ZREVRANK on top of that walked the rest of the set to learn its size.
  */
-int ZRANK(caller& call, const arg_t& argv) {
+static bool member_rank(const barch::shard_ptr& t, const conversion::comparable_key& container,
+                        const conversion::comparable_key& member, int64_t& rank, art::value_type& score) {
+    composite mq, lq, pq;
+    auto mkey = mq.create(art::ts_ordered_map, {IX_MEMBER, container, member});
+    auto n = t->search(mkey);
+    if (n.null() || !n.is_leaf) return false;
+    auto l = n.const_leaf();
+    if (l->is_tomb() || l->deleted() || l->expired()) return false;
+    auto sk = l->get_value();
+    auto prefix = pq.create(art::ts_ordered_map, {container}, false);
+    if (sk.size < prefix.size + numeric_key_size) return false;
+    auto lower = lq.create(art::ts_ordered_map, {container});
+    art::iterator first(t, lower);
+    art::iterator at(t, sk);
+    if (!at.ok() || !(at.key() == sk)) return false;
+    rank = at.position() - first.position();
+    score = sk.sub(prefix.size, numeric_key_size);
+    return true;
+}
+
+static int reply_rank(caller& call, const arg_t& argv, bool rev) {
     if (argv.size() < 3 || argv.size() > 4) {
         return call.wrong_arity();
     }
@@ -2045,35 +2110,21 @@ int ZRANK(caller& call, const arg_t& argv) {
     // the member is stored encoded, the same way ZADD writes it - which is why zrange
     // hands it back through push_encoded_key. Comparing the raw argument against the
     // stored bytes never matches
-    auto wanted_key = conversion::convert(argv[2]);
-    art::value_type wanted = wanted_key.get_value();
+    auto wanted = conversion::convert(argv[2]);
     barch::sharded_store kstore(call.kspace());
     auto t = kstore.read_locked(c);
 
     auto container = conversion::convert(c);
-    query lq, pq;
-    auto lower = lq->create(art::ts_ordered_map, {container});
-    auto prefix = pq->create(art::ts_ordered_map, {container}, false);
-
     int64_t position = 0;
-    bool found = false;
     art::value_type score{};
-    art::iterator ai(t, lower);
-    while (ai.ok()) {
-        auto v = ai.key();
-        if (!v.starts_with(prefix)) break;
-        auto member = v.sub(prefix.size + numeric_key_size);
-        if (member == wanted) {
-            score = v.sub(prefix.size, numeric_key_size);
-            found = true;
-            break;
-        }
-        ++position;
-        ai.next();
-    }
-    if (!found) {
+    if (!member_rank(t, container, wanted, position, score)) {
         return call.push_null();
     }
+    if (rev) {
+        query ixq;
+        auto members = ixq->create(art::ts_ordered_map, {IX_MEMBER, container}, false);
+        position = (int64_t)t->get_container_size(members).count - 1 - position;
+    }
     if (withscore) {
         call.start_array();
         call.push_ll(position);
@@ -2083,6 +2134,19 @@ int ZRANK(caller& call, const arg_t& argv) {
     }
     return call.push_ll(position);
 }
+
+extern "C"
+/**
+ * ZRANK key member [WITHSCORE]
+ *
+ * redis's ZRANK: the position of one member counting from the lowest score, zero based,
+ * and nil when the member is not in the set. It used to take two bounds and answer how
+ * many members fell between them, which is a different question - ZFASTRANK still answers
+ * that one, in constant time, and is the right command for it. See TODO 38.
+ */
+int ZRANK(caller& call, const arg_t& argv) {
+    return reply_rank(call, argv, false);
+}
 int cmd_ZRANK(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
     vk_caller call;
     return call.vk_call(ctx, argv, argc, ZRANK);
@@ -2090,61 +2154,7 @@ int cmd_ZRANK(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
 
 extern "C"
 int ZREVRANK(caller& call, const arg_t& argv) {
-    if (argv.size() < 3 || argv.size() > 4) {
-        return call.wrong_arity();
-    }
-    bool withscore = false;
-    if (argv.size() == 4) {
-        auto opt = argv[3].to_string();
-        for (auto& ch : opt) ch = (char) toupper((unsigned char) ch);
-        if (opt != "WITHSCORE") {
-            return call.syntax_error();
-        }
-        withscore = true;
-    }
-    auto c = argv[1];
-    if (c.empty() || argv[2].empty()) {
-        return call.wrong_arity();
-    }
-    auto wanted_key = conversion::convert(argv[2]);
-    art::value_type wanted = wanted_key.get_value();
-    barch::sharded_store kstore(call.kspace());
-    auto t = kstore.read_locked(c);
-
-    auto container = conversion::convert(c);
-    query lq, pq;
-    auto lower = lq->create(art::ts_ordered_map, {container});
-    auto prefix = pq->create(art::ts_ordered_map, {container}, false);
-
-    int64_t position = 0;
-    int64_t n = 0;
-    bool found = false;
-    art::value_type score{};
-    art::iterator ai(t, lower);
-    while (ai.ok()) {
-        auto v = ai.key();
-        if (!v.starts_with(prefix)) break;
-        auto member = v.sub(prefix.size + numeric_key_size);
-        if (member == wanted) {
-            score = v.sub(prefix.size, numeric_key_size);
-            found = true;
-            position = n;
-        }
-        ++n;
-        ai.next();
-    }
-    if (!found) {
-        return call.push_null();
-    }
-    int64_t rev = n - 1 - position;
-    if (withscore) {
-        call.start_array();
-        call.push_ll(rev);
-        call.push_encoded_key(score);
-        call.end_array();
-        return call.ok();
-    }
-    return call.push_ll(rev);
+    return reply_rank(call, argv, true);
 }
 int cmd_ZREVRANK(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
     vk_caller call;
@@ -2174,40 +2184,45 @@ int ZREMRANGEBYRANK(caller& call, const arg_t& argv) {
         return 0;
     auto t = kstore.write_locked(argv[1]);
     auto container = conversion::convert(argv[1]);
-    query lq, pq;
+    query lq, pq, ixq;
     auto lower = lq->create(art::ts_ordered_map, {container});
     auto prefix = pq->create(art::ts_ordered_map, {container}, false);
-    struct scored { std::string score, member; };
-    heap::std_vector<scored> found;
-    art::iterator ai(t, lower);
-    while (ai.ok()) {
-        auto v = ai.key();
-        if (!v.starts_with(prefix)) break;
-        if (v.size <= prefix.size + numeric_key_size) { ai.next(); continue; }
-        auto sc = v.sub(prefix.size, numeric_key_size);
-        auto mem = v.sub(prefix.size + numeric_key_size,
-                         v.size - prefix.size - numeric_key_size);
-        found.push_back({std::string(sc.chars(), sc.size),
-                         std::string(mem.chars(), mem.size)});
-        ai.next();
-    }
-    const int64_t n = (int64_t) found.size();
+    auto members = ixq->create(art::ts_ordered_map, {IX_MEMBER, container}, false);
+    const int64_t n = (int64_t) t->get_container_size(members).count;
     if (start < 0) start += n;
     if (stop < 0) stop += n;
     if (start < 0) start = 0;
     if (stop >= n) stop = n - 1;
-    int64_t removed = 0;
+    // only the members being removed are read, from the first of them on - the iterator
+    // is put there from the leaf counts of the tree rather than by walking the members
+    // before it. They are copied out before any is removed, because removing moves the
+    // keys the iterator is standing on
+    struct scored { std::string score, member; };
+    heap::std_vector<scored> found;
     if (n > 0 && start <= stop && start < n) {
-        for (int64_t i = start; i <= stop; ++i) {
-            composite score_key, member_key;
-            art::value_type sc{found[(size_t) i].score};
-            art::value_type mem{found[(size_t) i].member};
-            score_key.create(art::ts_ordered_map, {container, sc, mem});
-            member_key.create(art::ts_ordered_map, {IX_MEMBER, container, mem});
-            remove_ordered(call, score_key, member_key);
-            ++removed;
+        art::iterator ai(t);
+        bool at = ai.seek(art::iterator(t, lower).position() + start);
+        for (int64_t i = start; at && i <= stop && ai.ok(); ++i) {
+            auto v = ai.key();
+            if (!v.starts_with(prefix) || v.size <= prefix.size + numeric_key_size) break;
+            auto sc = v.sub(prefix.size, numeric_key_size);
+            auto mem = v.sub(prefix.size + numeric_key_size,
+                             v.size - prefix.size - numeric_key_size);
+            found.push_back({std::string(sc.chars(), sc.size),
+                             std::string(mem.chars(), mem.size)});
+            at = ai.next();
         }
     }
+    int64_t removed = 0;
+    for (const auto& rec : found) {
+        composite score_key, member_key;
+        art::value_type sc{rec.score};
+        art::value_type mem{rec.member};
+        score_key.create(art::ts_ordered_map, {container, sc, mem});
+        member_key.create(art::ts_ordered_map, {IX_MEMBER, container, mem});
+        remove_ordered(call, score_key, member_key);
+        ++removed;
+    }
     return call.push_ll(removed);
 }
 int cmd_ZREMRANGEBYRANK(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
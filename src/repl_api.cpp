@@ -29,11 +29,13 @@
 #include "keyspace_locks.h"
 #include "dictionary_compressor.h"
 #include "statistics.h"
+#include "append_log.h"
 #include "swig_api.h"
 #include "thread_pool.h"
 #include "auth_api.h"
 #include "rpc/server.h"
 #include "rpc/restarter.h"
+#include "rpc/constants.h"
 #include "rpc/redis_parser.h"
 
 extern "C" {
@@ -59,20 +61,24 @@ int LOAD(caller& call, const arg_t& argv) {
     // next to the one just read back. hash sharding loads under each shard's
     // own latch. the range table is rebuilt before the space lock drops,
     // because it is nothing but each shard's first key
-    barch::sharded_store::write_guard held;
-    if (call.kspace()->is_stateful_sharding()) {
-        held = store.lock_space_write();
-        store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
-            if (!shard->load_holding_lock()) ++errors;
-        });
-        if (call.kspace()->is_range_sharded()) {
-            call.kspace()->routes().rebuild(store.shards());
+    {
+        barch::sharded_store::write_guard held;
+        if (call.kspace()->is_stateful_sharding()) {
+            held = store.lock_space_write();
+            store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
+                if (!shard->load_holding_lock()) ++errors;
+            });
+            if (call.kspace()->is_range_sharded()) {
+                call.kspace()->routes().rebuild(store.shards());
+            }
+        } else {
+            store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
+                if (!shard->load(true)) ++errors;
+            });
         }
-    } else {
-        store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
-            if (!shard->load(true)) ++errors;
-        });
     }
+    // the writes logged since the files were saved, replayed once the space is unfrozen
+    barch::append_log::recover(call.kspace());
     return errors>0 ? call.push_error("some shards did not load") : call.push_simple("OK");
 }
 int cmd_LOAD(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
@@ -90,43 +96,77 @@ int RELOAD(caller& call, const arg_t& argv) {
     // has already been replaced from disk for one that has not. hash sharding
     // reloads under each shard's own latch. the range table is rebuilt before
     // the space lock drops
-    barch::sharded_store::write_guard held;
-    if (call.kspace()->is_stateful_sharding()) {
-        held = store.lock_space_write();
-        store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
-            if (!shard->reload_holding_lock()) ++errors;
-        });
-        if (call.kspace()->is_range_sharded()) {
-            // the routing table describes the shards, and the shards were just
-            // replaced by what was on disk. rebuilding is what a load does
-            // anyway - the table is never written down, only derived
-            call.kspace()->routes().rebuild(store.shards());
+    {
+        barch::sharded_store::write_guard held;
+        if (call.kspace()->is_stateful_sharding()) {
+            held = store.lock_space_write();
+            store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
+                if (!shard->reload_holding_lock()) ++errors;
+            });
+            if (call.kspace()->is_range_sharded()) {
+                // the routing table describes the shards, and the shards were just
+                // replaced by what was on disk. rebuilding is what a load does
+                // anyway - the table is never written down, only derived
+                call.kspace()->routes().rebuild(store.shards());
+            }
+        } else {
+            store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
+                if (!shard->reload()) ++errors;
+            });
         }
-    } else {
-        store.each_shard_parallel([&errors](const barch::shard_ptr& shard) {
-            if (!shard->reload()) ++errors;
-        });
     }
+    // the writes logged since the files were saved, replayed once the space is unfrozen
+    barch::append_log::recover(call.kspace());
     return errors>0 ? call.push_error("some shards did not reload") : call.push_simple("OK");
 }
+/**
+ * START interface port [SSL] [URING|SQPOLL] [CORES [count]] [ASYNCH]
+ * (re)start the resp server. URING serves plain tcp connections from io_uring rings,
+ * SQPOLL the same with a kernel thread polling each ring. CORES gives every resp thread
+ * its own listener and a share of the shards, see server::start, with one thread per
+ * hardware thread unless count says how many. the flags can come in any order, SSL
+ * cannot be had with a ring or with CORES
+ */
 int START(caller& call, const arg_t& argv) {
-    if (argv.size() > 5 || argv.size() < 3)
+    if (argv.size() > 8 || argv.size() < 3)
         return call.wrong_arity();
-    if (argv.size() >= 4 && argv[3] != "SSL") {
-        return call.push_error("invalid argument");
+    bool ssl = false;
+    bool async = false;
+    bool per_core = false;
+    size_t core_count = 0;
+    auto backend = barch::server::io_backend::asio;
+    for (size_t i = 3; i < argv.size(); ++i) {
+        if (argv[i] == "SSL" && !ssl) {
+            ssl = true;
+        } else if (argv[i] == "ASYNCH" && !async) {
+            async = true;
+        } else if (argv[i] == "CORES" && !per_core) {
+            per_core = true;
+            if (i + 1 < argv.size() && !argv[i + 1].empty() && isdigit((unsigned char) argv[i + 1].chars()[0])) {
+                auto count = conversion::as_variable(argv[++i]).ui();
+                if (count == 0 || count > core_count_max)
+                    return call.push_error("invalid core count");
+                core_count = count;
+            }
+        } else if (argv[i] == "URING" && backend == barch::server::io_backend::asio) {
+            backend = barch::server::io_backend::uring;
+        } else if (argv[i] == "SQPOLL" && backend == barch::server::io_backend::asio) {
+            backend = barch::server::io_backend::uring_sqpoll;
+        } else {
+            return call.push_error("invalid argument");
+        }
     }
-    if (argv.size() == 5 && argv[4] != "ASYNCH") {
-        return call.push_error("invalid argument");
-    };
+    if (ssl && backend != barch::server::io_backend::asio)
+        return call.push_error("SSL connections cannot use io_uring");
+    if (ssl && per_core)
+        return call.push_error("SSL connections cannot be served per core");
     auto interface = argv[1];
     auto port = conversion::as_variable(argv[2]).ui();
-    bool ssl = argv.size() == 4 && argv[3] == "SSL";
-    bool async = argv.size() == 5 && argv[4] == "ASYNCH";
     if (call.is_remote()) async = true;
     if (async)
-        restart.asynch_restart(interface.chars(), port, ssl);
+        restart.asynch_restart(interface.chars(), port, ssl, backend, per_core, core_count);
     else
-        restart.inline_restart(interface.chars(), port, ssl);
+        restart.inline_restart(interface.chars(), port, ssl, backend, per_core, core_count);
     return call.push_simple("OK");
 }
 int cmd_START(ValkeyModuleCtx *ctx, ValkeyModuleString **argv, int argc) {
@@ -5,9 +5,15 @@
 #ifndef BARCH_ASIO_RESP_SESISON_H
 #define BARCH_ASIO_RESP_SESISON_H
 #include <cctype>
+#include <cerrno>
 #include <mutex>
 #include <utility>
+#include <poll.h>
+#include <type_traits>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
+#include "append_log.h"
 #include "abstract_session.h"
 #include "asio_includes.h"
 #include "redis_parser.h"
@@ -15,8 +21,10 @@
 #include "netstat.h"
 #include "vector_stream.h"
 #include "constants.h"
+#include "configuration.h"
 #include "time_conversion.h"
 #include "rpc/proto_info.h"
+#include "rpc/shard_cores.h"
 #include "foreign/foreign.h"
 namespace barch {
     extern std::atomic<uint64_t> client_id;
@@ -73,6 +81,14 @@ namespace barch {
         {
             do_read();
         }
+        /**
+         * serve this connection on core `at` of a server started per core. Called before
+         * start, on the core itself
+         */
+        void on_core(std::shared_ptr<shard_cores> all, size_t at) {
+            cores = std::move(all);
+            core = at;
+        }
         // socket independent function to get info for session
         std::string get_info_l(const std::string& laddress, const std::string& raddress ) const {
             uint64_t seconds = (art::now() - created)/1000;
@@ -81,8 +97,15 @@ namespace barch {
                 "laddr="+laddress+" fd="+"10"+ " "
                 "name="+""+" age="+std::to_string(seconds)+" "+
                 "idle=0 flags=N capa= db=0 sub=0 psub=0 ssub=0 "+
-                "multi=-1 watch=0 qbuf=0 qbuf-free=0 argv-mem=10 multi-mem=0 "+
-                "rbs=1024 rbp=0 obl=0 oll=0 omem=0 tot-mem="+std::to_string(rpc_io_buffer_size+parser.get_max_buffer_size())+" "+
+                // qbuf is what is waiting to be parsed, out of a buffer lent by the pool
+                // that an idle connection does not hold, and rbs/rbp the read size now
+                // and at its largest
+                "multi=-1 watch=0 qbuf="+std::to_string(parser.remaining())+" "+
+                "qbuf-free="+std::to_string(parser.get_buffer_capacity()-std::min(parser.get_buffer_capacity(), parser.remaining()))+" "+
+                "argv-mem=10 multi-mem=0 "+
+                "rbs="+std::to_string(read_size)+" rbp="+std::to_string(read_peak)+" "+
+                "obl=0 oll=0 omem="+std::to_string(stream.buf.capacity())+" "+
+                "tot-mem="+std::to_string(parser.get_buffer_capacity()+stream.buf.capacity())+" "+
                 "events=r cmd=client|info user="+caller.get_user()+" redir=-1 "+
                 "resp="+std::to_string(caller.get_protocol())+" lib-name= lib-ver= "+
                 // SCAN cursors this connection is holding, and what they cost. An
@@ -176,6 +199,8 @@ namespace barch {
             vector_stream stream{}; // the stream buffer needs to stau alive while the call completes
             std::vector<std::string> params{};
             std::string cn;
+            // logged when it runs, see rpc_caller::call
+            barch::append_log::ticket logged{};
         };
         typedef std::shared_ptr<asynch_call_context> asynch_call_context_ptr;
 
@@ -230,12 +255,7 @@ namespace barch {
                     redis::rwrite(ostream, error{"unknown command"});
                 } else {
                     auto &f = ic->second.call;
-                    ++ic->second.calls;
-                    if (ic->second.is_write() && ic->second.is_data()
-                        && barch::repl::has_destinations()) {
-                        std::vector<std::string> owned(params.begin(), params.end());
-                        repl::call(owned);
-                    }
+                    barch::append_log::ticket logged = pass_on(ic->second, prev_cn, params);
 
 
                     // once one call is asynch all calls in this batch must be asynch to preserve order
@@ -244,9 +264,11 @@ namespace barch {
                         if (!stream.empty()) {
                             asynch_call_context_ptr ctx = std::make_shared<asynch_call_context>(caller,f,params,prev_cn);
                             ctx->stream = std::move(stream); // move the current stream - it should be empty after the move
+                            ctx->logged = std::move(logged);
                             asynch_calls.push_back(ctx);
                         }else {
                             asynch_calls.emplace_back(std::make_shared<asynch_call_context>(caller,f,params,prev_cn));
+                            asynch_calls.back()->logged = std::move(logged);
                         }
 
                     }else {
@@ -254,7 +276,7 @@ namespace barch {
                         // auto current = now(); // remove this for now since it has a measurable impact on performance
 
                         caller.reply_out = &ostream;
-                        int32_t r = caller.call(params,f);
+                        int32_t r = caller.call(params,f,&logged);
                         caller.reply_out = nullptr;
                         if (!caller.has_blocks())
                             write_result<Stream>(caller, ostream, r);
@@ -271,33 +293,323 @@ namespace barch {
                 caller.set_kspace(old_spc); // return to old value
 
         }
-        // the async call context needs to stay alive while calls complete
-        void do_read() {
-            socket_.async_read_some(asio::buffer(data_, rpc_io_buffer_size),
-                [this](std::error_code ec, std::size_t length)// NOTE: the self shared pointers can cause noticeable cpu usage so we keep the session afloat elsewhere
-            {
+        /**
+         * count a call, replicate it and encode it for the log, ahead of running it. It is
+         * replicated in the order the requests arrived, and logged in the order it ran
+         */
+        barch::append_log::ticket pass_on(barch_info& info, const std::string& name, const std::vector<redis::string_param_t>& params) {
+            ++info.calls;
+            if (info.is_write() && info.is_data() && barch::repl::has_destinations()) {
+                std::vector<std::string> owned(params.begin(), params.end());
+                repl::call(owned);
+            }
+            barch::append_log::ticket logged{};
+            if (barch::append_log::is_open() && barch::append_log::logs(info, name)) {
+                logged = barch::append_log::append(caller.kspace()->get_canonical_name(), name, params);
+            }
+            return logged;
+        }
 
-                if (!ec){
-                    bytes_recv += length;
-                    parser.add_data(data_, length);
+        /** one request of a pipeline that is run a shard at a time */
+        struct fanned_request {
+            // views into the parser's buffer, which stays put while reading is suspended
+            std::vector<redis::string_param_t> params{};
+            barch_info* info{nullptr};
+            std::string name{};
+            size_t group{0};
+            // where its reply starts and ends in its group's stream
+            size_t begin{0};
+            size_t end{0};
+            barch::append_log::ticket logged{};
+        };
+        /**
+         * the requests of a pipeline that one worker runs, in the order they arrived. On
+         * a server started per core the group is a core's shards, and owner that core
+         */
+        struct fanned_group {
+            fanned_group(const rpc_caller& caller, size_t owner) : caller(caller), owner(owner) {}
+            rpc_caller caller;
+            size_t owner;
+            vector_stream out{};
+            heap::vector<size_t> requests{};
+        };
+        struct fanned_pipeline {
+            heap::vector<fanned_request> requests{};
+            heap::vector<fanned_group> groups{};
+            std::atomic<size_t> running{0};
+        };
+        typedef std::shared_ptr<fanned_pipeline> fanned_pipeline_ptr;
 
-                    try {
+        /**
+         * Keep a request back to be run with the rest of a pipeline a shard at a time, if
+         * it can be: a single key command, in the connection's own key space, on a server
+         * that answers it here, outside MULTI. A space with a foreign source is left out
+         * because a miss there blocks, and a range sharded one because a key can change
+         * shard while the pipeline is being split.
+         *
+         * Started per core, a request for a shard this core owns with nothing kept back
+         * ahead of it is not kept either: it runs at once, as it would on any server,
+         * without being copied into a pipeline first.
+         */
+        bool collect(const std::vector<redis::string_param_t>& params) {
+            if (params.size() < 2 || params[1].empty() || caller.is_buffering() || caller.valid_routes || caller.host)
+                return false;
+            std::string_view raw = params[0];
+            if (raw.empty() || raw.find(':') != std::string_view::npos)
+                return false;
+            // the same command as the last one, as most of a pipeline is, is not looked
+            // up again. fan_cn is upper case, so only a name sent that way matches
+            if (raw != fan_cn) {
+                fan_cn.assign(raw);
+                for (auto& ch : fan_cn) {
+                    ch = (char) toupper((unsigned char) ch);
+                }
+                fan_fn = barch_functions->find(fan_cn);
+            }
+            auto fn = fan_fn;
+            if (fn == barch_functions->end() || !fn->second.single_key || fn->second.is_asynch)
+                return false;
+            if (!is_authorized(fn->second.cats, caller.get_acl()))
+                return false;
+            auto ks = caller.kspace();
+            if (ks->has_foreign() || ks->routes_move())
+                return false;
+            size_t shard = ks->get_shard_index(ks->encode_key(params[1]).get_value());
+            bool kept = fanned && !fanned->requests.empty();
+            if (cores && !kept && cores->owner(shard) == core)
+                return false;
+            if (!fanned)
+                fanned = std::make_shared<fanned_pipeline>();
+            auto& q = fanned->requests.emplace_back();
+            q.params = params;
+            q.info = &fn->second;
+            q.name = fan_cn;
+            q.group = shard;
+            return true;
+        }
+        /** the group a shard's requests run in: a worker's, or the core that owns it */
+        [[nodiscard]] size_t group_of_shard(size_t shard) const {
+            return cores ? cores->owner(shard) : shard % pipeline_parallel_groups;
+        }
+        [[nodiscard]] size_t group_count() const {
+            return cores ? cores->size() : (size_t) pipeline_parallel_groups;
+        }
+        /**
+         * true when what was kept back is worth splitting: enough requests, over more
+         * than one group of shards. Started per core, any request for a shard another
+         * core owns is reason enough, since that core is the one that runs it
+         */
+        bool worth_fanning() const {
+            if (!fanned || fanned->requests.empty())
+                return false;
+            if (cores) {
+                for (const auto& q : fanned->requests) {
+                    if (cores->owner(q.group) != core)
+                        return true;
+                }
+                return false;
+            }
+            if (fanned->requests.size() < pipeline_parallel_min)
+                return false;
+            size_t first = group_of_shard(fanned->requests[0].group);
+            for (const auto& q : fanned->requests) {
+                if (group_of_shard(q.group) != first)
+                    return true;
+            }
+            return false;
+        }
+        /**
+         * what was kept back, run here and now as if it had never been. The pipeline is
+         * kept for the next run, with the room its requests took
+         */
+        void run_collected(heap::vector<asynch_call_context_ptr>& asynch_calls) {
+            if (!fanned || fanned->requests.empty())
+                return;
+            for (auto& q : fanned->requests) {
+                run_params(stream, q.params, asynch_calls);
+            }
+            fanned->requests.clear();
+        }
+        /**
+         * Run what was kept back a group of shards at a time on the workers. A key is on
+         * one shard, so requests for the same key stay in the order they arrived, and
+         * requests for different keys have no order to keep. Reading is suspended until
+         * every group is done, then the replies are put back in request order.
+         */
+        void run_fanned() {
+            auto pipeline = std::move(fanned);
+            size_t groups = 0;
+            heap::vector<size_t> group_of(group_count(), SIZE_MAX);
+            for (size_t at = 0; at < pipeline->requests.size(); ++at) {
+                auto& q = pipeline->requests[at];
+                size_t key = group_of_shard(q.group);
+                size_t& g = group_of[key];
+                if (g == SIZE_MAX) {
+                    g = groups++;
+                    pipeline->groups.emplace_back(caller, key);
+                    auto& c = pipeline->groups.back().caller;
+                    // replies go to the group's stream, and only the session writes the socket
+                    c.write_socket_bytes = nullptr;
+                    c.send_vectored = nullptr;
+                }
+                q.group = g;
+                pipeline->groups[g].requests.push_back(at);
+                q.logged = pass_on(*q.info, q.name, q.params);
+            }
+            pipeline->running = groups;
+            if (cores) {
+                run_on_cores(pipeline);
+                return;
+            }
+            ++statistics::repl::parallel_pipelines;
+            statistics::repl::parallel_requests += pipeline->requests.size();
+            auto self(this->shared_from_this());
+            for (size_t g = 0; g < groups; ++g) {
+                asio::post(workers, [this, self, pipeline, g]() {
+                    run_group(*pipeline, pipeline->groups[g]);
+                    if (--pipeline->running == 0) {
+                        asio::post(socket_.get_executor(), [this, self, pipeline]() {
+                            fanned_done(pipeline);
+                        });
+                    }
+                });
+            }
+        }
+        /**
+         * Started per core, each group goes to the core that owns its shards, through the
+         * mailbox from this core to that one, and its replies come back through the one
+         * the other way. The group this core owns is run here once the others are on
+         * their way. Everything that counts groups down runs on this core, so the last
+         * one to arrive is the one that carries on.
+         */
+        void run_on_cores(const fanned_pipeline_ptr& pipeline) {
+            auto self(this->shared_from_this());
+            fanned_group* own = nullptr;
+            for (size_t g = 0; g < pipeline->groups.size(); ++g) {
+                auto& group = pipeline->groups[g];
+                if (group.owner == core) {
+                    own = &group;
+                    continue;
+                }
+                statistics::repl::core_forwarded_requests += group.requests.size();
+                cores->send(core, group.owner, [this, self, pipeline, g]() {
+                    auto& theirs = pipeline->groups[g];
+                    run_group(*pipeline, theirs);
+                    cores->send(theirs.owner, core, [this, self, pipeline]() {
+                        if (--pipeline->running == 0)
+                            fanned_done(pipeline);
+                    });
+                });
+            }
+            if (own) {
+                run_group(*pipeline, *own);
+                if (--pipeline->running == 0) {
+                    asio::post(socket_.get_executor(), [this, self, pipeline]() {
+                        fanned_done(pipeline);
+                    });
+                }
+            }
+        }
+        /** one group's requests, in order, each reply kept where fanned_done finds it */
+        static void run_group(fanned_pipeline& pipeline, fanned_group& group) {
+            for (auto at : group.requests) {
+                auto& q = pipeline.requests[at];
+                q.begin = group.out.buf.size();
+                group.caller.reply_out = &group.out;
+                int32_t r = group.caller.call(q.params, q.info->call, &q.logged);
+                group.caller.reply_out = nullptr;
+                write_result(group.caller, group.out, r);
+                q.end = group.out.buf.size();
+                q.logged = {};
+            }
+        }
+        void fanned_done(const fanned_pipeline_ptr& pipeline) {
+            for (const auto& q : pipeline->requests) {
+                const auto& out = pipeline->groups[q.group].out;
+                stream.write((const char*) out.buf.data() + q.begin, q.end - q.begin);
+            }
+            // the rest of what was read, starting with the request that ended the run
+            if (!consume_more()) {
+                do_write(stream);
+                do_read();
+            }
+        }
+
+        // plain sockets can be waited on without reading, so an idle connection waits
+        // holding no buffer. ssl has to read to know, and a ring reads for us
+        static constexpr bool waits_unbuffered = std::is_same_v<TSock, tcp::socket> || std::is_same_v<TSock, local_socket>;
 
-                        if (!consume_available()) {
-                            do_write(stream);
+        /**
+         * Reads go straight into the parser's buffer, which comes from the shared pool.
+         * A connection with nothing half read gives it back before it waits, so idle
+         * connections cost no buffer at all. The read size follows the traffic: a read
+         * that fills what it was given doubles the next one, up to rpc_max_buffer, and
+         * one that uses less than a quarter of it halves it.
+         */
+        // the async call context needs to stay alive while calls complete
+        void do_read() {
+            if constexpr (waits_unbuffered) {
+                parser.release();
+                socket_.async_wait(TSock::wait_read,
+                    [this](std::error_code ec)// NOTE: the self shared pointers can cause noticeable cpu usage so we keep the session afloat elsewhere
+                {
+                    if (ec) {
+                        on_read(ec, 0);
+                        return;
+                    }
+                    char* into = parser.prepare(read_size);
+                    ssize_t length = ::recv(socket_.native_handle(), into, read_size, MSG_DONTWAIT);
+                    if (length < 0) {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
                             do_read();
+                            return;
                         }
+                        on_read(std::error_code(errno, std::system_category()), 0);
+                        return;
+                    }
+                    if (length == 0) {
+                        on_read(asio::error::eof, 0);
+                        return;
+                    }
+                    on_read({}, (size_t) length);
+                });
+            } else {
+                char* into = parser.prepare(read_size);
+                socket_.async_read_some(asio::buffer(into, read_size),
+                    [this](std::error_code ec, std::size_t length)// NOTE: the self shared pointers can cause noticeable cpu usage so we keep the session afloat elsewhere
+                {
+                    on_read(ec, length);
+                });
+            }
+        }
 
-                    }catch (std::exception& e) {
-                        barch::err({"error", e.what()});
+        void on_read(std::error_code ec, size_t length) {
+            if (!ec){
+                bytes_recv += length;
+                parser.commit(length);
+                if (length == read_size) {
+                    read_size = std::min<size_t>(read_size * 2, std::max<size_t>(read_limit, rpc_read_buffer_min));
+                } else if (length < read_size / 4) {
+                    read_size = std::max<size_t>(read_size / 2, rpc_read_buffer_min);
+                }
+                read_peak = std::max(read_peak, read_size);
+
+                try {
+
+                    if (!consume_available()) {
+                        do_write(stream);
+                        do_read();
                     }
-                }else {
-                    if (caller.has_blocks())
-                        erase_blocks();
-                    //if (ec.category())
-                     //barch::err({ec.message().c_str()});
+
+                }catch (std::exception& e) {
+                    barch::err({"error", e.what()});
                 }
-            });
+            }else {
+                if (caller.has_blocks())
+                    erase_blocks();
+                //if (ec.category())
+                 //barch::err({ec.message().c_str()});
+            }
         }
 
         void start_block_to() {
@@ -326,16 +638,45 @@ namespace barch {
         /** parse already-buffered requests. true if the connection is parked. */
         bool consume_available() {
             stream.clear();
+            return consume_more();
+        }
+        /**
+         * the body of consume_available, which a pipeline run a shard at a time picks up
+         * again once its replies are in the stream. Single key requests are kept back
+         * while they come in a run; a run long enough goes to the workers, and anything
+         * shorter is run here as it always was. Started per core, a run goes to the
+         * cores that own its shards whenever one of them is not this one.
+         */
+        bool consume_more() {
             heap::vector<asynch_call_context_ptr> asynch_calls;
-            while (parser.remaining() > 0) {
-                auto &params = parser.read_new_request();
-                if (params.empty())
-                    break;
-                ++calls_recv;
-                run_params(stream, params, asynch_calls);
+            while (!carried.empty() || parser.remaining() > 0) {
+                if (carried.empty()) {
+                    auto &params = parser.read_new_request();
+                    if (params.empty())
+                        break;
+                    ++calls_recv;
+                    if (asynch_calls.empty() && collect(params))
+                        continue;
+                    if (worth_fanning()) {
+                        carried = params;
+                        run_fanned();
+                        return true;
+                    }
+                    run_collected(asynch_calls);
+                    run_params(stream, params, asynch_calls);
+                } else {
+                    auto params = std::move(carried);
+                    carried.clear();
+                    run_params(stream, params, asynch_calls);
+                }
                 if (caller.has_blocks())
                     break;
             }
+            if (worth_fanning()) {
+                run_fanned();
+                return true;
+            }
+            run_collected(asynch_calls);
             if (!asynch_calls.empty()) {
                 auto batch = std::make_shared<heap::vector<asynch_call_context_ptr>>(
                     std::move(asynch_calls));
@@ -396,14 +737,85 @@ namespace barch {
                 drain_stream(stream);
                 return write_socket_now(data, n);
             };
+            caller.peer_closed_check = [this]() -> bool {
+                return peer_closed_now();
+            };
+            caller.send_vectored = [this](const iovec* iov, size_t n) -> ssize_t {
+                return send_now(iov, n);
+            };
+        }
+        /**
+         * A large GET value goes from the leaf to the socket through here, so it is not
+         * copied into the reply stream on the way. The leaf is only held in place while
+         * the call runs, so this must not block: it sends what the socket will take now
+         * and leaves the caller to copy the rest. It must not overtake a write that is
+         * still out either, so it declines while there is one. Over ssl the bytes have
+         * to be encrypted first, so it always declines.
+         */
+        ssize_t send_now(const iovec* iov, size_t n) {
+            if constexpr (std::is_same_v<TSock, ssl_stream>) {
+                return -1;
+            } else {
+                if (writes_out > 0) return -1;
+                std::lock_guard lk(socket_write_mutex);
+                msghdr msg{};
+                msg.msg_iov = const_cast<iovec*>(iov);
+                msg.msg_iovlen = n;
+                ssize_t sent = ::sendmsg(socket_.lowest_layer().native_handle(), &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (sent < 0) {
+                    // full is not a failure, it only means everything is copied
+                    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+                }
+                net_stat stat;
+                stream_write_ctr += sent;
+                bytes_sent += sent;
+                return sent;
+            }
+        }
+        /**
+         * Whether the client has gone, without reading anything off the socket. Reading
+         * is suspended while a KEYS runs, so the hangup would otherwise only be noticed
+         * once the reply is written. A client that shuts its sending side counts as
+         * gone, as it does for redis, which drops a connection on end of file.
+         */
+        bool peer_closed_now() {
+            pollfd pfd{};
+            pfd.fd = socket_.lowest_layer().native_handle();
+#ifdef POLLRDHUP
+            pfd.events = POLLRDHUP;
+#endif
+            if (::poll(&pfd, 1, 0) <= 0) return false;
+            short gone = POLLHUP | POLLERR | POLLNVAL;
+#ifdef POLLRDHUP
+            gone |= POLLRDHUP;
+#endif
+            return (pfd.revents & gone) != 0;
         }
 
-        void do_write(const vector_stream& local_stream) {
+        /**
+         * The replies are swapped out of the session's stream into a spare one that the
+         * write keeps until it completes, so the session can encode the next batch while
+         * they are still going out. asio mostly has them sent before async_write returns,
+         * a ring only reads them once the kernel gets to the send. Spares are handed back
+         * with their buffers, so this allocates nothing once a connection is warm.
+         */
+        void do_write(vector_stream& local_stream) {
 
             if (local_stream.empty()) return;
 
-            asio::async_write(socket_, asio::buffer(local_stream.buf),
-                [this](std::error_code ec, std::size_t length){ // NOTE: the self shared pointers can cause noticeable cpu usage so we keep the session afloat elsewhere
+            std::shared_ptr<vector_stream> out;
+            if (spare_streams.empty()) {
+                out = std::make_shared<vector_stream>();
+            } else {
+                out = std::move(spare_streams.back());
+                spare_streams.pop_back();
+            }
+            std::swap(out->buf, local_stream.buf);
+            std::swap(out->pos, local_stream.pos);
+            ++writes_out;
+            asio::async_write(socket_, asio::buffer(out->buf),
+                [this, out](std::error_code ec, std::size_t length) mutable { // NOTE: the self shared pointers can cause noticeable cpu usage so we keep the session afloat elsewhere
+                    --writes_out;
                     if (!ec){
                         net_stat stat;
                         stream_write_ctr += length;
@@ -411,6 +823,9 @@ namespace barch {
                     }else {
                         //art::err({"error", ec.message(), ec.value()});
                     }
+                    out->clear();
+                    if (spare_streams.size() < max_spare_streams)
+                        spare_streams.push_back(std::move(out));
                 });
         }
         typedef std::shared_ptr<heap::vector<asynch_call_context_ptr>> asynch_batch_ptr;
@@ -442,7 +857,7 @@ namespace barch {
                 auto fn = barch_functions->find(ctx->cn); // not `ic`: that is a member
                 if (fn != barch_functions->end()) {
                     auto current = now();
-                    int32_t r = ctx->caller.call(ctx->params, fn->second.call);
+                    int32_t r = ctx->caller.call(ctx->params, fn->second.call, &ctx->logged);
                     // a call that registered a block has no answer yet, exactly as on
                     // the synchronous path - the reply is written when it resolves
                     if (!ctx->caller.has_blocks())
@@ -504,8 +919,10 @@ namespace barch {
                 then();
                 return;
             }
+            ++writes_out;
             asio::async_write(socket_, asio::buffer(out->buf),
                 [this, out, then](std::error_code ec, std::size_t length){
+                    --writes_out;
                     if (!ec){
                         net_stat stat;
                         stream_write_ctr += length;
@@ -523,8 +940,10 @@ namespace barch {
                 then();
                 return;
             }
+            ++writes_out;
             asio::async_write(socket_, asio::buffer(ctx->stream.buf),
                 [this, ctx, then](std::error_code ec, std::size_t length){
+                    --writes_out;
                     if (!ec){
                         net_stat stat;
                         stream_write_ctr += length;
@@ -537,8 +956,10 @@ namespace barch {
         void do_write(asynch_call_context_ptr ctx) {
             if (ctx->stream.empty()) return;
 
+            ++writes_out;
             asio::async_write(socket_, asio::buffer(ctx->stream.buf),
                 [this, ctx](std::error_code ec, std::size_t length){ // NOTE: the self shared pointers can cause noticeable cpu usage so we keep the session afloat elsewhere
+                    --writes_out;
                     if (!ec){
                         net_stat stat;
                         stream_write_ctr += length;
@@ -551,17 +972,34 @@ namespace barch {
     public:
         TSock socket_;
     private:
-        char data_[rpc_io_buffer_size];
         redis::redis_parser parser{};
+        // what the next read asks for, the most it has asked for, and the most it may
+        size_t read_size{rpc_read_buffer_min};
+        size_t read_peak{rpc_read_buffer_min};
+        size_t read_limit{barch::get_rpc_max_buffer()};
         rpc_caller caller{};
         vector_stream stream{};
+        // streams do_write handed to the socket and got back, each keeping its buffer
+        static constexpr size_t max_spare_streams = 2;
+        heap::vector<std::shared_ptr<vector_stream>> spare_streams{};
         std::mutex socket_write_mutex{};
+        // async writes started and not completed. write_then is started from workers
+        std::atomic<uint32_t> writes_out{0};
         // an asynchronous batch that stopped on a blocking command, and how far it got.
         // Set while the chain is suspended and cleared as it is picked back up.
         asynch_batch_ptr pending_batch{};
         size_t pending_at{0};
         std::string prev_cn{};
         function_map::iterator ic{};
+        // single key requests kept back to be run a shard at a time, and the request
+        // that ended their run, which goes next once they are done
+        fanned_pipeline_ptr fanned{};
+        std::vector<redis::string_param_t> carried{};
+        std::string fan_cn{};
+        function_map::iterator fan_fn{};
+        // set on a server started per core: all of its cores, and the one this is on
+        std::shared_ptr<shard_cores> cores{};
+        size_t core{0};
         uint64_t id = ++client_id;
         uint64_t bytes_recv = 0;
         uint64_t bytes_sent = 0;
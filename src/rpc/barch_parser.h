@@ -55,57 +55,60 @@ namespace barch {
             return in.buf.size() - in.pos;
         }
         /**
-         *
+         * run every complete call that has arrived. A frame carries `calls` commands and
+         * the replicating side keeps several frames on the wire at once, so one read can
+         * hold the tail of one frame, a few whole ones and the head of the next. Each
+         * call gets its own reply, in order, which is what the sender matches its acks on.
          * @return true if someting needs to be written
          */
         bool process(vector_stream& out) {
+            bool wrote = false;
             while (remaining() > 0) {
                 switch (state) {
                     case barch_wait_for_header:
-                        if (remaining() >= header_size) {
-                            readp(in,calls);
-                            if (1 != calls) {
-                                return false; // nothing to do - wait for more data
-                            }
-                            c = 0;
-                            buffers_size = 0;
-                            state = barch_wait_for_buffer_size;
+                        if (remaining() < header_size) {
+                            compact();
+                            return wrote; // nothing to do - wait for more data
+                        }
+                        readp(in,calls);
+                        if (calls == 0 || calls > rpc_max_batch_calls) {
+                            barch::err({"invalid call count", calls});
+                            clear();
+                            return wrote;
                         }
+                        c = 0;
+                        buffers_size = 0;
+                        state = barch_wait_for_buffer_size;
                         break;
                     case barch_wait_for_buffer_size:
-                        if (c < calls) {
-                            if (remaining() < sizeof(buffers_size)) {
-                                return false; // nothing to do - wait for more data
-                            }
-                            readp(in,buffers_size);
-                            if (buffers_size == 0) {
-                                barch::err({"invalid buffer size", buffers_size});
-                                clear();
-                                return false;
-                            }
-                            if (buffer.size() < buffers_size) {
-                                buffer.resize(buffers_size);
-                            }
-                            state = barch_wait_for_buffer;
-                        }else {
-                            state = barch_wait_for_header;
-                            if (remaining()  >= in.buf.size())
-                                return false;
+                        if (remaining() < sizeof(buffers_size)) {
+                            compact();
+                            return wrote; // nothing to do - wait for more data
                         }
+                        readp(in,buffers_size);
+                        if (buffers_size == 0) {
+                            barch::err({"invalid buffer size", buffers_size});
+                            clear();
+                            return wrote;
+                        }
+                        if (buffer.size() < buffers_size) {
+                            buffer.resize(buffers_size);
+                        }
+                        state = barch_wait_for_buffer;
                         break;
                     case barch_wait_for_buffer:{
                         // wait for input buffer to reach a target
                         if (remaining() < buffers_size) {
-                            return false; // nothing to do - wait for more data
+                            compact();
+                            return wrote; // nothing to do - wait for more data
                         }
                         readp(in, buffer.data(), buffers_size);
                         int32_t r = 0;
+                        replies.clear();
                         if (buffers_size > rpc_max_param_buffer_size) {
                             r = -1;
-                            replies.clear();
                             push_value(replies, error{"parameter buffer too large"});
                         }else {
-                            // TODO: max buffer size check
                             auto bf = barch_functions; // take a snapshot
                             std::vector<std::string_view> params;
                             for (size_t i = 0; i < buffers_size;) {
@@ -116,23 +119,24 @@ namespace barch {
                             std::string cn = std::string{params[0]};
                             auto ic = bf->find(cn);
                             if (ic == bf->end()) {
+                                // still a reply of its own: the sender counts replies to
+                                // match them to frames, so a call cannot go unanswered
                                 barch::err({"invalid call", cn});
-                                writep(out, replies_size);
-                                clear();
-                                return true;
-                            }
-                            auto f = ic->second.call;
-                            ++ic->second.calls;
-                            ++statistics::repl::barch_requests;
-                            r = caller.call(params,f);
-                            replies.clear();
-                            // the barch protocol carries a flat list of values, so an
-                            // array reply is unwrapped here rather than sent nested
-                            for (size_t i = 0, n = caller.flat_size(); i < n; ++i) {
-                                push_value(replies,caller.flat_at(i));
-                            }
-                            for (auto &v: caller.errors) {
-                                push_value(replies,v);
+                                r = -1;
+                                push_value(replies, error{"unknown command"});
+                            }else {
+                                auto f = ic->second.call;
+                                ++ic->second.calls;
+                                ++statistics::repl::barch_requests;
+                                r = caller.call(params,f);
+                                // the barch protocol carries a flat list of values, so an
+                                // array reply is unwrapped here rather than sent nested
+                                for (size_t i = 0, n = caller.flat_size(); i < n; ++i) {
+                                    push_value(replies,caller.flat_at(i));
+                                }
+                                for (auto &v: caller.errors) {
+                                    push_value(replies,v);
+                                }
                             }
                         }
 
@@ -140,27 +144,37 @@ namespace barch {
                         writep(out, r);
                         writep(out, replies_size);
                         writep(out, replies.data(), replies_size);
+                        wrote = true;
                         ++c;
                         if (c < calls) {
-                            state = barch_wait_for_buffer;
+                            state = barch_wait_for_buffer_size;
                         }else {
                             state = barch_wait_for_header;
-                            buffers_size = 0;
-                        }
-
-                        if (remaining() <= 0) {
-                            in.clear();
-                            return true;
                         }
-
+                        buffers_size = 0;
                     }
                         break;
                     default:
                         barch::err({"invalid state", state});
-                        break;
+                        clear();
+                        return wrote;
                 }
             }
-            return false; // consumed all data but no action could be taken
+            in.clear();
+            return wrote;
+        }
+        /**
+         * drop what has been read already. A pipelining sender rarely lets the input run
+         * dry, so without this the buffer would only ever grow
+         */
+        void compact() {
+            if (in.pos == 0) return;
+            if (in.pos >= in.buf.size()) {
+                in.clear();
+                return;
+            }
+            in.buf.erase(in.buf.begin(), in.buf.begin() + (ptrdiff_t)in.pos);
+            in.pos = 0;
         }
         void add_data(const uint8_t *data, size_t length) {
             in.buf.insert(in.buf.end(),data,data+length);
@@ -8,7 +8,11 @@
 #include "statistics.h"
 #include "vector_stream.h"
 #include "asio_includes.h"
+#include "buffer_pool.h"
+#include "constants.h"
+#include <cerrno>
 #include <memory>
+#include <sys/socket.h>
 
 namespace barch {
     template<typename Proto>
@@ -32,22 +36,35 @@ namespace barch {
         }
 
     private:
+        /**
+         * wait until there is something to read before borrowing a buffer to read it
+         * into, so an idle peer holds none. The parser keeps what it needs of it
+         */
         void do_read()
         {
             auto self(this->shared_from_this());
-            socket_.async_read_some(asio::buffer(data_, rpc_io_buffer_size),
-                [this, self](std::error_code ec, std::size_t length)
+            socket_.async_wait(Proto::socket::wait_read,
+                [this, self](std::error_code ec)
             {
 
                 if (!ec){
+                    auto data = buffer_pool::take(rpc_io_buffer_size);
+                    ssize_t length = ::recv(socket_.native_handle(), data.data(), data.capacity(), MSG_DONTWAIT);
+                    if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                        do_read();
+                        return;
+                    }
+                    if (length <= 0) {
+                        return;
+                    }
                     stream_read_ctr += length;
-                    parser.add_data(data_, length);
+                    parser.add_data(data.data(), (size_t) length);
+                    data.release();
                     try {
-                        vector_stream out;
-                        parser.process(out);
-                        if (out.tellg() > 0) {
-                            do_write(out);
-                            do_read();
+                        auto out = std::make_shared<vector_stream>();
+                        parser.process(*out);
+                        if (out->tellg() > 0) {
+                            do_write(out); // reads again once the replies are out
                         }else {
                             do_read();
                         }
@@ -59,19 +76,23 @@ namespace barch {
                 }
             });
         }
-
-        void do_write(const vector_stream& stream) {
+        /**
+         * the replies have to outlive the write, and the next read waits for it. A
+         * replicating peer keeps frames coming without waiting, so reading while a
+         * write is still out would put two reads on the socket
+         */
+        void do_write(std::shared_ptr<vector_stream> out) {
             auto self(this->shared_from_this());
 
-            asio::async_write(socket_, asio::buffer(stream.buf),
-                [this, self](std::error_code ec, std::size_t /*length*/){
+            asio::async_write(socket_, asio::buffer(out->buf),
+                [this, self, out](std::error_code ec, std::size_t length){
                     if (!ec){
+                        stream_write_ctr += length;
                         do_read();
                     }
                 });
         }
         Proto::socket socket_;
-        uint8_t data_[rpc_io_buffer_size]{};
         barch_parser parser{};
     };
 }
@@ -0,0 +1,101 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "buffer_pool.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "sastam.h"
+
+namespace barch {
+    pooled_buffer& pooled_buffer::operator=(pooled_buffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            bytes = other.bytes;
+            size = other.size;
+            other.bytes = nullptr;
+            other.size = 0;
+        }
+        return *this;
+    }
+
+    void pooled_buffer::release() {
+        if (!bytes)
+            return;
+        buffer_pool::give(bytes, size);
+        bytes = nullptr;
+        size = 0;
+    }
+
+    namespace buffer_pool {
+        struct size_class {
+            std::mutex lock{};
+            std::vector<uint8_t*> free{};
+        };
+        static constexpr size_t class_count = 9; // buffer_pool_min << 8 == buffer_pool_max
+        static_assert(((size_t) buffer_pool_min << (class_count - 1)) == buffer_pool_max);
+
+        static std::array<size_class, class_count>& classes() {
+            static std::array<size_class, class_count> c{};
+            return c;
+        }
+        static std::atomic<uint64_t> lent_bytes{0};
+        static std::atomic<uint64_t> pooled_bytes{0};
+        static std::atomic<uint64_t> taken{0};
+        static std::atomic<uint64_t> reused{0};
+
+        static size_t class_of(size_t capacity) {
+            size_t c = 0;
+            while (((size_t) buffer_pool_min << c) < capacity)
+                ++c;
+            return c;
+        }
+
+        pooled_buffer take(size_t n) {
+            ++taken;
+            if (n > buffer_pool_max) {
+                lent_bytes += n;
+                return {heap::allocate<uint8_t>(n), n};
+            }
+            size_t c = class_of(std::max<size_t>(n, buffer_pool_min));
+            size_t capacity = (size_t) buffer_pool_min << c;
+            lent_bytes += capacity;
+            auto& sc = classes()[c];
+            {
+                std::lock_guard lk(sc.lock);
+                if (!sc.free.empty()) {
+                    uint8_t* bytes = sc.free.back();
+                    sc.free.pop_back();
+                    pooled_bytes -= capacity;
+                    ++reused;
+                    return {bytes, capacity};
+                }
+            }
+            return {heap::allocate<uint8_t>(capacity), capacity};
+        }
+
+        void give(uint8_t* bytes, size_t capacity) {
+            lent_bytes -= capacity;
+            if (capacity > buffer_pool_max || pooled_bytes + capacity > buffer_pool_retain) {
+                heap::free(bytes, capacity);
+                return;
+            }
+            auto& sc = classes()[class_of(capacity)];
+            std::lock_guard lk(sc.lock);
+            sc.free.push_back(bytes);
+            pooled_bytes += capacity;
+        }
+
+        usage get_usage() {
+            return {lent_bytes.load(), pooled_bytes.load(), taken.load(), reused.load()};
+        }
+
+        void reset() {
+            taken = 0;
+            reused = 0;
+        }
+    }
+}
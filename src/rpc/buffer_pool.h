@@ -0,0 +1,79 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_BUFFER_POOL_H
+#define BARCH_BUFFER_POOL_H
+#include <cstddef>
+#include <cstdint>
+
+namespace barch {
+    /**
+     * A buffer on loan from the pool, given back when it goes. Only the capacity is
+     * kept: what part of it is in use is the borrower's business.
+     */
+    class pooled_buffer {
+    public:
+        pooled_buffer() = default;
+        pooled_buffer(uint8_t* bytes, size_t capacity) : bytes(bytes), size(capacity) {}
+        pooled_buffer(const pooled_buffer&) = delete;
+        pooled_buffer& operator=(const pooled_buffer&) = delete;
+        pooled_buffer(pooled_buffer&& other) noexcept : bytes(other.bytes), size(other.size) {
+            other.bytes = nullptr;
+            other.size = 0;
+        }
+        pooled_buffer& operator=(pooled_buffer&& other) noexcept;
+        ~pooled_buffer() {
+            release();
+        }
+        [[nodiscard]] uint8_t* data() const {
+            return bytes;
+        }
+        [[nodiscard]] size_t capacity() const {
+            return size;
+        }
+        [[nodiscard]] bool empty() const {
+            return bytes == nullptr;
+        }
+        /** back to the pool now rather than when this goes */
+        void release();
+    private:
+        uint8_t* bytes{nullptr};
+        size_t size{0};
+    };
+
+    /**
+     * The buffers connections read and parse requests into, shared by all of them.
+     *
+     * A connection only holds one while it has something half read, so a server with
+     * thousands of idle clients holds none for them. Sizes are powers of two from
+     * buffer_pool_min to buffer_pool_max, each with its own free list, and a buffer
+     * given back stays in the pool while the pool is under buffer_pool_retain bytes.
+     * Anything larger than buffer_pool_max - a request carrying a multi megabyte value -
+     * is allocated for the occasion and freed when it is given back.
+     */
+    namespace buffer_pool {
+        enum {
+            buffer_pool_min = 1024 * 4,
+            buffer_pool_max = 1024 * 1024,
+            buffer_pool_retain = 1024 * 1024 * 64,
+        };
+        /** a buffer of at least n bytes */
+        pooled_buffer take(size_t n);
+        /** for pooled_buffer only */
+        void give(uint8_t* bytes, size_t capacity);
+
+        struct usage {
+            // bytes lent to connections, and bytes waiting in the pool
+            uint64_t lent_bytes{0};
+            uint64_t pooled_bytes{0};
+            // buffers handed out, and how many of those came out of the pool
+            uint64_t taken{0};
+            uint64_t reused{0};
+        };
+        usage get_usage();
+        /** CONFIG RESETSTAT: the counters, not what is lent or pooled */
+        void reset();
+    }
+}
+#endif //BARCH_BUFFER_POOL_H
@@ -6,10 +6,39 @@
 #define BARCH_CONSTANTS_H
 // constants for rpc
 enum {
-    rpc_server_version = 21,
+    rpc_server_version = 22,
     rpc_max_param_buffer_size = 1024 * 1024 * 10,
     asynch_proccess_workers = 4,
     rpc_io_buffer_size = 1024 * 32,
+    // the first read a connection makes, and the smallest it shrinks back to. Busy
+    // connections grow theirs up to the rpc_max_buffer setting
+    rpc_read_buffer_min = 1024 * 4,
     debug_repl = 0,
+    // replication framing: how many commands go in one frame, a soft cap on the bytes
+    // in one frame, and how many frames may be on the wire before the first ack
+    rpc_max_batch_calls = 512,
+    rpc_max_batch_bytes = 1024 * 1024,
+    rpc_repl_window = 8,
+    // io_uring backend: submission queue entries per ring, the receive buffers each
+    // ring provides the kernel and their size, the connections whose sockets can be
+    // registered with a ring, and how much a connection may have received and not
+    // read before its receive is cancelled until it catches up
+    uring_ring_entries = 4096,
+    uring_buffer_count = 1024,
+    uring_buffer_size = 1024 * 16,
+    uring_fixed_files = 4096,
+    uring_max_unread = 1024 * 256,
+    // a bulk reply at least this large is sent from the leaf rather than copied into
+    // the reply stream first
+    reply_scatter_min = 1024 * 16,
+    // a pipeline run of at least this many single key requests is split into groups
+    // of shards and run on the workers, in at most this many groups
+    pipeline_parallel_min = 64,
+    pipeline_parallel_groups = asynch_proccess_workers,
+    // a server started per core: the tasks one core can have waiting for another
+    // before it posts them instead
+    core_mailbox_size = 1024,
+    // the most cores START ... CORES count may ask for. Each pair of cores has a mailbox
+    core_count_max = 64,
 };
 #endif //BARCH_CONSTANTS_H
\ No newline at end of file
@@ -97,9 +97,13 @@ namespace redis {
         item.size = 2;
 
         for (ptrdiff_t i = 2; i < end; i++) {
-            const auto* d = (const uint8_t*) memchr(&item.bytes[i-2],'\r',end);
+            // only as far as what was received: a pooled buffer has no terminator after it
+            const auto* d = (const uint8_t*) memchr(&item.bytes[i-2],'\r',rem - (i-2));
             if (d == nullptr) break;
             i += (d - &item.bytes[i-2]);
+            // a '\r' that is the last byte received is followed by whatever the buffer
+            // held before, which is not what the client sent
+            if (i - 1 >= rem) break;
             if (item.bytes[i-2] == '\r' &&
                 item.bytes[i-1] == '\n') {
                 item.size = i;
@@ -112,24 +116,71 @@ namespace redis {
         return false;
     }
 
+    bool redis_parser::between_requests() const {
+        return state == state_start && item_nr == 0 && buffer_start >= buffer_size;
+    }
+
     void redis_parser::add_data(const char * data, size_t len) {
+        if (!len) return;
+        memcpy(prepare(len), data, len);
+        commit(len);
+    }
+
+    char* redis_parser::prepare(size_t n) {
         // only drop a consumed buffer between requests. a partial parse
         // holds offsets into full_buffer, so clearing here used to make
         // params[0] a slice of the next packet
-        if (state == state_start && item_nr == 0 && buffer_start >= buffer_size) {
+        if (between_requests()) {
             buffer_start = 0;
-            full_buffer.clear();
             buffer_size = 0;
+            request_start = 0;
         }
-        full_buffer.append(data, len);
-        buffer_size += len;
+        if (buffer_size + n > full_buffer.capacity() && request_start > 0) {
+            // a pipeline that never ends on a request boundary would otherwise grow
+            // the buffer for as long as it keeps coming
+            compact();
+        }
+        if (buffer_size + n > full_buffer.capacity()) {
+            // offsets survive the move, pointers would not - see spans
+            auto larger = barch::buffer_pool::take(std::max(buffer_size + n, full_buffer.capacity() * 2));
+            if (buffer_size)
+                memcpy(larger.data(), full_buffer.data(), buffer_size);
+            full_buffer = std::move(larger);
+        }
+        return (char*) full_buffer.data() + buffer_size;
+    }
+
+    void redis_parser::compact() {
+        size_t from = request_start;
+        auto* base = full_buffer.data();
+        memmove(base, base + from, buffer_size - from);
+        buffer_size -= from;
+        buffer_start -= from;
+        for (int i = 0; i < item_nr; ++i) {
+            if (spans[(size_t)i].first != k_null_bulk)
+                spans[(size_t)i].first -= (uint32_t)from;
+        }
+        request_start = 0;
+    }
+
+    void redis_parser::commit(size_t n) {
+        buffer_size += n;
         max_buffer_size = std::max(buffer_size,max_buffer_size);
     }
+
+    void redis_parser::release() {
+        if (!between_requests())
+            return;
+        buffer_start = 0;
+        buffer_size = 0;
+        request_start = 0;
+        full_buffer.release();
+    }
     size_t redis_parser::remaining() const {
         return std::max(buffer_size, buffer_start) - buffer_start; //buffer.size();
     }
     std::string_view redis_parser::read_next_item() {
-        auto item = art::value_type{full_buffer.data() + buffer_start, 0};
+        auto item = art::value_type{(const char*) full_buffer.data() + buffer_start, 0};
         if(!buffer_get_valid_item(item)) {
             if (item.size > redis_max_item_len) {
                 throw_exception<std::domain_error>("item exceeds maximum length");
@@ -139,7 +190,7 @@ namespace redis {
         return std::string_view{item.chars(),item.size};
     }
     std::string_view redis_parser::read_next_item(ptrdiff_t hint) {
-        auto item = art::value_type{full_buffer.data() + buffer_start, 0};
+        auto item = art::value_type{(const char*) full_buffer.data() + buffer_start, 0};
         if(!buffer_get_valid_item(item, hint)) {
             if (item.size > redis_max_item_len) {
                 throw_exception<std::domain_error>("item exceeds maximum length");
@@ -220,6 +271,7 @@ namespace redis {
             // Assumes each RESP request is an array of bulk strings
             switch (state) {
                 case state_start: {
+                    request_start = buffer_start;
                     arr_size_item = read_next_item();
                     if (arr_size_item.empty()) {
                         return empty;
@@ -244,7 +296,7 @@ namespace redis {
                 case state_bstr: {
                     if (item_nr >= size) {
                         req.resize((size_t)size);
-                        const char* base = full_buffer.data();
+                        const char* base = (const char*) full_buffer.data();
                         for (int i = 0; i < size; ++i) {
                             auto [off, len] = spans[(size_t)i];
                             if (off == k_null_bulk)
@@ -297,7 +349,7 @@ namespace redis {
                         throw_exception<std::domain_error>("Bulk string size does not match");
                     }
                     *(char*)(bstr.data()+bstr.size()) = 0x00;
-                    auto off = (uint32_t)(bstr.data() - full_buffer.data());
+                    auto off = (uint32_t)(bstr.data() - (const char*) full_buffer.data());
                     spans[(size_t)item_nr] = {off, (uint32_t)bstr.length()};
                     ++item_nr;
 
@@ -12,6 +12,7 @@
 #include "variable.h"
 #include "ioutil.h"
 #include "sastam.h"
+#include "buffer_pool.h"
 
 namespace redis {
     // views into the recv buffer for the request being run. they are only
@@ -35,14 +36,31 @@ namespace redis {
     public:
         redis_parser() = default;
         void init(char cs){
-            full_buffer=cs;
-            buffer_size=1;
+            *prepare(1) = cs;
+            commit(1);
         };
         void add_data(const char * data, size_t len);
+        /**
+         * room for n more bytes at the end of what has been received, to read into
+         * directly. commit says how many of them were
+         */
+        char* prepare(size_t n);
+        void commit(size_t n);
+        /**
+         * give the buffer back to the pool if nothing in it is waiting to be parsed. The
+         * views read_new_request handed out go with it
+         */
+        void release();
         [[nodiscard]] size_t remaining() const ;
         const std::vector<string_param_t>& read_new_request();
         size_t get_max_buffer_size() const;
+        /** what the buffer can hold, 0 while it is with the pool */
+        [[nodiscard]] size_t get_buffer_capacity() const {
+            return full_buffer.capacity();
+        }
     private:
+        [[nodiscard]] bool between_requests() const;
+        void compact();
         int state = 0;
         int size = 0;
         std::vector<string_param_t> req{};
@@ -52,11 +70,13 @@ namespace redis {
         int item_nr = 0;
         int32_t bstr_size = 0;
         size_t buffer_start = 0l;
+        // where the request being parsed starts. Everything before it has been answered
+        size_t request_start = 0l;
         size_t buffer_size = 0l;
         size_t max_buffer_size = 0l;
         size_t parameters_processed = 0l;
         size_t messages_processed = 0l;
-        std::string full_buffer{};
+        barch::pooled_buffer full_buffer{};
         std::string_view arr_size_item{};
         std::string_view bstr_item{};
         std::string_view bstr_size_item{};
@@ -72,14 +92,18 @@ namespace redis {
         auto r = std::to_chars(buf, buf + sizeof(buf), n);
         writep(io, buf, (size_t)(r.ptr - buf));
     }
-    template<typename TS>
-    inline void rwrite_bulk(TS& io, const char* data, size_t len) {
-        char hdr[32];
+    // the `$len\r\n` a bulk string starts with, into hdr. returns its length
+    inline size_t bulk_header(char (&hdr)[32], size_t len) {
         hdr[0] = '$';
         auto r = std::to_chars(hdr + 1, hdr + 30, len);
         *r.ptr++ = '\r';
         *r.ptr++ = '\n';
-        writep(io, hdr, (size_t)(r.ptr - hdr));
+        return (size_t)(r.ptr - hdr);
+    }
+    template<typename TS>
+    inline void rwrite_bulk(TS& io, const char* data, size_t len) {
+        char hdr[32];
+        writep(io, hdr, bulk_header(hdr, len));
         if (len)
             writep(io, data, len);
         writep(io, CRLF);
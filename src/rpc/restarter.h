@@ -7,17 +7,19 @@
 
 struct restarter {
     std::thread restart_thread;
-    void asynch_restart(std::string interface, int port, bool ssl) {
+    void asynch_restart(std::string interface, int port, bool ssl,
+                        barch::server::io_backend backend = barch::server::io_backend::asio,
+                        bool per_core = false, size_t core_count = 0) {
         if (restart_thread.joinable()) {
             restart_thread.join();
         }
-        restart_thread = std::thread([interface, port, ssl]() {
+        restart_thread = std::thread([interface, port, ssl, backend, per_core, core_count]() {
 
             try {
                 barch::server::stop();
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
                 if (!interface.empty() || port > 100)
-                    barch::server::start(interface,port, ssl);
+                    barch::server::start(interface,port, ssl, backend, per_core, core_count);
             }catch (std::exception &e) {
                 barch::err({"could not restart server",e.what()});
             }
@@ -35,11 +37,13 @@ struct restarter {
             }
         });
     }
-    void inline_restart(std::string interface, int port, bool ssl) {
+    void inline_restart(std::string interface, int port, bool ssl,
+                        barch::server::io_backend backend = barch::server::io_backend::asio,
+                        bool per_core = false, size_t core_count = 0) {
         barch::server::stop();
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
         if (!interface.empty() || port > 100)
-            barch::server::start(interface,port, ssl);
+            barch::server::start(interface,port, ssl, backend, per_core, core_count);
     }
     ~restarter() {
         if (restart_thread.joinable()) {
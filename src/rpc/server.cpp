@@ -6,6 +6,10 @@
 #include "lzr_log.h"
 
 
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <type_traits>
 #include <utility>
 #include "module.h"
 #include "statistics.h"
@@ -20,12 +24,14 @@
 #include "thread_pool.h"
 #include "asio_resp_session.h"
 #include "rpc/barch_session.h"
-//#include "uring_resp_session.h"
+#include "uring_resp_session.h"
+#include "shard_cores.h"
 #include "rpc/constants.h"
 
 namespace barch {
     std::atomic<uint64_t> client_id = 0;
     typedef asio::executor_work_guard<asio::io_context::executor_type> exec_guard;
+    typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
     struct asio_work_unit {
         asio::io_context io{};
         exec_guard guard;
@@ -59,7 +65,10 @@ namespace barch {
         asio::io_context workers{};
         exec_guard worker_guard {asio::make_work_guard(workers)};
         std::vector<std::shared_ptr<asio_work_unit>> asio_resp_ios{};
-        //std::vector<std::shared_ptr<uring_work_unit>> uring_resp_ios{};
+#ifdef BARCH_USE_LIBURING
+        // a resp thread runs either an asio unit or a ring, never both
+        std::vector<std::shared_ptr<uring_work_unit>> uring_resp_ios{};
+#endif
 
         Proto::acceptor accept;
         asio::ssl::context ssl_context;
@@ -72,10 +81,21 @@ namespace barch {
         std::atomic<size_t> asio_resp_distributor{};
         std::mutex session_latch;
         bool use_ssl = false;
-        const bool use_uring = false;
+        bool use_uring = false;
+        bool use_sqpoll = false;
+        // started per core: the resp threads are the cores, each accepting on its own
+        // listener, and the accept threads only serve what is not resp
+        bool use_cores = false;
+        std::shared_ptr<shard_cores> cores{};
+        std::vector<std::unique_ptr<typename Proto::acceptor>> core_accept{};
+        std::optional<exec_guard> accept_guard{};
         typedef asio::local::stream_protocol uds;
         std::vector<std::shared_ptr<resp_session<tcp::socket>>> tcp_sessions;
         std::vector<std::shared_ptr<resp_session<uds::socket>>> uds_sessions;
+#ifdef BARCH_USE_LIBURING
+        std::vector<std::shared_ptr<resp_session<uring_socket>>> uring_sessions;
+        heap::unordered_set<size_t> open_pos_uring;
+#endif
         moodycamel::LightweightSemaphore collector_control{};
         moodycamel::LightweightSemaphore collector_exit{};
         heap::unordered_set<size_t> open_pos_tcp;
@@ -104,10 +124,40 @@ namespace barch {
         void register_session(const std::shared_ptr<resp_session<uds::socket>>& session) {
             register_(session,open_pos_uds, uds_sessions);
         }
-        std::shared_ptr<asio_work_unit> get_asio_unit() {
-            size_t r = (asio_resp_distributor % asio_resp_ios.size());
+#ifdef BARCH_USE_LIBURING
+        void register_session(const std::shared_ptr<resp_session<uring_socket>>& session) {
+            register_(session,open_pos_uring, uring_sessions);
+        }
+#endif
+        size_t next_resp_unit() {
+            size_t r = (asio_resp_distributor % asio_resp_pool.size());
             ++asio_resp_distributor;
-            return asio_resp_ios[r];
+            return r;
+        }
+        /**
+         * hand a plain tcp connection to the ring of resp thread `at`, if that thread
+         * runs one. false when it runs asio, and the caller starts an asio session
+         */
+        bool start_uring_session(size_t at, tcp::socket& endpoint, char init_char) {
+#ifdef BARCH_USE_LIBURING
+            if (!use_uring || !uring_resp_ios[at])
+                return false;
+            auto unit = uring_resp_ios[at];
+            tcp::socket socket (unit->io);
+            handle_assign(socket, endpoint);
+            auto session = std::make_shared<resp_session<uring_socket>>(uring_socket(unit, std::move(socket)),workers, init_char);
+            if (cores) session->on_core(cores, at);
+            register_session(session);
+            session->start();
+            return true;
+#else
+            (void)at; (void)endpoint; (void)init_char;
+            return false;
+#endif
+        }
+        template<typename UnkSock>
+        bool start_uring_session(size_t, UnkSock&, char) {
+            return false;
         }
         template<typename Sock_T>
         void collect_sessions(heap::unordered_set<size_t>& open_pos, std::vector<std::shared_ptr<resp_session<Sock_T>>> &sessions) {
@@ -164,13 +214,22 @@ namespace barch {
         void append_client_lines(std::string& out) {
             std::vector<std::shared_ptr<resp_session<tcp::socket>>> tcp_copy;
             std::vector<std::shared_ptr<resp_session<uds::socket>>> uds_copy;
+#ifdef BARCH_USE_LIBURING
+            std::vector<std::shared_ptr<resp_session<uring_socket>>> uring_copy;
+#endif
             {
                 std::lock_guard lock(session_latch);
                 tcp_copy = tcp_sessions;
                 uds_copy = uds_sessions;
+#ifdef BARCH_USE_LIBURING
+                uring_copy = uring_sessions;
+#endif
             }
             append_lines(out, tcp_copy);
             append_lines(out, uds_copy);
+#ifdef BARCH_USE_LIBURING
+            append_lines(out, uring_copy);
+#endif
         }
 
         void start_session_collector() {
@@ -180,6 +239,9 @@ namespace barch {
                 while (!this->collector_control.wait((int64_t)get_maintenance_poll_delay()*1000ll)) {
                     collect_sessions<tcp::socket>(open_pos_tcp,tcp_sessions);
                     collect_sessions<uds::socket>(open_pos_uds,uds_sessions);
+#ifdef BARCH_USE_LIBURING
+                    collect_sessions<uring_socket>(open_pos_uring,uring_sessions);
+#endif
                 }
                 log({"ending session collector thread"});
                 collector_exit.signal(1);
@@ -194,7 +256,14 @@ namespace barch {
             try {
                 accept.close();
             }catch (std::exception& ) {}
+            for (auto &a: core_accept) {
+                try {
+                    if (a) a->close();
+                }catch (std::exception& ) {}
+            }
+            accept_guard.reset();
             for (auto &proc: asio_resp_ios) {
+                if (!proc) continue;
                 try {
                     proc->stop();
                 }catch (std::exception& e) {
@@ -202,6 +271,16 @@ namespace barch {
                 }
 
             }
+#ifdef BARCH_USE_LIBURING
+            for (auto &proc: uring_resp_ios) {
+                if (!proc) continue;
+                try {
+                    proc->stop();
+                }catch (std::exception& e) {
+                    barch::err({"failed to stop resp io_uring service", e.what()});
+                }
+            }
+#endif
             try {
                 io.stop();
 
@@ -220,6 +299,11 @@ namespace barch {
             pool.stop();
 
             asio_resp_pool.stop();
+            if (cores) {
+                // what was still in the mailboxes never runs, and holds sessions
+                cores->stop();
+                statistics::repl::shard_cores = 0;
+            }
             collector_control.signal(1);
             collector_exit.wait();
             if (session_collector.joinable())
@@ -280,9 +364,64 @@ namespace barch {
             }
         }
 
+        /**
+         * Started per core, core c accepts on a listener of its own, which shares the
+         * port with the other cores' so the kernel spreads connections over them.
+         */
+        void start_core_accept(size_t c) {
+            core_accept[c]->async_accept([this, c](asio::error_code error, Proto::socket endpoint) {
+                if (error) {
+                    if (error != asio::error::operation_aborted)
+                        barch::err({"accept error on core",c,error.message(),error.value()});
+                    return;
+                }
+                on_core_accepted(c, std::make_shared<typename Proto::socket>(std::move(endpoint)));
+                start_core_accept(c);
+            });
+        }
+        /**
+         * A resp connection stays on the core that accepted it. Which protocol it speaks
+         * is only known from its first byte, and a core must not block waiting for that,
+         * so the byte is waited for and peeked at. The binary protocol goes to the accept
+         * threads, where it is served when the server is not started per core.
+         */
+        void on_core_accepted(size_t c, const std::shared_ptr<typename Proto::socket>& endpoint) {
+            endpoint->async_wait(Proto::socket::wait_read, [this, c, endpoint](std::error_code ec) {
+                if (ec) return;
+                char first = 0;
+                ssize_t n = ::recv(endpoint->native_handle(), &first, 1, MSG_PEEK | MSG_DONTWAIT);
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    on_core_accepted(c, endpoint);
+                    return;
+                }
+                if (n != 1) return;
+                net_stat stat;
+                if (first) {
+                    process_data(*endpoint, c);
+                    return;
+                }
+                asio::post(io, [this, endpoint]() {
+                    typename Proto::socket moved(io);
+                    handle_assign(moved, *endpoint);
+                    net_stat stat;
+                    process_data(moved);
+                });
+            });
+        }
+        /** open, bind and listen, sharing the port with other listeners when shared */
+        static void listen_on(Proto::acceptor& a, const Proto::endpoint& ep, bool shared) {
+            a.open(ep.protocol());
+            a.set_option(asio::socket_base::reuse_address(true));
+            if (shared)
+                a.set_option(reuse_port(true));
+            a.bind(ep);
+            a.listen();
+        }
+
         void start() {}
 
-        void process_data(Proto::socket& endpoint) {
+        /** at is the resp thread a resp connection goes to, the next one when not given */
+        void process_data(Proto::socket& endpoint, size_t at = SIZE_MAX) {
             try {
                 char cs[1] ;
                 //readp(stream, cs);
@@ -293,10 +432,15 @@ namespace barch {
                         err({"Too many resp sessions/connections",statistics::repl::redis_sessions.load()});
                         return;
                     }
-                    auto unit = this->get_asio_unit();
+                    if (at == SIZE_MAX)
+                        at = this->next_resp_unit();
+                    if (start_uring_session(at, endpoint, cs[0]))
+                        return;
+                    auto unit = asio_resp_ios[at];
                     typename Proto::socket socket (unit->io);
                     handle_assign(socket, endpoint);
                     auto session = std::make_shared<resp_session<typename Proto::socket>>(std::move(socket),workers, cs[0]);
+                    if (cores) session->on_core(cores, at);
                     register_session(session);
 
                     session->start();
@@ -362,10 +506,44 @@ namespace barch {
         }
 #endif
 
-        server_context(Proto::endpoint ep, bool ssl)
-        :   accept(io, ep)
+        server_context(Proto::endpoint ep, bool ssl, server::io_backend backend, bool per_core, size_t core_count)
+        :   accept(io)
         ,   ssl_context(asio::ssl::context::tlsv13)
         ,   use_ssl(ssl) {
+            // only plain tcp goes through a ring. TLS needs the asio stream on top of
+            // the socket, and unix sockets are not what the frontends use
+            use_uring = backend != server::io_backend::asio && !ssl && std::is_same_v<Proto, tcp>;
+            use_sqpoll = backend == server::io_backend::uring_sqpoll;
+#ifndef BARCH_USE_LIBURING
+            if (use_uring) {
+                barch::err({"this build has no io_uring, connections use asio"});
+                use_uring = false;
+            }
+#endif
+            // the same goes for serving per core, where a core reads its own connections
+            use_cores = per_core && !ssl && std::is_same_v<Proto, tcp>;
+            if (per_core && !use_cores) {
+                barch::err({"only plain tcp connections are served per core"});
+            }
+            // every listener is bound before any thread starts, so a port that is taken
+            // fails the start with nothing left running
+            if (use_cores) {
+                // one core per hardware thread unless a count was given, each pinned to
+                // its own below. More cores than hardware threads share them
+                size_t count = core_count;
+                if (!count)
+                    count = thread_pool::get_min_threads() ? 1 : std::max<size_t>(1, thread_pool::get_system_threads());
+                asio_resp_pool.pool.resize(count);
+                for (size_t c = 0; c < asio_resp_pool.size(); ++c) {
+                    core_accept.emplace_back(std::make_unique<typename Proto::acceptor>(io));
+                    listen_on(*core_accept.back(), ep, true);
+                }
+                cores = std::make_shared<shard_cores>(asio_resp_pool.size());
+                // nothing is accepted on io, and the accept threads must wait for work
+                accept_guard.emplace(asio::make_work_guard(io));
+            } else {
+                listen_on(accept, ep, false);
+            }
 
             start_session_collector();
             if (use_ssl) {
@@ -381,7 +559,8 @@ namespace barch {
                 ssl_context.use_tmp_dh_file(get_tls_tmp_dh_file());
             }
 
-            start_accept();
+            if (!use_cores)
+                start_accept();
             pool.start([this,&ep](size_t tid) -> void{
                 auto addr = address_off(ep);
                 auto prot_name = proto_name(ep);
@@ -398,14 +577,46 @@ namespace barch {
             num_started = 0;
             barch::log({"resp pool size",asio_resp_pool.size()});
             asio_resp_ios.resize(asio_resp_pool.size());
+#ifdef BARCH_USE_LIBURING
+            uring_resp_ios.resize(asio_resp_pool.size());
+#endif
             asio_resp_pool.start([this](size_t tid) -> void {
+#ifdef BARCH_USE_LIBURING
+                if (use_uring) {
+                    auto ring = std::make_shared<uring_work_unit>(use_sqpoll);
+                    if (ring->ok()) {
+                        if (cores) cores->bind(tid, ring->io);
+                        uring_resp_ios[tid] = ring;
+                        ++num_started;
+                        ring->run();
+                        return;
+                    }
+                    barch::err({"no io_uring ring for resp thread",tid,"- its connections use asio"});
+                }
+#endif
+                auto unit = std::make_shared<asio_work_unit>();
+                if (cores) cores->bind(tid, unit->io);
+                asio_resp_ios[tid] = unit;
+                // counted once the unit is there, so the first accept cannot find it missing
                 ++num_started;
-                asio_resp_ios[tid] = std::make_shared<asio_work_unit>();
-                asio_resp_ios[tid]->run();
+                unit->run();
             });
             while (num_started != asio_resp_pool.size()) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(1));
             }
+            if (use_cores) {
+                asio_resp_pool.pin_threads();
+                // the listeners move to the cores' io_contexts, still listening
+                for (size_t c = 0; c < core_accept.size(); ++c) {
+                    auto on_core = std::make_unique<typename Proto::acceptor>(cores->io(c));
+                    on_core->assign(ep.protocol(), core_accept[c]->release());
+                    core_accept[c] = std::move(on_core);
+                    asio::post(cores->io(c), [this, c]() {
+                        start_core_accept(c);
+                    });
+                }
+                barch::log({"serving per core on",asio_resp_pool.size(),"cores"});
+            }
 
             started = true;
         }
@@ -426,16 +637,21 @@ namespace barch {
         return srv;
     }
 
+    static std::atomic<uint_least16_t>& srv_port() {
+        static std::atomic<uint_least16_t> port{0};
+        return port;
+    }
+
     static std::shared_ptr<server_context<asio::local::stream_protocol>>& get_srv_unix() {
         static std::shared_ptr<server_context<asio::local::stream_protocol>> srv = nullptr;
         return srv;
     }
     template<typename Proto>
-    void handle_start(typename Proto::endpoint ep, bool ssl, std::shared_ptr<server_context<Proto>>& s) {
+    void handle_start(typename Proto::endpoint ep, bool ssl, server::io_backend backend, bool per_core, size_t core_count, std::shared_ptr<server_context<Proto>>& s) {
         s = nullptr;
         try {
             barch::set_configuration_value("static_bloom_filter", barch::get_static_bloom_filter() ? "on":"off");
-            s = std::make_shared<server_context<Proto>>(ep, ssl);
+            s = std::make_shared<server_context<Proto>>(ep, ssl, backend, per_core, core_count);
         }catch (std::exception& e) {
             barch::err({"failed to start server", e.what()});
         }
@@ -445,26 +661,32 @@ namespace barch {
 
         s = nullptr;
     }
-    void server::start(const std::string& interface, uint_least16_t port, bool ssl) {
+    void server::start(const std::string& interface, uint_least16_t port, bool ssl, io_backend backend, bool per_core, size_t core_count) {
         std::unique_lock l(srv_mut());
         if (port == 0) {
             ::unlink(interface.c_str());
             asio::local::stream_protocol::endpoint ep(interface);
-            handle_start(ep, false, get_srv_unix());
+            handle_start(ep, false, backend, per_core, core_count, get_srv_unix());
         }else if (ssl) {
             auto ep = tcp::endpoint(tcp::v4(), port);
-            handle_start(ep, true, get_srv_ssl());
+            handle_start(ep, true, backend, per_core, core_count, get_srv_ssl());
         }else {
             auto ep = tcp::endpoint(tcp::v4(), port);
-            handle_start(ep, false, get_srv());
+            handle_start(ep, false, backend, per_core, core_count, get_srv());
+            srv_port() = get_srv() ? port : 0;
         }
     }
 
+    uint_least16_t server::listening_port() {
+        return srv_port();
+    }
+
     void server::stop() {
 
         std::unique_lock l(srv_mut());
         handle_stop(get_srv());
         handle_stop(get_srv_ssl());
+        srv_port() = 0;
     }
 
     void server::list_clients(caller& call) {
@@ -650,6 +872,184 @@ namespace barch {
             call_result call(heap::vector<Variable>& result, const heap::vector<std::string>& params) override {
                 return tcall(result, params);
             }
+            /**
+             * frames are built before anything is written so the write side never waits
+             * on encoding. Each carries up to rpc_max_batch_calls commands, less when the
+             * encoded size passes rpc_max_batch_bytes
+             */
+            struct frame {
+                vector_stream bytes{};
+                uint32_t calls{};
+                uint64_t queued_at{};
+            };
+            void build_frames(heap::vector<frame>& frames, const heap::vector<queued_call>& commands) {
+                frame f;
+                auto close_frame = [&]() {
+                    if (!f.calls) return;
+                    // the call count leads the frame but is only known once it is full
+                    memcpy(f.bytes.buf.data(), &f.calls, sizeof(f.calls));
+                    frames.push_back(std::move(f));
+                    f = frame{};
+                };
+                for (const auto& qc : commands) {
+                    if (qc.params.empty()) continue;
+                    to_send.clear();
+                    for (auto& p: qc.params) {
+                        push_value(to_send, value_type{p});
+                    }
+                    if (!f.calls) {
+                        f.queued_at = qc.queued_at;
+                        writep(f.bytes, uint32_t{0});
+                    }
+                    uint32_t buffers_size = to_send.size();
+                    writep(f.bytes, buffers_size);
+                    writep(f.bytes, to_send.data(), to_send.size());
+                    ++f.calls;
+                    if (f.calls >= rpc_max_batch_calls || f.bytes.buf.size() >= rpc_max_batch_bytes) {
+                        close_frame();
+                    }
+                }
+                close_frame();
+            }
+            void connect_stream() {
+                if (s.is_open()) return;
+                stream.clear();
+                auto once_connected = [this](const std::error_code& ec, typename Proto::endpoint unused(ep)) {
+                    error = ec;
+                };
+                do_connect(s, once_connected);
+                run(barch::get_rpc_connect_to_s());
+                if (error) {
+                    throw_exception<std::runtime_error>("failed to connect");
+                };
+                uint32_t cmd = cmd_barch_call;
+                writep(stream,uint8_t{0x00});
+                writep(stream, cmd);
+                write(s,asio::buffer(stream.buf.data(), stream.buf.size()));
+                stream.clear();
+            }
+            /**
+             * Writes and ack reads are two chains on the same io_context. The write chain
+             * keeps up to rpc_repl_window frames unacknowledged, and the read chain takes
+             * the replies off as they come, one per call, and retires a frame once all
+             * of its calls are answered. Reading while still writing is not optional:
+             * with a large backlog both socket buffers would fill and neither side could
+             * move. The read timeout applies to progress, not to the whole run, so a long
+             * backlog is fine as long as acks keep arriving.
+             */
+            size_t replicate(const heap::vector<queued_call>& commands, stream_progress& progress) override {
+                std::lock_guard lock(latch);
+                heap::vector<frame> frames;
+                build_frames(frames, commands);
+                if (frames.empty()) return 0;
+                size_t sent = 0;       // frames written
+                size_t retired = 0;    // frames fully acknowledged
+                uint32_t answered = 0; // replies for frames[retired] so far
+                size_t acked = 0;      // commands acknowledged
+                bool writing = false;
+                struct {
+                    int32_t call_error{};
+                    uint32_t replies_size{};
+                } ack;
+                static_assert(sizeof(ack) == sizeof(int32_t) + sizeof(uint32_t));
+                error = {};
+                try {
+                    net_stat stat;
+                    connect_stream();
+                    std::function<void()> send_next;
+                    std::function<void()> read_ack;
+                    auto fail = [&](const std::error_code& ec) {
+                        if (!error) error = ec;
+                        ++statistics::repl::request_errors;
+                        s.close();
+                    };
+                    send_next = [&]() {
+                        if (writing || error) return;
+                        if (sent >= frames.size() || sent - retired >= rpc_repl_window) return;
+                        writing = true;
+                        auto& f = frames[sent];
+                        progress.in_flight += f.calls;
+                        asio::async_write(s, asio::buffer(f.bytes.buf),
+                            [&](const std::error_code& ec, std::size_t n) {
+                                writing = false;
+                                if (ec) {
+                                    fail(ec);
+                                    return;
+                                }
+                                stream_write_ctr += n;
+                                ++sent;
+                                ++progress.batches;
+                                send_next();
+                            });
+                    };
+                    auto on_ack = [&]() {
+                        if (ack.call_error != 0) {
+                            ++progress.call_errors;
+                            ++statistics::repl::instructions_failed;
+                        }
+                        ++answered;
+                        ++acked;
+                        ++progress.acked;
+                        --progress.in_flight;
+                        --progress.backlog;
+                        if (answered == frames[retired].calls) {
+                            progress.lag_ms = art::now() - frames[retired].queued_at;
+                            answered = 0;
+                            ++retired;
+                            send_next();
+                        }
+                        read_ack();
+                    };
+                    read_ack = [&]() {
+                        if (retired >= frames.size() || error) return;
+                        asio::async_read(s, asio::buffer(&ack, sizeof(ack)),
+                            [&](const std::error_code& ec, std::size_t n) {
+                                if (ec) {
+                                    fail(ec);
+                                    return;
+                                }
+                                stream_read_ctr += n;
+                                if (ack.replies_size == 0) {
+                                    on_ack();
+                                    return;
+                                }
+                                // the values are not needed, an ack only has to be counted
+                                replies.resize(ack.replies_size);
+                                asio::async_read(s, asio::buffer(replies),
+                                    [&](const std::error_code& rec, std::size_t rn) {
+                                        if (rec) {
+                                            fail(rec);
+                                            return;
+                                        }
+                                        stream_read_ctr += rn;
+                                        on_ack();
+                                    });
+                            });
+                    };
+                    ioc.restart();
+                    send_next();
+                    read_ack();
+                    while (!ioc.stopped()) {
+                        size_t before = acked + sent;
+                        ioc.run_for(barch::get_rpc_read_to_s());
+                        if (!ioc.stopped() && before == acked + sent) {
+                            fail(std::make_error_code(std::errc::timed_out));
+                            ioc.run();
+                        }
+                    }
+                    if (error) {
+                        throw_exception<std::runtime_error>("replication stream failed");
+                    }
+                }catch (std::exception& e) {
+                    barch::err({"replication failed [", e.what(),"] to",host,port,"because [",error.message(),error.value(),"]"});
+                    ++progress.failures;
+                    progress.in_flight = 0;
+                    stream.clear();
+                    if (s.is_open()) s.close();
+                }
+                return acked;
+            }
+
             call_result call(heap::vector<Variable>& result, const heap::vector<value_type>& params) override {
                 return tcall(result, params);
             }
@@ -673,63 +1073,268 @@ namespace barch {
             }
             return std::make_shared<rpc_impl<tcp>>(host, port);
         }
-        struct consumers {
-            std::mutex m;
-            heap::vector<std::vector<std::string>> buffer;
-            heap::string_map<std::shared_ptr<rpc>> destinations;
-            bool exit = false;
-            consumers() {
-
+        /**
+         * A replication destination, with a sender thread of its own. Commands are put on
+         * its queue by whichever thread made the change and taken off by the sender, so a
+         * slow or unreachable replica only ever holds up itself - not the other replicas
+         * and not the maintenance thread, which is where all of this used to run.
+         *
+         * The queue is bounded by repl_queue_max. What happens when it is full is
+         * repl_backpressure:
+         *  - block: the writer waits for room. Nothing is lost, and a replica that
+         *    cannot keep up slows the writes down to its pace - all of them, for as
+         *    long as it is away, which is why this is not the default.
+         *  - drop-oldest: the oldest queued command is thrown away. The replica carries
+         *    on, missing whatever was dropped.
+         *  - resync, the default: the whole queue is dropped and, before anything else
+         *    is sent, the replica is asked to RETRIEVE everything from here. Commands
+         *    queued after the drop follow the RETRIEVE, so some of them may be applied
+         *    twice.
+         */
+        struct destination {
+            std::string name{};
+            std::shared_ptr<rpc> client{};
+            stream_progress progress{};
+            std::mutex m{};
+            std::condition_variable work{};
+            std::condition_variable room{};
+            std::deque<queued_call> queue{};
+            bool exit{false};
+            bool resync{false};
+            std::thread sender{};
+
+            destination(std::string name, std::shared_ptr<rpc> client)
+            : name(std::move(name)), client(std::move(client)) {
+                sender = std::thread([this]() {
+                    run();
+                });
             }
-            ~consumers() {
+            ~destination() {
                 stop();
             }
-            void distribute() {
-
-                if (exit) return;
+            void stop() {
                 {
                     std::lock_guard l(m);
-                    if (destinations.empty()) return;
-                    if (buffer.empty()) return;
+                    exit = true;
                 }
-                heap::vector<std::vector<std::string>> todo;
-                heap::string_map<std::shared_ptr<rpc>> active;
-                {
-                    std::lock_guard l(m);
-                    todo.swap(buffer);
-                    active = destinations;
-                }
-                for (auto dest: active) {
-                    heap::vector<Variable> results{};
-                    for (const auto&p : todo) {
-                        results.clear();
-                        auto r = dest.second->call(results,p);
-                        if (r.net_error) {
-                            barch::err({"call to",dest.first,"failed"});
+                work.notify_all();
+                room.notify_all();
+                if (sender.joinable()) sender.join();
+            }
+            /**
+             * the writer side. Called with the caller's command already decided, before it
+             * has been applied here.
+             */
+            void push(const std::vector<std::string>& params, uint64_t at) {
+                std::unique_lock l(m);
+                if (exit) return;
+                size_t max_queue = std::max<uint64_t>(get_repl_queue_max(), 1);
+                if (queue.size() >= max_queue) {
+                    switch (get_repl_backpressure()) {
+                        case repl_backpressure_drop_oldest:
+                            while (queue.size() >= max_queue) {
+                                queue.pop_front();
+                                ++progress.dropped;
+                                --progress.backlog;
+                            }
                             break;
+                        case repl_backpressure_resync:
+                            progress.dropped += queue.size();
+                            progress.backlog -= queue.size();
+                            queue.clear();
+                            if (!resync) {
+                                barch::err({"replication queue to",name,"is full - it will be resynchronised"});
+                            }
+                            resync = true;
+                            break;
+                        default:
+                            ++progress.blocked;
+                            room.wait(l, [&]() {
+                                return exit || queue.size() < max_queue;
+                            });
+                            if (exit) return;
+                            break;
+                    }
+                }
+                queue.push_back({params, at});
+                ++progress.backlog;
+                l.unlock();
+                work.notify_one();
+            }
+            /**
+             * ask the replica to load everything from this server. It connects back to
+             * external_host on the port this server listens on, so both have to be right
+             * for a replica elsewhere
+             */
+            bool send_resync() {
+                auto port = server::listening_port();
+                if (!port) {
+                    barch::err({"cannot resynchronise",name,"- this server is not listening"});
+                    return false;
+                }
+                heap::vector<Variable> result;
+                std::vector<std::string> params = {"RETRIEVE", get_external_host(), std::to_string(port)};
+                auto r = client->call(result, params);
+                if (!r.ok()) {
+                    barch::err({"resynchronising",name,"failed"});
+                    return false;
+                }
+                ++progress.resyncs;
+                return true;
+            }
+            /**
+             * wait before trying again after a failure, doubling each time up to
+             * repl_backoff_max_ms. A stop cuts it short.
+             */
+            void back_off(uint64_t& delay) {
+                delay = std::min<uint64_t>(delay ? delay * 2 : 10, std::max<uint64_t>(get_repl_backoff_max_ms(), 1));
+                std::unique_lock l(m);
+                work.wait_for(l, std::chrono::milliseconds(delay), [&]() {
+                    return exit;
+                });
+            }
+            void run() {
+                uint64_t delay = 0;
+                const size_t take_max = (size_t)rpc_max_batch_calls * rpc_repl_window;
+                heap::vector<queued_call> todo;
+                while (true) {
+                    bool do_resync = false;
+                    {
+                        std::unique_lock l(m);
+                        work.wait(l, [&]() {
+                            return exit || resync || !queue.empty() || !todo.empty();
+                        });
+                        if (exit) break;
+                        do_resync = resync;
+                        if (do_resync) {
+                            // whatever was held back from a failed attempt predates the
+                            // resync, and the RETRIEVE covers it
+                            progress.dropped += todo.size();
+                            progress.backlog -= todo.size();
+                            todo.clear();
+                        }
+                        // a retry sends what it has first, so the queue keeps its bound
+                        // while the replica is away
+                        if (todo.empty()) {
+                            while (!queue.empty() && todo.size() < take_max) {
+                                todo.push_back(std::move(queue.front()));
+                                queue.pop_front();
+                            }
+                        }
+                    }
+                    room.notify_all();
+                    if (do_resync) {
+                        if (!send_resync()) {
+                            back_off(delay);
+                            // put the commands taken back on the queue; the resync still
+                            // has to go first
+                            std::lock_guard l(m);
+                            for (auto i = todo.rbegin(); i != todo.rend(); ++i) {
+                                queue.push_front(std::move(*i));
+                            }
+                            todo.clear();
+                            continue;
                         }
-                        if (exit) return;
+                        std::lock_guard l(m);
+                        resync = false;
                     }
-                    if (exit) return;
+                    if (todo.empty()) continue;
+                    size_t acked = client->replicate(todo, progress);
+                    if (acked < todo.size()) {
+                        // kept for the next attempt, from the first one not acknowledged.
+                        // That one may have been applied with only its ack lost, so a
+                        // reconnect can repeat a few commands, never skip one
+                        todo.erase(todo.begin(), todo.begin() + (ptrdiff_t)acked);
+                        ++progress.reconnects;
+                        back_off(delay);
+                        continue;
+                    }
+                    todo.clear();
+                    delay = 0;
+                }
+            }
+        };
+        struct consumers {
+            std::mutex m;
+            heap::string_map<std::shared_ptr<destination>> destinations;
+            // what consume walks, replaced as a whole when a destination comes or goes so
+            // that the write path only has to copy a pointer
+            std::shared_ptr<const heap::vector<std::shared_ptr<destination>>> targets{};
+            std::atomic<bool> any{false};
+            consumers() {
+
+            }
+            ~consumers() {
+                stop();
+            }
+            void update_targets() {
+                auto t = std::make_shared<heap::vector<std::shared_ptr<destination>>>();
+                for (auto& d : destinations) {
+                    t->push_back(d.second);
                 }
+                any = !t->empty();
+                targets = t;
             }
             void add(const std::string &host, int port) {
-                std::lock_guard l(m);
                 std::string addr = host;
                 addr += ":";
                 addr += std::to_string(port);
-                destinations[addr] = create(host,port);
+                std::shared_ptr<destination> old;
+                {
+                    std::lock_guard l(m);
+                    auto at = destinations.find(addr);
+                    if (at != destinations.end()) old = at->second;
+                    destinations[addr] = std::make_shared<destination>(addr, create(host,port));
+                    update_targets();
+                }
+                if (old) old->stop();
             }
             void consume(const std::vector<std::string>& params) {
-                if (destinations.empty()) return;
+                if (!any) return;
+                std::shared_ptr<const heap::vector<std::shared_ptr<destination>>> t;
+                {
+                    std::lock_guard l(m);
+                    t = targets;
+                }
+                if (!t) return;
+                uint64_t at = art::now();
+                for (auto& d : *t) {
+                    d->push(params, at);
+                }
+            }
+            heap::vector<destination_statistics> get_statistics() {
+                heap::vector<destination_statistics> r;
                 std::lock_guard l(m);
-                buffer.push_back(params);
+                for (auto& d : destinations) {
+                    auto& p = d.second->progress;
+                    destination_statistics ds;
+                    ds.name = d.first;
+                    ds.backlog = p.backlog;
+                    ds.in_flight = p.in_flight;
+                    ds.acked = p.acked;
+                    ds.batches = p.batches;
+                    ds.call_errors = p.call_errors;
+                    ds.failures = p.failures;
+                    ds.dropped = p.dropped;
+                    ds.blocked = p.blocked;
+                    ds.resyncs = p.resyncs;
+                    ds.reconnects = p.reconnects;
+                    ds.lag_ms = p.backlog ? p.lag_ms.load() : 0;
+                    r.push_back(ds);
+                }
+                return r;
             }
             void stop() {
-                std::lock_guard l(m);
-                destinations.clear();
-                buffer.clear();
-                exit = true;
+                heap::string_map<std::shared_ptr<destination>> stopping;
+                {
+                    std::lock_guard l(m);
+                    stopping.swap(destinations);
+                    update_targets();
+                }
+                // joined outside the lock: a sender can be waiting on a long write
+                for (auto& d : stopping) {
+                    d.second->stop();
+                }
             }
         };
         consumers& dests() {
@@ -740,13 +1345,13 @@ namespace barch {
             dests().add(host, port);
         }
         bool has_destinations() {
-            return !dests().destinations.empty();
+            return dests().any;
         }
         void call(const std::vector<std::string>& params){
             dests().consume(params);
         }
-        void distribute() {
-            dests().distribute();
+        heap::vector<destination_statistics> get_destination_statistics() {
+            return dests().get_statistics();
         }
 
 
@@ -4,6 +4,7 @@
 
 #ifndef SERVER_H
 #define SERVER_H
+#include <atomic>
 #include <cstdint>
 #include "value_type.h"
 #include <thread>
@@ -21,13 +22,33 @@ namespace barch {
     typedef std::pair<std::string, size_t> host_id;
     host_id get_host_id();
     namespace server {
-        extern void start(const std::string &interface, uint_least16_t port, bool ssl);
+        /**
+         * what the resp threads wait on. asio is epoll. uring gives each resp thread an
+         * io_uring ring, and uring_sqpoll has a kernel thread poll that ring for
+         * submissions. Only plain tcp connections use a ring.
+         */
+        enum class io_backend {
+            asio,
+            uring,
+            uring_sqpoll
+        };
+        /**
+         * per_core gives each resp thread its own listener on the port and a share of
+         * the shards, and sends single key requests to the thread that owns their shard.
+         * There are core_count of them, or one per hardware thread when it is 0. Only
+         * plain tcp is served per core
+         */
+        extern void start(const std::string &interface, uint_least16_t port, bool ssl,
+                          io_backend backend = io_backend::asio, bool per_core = false,
+                          size_t core_count = 0);
         extern void stop();
         /**
          * push one CLIENT INFO style line per open session, as CLIENT LIST. The session
          * vectors live in here, so the walk does too - a caller never sees a session.
          */
         extern void list_clients(caller& call);
+        /** the port the plain tcp listener is on, 0 when there is none */
+        extern uint_least16_t listening_port();
     };
     namespace repl {
         struct call_result {
@@ -37,6 +58,51 @@ namespace barch {
                 return call_error == 0 && net_error == 0;
             }
         };
+        /**
+         * a replicated command waiting to go out, with the time it was queued so the
+         * lag of a destination can be worked out when it is acknowledged
+         */
+        struct queued_call {
+            std::vector<std::string> params{};
+            uint64_t queued_at{};
+        };
+        /**
+         * what one replication destination is doing right now. in_flight and backlog are
+         * gauges, the rest count up. lag_ms is the age of the oldest command in the last
+         * acknowledged frame, so it reads 0 only once that destination has nothing left.
+         * dropped, blocked and resyncs are what repl_backpressure did when the queue was
+         * full, reconnects the attempts that had to be repeated
+         */
+        struct stream_progress {
+            std::atomic<uint64_t> backlog{};
+            std::atomic<uint64_t> in_flight{};
+            std::atomic<uint64_t> acked{};
+            std::atomic<uint64_t> batches{};
+            std::atomic<uint64_t> call_errors{};
+            std::atomic<uint64_t> failures{};
+            std::atomic<uint64_t> dropped{};
+            std::atomic<uint64_t> blocked{};
+            std::atomic<uint64_t> resyncs{};
+            std::atomic<uint64_t> reconnects{};
+            std::atomic<uint64_t> lag_ms{};
+        };
+        /**
+         * a copy of stream_progress for one destination, for INFO replication
+         */
+        struct destination_statistics {
+            std::string name{};
+            uint64_t backlog{};
+            uint64_t in_flight{};
+            uint64_t acked{};
+            uint64_t batches{};
+            uint64_t call_errors{};
+            uint64_t failures{};
+            uint64_t dropped{};
+            uint64_t blocked{};
+            uint64_t resyncs{};
+            uint64_t reconnects{};
+            uint64_t lag_ms{};
+        };
         class rpc {
         public:
             virtual ~rpc() = default;
@@ -52,13 +118,22 @@ namespace barch {
 
             virtual call_result asynch_call(heap::vector<Variable>& result, const heap::vector<art::value_type>& params) = 0;
             [[nodiscard]] virtual std::error_code net_error() const = 0;
+            /**
+             * send a run of replicated commands as batched frames, keeping several frames
+             * on the wire before the first ack comes back. Acks are matched to frames in
+             * the order they were sent. The counters in progress are updated as frames go
+             * out and come back so a reader can see how far behind this destination is.
+             * Answers with the number of commands acknowledged, which is less than
+             * commands.size() only when the connection failed part way.
+             */
+            virtual size_t replicate(const heap::vector<queued_call>& commands, stream_progress& progress) = 0;
         };
         std::shared_ptr<rpc> create(const std::string& host, int port);
         void publish(const std::string& host, int port);
         bool has_destinations();
         void call(const std::vector<std::string>& params);
-        void distribute();
         void stop_repl();
+        heap::vector<destination_statistics> get_destination_statistics();
         struct repl_dest {
             std::string host {};
             std::string name {};
@@ -0,0 +1,59 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "shard_cores.h"
+#include <algorithm>
+#include "constants.h"
+#include "statistics.h"
+
+namespace barch {
+    shard_cores::shard_cores(size_t count) : count(std::max<size_t>(count, 1)) {
+        ios.resize(this->count, nullptr);
+        boxes.reserve(this->count * this->count);
+        for (size_t i = 0; i < this->count * this->count; ++i) {
+            boxes.emplace_back(std::make_unique<mailbox>(core_mailbox_size));
+        }
+        statistics::repl::shard_cores = this->count;
+    }
+
+    void shard_cores::bind(size_t core, asio::io_context& io) {
+        ios[core] = &io;
+    }
+
+    void shard_cores::send(size_t from, size_t to, task t) {
+        auto& box = *boxes[from * count + to];
+        ++statistics::repl::core_mailbox_sends;
+        if (!box.ring.push(std::move(t))) {
+            ++statistics::repl::core_mailbox_full;
+            asio::post(*ios[to], std::move(t));
+            return;
+        }
+        // the receiving side clears waking before it takes anything, so a task pushed
+        // after its last look finds waking clear and posts another drain
+        if (!box.waking.exchange(true)) {
+            asio::post(*ios[to], [this, from, to]() {
+                drain(from, to);
+            });
+        }
+    }
+
+    void shard_cores::stop() {
+        task t;
+        for (auto& box : boxes) {
+            while (box->ring.pop(t)) {
+                t = nullptr;
+            }
+            box->waking.store(false);
+        }
+    }
+
+    void shard_cores::drain(size_t from, size_t to) {
+        auto& box = *boxes[from * count + to];
+        box.waking.store(false);
+        task t;
+        while (box.ring.pop(t)) {
+            t();
+        }
+    }
+}
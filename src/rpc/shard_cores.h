@@ -0,0 +1,109 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_SHARD_CORES_H
+#define BARCH_SHARD_CORES_H
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "asio_includes.h"
+#include "sastam.h"
+
+namespace barch {
+    /**
+     * A bounded ring that one thread puts into and one other thread takes from, without
+     * a lock: each side only writes its own index, and reads the other's to see how far
+     * it may go. One slot is always left empty so full and empty can be told apart.
+     */
+    template<typename T>
+    class spsc_ring {
+    public:
+        explicit spsc_ring(size_t capacity) : slots(capacity + 1) {}
+        spsc_ring(const spsc_ring&) = delete;
+        spsc_ring& operator=(const spsc_ring&) = delete;
+
+        /** false when the ring is full, and item is left as it was */
+        bool push(T&& item) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            size_t next = (t + 1) % slots.size();
+            if (next == head.load(std::memory_order_acquire))
+                return false;
+            slots[t] = std::move(item);
+            tail.store(next, std::memory_order_release);
+            return true;
+        }
+        bool pop(T& item) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return false;
+            item = std::move(slots[h]);
+            slots[h] = T{};
+            head.store((h + 1) % slots.size(), std::memory_order_release);
+            return true;
+        }
+    private:
+        heap::vector<T> slots;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+
+    /**
+     * The cores of a server started per core. Each core is one resp thread with its own
+     * io_context, and owns the shards whose index it is modulo the number of cores, in
+     * every key space. Single key requests for a shard are only ever run by its owner, so
+     * the shard's latch is only ever taken by one core on that path.
+     *
+     * Work goes from one core to another through a mailbox per ordered pair of cores,
+     * which is an spsc_ring: core a is the only one that puts into mailbox (a, b), and
+     * core b the only one that takes from it. The receiving core is woken with a post to
+     * its io_context, but only when its mailbox has no wake up pending already, so a busy
+     * pair of cores shares one post between many tasks.
+     */
+    class shard_cores {
+    public:
+        typedef std::function<void()> task;
+        explicit shard_cores(size_t count);
+        shard_cores(const shard_cores&) = delete;
+        shard_cores& operator=(const shard_cores&) = delete;
+
+        [[nodiscard]] size_t size() const {
+            return count;
+        }
+        [[nodiscard]] size_t owner(size_t shard) const {
+            return shard % count;
+        }
+        /** the io_context core runs. set once, by the core itself, before it accepts */
+        void bind(size_t core, asio::io_context& io);
+        [[nodiscard]] asio::io_context& io(size_t core) const {
+            return *ios[core];
+        }
+        /**
+         * run t on core to. Only ever called on core from, which is what makes each
+         * mailbox single producer. A full mailbox falls back to posting t on its own,
+         * which does not keep its order with what is in the mailbox - nothing sent here
+         * has an order to keep with anything else sent here.
+         */
+        void send(size_t from, size_t to, task t);
+        /**
+         * drop what is still in the mailboxes. Only once no core runs any more: the
+         * tasks never will, and they hold the sessions and pipelines they were for
+         */
+        void stop();
+    private:
+        struct mailbox {
+            explicit mailbox(size_t capacity) : ring(capacity) {}
+            spsc_ring<task> ring;
+            // a drain is posted to the receiving core and has not started taking yet
+            std::atomic<bool> waking{false};
+        };
+        void drain(size_t from, size_t to);
+
+        size_t count;
+        heap::vector<asio::io_context*> ios{};
+        // indexed from * count + to
+        heap::vector<std::unique_ptr<mailbox>> boxes{};
+    };
+}
+#endif //BARCH_SHARD_CORES_H
@@ -0,0 +1,430 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#include "uring_resp_session.h"
+#ifdef BARCH_USE_LIBURING
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+#include "constants.h"
+#include "logger.h"
+#include "statistics.h"
+
+namespace barch {
+    uring_work_unit::uring_work_unit(bool sqpoll) : guard(asio::make_work_guard(io)) {
+        io_uring_params params{};
+        // a completion for every connection's receive and send, more than once over
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = uring_ring_entries * 4;
+        if (sqpoll) {
+            params.flags |= IORING_SETUP_SQPOLL;
+            params.sq_thread_idle = 50;
+        }
+        int status = io_uring_queue_init_params(uring_ring_entries, &ring, &params);
+        if (status < 0) {
+            barch::err({"io_uring is not available", std::string(strerror(-status))});
+            return;
+        }
+        ring_open = true;
+        buffers = io_uring_setup_buf_ring(&ring, uring_buffer_count, buffer_group, 0, &status);
+        if (!buffers) {
+            barch::err({"io_uring provided buffer rings are not available", std::string(strerror(-status))});
+            return;
+        }
+        buffer_memory.resize((size_t) uring_buffer_count * uring_buffer_size);
+        for (unsigned bid = 0; bid < uring_buffer_count; ++bid) {
+            give_back(bid);
+        }
+        return_buffers();
+        // registering costs a syscall per connection, once, and saves the kernel looking
+        // the fd up on every receive and send after that. not having it is not fatal
+        if (io_uring_register_files_sparse(&ring, uring_fixed_files) == 0) {
+            free_slots.reserve(uring_fixed_files);
+            for (int slot = uring_fixed_files; slot > 0; --slot) {
+                free_slots.push_back(slot - 1);
+            }
+        }
+        ready = true;
+    }
+
+    uring_work_unit::~uring_work_unit() {
+        guard.reset();
+        if (ring_watch) {
+            ring_watch->release(); // the ring's fd is closed by io_uring_queue_exit
+            ring_watch.reset();
+        }
+        if (buffers)
+            io_uring_free_buf_ring(&ring, buffers, uring_buffer_count, buffer_group);
+        // the ring goes first: a send still with the kernel reads out of buffers its
+        // handler keeps, and they are only let go once nothing can read them
+        if (ring_open)
+            io_uring_queue_exit(&ring);
+        for (auto& [_, c] : live) {
+            if (c->owns_fd && c->fd >= 0)
+                ::close(c->fd);
+        }
+        live.clear();
+    }
+
+    void uring_work_unit::run() {
+        ring_watch.emplace(io, ring.ring_fd);
+        watch();
+        io.run();
+    }
+
+    void uring_work_unit::stop() {
+        io.stop();
+        guard.reset();
+    }
+
+    void uring_work_unit::watch() {
+        ring_watch->async_wait(asio::posix::stream_descriptor::wait_read, [this](const std::error_code& ec) {
+            if (ec)
+                return;
+            reap();
+            watch();
+        });
+        // a completion that landed before the wait was armed raised the fd already
+        if (io_uring_cq_ready(&ring))
+            asio::post(io, [this]() { reap(); });
+    }
+
+    uint8_t* uring_work_unit::buffer_at(unsigned bid) {
+        return buffer_memory.data() + (size_t) bid * uring_buffer_size;
+    }
+
+    void uring_work_unit::give_back(unsigned bid) {
+        io_uring_buf_ring_add(buffers, buffer_at(bid), uring_buffer_size, (unsigned short) bid,
+                              io_uring_buf_ring_mask(uring_buffer_count), (int) returned++);
+    }
+
+    void uring_work_unit::return_buffers() {
+        if (!returned)
+            return;
+        io_uring_buf_ring_advance(buffers, (int) returned);
+        returned = 0;
+    }
+
+    io_uring_sqe* uring_work_unit::next_sqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        while (!sqe) {
+            // full: what is queued goes now. with SQPOLL the kernel thread may still
+            // have to catch up before there is room
+            submit();
+            sqe = io_uring_get_sqe(&ring);
+            if (!sqe)
+                std::this_thread::yield();
+        }
+        if (!submit_posted) {
+            // everything the handlers running now prepare goes in the same submit
+            submit_posted = true;
+            asio::post(io, [this]() {
+                submit_posted = false;
+                submit();
+            });
+        }
+        return sqe;
+    }
+
+    void uring_work_unit::submit() {
+        return_buffers();
+        if (io_uring_sq_ready(&ring) == 0)
+            return;
+        int status = io_uring_submit(&ring);
+        if (status < 0) {
+            barch::err({"io_uring submit failed", std::string(strerror(-status))});
+            return;
+        }
+        ++statistics::repl::uring_submits;
+    }
+
+    void uring_work_unit::reap() {
+        if (io_uring_cq_has_overflow(&ring))
+            io_uring_get_events(&ring);
+        completions.clear();
+        io_uring_cqe* cqe = nullptr;
+        unsigned head = 0;
+        unsigned n = 0;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            completions.push_back({cqe->user_data, cqe->res, cqe->flags});
+            ++n;
+        }
+        io_uring_cq_advance(&ring, n);
+        statistics::repl::uring_completions += n;
+        // completions is not touched by anything a handler can reach
+        for (const auto& e : completions) {
+            complete(e);
+        }
+        return_buffers();
+    }
+
+    void uring_work_unit::complete(const completed& e) {
+        auto* c = (uring_connection*) (uintptr_t) (e.user_data & ~(uint64_t) op_mask);
+        switch (e.user_data & op_mask) {
+            case op_recv:
+                received(c, e.res, e.flags);
+                break;
+            case op_send:
+                sent(c, e.res);
+                break;
+            default:
+                --c->in_flight;
+                break;
+        }
+        forget_if_done(c);
+    }
+
+    void uring_work_unit::received(uring_connection* c, int32_t res, uint32_t flags) {
+        if (!(flags & IORING_CQE_F_MORE)) {
+            c->receiving = false;
+            c->cancelling = false;
+            --c->in_flight;
+        }
+        if (flags & IORING_CQE_F_BUFFER) {
+            unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            if (res > 0 && !c->closed)
+                take(c, buffer_at(bid), (size_t) res);
+            give_back(bid);
+        }
+        if (c->closed)
+            return;
+        if (res == 0) {
+            c->read_error = asio::error::eof;
+        } else if (res < 0) {
+            if (res == -EINVAL && c->multishot) {
+                // no multishot receives on this kernel. armed once a read below
+                c->multishot = false;
+            } else if (res != -ENOBUFS && res != -ECANCELED) {
+                // ENOBUFS: every buffer was out, and they are handed back below.
+                // ECANCELED: stopped while the reader caught up
+                c->read_error = std::error_code(-res, std::system_category());
+            }
+        }
+        deliver(c);
+        arm(c);
+    }
+
+    void uring_work_unit::take(uring_connection* c, const uint8_t* data, size_t n) {
+        if (c->read_done && c->unread_bytes() == 0) {
+            // straight to the waiting reader, and only what it has no room for is kept
+            size_t now = std::min(n, c->read_into.size());
+            memcpy(c->read_into.data(), data, now);
+            data += now;
+            n -= now;
+            auto done = std::move(c->read_done);
+            done->complete({}, now);
+            if (c->closed)
+                return;
+        }
+        if (n == 0)
+            return;
+        if (c->unread_at > 0 && c->unread_at == c->unread.size()) {
+            c->unread.clear();
+            c->unread_at = 0;
+        }
+        c->unread.insert(c->unread.end(), data, data + n);
+        if (c->unread_bytes() >= uring_max_unread && c->receiving && !c->cancelling) {
+            // the reader has stopped (a blocking command, an asynch batch) and the
+            // client has not. stop receiving until it catches up, as a full socket
+            // buffer would have stopped the client on asio
+            auto* sqe = next_sqe();
+            io_uring_prep_cancel64(sqe, tag(c, op_recv), 0);
+            io_uring_sqe_set_data64(sqe, tag(c, op_cancel));
+            c->cancelling = true;
+            ++c->in_flight;
+        }
+    }
+
+    void uring_work_unit::deliver(uring_connection* c) {
+        if (!c->read_done)
+            return;
+        if (c->unread_bytes() > 0) {
+            size_t n = std::min(c->unread_bytes(), c->read_into.size());
+            memcpy(c->read_into.data(), c->unread.data() + c->unread_at, n);
+            c->unread_at += n;
+            if (c->unread_at == c->unread.size()) {
+                c->unread.clear();
+                c->unread_at = 0;
+            } else if (c->unread_at > c->unread.size() / 2) {
+                c->unread.erase(c->unread.begin(), c->unread.begin() + (ptrdiff_t) c->unread_at);
+                c->unread_at = 0;
+            }
+            auto done = std::move(c->read_done);
+            done->complete({}, n);
+        } else if (c->read_error) {
+            auto done = std::move(c->read_done);
+            done->complete(c->read_error, 0);
+        }
+    }
+
+    void uring_work_unit::arm(uring_connection* c) {
+        if (c->closed || c->receiving || c->read_error || c->unread_bytes() >= uring_max_unread)
+            return;
+        auto* sqe = next_sqe();
+        int target = c->slot >= 0 ? c->slot : c->fd;
+        if (c->multishot)
+            io_uring_prep_recv_multishot(sqe, target, nullptr, 0, 0);
+        else
+            io_uring_prep_recv(sqe, target, nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        if (c->slot >= 0)
+            sqe->flags |= IOSQE_FIXED_FILE;
+        sqe->buf_group = buffer_group;
+        io_uring_sqe_set_data64(sqe, tag(c, op_recv));
+        c->receiving = true;
+        ++c->in_flight;
+    }
+
+    void uring_work_unit::sent(uring_connection* c, int32_t res) {
+        --c->in_flight;
+        c->sending = false;
+        auto s = std::move(c->sends.front());
+        c->sends.pop_front();
+        if (!c->closed && s.done) {
+            if (res < 0)
+                s.done->complete(std::error_code(-res, std::system_category()), 0);
+            else
+                s.done->complete({}, (size_t) res);
+        }
+        send_next(c);
+    }
+
+    void uring_work_unit::send_next(uring_connection* c) {
+        if (c->closed || c->sending || c->sends.empty())
+            return;
+        auto& s = c->sends.front();
+        s.msg = {};
+        s.msg.msg_iov = s.iov.data();
+        s.msg.msg_iovlen = s.iov.size();
+        auto* sqe = next_sqe();
+        io_uring_prep_sendmsg(sqe, c->slot >= 0 ? c->slot : c->fd, &s.msg, MSG_NOSIGNAL);
+        if (c->slot >= 0)
+            sqe->flags |= IOSQE_FIXED_FILE;
+        io_uring_sqe_set_data64(sqe, tag(c, op_send));
+        c->sending = true;
+        ++c->in_flight;
+    }
+
+    void uring_work_unit::open(const uring_connection_ptr& c) {
+        if (c->closed)
+            return;
+        if (!free_slots.empty()) {
+            int slot = free_slots.back();
+            int fd = c->fd;
+            if (io_uring_register_files_update(&ring, slot, &fd, 1) == 1) {
+                c->slot = slot;
+                free_slots.pop_back();
+            }
+        }
+        live[c.get()] = c;
+        ++statistics::repl::uring_sessions;
+    }
+
+    void uring_work_unit::read(const uring_connection_ptr& c, asio::mutable_buffer into, uring_completion_ptr done) {
+        if (c->closed)
+            return;
+        c->read_into = into;
+        c->read_done = std::move(done);
+        if (c->unread_bytes() > 0 || c->read_error) {
+            // already here, but asio never completes a read inside the call that started it
+            asio::post(io, [this, c]() {
+                deliver(c.get());
+                arm(c.get());
+            });
+            return;
+        }
+        arm(c.get());
+    }
+
+    void uring_work_unit::write(const uring_connection_ptr& c, heap::vector<iovec> iov, uring_completion_ptr done) {
+        if (c->closed)
+            return;
+        if (iov.empty()) {
+            asio::post(io, [done = std::move(done)]() mutable {
+                done->complete({}, 0);
+            });
+            return;
+        }
+        c->sends.emplace_back();
+        auto& s = c->sends.back();
+        s.iov = std::move(iov);
+        s.done = std::move(done);
+        send_next(c.get());
+    }
+
+    void uring_work_unit::close(const uring_connection_ptr& c) {
+        if (c->closed)
+            return;
+        c->closed = true;
+        if (live.contains(c.get()))
+            --statistics::repl::uring_sessions;
+        else
+            live[c.get()] = c; // closed before it was opened
+        // nothing completes any more: the handlers belong to a session that has gone.
+        // sent() does not call one on a closed connection
+        c->read_done.reset();
+        if (c->sending) {
+            // the one with the kernel keeps its handler, which keeps the bytes it is
+            // reading, until it comes back
+            while (c->sends.size() > 1)
+                c->sends.pop_back();
+        } else {
+            c->sends.clear();
+        }
+        // a receive or send still with the kernel finishes at once, and the fd is
+        // closed when both are back
+        if (c->fd >= 0 && c->in_flight > 0)
+            ::shutdown(c->fd, SHUT_RDWR);
+        forget_if_done(c.get());
+    }
+
+    void uring_work_unit::forget_if_done(uring_connection* c) {
+        if (!c->closed || c->in_flight > 0)
+            return;
+        // the slot is only given to another connection once nothing refers to it
+        if (c->slot >= 0) {
+            int none = -1;
+            io_uring_register_files_update(&ring, c->slot, &none, 1);
+            free_slots.push_back(c->slot);
+            c->slot = -1;
+        }
+        if (c->owns_fd && c->fd >= 0)
+            ::close(c->fd);
+        c->fd = -1;
+        live.erase(c);
+    }
+
+    uring_socket::uring_socket(std::shared_ptr<uring_work_unit> unit, tcp::socket socket)
+    :   unit(std::move(unit)), socket_(std::move(socket)), conn(std::make_shared<uring_connection>()) {
+        conn->fd = socket_.native_handle();
+        // registering the fd is the ring's business, so it is done on the ring's thread
+        asio::post(this->unit->io, [u = this->unit.get(), c = conn]() {
+            u->open(c);
+        });
+    }
+
+    uring_socket::uring_socket(uring_socket&& other) noexcept
+    :   unit(std::move(other.unit)), socket_(std::move(other.socket_)), conn(std::move(other.conn)) {
+    }
+
+    uring_socket::~uring_socket() {
+        if (!conn)
+            return;
+        // the ring closes the fd once the kernel is done with it, so the number is not
+        // reused under a receive that is still out
+        std::error_code ec;
+        socket_.release(ec);
+        conn->owns_fd = !ec;
+        if (unit->io.stopped()) {
+            // nothing will run the close. the unit closes what is left when it goes
+            return;
+        }
+        asio::post(unit->io, [u = unit.get(), c = conn]() {
+            u->close(c);
+        });
+    }
+}
+#endif
@@ -0,0 +1,246 @@
+//
+// Created by teejip on 10/17/26.
+//
+
+#ifndef BARCH_URING_RESP_SESSION_H
+#define BARCH_URING_RESP_SESSION_H
+#ifdef BARCH_USE_LIBURING
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <liburing.h>
+
+#include "asio_includes.h"
+#include "proto_info.h"
+#include "sastam.h"
+
+namespace barch {
+    /**
+     * a handler the ring holds until the kernel answers for it. asio's composed writes
+     * are move only, so this is type erased by hand rather than kept in a std::function
+     */
+    struct uring_completion {
+        virtual ~uring_completion() = default;
+        virtual void complete(const std::error_code& ec, size_t n) = 0;
+    };
+    typedef std::unique_ptr<uring_completion> uring_completion_ptr;
+
+    template<typename Handler>
+    struct uring_completion_of final : uring_completion {
+        explicit uring_completion_of(Handler h) : handler(std::move(h)) {}
+        void complete(const std::error_code& ec, size_t n) override {
+            handler(ec, n);
+        }
+        Handler handler;
+    };
+
+    template<typename Handler>
+    uring_completion_ptr make_completion(Handler&& h) {
+        return std::make_unique<uring_completion_of<std::decay_t<Handler>>>(std::forward<Handler>(h));
+    }
+
+    /**
+     * a send, kept where the kernel can read it until it completes. The bytes are not
+     * copied: iov points into the buffers the writer gave, which asio's contract keeps
+     * alive until done is called, and resp_session keeps them in the handler. done is
+     * only dropped once the kernel has answered, even for a connection that has gone
+     */
+    struct uring_send {
+        heap::vector<iovec> iov{};
+        msghdr msg{};
+        uring_completion_ptr done{};
+    };
+
+    /**
+     * what a ring knows about one connection. The ring owns it, not the socket, because
+     * the kernel can still answer for a connection after its session has gone
+     */
+    struct uring_connection {
+        int fd{-1};
+        // the ring closes fd once the kernel has let go of it, unless the socket could
+        // not give it up
+        bool owns_fd{true};
+        // the slot the socket is registered in with the ring, -1 when it is not
+        int slot{-1};
+        // received and not read yet, from unread_at
+        heap::vector<uint8_t> unread{};
+        size_t unread_at{0};
+        // end of file, or the error the receive stopped on, once unread is empty
+        std::error_code read_error{};
+        asio::mutable_buffer read_into{};
+        uring_completion_ptr read_done{};
+        // in the order they were written. only the first is with the kernel
+        std::deque<uring_send> sends{};
+        bool receiving{false};
+        bool cancelling{false};
+        bool sending{false};
+        // the kernel refused a multishot receive, so each receive is armed again
+        bool multishot{true};
+        // the socket has gone: nothing completes, and the ring forgets it once the
+        // kernel has answered for everything it was given
+        bool closed{false};
+        int in_flight{0};
+        [[nodiscard]] size_t unread_bytes() const {
+            return unread.size() - unread_at;
+        }
+    };
+    typedef std::shared_ptr<uring_connection> uring_connection_ptr;
+
+    /**
+     * One io_uring ring, run by one resp thread next to that thread's io_context.
+     *
+     * Every connection on the ring receives through one multishot recv into buffers the
+     * ring provides, so a pipelining client costs no syscall per read. Sends are queued
+     * per connection, and whatever the handlers prepared while they ran is submitted in
+     * one go once they are done. Sockets are registered with the ring while there are
+     * slots, and with SQPOLL a kernel thread picks submissions up, so a busy ring need
+     * not enter the kernel at all.
+     *
+     * The io_context waits on the ring's fd, which is how completions wake the thread.
+     * Posts from other threads - a worker finishing an asynch call, a blocking command
+     * resolving - wake it the way they wake any asio thread.
+     */
+    class uring_work_unit {
+    public:
+        explicit uring_work_unit(bool sqpoll);
+        ~uring_work_unit();
+        uring_work_unit(const uring_work_unit&) = delete;
+        uring_work_unit& operator=(const uring_work_unit&) = delete;
+
+        /** false when the kernel has no io_uring, or not the parts used here */
+        [[nodiscard]] bool ok() const {
+            return ready;
+        }
+        void run();
+        void stop();
+
+        // the rest are only called on the unit's own thread
+        void open(const uring_connection_ptr& c);
+        void close(const uring_connection_ptr& c);
+        void read(const uring_connection_ptr& c, asio::mutable_buffer into, uring_completion_ptr done);
+        void write(const uring_connection_ptr& c, heap::vector<iovec> iov, uring_completion_ptr done);
+
+        asio::io_context io{};
+    private:
+        enum op : uint64_t {
+            op_recv = 1,
+            op_send = 2,
+            op_cancel = 3,
+            op_mask = 7
+        };
+        struct completed {
+            uint64_t user_data;
+            int32_t res;
+            uint32_t flags;
+        };
+        static constexpr uint16_t buffer_group = 0;
+
+        void watch();
+        void reap();
+        void submit();
+        io_uring_sqe* next_sqe();
+        void complete(const completed& e);
+        void received(uring_connection* c, int32_t res, uint32_t flags);
+        void sent(uring_connection* c, int32_t res);
+        void take(uring_connection* c, const uint8_t* data, size_t n);
+        void deliver(uring_connection* c);
+        void arm(uring_connection* c);
+        void send_next(uring_connection* c);
+        void give_back(unsigned bid);
+        void return_buffers();
+        void forget_if_done(uring_connection* c);
+        uint8_t* buffer_at(unsigned bid);
+        static uint64_t tag(uring_connection* c, op o) {
+            return (uint64_t) (uintptr_t) c | o;
+        }
+
+        asio::executor_work_guard<asio::io_context::executor_type> guard;
+        io_uring ring{};
+        io_uring_buf_ring* buffers{nullptr};
+        heap::vector<uint8_t> buffer_memory{};
+        unsigned returned{0};
+        heap::vector<int> free_slots{};
+        heap::map<uring_connection*, uring_connection_ptr> live{};
+        heap::vector<completed> completions{};
+        std::optional<asio::posix::stream_descriptor> ring_watch{};
+        bool ring_open{false};
+        bool ready{false};
+        bool submit_posted{false};
+    };
+
+    /**
+     * The socket a resp_session on a ring reads and writes through. It looks enough like
+     * tcp::socket that resp_session parses and dispatches exactly as it does for asio:
+     * async_read_some and async_write_some go to the ring, and everything else - the
+     * addresses CLIENT LIST shows, the blocking writes KEYS makes - to the tcp::socket
+     * underneath, which lives on the ring's io_context.
+     */
+    class uring_socket {
+    public:
+        typedef tcp::socket::executor_type executor_type;
+        typedef tcp::socket lowest_layer_type;
+
+        uring_socket(std::shared_ptr<uring_work_unit> unit, tcp::socket socket);
+        uring_socket(uring_socket&& other) noexcept;
+        uring_socket& operator=(uring_socket&&) = delete;
+        uring_socket(const uring_socket&) = delete;
+        uring_socket& operator=(const uring_socket&) = delete;
+        ~uring_socket();
+
+        executor_type get_executor() {
+            return socket_.get_executor();
+        }
+        tcp::socket& lowest_layer() {
+            return socket_;
+        }
+        [[nodiscard]] const tcp::socket& lowest_layer() const {
+            return socket_;
+        }
+
+        /** the first buffer only, which is all resp_session ever reads into */
+        template<typename MutableBuffers, typename Handler>
+        void async_read_some(const MutableBuffers& buffers, Handler&& handler) {
+            asio::mutable_buffer into = *asio::buffer_sequence_begin(buffers);
+            asio::dispatch(unit->io, [u = unit.get(), c = conn, into,
+                                      done = make_completion(std::forward<Handler>(handler))]() mutable {
+                u->read(c, into, std::move(done));
+            });
+        }
+
+        /** the buffers must stay put until handler is called, as for any asio write */
+        template<typename ConstBuffers, typename Handler>
+        void async_write_some(const ConstBuffers& buffers, Handler&& handler) {
+            heap::vector<iovec> iov;
+            for (auto b = asio::buffer_sequence_begin(buffers); b != asio::buffer_sequence_end(buffers); ++b) {
+                asio::const_buffer out(*b);
+                if (out.size() > 0)
+                    iov.push_back({const_cast<void*>(out.data()), out.size()});
+            }
+            asio::dispatch(unit->io, [u = unit.get(), c = conn, iov = std::move(iov),
+                                      done = make_completion(std::forward<Handler>(handler))]() mutable {
+                u->write(c, std::move(iov), std::move(done));
+            });
+        }
+
+        template<typename ConstBuffers>
+        size_t write_some(const ConstBuffers& buffers, std::error_code& ec) {
+            return socket_.write_some(buffers, ec);
+        }
+    private:
+        std::shared_ptr<uring_work_unit> unit;
+        tcp::socket socket_;
+        uring_connection_ptr conn;
+    };
+
+    inline std::string remote_address_off(const uring_socket& sock) {
+        return ::remote_address_off(sock.lowest_layer());
+    }
+    inline std::string local_address_off(const uring_socket& sock) {
+        return ::local_address_off(sock.lowest_layer());
+    }
+}
+#endif
+#endif //BARCH_URING_RESP_SESSION_H
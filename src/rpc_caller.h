@@ -5,6 +5,7 @@
 #ifndef SWIG_CALLER_H
 #define SWIG_CALLER_H
 #include <cctype>
+#include <sys/uio.h>
 #include "caller.h"
 #include <string>
 #include <vector>
@@ -17,7 +18,10 @@
 #include "auth_api.h"
 #include "rpc/barch_functions.h"
 #include "rpc/redis_parser.h"
+#include "rpc/constants.h"
+#include "statistics.h"
 #include "vector_stream.h"
+#include "latency.h"
 
 struct rpc_caller : caller {
     barch::key_space_ptr ks {get_default_ks()};
@@ -47,9 +51,16 @@ struct rpc_caller : caller {
     // the session sets this to a blocking write on its socket. null means the
     // reply stays in results and is written after the call, as it always was.
     std::function<bool(const char*, size_t)> write_socket_bytes;
+    // the session sets this to a look at its socket that does not block. null means
+    // there is no connection that can go away under a call
+    std::function<bool()> peer_closed_check;
     // the session's reply buffer for this call. GET writes a bulk string
     // here from the leaf so the value is not copied into results first
     vector_stream* reply_out{nullptr};
+    // the session sets this to a send on its socket that does not block. It answers
+    // how many bytes the socket took, or -1 when it cannot be written to now. null
+    // means a large value is copied into reply_out like any other
+    std::function<ssize_t(const iovec*, size_t)> send_vectored;
     // true once write_socket* has put bytes on the socket. write_result must
     // not emit a second reply (an empty results vector is a RESP null).
     bool reply_sent{false};
@@ -65,6 +76,10 @@ struct rpc_caller : caller {
         return (bool) write_socket_bytes && !call_buffering && !collecting_exec;
     }
 
+    [[nodiscard]] bool peer_closed() const override {
+        return peer_closed_check && peer_closed_check();
+    }
+
     bool write_encoded(const vector_stream& encoded) {
         if (encoded.empty()) {
             reply_sent = true;
@@ -330,11 +345,55 @@ struct rpc_caller : caller {
         if (!temp.empty() || collecting_exec || call_buffering || !reply_out) {
             return push_vt(v);
         }
-        redis::rwrite_bulk(*reply_out, v.chars(), v.size);
+        if (v.size < reply_scatter_min || !send_vectored || !send_scattered(v)) {
+            redis::rwrite_bulk(*reply_out, v.chars(), v.size);
+        }
         reply_sent = true;
         return 0;
     }
 
+    /**
+     * Send a large bulk string straight from the leaf, behind the replies already in
+     * reply_out, in one sendmsg. push_bulk runs while the shard's read latch holds the
+     * leaf where it is, and the send does not block, so the latch is not held for
+     * longer than the syscall. Whatever the socket did not take is copied into
+     * reply_out after all, in order, and goes out with the rest of the batch.
+     */
+    bool send_scattered(art::value_type v) {
+        auto& out = *reply_out;
+        char hdr[32];
+        iovec iov[4];
+        size_t n = 0;
+        if (!out.empty())
+            iov[n++] = {out.buf.data(), out.buf.size()};
+        size_t first = n;
+        iov[n++] = {hdr, redis::bulk_header(hdr, v.size)};
+        iov[n++] = {(void*) v.chars(), v.size};
+        iov[n++] = {redis::CRLF, sizeof(redis::CRLF)};
+        ssize_t sent = send_vectored(iov, n);
+        if (sent < 0)
+            return false;
+        ++statistics::repl::scattered_replies;
+        auto left = (size_t) sent;
+        if (first) {
+            size_t pending = out.buf.size();
+            size_t gone = std::min(left, pending);
+            out.buf.erase(out.buf.begin(), out.buf.begin() + (ptrdiff_t) gone);
+            out.pos = out.buf.size();
+            left -= gone;
+        }
+        for (size_t i = first; i < n; ++i) {
+            size_t skip = std::min(left, iov[i].iov_len);
+            left -= skip;
+            size_t rest = iov[i].iov_len - skip;
+            if (rest) {
+                out.write((const char*) iov[i].iov_base + skip, rest);
+                statistics::repl::scattered_bytes_copied += rest;
+            }
+        }
+        return true;
+    }
+
     int push_simple(art::value_type v) override {
         if (!temp.empty())
             push_vt_impl(temp.back(), v, false);
@@ -543,14 +602,23 @@ struct rpc_caller : caller {
     }
     call_type fexec = EXEC;
     commands_t commands;
+    /**
+     * run f with params. logged is the command's append log ticket, if it has one: its
+     * writes are logged under it, and with append_fsync always the call returns once
+     * they are on disk
+     */
     template<typename TC, typename VT>
-    int call(const VT& params, TC&& f) {
+    int call(const VT& params, TC&& f, barch::append_log::ticket* logged = nullptr) {
         if (params.empty()) {
             barch::err({"invalid parameters"});
             return 0;
         }
+        barch::latency::command_timer timed{std::string_view(params[0])};
         if (is_buffering() && (params[0] != "EXEC" || params[0] == "MULTI")) {
             commands.emplace_back(f, params, ks);
+            if (logged && *logged) {
+                commands.back().logged = std::make_shared<barch::append_log::ticket>(std::move(*logged));
+            }
             return 0;
         }
         ++statistics::local_calls;
@@ -573,9 +641,11 @@ struct rpc_caller : caller {
         for (const auto& s : params) {
             args.push_back(s);
         }
+        barch::append_log::active logging(logged);
         try {
 
             cr.call_error = f(*this, args);
+            logging.wait();
         }catch (const std::exception& e) {
             ++statistics::exceptions_raised;
             errors.emplace_back(e.what());
@@ -592,8 +662,8 @@ struct rpc_caller : caller {
         return cr.call_error;
     }
     template<typename TC, typename VT>
-    Variable callv(const VT& params, TC&& f, Variable def = nullptr) {
-        return retval(call(params, f),def);
+    Variable callv(const VT& params, TC&& f, Variable def = nullptr, barch::append_log::ticket* logged = nullptr) {
+        return retval(call(params, f, logged),def);
     }
     // write_result treats r >= 0 as results. An empty results vector is a RESP
     // null, so a continue that only push_error'd has to return -1 here.
@@ -709,7 +779,7 @@ struct rpc_caller : caller {
         auto original = ks;
         for (auto& cmd: commands) {
             this->ks = cmd.space;
-            int e = this->call(cmd.args, cmd.call);
+            int e = this->call(cmd.args, cmd.call, cmd.logged.get());
             // analyze results
             if (e != 0) {
                 buffered_results.emplace_back(errors[0]);
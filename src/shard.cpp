@@ -6,9 +6,12 @@
 #include "module.h"
 #include <random>
 #include <algorithm>
+#include <filesystem>
+#include <limits>
 
 #include "dictionary_compressor.h"
 #include "time_conversion.h"
+#include "rpc/server.h"
 
 static std::random_device rd;
 static std::mt19937 gen(rd());
@@ -73,6 +76,8 @@ art_statistics barch::get_statistics() {
     as.leaf_nodes_replaced = (int64_t) statistics::leaf_nodes_replaced;
     as.pages_evicted = (int64_t) statistics::pages_evicted;
     as.keys_evicted = (int64_t) statistics::keys_evicted;
+    as.keys_evicted_lfu = (int64_t) statistics::keys_evicted_lfu;
+    as.keys_expired = (int64_t) statistics::keys_expired;
     as.pages_defragged = (int64_t) statistics::pages_defragged;
     as.vmm_pages_defragged = (int64_t) statistics::vmm_pages_defragged;
     as.vmm_pages_popped = (int64_t) statistics::vmm_pages_popped;
@@ -144,6 +149,14 @@ art_repl_statistics barch::get_repl_statistics(){
     rs.out_queue_size = (int64_t) statistics::repl::out_queue_size;
     rs.routes_succeeded = (int64_t) statistics::repl::routes_succeeded;
     rs.attempted_routes = (int64_t) statistics::repl::attempted_routes;
+    for (const auto& d : repl::get_destination_statistics()) {
+        rs.repl_backlog += (int64_t) d.backlog;
+        rs.repl_in_flight += (int64_t) d.in_flight;
+        rs.repl_batches_sent += (int64_t) d.batches;
+        rs.repl_commands_acked += (int64_t) d.acked;
+        rs.repl_dropped += (int64_t) d.dropped;
+        rs.repl_lag_ms = std::max<int64_t>(rs.repl_lag_ms, (int64_t) d.lag_ms);
+    }
     return rs;
 }
 #include "ioutil.h"
@@ -264,6 +277,82 @@ void barch::shard::clear_hash() {
 
 void barch::shard::remove_leaf(const logical_address& )  {
 }
+
+// how long the component starting at p is, 0 if it is not one or does not fit
+static size_t component_size(const uint8_t* p, size_t left) {
+    if (!left) return 0;
+    switch (*p) {
+        case art::tinteger:
+        case art::tdouble:
+            return numeric_key_size <= left ? (size_t) numeric_key_size : 0;
+        case art::tshort:
+        case art::tfloat:
+            return num32_key_size <= left ? (size_t) num32_key_size : 0;
+        case art::tstring: {
+            size_t i = 1;
+            while (i < left && p[i] != 0 && p[i] != key_terminator) ++i;
+            return i < left ? i + 1 : 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * which container a hash or ordered set key belongs to, written to id as the lead byte
+ * followed by the container name's component. member is set for the one key per field or
+ * member that is counted: every hash key, and an ordered set's member index key - an
+ * ordered set keeps two keys per member, and the index one begins with an empty component
+ * where the score one begins with the name
+ */
+static bool container_of(art::value_type key, std::string& id, bool& member) {
+    if (key.size < 3 || key.bytes[1] != key_terminator) return false;
+    uint8_t lead = key.bytes[0];
+    if (lead != art::tcomposite_hash && lead != art::tcomposite_ordered_map) return false;
+    size_t at = 2;
+    size_t first = component_size(key.bytes + at, key.size - at);
+    if (!first) return false;
+    member = lead == art::tcomposite_hash;
+    if (lead == art::tcomposite_ordered_map && first == 2 && key.bytes[at] == art::tstring) {
+        // the index marker, the name comes after it
+        at += first;
+        first = component_size(key.bytes + at, key.size - at);
+        if (!first) return false;
+        member = true;
+    }
+    id.assign(1, (char)lead);
+    id.append((const char*)key.bytes + at, first);
+    return true;
+}
+
+void barch::shard::count_container_leaf(value_type key, size_t bytes, int direction) {
+    bool member = false;
+    if (!container_of(key, container_scratch, member)) return;
+    auto i = containers.find(container_scratch);
+    if (direction > 0) {
+        if (i == containers.end()) {
+            i = containers.emplace(container_scratch, container_size{}).first;
+        }
+        i->second.count += member ? 1 : 0;
+        i->second.bytes += bytes;
+        return;
+    }
+    if (i == containers.end()) return;
+    if (member && i->second.count) --i->second.count;
+    i->second.bytes -= std::min<uint64_t>(i->second.bytes, bytes);
+    if (i->second.count == 0 && i->second.bytes == 0) {
+        containers.erase(i);
+    }
+}
+
+barch::abstract_shard::container_size barch::shard::get_container_size(value_type prefix) const {
+    std::string id;
+    bool member = false;
+    if (!container_of(prefix, id, member)) return {};
+    auto i = containers.find(id);
+    if (i == containers.end()) return {};
+    return i->second;
+}
 bool barch::shard::remove_leaf_from_uset(value_type key) {
     auto i = h.find(key_query{key});
     if (i != h.end()) {
@@ -352,25 +441,148 @@ void barch::shard::read_extra(std::istream &in) {
         opt_ordered_keys = ordered != 0;
         --extra;
     }
+    // the key filter, when it was on while saving. a filter read back saves load_hash a
+    // pass over every key to rebuild it
+    if (extra >= sizeof(uint32_t)) {
+        uint32_t filter_size = 0;
+        readp(in, filter_size);
+        extra -= sizeof(uint32_t);
+        if (filter_size <= extra) {
+            if (has_static_bloom_filter()) {
+                filter_restored = bloom.read(in, filter_size);
+            } else {
+                for (uint32_t i = 0; i < filter_size; ++i) {
+                    uint8_t x;
+                    readp(in, x);
+                }
+            }
+            extra -= filter_size;
+        }
+    }
+    // how far into the append log the snapshot goes, in a file written since there is one
+    on_disk = true;
+    if (extra >= sizeof(uint64_t)) {
+        readp(in, log_position.next);
+        extra -= sizeof(uint64_t);
+    }
+    // what load_hash counts, so that a load that has no hashed index to rebuild need not
+    // read the leaves at all. each delta carries it again, the last one read is current
+    summary_restored = false;
+    if (extra >= sizeof(uint32_t)) {
+        uint32_t summary_size = 0;
+        readp(in, summary_size);
+        extra -= sizeof(uint32_t);
+        if (summary_size <= extra) {
+            summary_restored = read_summary(in, summary_size);
+            extra -= summary_size;
+        }
+    }
     // to keep backwards compatibility between shards
     while (extra > 0) {
         uint8_t x;
         readp(in, x); // bytes from some future version
+        --extra;
     }
 }
 void barch::shard::write_extra(std::ostream &of) const {
-    uint32_t extra = 1;
+    // every delta save writes the extra again, and the filter is a good deal bigger than
+    // the few pages a delta usually holds, so with deltas on it is rebuilt on load instead
+    uint32_t filter_size = get_max_save_deltas() ? 0 : bloom.stored_size();
+    uint64_t fixed = 1 + sizeof(uint32_t) + filter_size + sizeof(uint64_t) + sizeof(uint32_t);
+    // left out when it does not fit, and the load counts from the leaves instead
+    uint64_t summary = summary_size();
+    if (fixed + summary > std::numeric_limits<uint32_t>::max()) summary = 0;
+    // the filter size is written even when there is no filter, so that the log position
+    // after it is where a reader looks. one that predates it skips the position
+    uint32_t extra = (uint32_t) (fixed + summary);
 
     writep(of, extra);
     uint8_t ordered = opt_ordered_keys ? 1 : 0;
     writep(of, ordered);
+    writep(of, filter_size);
+    if (filter_size) {
+        bloom.write(of);
+    }
+    writep(of, log_position.next);
+    writep(of, (uint32_t) summary);
+    if (summary) {
+        write_summary(of);
+    }
     // in future we can extend with more options here
 }
+uint64_t barch::shard::summary_size() const {
+    uint64_t r = 3 * sizeof(uint64_t);
+    for (auto& [id, cs] : containers) {
+        r += sizeof(uint32_t) + id.size() + 2 * sizeof(uint64_t);
+    }
+    return r;
+}
+void barch::shard::write_summary(std::ostream &of) const {
+    writep(of, (uint64_t) tomb_stones);
+    writep(of, (uint64_t) h.size());
+    writep(of, (uint64_t) containers.size());
+    for (auto& [id, cs] : containers) {
+        writep(of, (uint32_t) id.size());
+        writep(of, id.data(), id.size());
+        writep(of, cs.count);
+        writep(of, cs.bytes);
+    }
+}
+bool barch::shard::read_summary(std::istream &in, uint32_t size) {
+    auto skip = [&in](uint64_t bytes) {
+        uint8_t x;
+        for (; bytes > 0; --bytes) readp(in, x);
+    };
+    if (size < 3 * sizeof(uint64_t)) {
+        skip(size);
+        return false;
+    }
+    uint64_t tombs = 0, hashed = 0, count = 0;
+    readp(in, tombs);
+    readp(in, hashed);
+    readp(in, count);
+    uint64_t rest = size - 3 * sizeof(uint64_t);
+    heap::string_map<container_size> read{};
+    std::string id;
+    for (; count > 0; --count) {
+        uint32_t len = 0;
+        if (rest < sizeof(uint32_t)) break;
+        readp(in, len);
+        rest -= sizeof(uint32_t);
+        if (rest < len + 2 * sizeof(uint64_t)) break;
+        id.resize(len);
+        readp(in, id.data(), len);
+        container_size cs{};
+        readp(in, cs.count);
+        readp(in, cs.bytes);
+        rest -= len + 2 * sizeof(uint64_t);
+        read.emplace(id, cs);
+    }
+    if (count > 0 || rest > 0 || in.fail()) {
+        skip(rest);
+        return false;
+    }
+    tomb_stones = tombs;
+    summary_hashed = hashed;
+    containers = std::move(read);
+    return true;
+}
 
 
 bool barch::shard::_save(bool stats) const {
     auto *t = this;
-    if ((nodes.get_main().get_bytes_allocated()+leaves.get_main().get_bytes_allocated())==0) return true;
+    // taken under the latch the caller holds, so every entry of this shard numbered below
+    // it is in what is written, and none after
+    auto at = append_log::current();
+    if ((nodes.get_main().get_bytes_allocated()+leaves.get_main().get_bytes_allocated())==0) {
+        // nothing is written. a shard that never had files holds all the log does, one
+        // that has them still holds what they say
+        if (!on_disk) append_log::saved(name, shard_number, at.next);
+        return true;
+    }
+    // what the files held before is still what they hold if these are not written
+    auto was = log_position;
+    log_position = std::move(at);
     bool saved = false;
     node_ptr troot;
     size_t tsize;
@@ -405,19 +617,26 @@ bool barch::shard::_save(bool stats) const {
         //leaves.borrow(get_leaves().get_main());
         //nodes.borrow(get_nodes().get_main());
         if (!get_leaves().self_save_extra(EXT, save_stats_and_root)) {
+            log_position = std::move(was);
             return false;
         }
 
         if (!get_nodes().self_save_extra( EXT, [&](std::ostream &) {
         })) {
+            log_position = std::move(was);
             return false;
         }
     }
+    on_disk = true;
+    append_log::saved(name, shard_number, log_position.next);
     return true;
 }
 bool barch::shard::save(bool stats) {
     //std::unique_lock guard(save_load_mutex); // prevent save and load from occurring concurrently
     bool success = false;
+    // a snapshot taken while the append log replays would say it holds entries that are
+    // not in it yet
+    append_log::wait_for_recovery();
     std::unique_lock guard(save_load_mutex);
     saving = true;
     auto st = std::chrono::high_resolution_clock::now();
@@ -516,6 +735,10 @@ bool barch::shard::reload_holding_lock() {
 }
 bool barch::shard::_load(bool) {
     h.clear();
+    filter_restored = false;
+    summary_restored = false;
+    log_position = {};
+    on_disk = false;
     auto *t = this;
     logical_address root{nullptr};
     bool is_leaf = false;
@@ -534,12 +757,16 @@ bool barch::shard::_load(bool) {
     };
     auto st = std::chrono::high_resolution_clock::now();
 
-    if (!get_nodes().load_extra(EXT, [&](std::istream &) {
-    })) {
-        return false;
-    }
-    if (!get_leaves().load_extra(EXT, load_stats_and_root)) {
-        return false;
+    bool loaded = get_nodes().load_extra(EXT, [&](std::istream &) {})
+                  && get_leaves().load_extra(EXT, load_stats_and_root);
+    if (!loaded) {
+        // a shard that was never saved has no files and is loaded as the empty shard it
+        // is, which holds nothing of the append log and keeps all of it. files that are
+        // there and could not be read are a load that failed, and the log keeps what the
+        // shard said it held before
+        if (std::filesystem::exists(get_leaves().get_name() + EXT)) return false;
+        append_log::saved(name, shard_number, log_position.next);
+        return true;
     }
     root = logical_address{root.address(), this};// translate root to the now
     if (is_leaf) {
@@ -550,6 +777,9 @@ bool barch::shard::_load(bool) {
     }
     page_modifications::inc_all_tickers();
     load_hash();
+    restore_bloom();
+    mods = get_modifications(); // what was just read is what is saved
+    append_log::saved(name, shard_number, log_position.next);
     auto now = std::chrono::high_resolution_clock::now();
     const auto d = std::chrono::duration_cast<std::chrono::milliseconds>(now - st);
     const auto dm = std::chrono::duration_cast<std::chrono::microseconds>(now - st);
@@ -568,12 +798,11 @@ bool barch::shard::load(bool) {
     std::unique_lock guard(save_load_mutex); // prevent save and load from occurring concurrently
     try {
         unique_latch release(this->latch);
-        _load(true);
+        return _load(true);
     }catch (std::exception &e) {
         log({"could not load",e.what()});
         return false;
     }
-    return true;
 }
 bool barch::shard::load_holding_lock() {
     // the caller holds the shard write lock. LOAD takes the whole space so a
@@ -586,8 +815,7 @@ bool barch::shard::load_holding_lock() {
         // arena free list from the file is read into a shard that still holds
         // the old one, and read_emancipated logs "erased should be empty"
         _clear();
-        _load(true);
-        return true;
+        return _load(true);
     }catch (std::exception &e) {
         log({"could not load",e.what()});
         return false;
@@ -635,6 +863,7 @@ bool barch::shard::retrieve(std::istream& unused(in)) {
         }
         page_modifications::inc_all_tickers();
         load_hash();
+        restore_bloom();
         auto now = std::chrono::high_resolution_clock::now();
         const auto d = std::chrono::duration_cast<std::chrono::milliseconds>(now - st);
         const auto dm = std::chrono::duration_cast<std::chrono::microseconds>(now - st);
@@ -657,6 +886,7 @@ void barch::shard::begin() {
     save_size = size;
     save_stats.clear();
     stats_to_stream(save_stats, owned);
+    save_containers = containers;
     {
        storage_release release(this->shared_from_this());
         get_leaves().begin();
@@ -683,8 +913,90 @@ void barch::shard::rollback() {
     size = save_size;
     save_stats.seek(0);
     stream_to_stats(save_stats, owned);
+    containers = save_containers;
     transacted = false;
 }
+void barch::shard::restore_bloom() {
+    // the filter was not saved with the shard, or was saved while it was off: size one
+    // for the keys just loaded and fill it from them
+    if (!filter_restored) {
+        if (has_static_bloom_filter() && load_walk_pending) {
+            // the leaves were not read, and are not read for this either
+            bloom.defer();
+        } else {
+            create_bloom(has_static_bloom_filter());
+            load_bloom();
+        }
+    }
+    filter_restored = false;
+}
+void barch::shard::finish_load() {
+    if (!load_walk_pending.load(std::memory_order_acquire)) return;
+    // a save, load or clear meanwhile would leave this pass filling the wrong things, so
+    // it waits for the next maintenance pass instead
+    std::unique_lock guard(save_load_mutex, std::try_to_lock);
+    if (!guard.owns_lock()) return;
+    bool expiring = false;
+    bool filtering = false;
+    {
+        unique_latch l(this->latch);
+        if (!load_walk_pending) return;
+        expiring = expiries_pending;
+        filtering = bloom.deferred();
+        if (filtering) bloom.start_rebuild(get_tree_size() + get_hash_size());
+    }
+    {
+        // keys written from here on schedule their own expiry and go into the filter being
+        // built, so readers and writers can carry on while the leaves are read
+        shared_latch l(this->latch);
+        auto &lc = get_leaves();
+        lc.iterate_pages([this,expiring,filtering](size_t s, size_t unused(page), auto& data) {
+            page_iterator(data, s, [this,expiring,filtering](const leaf *l, uint32_t unused(pos)) {
+                if (expiring && l->is_expiry()) {
+                    auto key = l->get_key();
+                    expiries.add(key.chars(), key.size, l->expiry_ms());
+                }
+                if (filtering && !l->deleted() && !l->is_tomb()) {
+                    bloom.add_rebuilt(l->get_key());
+                }
+                return true;
+            });
+        });
+    }
+    unique_latch l(this->latch);
+    if (filtering) bloom.finish_rebuild();
+    expiries_pending = false;
+    load_walk_pending = false;
+}
+void barch::shard::rebuild_bloom() {
+    {
+        // maintenance asks every pass, and the answer is almost always no - which a
+        // shared latch is enough to find out
+        shared_latch l(this->latch);
+        if (!bloom.needs_rebuild(get_tree_size() + get_hash_size())) return;
+    }
+    {
+        unique_latch l(this->latch);
+        size_t live = get_tree_size() + get_hash_size();
+        if (!bloom.needs_rebuild(live)) return;
+        bloom.start_rebuild(live);
+    }
+    {
+        // keys written from here on go into both filters, so the replacement only has to
+        // be filled with what is already there, and readers can carry on while it is
+        shared_latch l(this->latch);
+        auto &lc = get_leaves();
+        lc.iterate_pages([this](size_t s, size_t unused(page), auto& data) {
+            page_iterator(data, s, [this](const leaf *l, uint32_t unused(pos)) {
+                if (l->deleted() || l->is_tomb()) return true;
+                bloom.add_rebuilt(l->get_key());
+                return true;
+            });
+        });
+    }
+    unique_latch l(this->latch);
+    bloom.finish_rebuild();
+}
 void barch::shard::load_bloom() {
     if (!has_static_bloom_filter()) return;
     auto &lc = get_leaves();
@@ -707,10 +1019,15 @@ void barch::shard::_clear() {
     saf_get_ops = 0;
     saf_keys_found = 0;
     queue_size = 0;
-    create_bloom(has_static_bloom_filter()); // resets the bloom
+    expiries.clear();
+    lfu_pool.clear();
+    containers.clear();
     get_leaves().clear();
     get_nodes().clear();
     h.clear();
+    load_walk_pending = false;
+    expiries_pending = false;
+    create_bloom(has_static_bloom_filter()); // resets the bloom, sized for an empty shard
     // take away what this shard held, rather than zeroing counters the other shards share.
     // the event counters (oom_avoided_inserts, keys_found, new_keys_added, keys_replaced)
     // count things that happened rather than things that exist, so clearing a shard does
@@ -729,7 +1046,14 @@ void barch::shard::clear() {
     std::unique_lock guard(save_load_mutex); // prevent save and load from occurring concurrently
     storage_release release(this->shared_from_this());
     _clear();
-
+    append_log::cleared(name, shard_number);
+}
+barch::append_log::position barch::shard::get_log_position() const {
+    std::shared_lock guard(const_cast<std::shared_mutex&>(save_load_mutex));
+    return log_position;
+}
+bool barch::shard::changed_since_saved() const {
+    return get_modifications() != mods;
 }
 
 bool barch::shard::insert(value_type key, value_type value, bool update, const NodeResult &fc) {
@@ -772,6 +1096,9 @@ bool barch::shard::hash_insert(const key_options &options, value_type key, value
 
                 dl->set_value(value);
                 dl->set_expiry(options.is_keep_ttl() ? dl->expiry_ms() : options.get_expiry());
+                if (!options.is_keep_ttl() && options.get_expiry() > 0) {
+                    schedule_expiry(key, (int64_t)options.get_expiry());
+                }
                 options.is_volatile() ? dl->set_volatile() : dl->unset_volatile();
                 dl->set_compressed(options.is_compressed());
                 last_leaf_added = n;
@@ -1074,6 +1401,7 @@ void barch::shard::insert_cached_miss(value_type unfiltered_key, uint64_t ttl_ms
     }
     if (valid_tomb && ttl_ms && existing.cl()->is_expiry()) {
         existing.l()->set_expiry(art::now() + static_cast<leaf::ExpiryType>(ttl_ms));
+        schedule_expiry(key, existing.cl()->expiry_ms());
         call_unblock(std::string(key.chars(), key.size));
         return;
     }
@@ -1173,6 +1501,33 @@ art::node_ptr barch::shard::search(value_type unfiltered_key) {
     // check if r.cl()->is_tombstone() and return nullptr
     return r;
 }
+
+void barch::shard::search_batch(const value_type* unfiltered_keys, size_t count, node_ptr* found) {
+    heap::vector<std::string> kbufs(count);
+    heap::vector<value_type> keys(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = s_filter_key(kbufs[i], unfiltered_keys[i]);
+    }
+    if (!opt_ordered_keys) {
+        for (size_t i = 0; i < count; ++i) {
+            auto n = from_unordered_set(keys[i]);
+            found[i] = !n.null() && n.cl()->is_tomb() ? nullptr : n;
+        }
+        return;
+    }
+
+    art::find_batch(this, keys.data(), count, found);
+    for (size_t i = 0; i < count; ++i) {
+        auto& r = found[i];
+        if (r.null()) {
+            if (dependencies) {
+                r = dependencies->search(keys[i]);
+            }
+        } else if (r.cl()->is_tomb()) {
+            r = nullptr;
+        }
+    }
+}
 art::node_ptr barch::shard::tree_minimum() const {
     auto dmin = dependencies ? dependencies->tree_minimum() : nullptr;
     auto tmin = art::minimum(this);
@@ -1263,6 +1618,23 @@ void barch::shard::merge(const shard_ptr& to, merge_options options) {
 }
 void barch::shard::load_hash() {
     auto &lc = get_leaves();
+    if (summary_restored && summary_hashed == 0) {
+        // the counts came with the shard and there is no hashed index to rebuild, so the
+        // leaves are not walked and a mapped snapshot stays out of memory. The expiry wheel
+        // is filled by maintenance, until then keys expire when they are read
+        summary_restored = false;
+        expiries_pending = true;
+        load_walk_pending = true;
+        if (log_loading_messages == 1)
+            log({"loaded counts of [",lc.get_name(),"] with the shard, the leaves were not read"});
+        return;
+    }
+    if (summary_restored) {
+        // the hashed index needs every leaf read anyway, and is counted along with the rest
+        tomb_stones = 0;
+        containers.clear();
+        summary_restored = false;
+    }
     size_t encountered = 0;
 
     lc.iterate_pages([this,&encountered](size_t s, size_t page, auto& data) {
@@ -1270,9 +1642,12 @@ void barch::shard::load_hash() {
 
             if (l->is_tomb()) {
                 ++tomb_stones;
-            }else {
-                add_bloom(l->get_key());
             }
+            if (l->is_expiry()) {
+                auto key = l->get_key();
+                expiries.add(key.chars(), key.size, l->expiry_ms());
+            }
+            count_container_leaf(l->get_key(), l->byte_size(), 1);
 
             if (l->is_hashed()) {
 
@@ -1449,10 +1824,71 @@ void abstract_random_update(barch::shard *t, const std::function<void(const barc
 
     abstract_eviction(updater, [&lc, random_page]() { return lc.get_page_buffer(random_page); });
 }
+// samples a few random pages into the shard's candidate pool and evicts the least
+// frequently used keys in it, a round at a time, until memory is back under the
+// threshold or the pass has done its share
 void abstract_lfu_eviction(barch::shard *t, const std::function<bool(const barch::leaf *l)> &predicate) {
-    if (statistics::logical_allocated < calc_mem_threshold()) return;
+    auto threshold = calc_mem_threshold();
+    if (statistics::logical_allocated < threshold) return;
+    storage_release release(t->shared_from_this());
     auto &lc = t->get_leaves();
-    abstract_eviction(t, predicate, [&lc]() { return lc.get_lru_page(); });
+    auto page_num = lc.max_allocated_page_num();
+    if (!page_num) return;
+    uint8_t clock = t->lfu_clock;
+    std::uniform_int_distribution<size_t> dist(1, page_num);
+
+    for (unsigned round = 0; round < lfu_eviction_rounds && statistics::logical_allocated >= threshold; ++round) {
+        for (unsigned s = 0; s < lfu_sample_pages; ++s) {
+            auto page = lc.get_page_ptr(dist(gen));
+            if (!page.first) continue;
+            page_iterator_ptr(page.first, page.second, [&](const barch::leaf *l, uint32_t) {
+                if (!l->deleted() && predicate(l)) {
+                    t->offer_lfu_candidate(l, t->lfu_counts.count(l->get_key(), clock));
+                }
+                return true;
+            });
+        }
+        if (t->lfu_pool.empty()) return;
+
+        while (!t->lfu_pool.empty() && statistics::logical_allocated >= threshold) {
+            auto c = std::move(t->lfu_pool.front());
+            t->lfu_pool.erase(t->lfu_pool.begin());
+            value_type key{c.key.data(), c.key.size()};
+            auto n = c.hashed ? t->from_unordered_set(key) : art::search(t, key);
+            if (n.null()) continue;
+            // read straight from the page, cl() would count this as a use
+            const leaf *l = lc.read<leaf>(n.logical);
+            if (l == nullptr || l->deleted() || !predicate(l)) continue;
+            if (t->lfu_counts.count(key, clock) > c.count + 1) {
+                // it was used since it was sampled, let the next sample decide
+                continue;
+            }
+            // evicting frees the leaf while its key is still being used to find it
+            heap::vector<uint8_t> copy(l->byte_size());
+            memcpy(copy.data(), l, copy.size());
+            if (t->evict(reinterpret_cast<const leaf*>(copy.data()))) {
+                ++statistics::keys_evicted_lfu;
+            }
+        }
+    }
+}
+
+// advances the clock lfu counters decay against. With decay switched off the clock
+// stops where it is, rather than going back to 0 and aging every key at once. The
+// counters grow with the shard, which needs the latch, so it is only taken when they
+// have to
+void refresh_lfu_clock(barch::shard *t) {
+    if (!t->opt_keys_lfu) return;
+    auto keys = t->get_size();
+    if (!t->lfu_counts.fits(keys)) {
+        storage_release release(t->shared_from_this());
+        t->lfu_counts.fit(keys);
+    }
+    t->lfu_log_factor = std::min<uint64_t>(barch::get_lfu_log_factor(), std::numeric_limits<uint32_t>::max());
+    auto decay = barch::get_lfu_decay_time();
+    if (decay) {
+        t->lfu_clock = (uint8_t)(art::now() / 60000 / decay);
+    }
 }
 
 void run_evict_all_keys_lru(barch::shard *t) {
@@ -1490,9 +1926,26 @@ void run_evict_volatile_expired_keys(barch::shard *t) {
     });
 }
 
+// reclaims the keys whose deadline has passed since the last pass, see expiry_wheel
 void run_sweep_expired_keys(barch::shard *t) {
-    abstract_random_eviction(t, [](const barch::leaf *l) -> bool {
-        return l->expired();
+    if (!t->expiries.size()) return;
+    storage_release release(t->shared_from_this());
+    auto now = art::now();
+    t->expiries.advance(now, expiry_sweep_limit, [t](const barch::expiry_wheel::entry& e) {
+        value_type key{e.key.data(), e.key.size()};
+        auto n = t->from_unordered_set(key);
+        if (n.null()) n = art::search(t, key);
+        if (n.null()) return;
+        // not cl(), that would count as a use
+        const leaf *l = t->get_leaves().read<leaf>(n.logical);
+        // a key given a later deadline since has an entry of its own
+        if (l == nullptr || l->deleted() || !l->expired()) return;
+        heap::vector<uint8_t> copy(l->byte_size());
+        memcpy(copy.data(), l, copy.size());
+        if (t->evict(reinterpret_cast<const leaf*>(copy.data()))) {
+            ++statistics::keys_expired;
+            ++t->expiries_reclaimed;
+        }
     });
 }
 
@@ -1521,7 +1974,9 @@ void barch::shard::start_maintain() {
 
 }
 void barch::shard::maintenance() {
+    auto started = std::chrono::high_resolution_clock::now();
     try {
+        refresh_lfu_clock(this);
         run_sweep_lru_keys(this);
         run_evict_all_keys_lfu(this);
         run_evict_all_keys_random(this);
@@ -1534,6 +1989,8 @@ void barch::shard::maintenance() {
         if (this->opt_active_defrag) {
             run_defrag(); // periodic
         }
+        finish_load();
+        rebuild_bloom();
         if (saf_keys_found) {
             unique_latch l(this->latch);
             statistics::keys_found += saf_keys_found;
@@ -1555,4 +2012,5 @@ void barch::shard::maintenance() {
     }catch (std::exception& e) {
         barch::err({e.what()});
     }
+    maintenance_time.record(micros(started));
 }
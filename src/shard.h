@@ -11,6 +11,7 @@
 #include "abstract_shard.h"
 #include "merge_options.h"
 #include "overflow_hash.h"
+#include "expiry_wheel.h"
 #include "vector_stream.h"
 #include <condition_variable>
 #include <memory>
@@ -145,6 +146,20 @@ namespace barch {
     private:
         const std::string EXT = ".dat";
         bool with_stats{true};
+        // set by read_extra when the key filter came back with the shard
+        bool filter_restored{false};
+        // set by read_extra when the tomb stone and container counts came back with the
+        // shard, with the number of hashed keys it held
+        bool summary_restored{false};
+        uint64_t summary_hashed{0};
+        // a load left the expiry wheel or the key filter to be filled from the leaves by
+        // maintenance, see finish_load
+        std::atomic<bool> load_walk_pending{false};
+        bool expiries_pending{false};
+        // how far into the append log the files go, as read back or as last saved, and
+        // whether there are any files at all
+        mutable append_log::position log_position{};
+        mutable bool on_disk{false};
         mutable query_pair qp{this};
         mutable hk_hash hk_h{qp};
         mutable hk_eq hk_e{qp};
@@ -155,6 +170,9 @@ namespace barch {
         bool remove_from_unordered_set(value_type key);
         void write_extra(std::ostream& of) const ;
         void read_extra(std::istream& of);
+        [[nodiscard]] uint64_t summary_size() const;
+        void write_summary(std::ostream& of) const;
+        bool read_summary(std::istream& in, uint32_t size);
         shard_ptr dependencies;
         uint64_t deletes{};
         uint64_t inserts{};
@@ -181,6 +199,53 @@ namespace barch {
         std::chrono::high_resolution_clock::time_point start_save_time {};
         uint64_t mods{};
 
+        /**
+         * the least frequently used keys lfu eviction has seen so far, coldest first. Each
+         * pass samples a few random pages into it and evicts from the front, so a key only
+         * has to be colder than what the samples turned up, not the coldest in the shard -
+         * and the candidates a pass did not need stay here to be weighed against the next
+         * sample. A key is looked up again before it goes, since it may have warmed up,
+         * moved or gone in the meantime
+         */
+        struct lfu_candidate {
+            heap::string key{};
+            unsigned count{};
+            bool hashed{};
+        };
+        heap::vector<lfu_candidate> lfu_pool{};
+
+        /**
+         * fields per hash and members per ordered set, with the leaf bytes each uses. Kept
+         * up to date as the leaves are created and freed rather than by the commands, so
+         * that whatever removes a field - HDEL, ZPOPMIN, the expiry wheel, eviction, DEL of
+         * the whole container - is counted the same way, and HLEN and ZCARD are a lookup
+         * under a shared lock instead of a walk under an exclusive one. Saved with the
+         * shard, and rebuilt from the leaves on load only when it was not
+         */
+        heap::string_map<container_size> containers{};
+        heap::string_map<container_size> save_containers{};
+        std::string container_scratch{};
+        void count_container_leaf(value_type key, size_t bytes, int direction) override;
+        container_size get_container_size(value_type prefix) const override;
+
+        expiry_wheel expiries{};
+        std::atomic<uint64_t> expiries_reclaimed{};
+        void schedule_expiry(value_type key, int64_t deadline) override {
+            expiries.add(key.chars(), key.size, deadline);
+        }
+        void offer_lfu_candidate(const leaf* l, unsigned count) {
+            if (lfu_pool.size() >= lfu_pool_size && count >= lfu_pool.back().count) return;
+            auto key = l->get_key();
+            for (auto& c : lfu_pool) {
+                if (c.key.size() == key.size && memcmp(c.key.data(), key.bytes, key.size) == 0) return;
+            }
+            auto at = std::upper_bound(lfu_pool.begin(), lfu_pool.end(), count, [](unsigned v, const lfu_candidate& c) {
+                return v < c.count;
+            });
+            lfu_pool.insert(at, {heap::string(key.chars(), key.size), count, l->is_hashed()});
+            if (lfu_pool.size() > lfu_pool_size) lfu_pool.pop_back();
+        }
+
         node_ptr get_root() const override {
             return root;
         }
@@ -202,18 +267,24 @@ namespace barch {
         tree{"node", shard_number, root,size}{
             abstract_shard::opt_evict_all_keys_lru = get_evict_allkeys_lru();
             abstract_shard::opt_evict_volatile_keys_lru = get_evict_volatile_lru();
+            opt_keys_lfu = opt_evict_all_keys_lfu || opt_evict_volatile_keys_lfu;
+            if (opt_keys_lfu) lfu_counts.fit(size);
             barch::repl::clear_route(shard_number);
             if (has_static_bloom_filter())
                 create_bloom(true);
+            latch_series = latency::latch_series(name, shard_number);
             start_maintain();
 
         }
         // name configurable
         shard(const std::string& name, uint64_t size, size_t shard_number) :
         tree{name, shard_number, root,size}{
+            opt_keys_lfu = opt_evict_all_keys_lfu || opt_evict_volatile_keys_lfu;
+            if (opt_keys_lfu) lfu_counts.fit(size);
             barch::repl::clear_route(shard_number);
             if (has_static_bloom_filter())
                 create_bloom(true);
+            latch_series = latency::latch_series(name, shard_number);
             start_maintain();
 
         }
@@ -226,6 +297,7 @@ namespace barch {
             leaves.get_main().set_check_mem(false);
             //repl_client.shard = shard_number;
             barch::repl::clear_route(shard_number);
+            latch_series = latency::latch_series(name, shard_number);
             start_maintain();
         }
         shard& operator=(const shard&) = delete;
@@ -296,9 +368,24 @@ namespace barch {
         bool reload_holding_lock() final;
 
         void load_bloom() final;
+        /**
+         * after a load: fill the key filter from the leaves unless it was read back, or
+         * leave that to finish_load when load_hash did not read the leaves either
+         */
+        void restore_bloom();
+        /**
+         * what a load left for later: one pass over the leaves, with only the shard's read
+         * lock held, that schedules their expiries and fills a deferred key filter
+         */
+        void finish_load();
+        /** replace the key filter once it passes too much, see key_filter.h */
+        void rebuild_bloom();
 
         bool retrieve(std::istream& in) final;
 
+        append_log::position get_log_position() const final;
+        bool changed_since_saved() const final;
+
         void begin() final;
 
         void commit() final;
@@ -333,6 +420,7 @@ namespace barch {
          * @return not null key if it exists (incl. pull sources)
          */
         node_ptr search(value_type key) final;
+        void search_batch(const value_type* keys, size_t count, node_ptr* found) final;
         bool is_present(value_type key) final;
         art::node_ptr lower_bound(art::value_type key) final;
         art::node_ptr lower_bound(art::trace_list &trace, art::value_type key) final;
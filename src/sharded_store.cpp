@@ -12,11 +12,24 @@
 #include <optional>
 
 #include "art/iterator.h"
+#include "glob.h"
 #include "keys.h"
 #include "statistics.h"
 
 namespace barch {
 
+void log_written(const key_space_ptr& spc, const shard_ptr& t, const art::key_options& opts,
+                 art::value_type key, art::value_type value) {
+    if (!append_log::recording()) return;
+    append_log::wrote(spc->get_canonical_name(), t->get_shard_number(), key.to_view(), value.to_view(),
+                      opts.flags, opts.get_expiry());
+}
+
+void log_removed(const key_space_ptr& spc, const shard_ptr& t, art::value_type key) {
+    if (!append_log::recording()) return;
+    append_log::removed(spc->get_canonical_name(), t->get_shard_number(), key.to_view());
+}
+
 /**
  * route to the shard owning `key` and lock it, making sure the route is still true once
  * the lock is held.
@@ -83,12 +96,33 @@ const heap::vector<shard_ptr>& sharded_store::shards() const {
 
 // ---- single key ----
 
+// a shard with sources cannot answer from its own bloom filter alone, because the key
+// may only exist upstream - so it is filtered when every shard it pulls from is, and a
+// key is ruled out only when none of their filters has it either
+static bool filtered(const shard_ptr& t) {
+    for (auto s = t; s; s = s->sources()) {
+        if (!s->has_static_bloom_filter()) return false;
+    }
+    return true;
+}
+
+static bool ruled_out(const shard_ptr& t, art::value_type key) {
+    if (!filtered(t)) return false;
+    for (auto s = t; s; s = s->sources()) {
+        if (s->is_bloom(key)) return false;
+    }
+    t->bloom.ruled_out.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// a key the filter let through, and whether the shard had it after all
+static void passed_filter(const shard_ptr& t, bool found) {
+    if (!filtered(t)) return;
+    t->bloom.passed.fetch_add(1, std::memory_order_relaxed);
+    if (!found) t->bloom.false_positives.fetch_add(1, std::memory_order_relaxed);
+}
+
 bool sharded_store::search(art::value_type key, const node_cb& cb) const {
-    // a shard with sources cannot answer from its own bloom filter alone, because the
-    // key may only exist upstream
-    auto ruled_out = [&key](const shard_ptr& t) {
-        return !t->sources() && t->has_static_bloom_filter() && !t->is_bloom(key);
-    };
     auto t = shard_for(key);
     if (!t) return false;
 
@@ -96,40 +130,97 @@ bool sharded_store::search(art::value_type key, const node_cb& cb) const {
     // where routing cannot move a key the filter is worth reading before taking the
     // lock, because a miss saves the lock entirely. Where it can, a filter read off the
     // shard that used to own the key says nothing, so it waits until the route is settled
-    if (!moves && ruled_out(t)) {
+    if (!moves && ruled_out(t, key)) {
         return false;
     }
     std::optional<read_lock> release;
     t = route_locked<read_lock>(*this, key, release);
     if (!t) return false;
-    if (moves && ruled_out(t)) {
+    if (moves && ruled_out(t, key)) {
         return false;
     }
     auto r = t->search(key);
-    if (r.null() || r.cl()->is_tomb()) {
+    const bool found = !r.null() && !r.cl()->is_tomb();
+    passed_filter(t, found);
+    if (!found) {
         return false;
     }
     cb(r);
     return true;
 }
 
+void sharded_store::search_many(const art::value_type* keys, size_t count, const batch_cb& cb) const {
+    if (!count) return;
+    heap::vector<shard_ptr> owners(count);
+    heap::vector<shard_ptr> involved;
+    heap::vector<art::node_ptr> found(count);
+    heap::vector<art::value_type> group;
+    heap::vector<art::node_ptr> group_found;
+    heap::vector<size_t> positions;
+    for (;;) {
+        involved.clear();
+        for (size_t i = 0; i < count; ++i) {
+            owners[i] = shard_for(keys[i]);
+            if (owners[i]) involved.push_back(owners[i]);
+        }
+        std::sort(involved.begin(), involved.end(), [](const shard_ptr& a, const shard_ptr& b) {
+            return a->get_shard_number() < b->get_shard_number();
+        });
+        involved.erase(std::unique(involved.begin(), involved.end()), involved.end());
+
+        // the order rule of keyspace_locks.h, and the same re-route as route_locked
+        read_guard held;
+        for (auto& t : involved) {
+            held.locks.emplace_back(t);
+        }
+        bool moved = false;
+        for (size_t i = 0; i < count && !moved; ++i) {
+            moved = owners[i] && spc->route_moved(keys[i], owners[i]);
+        }
+        if (moved) continue;
+
+        for (auto& t : involved) {
+            group.clear();
+            positions.clear();
+            for (size_t i = 0; i < count; ++i) {
+                if (owners[i] != t) continue;
+                if (ruled_out(t, keys[i])) continue;
+                group.push_back(keys[i]);
+                positions.push_back(i);
+            }
+            if (group.empty()) continue;
+            group_found.resize(group.size());
+            t->search_batch(group.data(), group.size(), group_found.data());
+            for (size_t j = 0; j < positions.size(); ++j) {
+                auto& r = group_found[j];
+                // a pull source can still answer with a tombstone
+                found[positions[j]] = !r.null() && r.cl()->is_tomb() ? nullptr : r;
+                passed_filter(t, !found[positions[j]].null());
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            cb(i, found[i]);
+        }
+        return;
+    }
+}
+
 bool sharded_store::exists(art::value_type key) const {
-    auto ruled_out = [&key](const shard_ptr& t) {
-        return !t->sources() && t->has_static_bloom_filter() && !t->is_bloom(key);
-    };
     auto t = shard_for(key);
     if (!t) return false;
     const bool moves = spc->routes_move();
-    if (!moves && ruled_out(t)) {
+    if (!moves && ruled_out(t, key)) {
         return false;
     }
     std::optional<read_lock> release;
     t = route_locked<read_lock>(*this, key, release);
     if (!t) return false;
-    if (moves && ruled_out(t)) {
+    if (moves && ruled_out(t, key)) {
         return false;
     }
-    return !t->search(key).null();
+    const bool found = !t->search(key).null();
+    passed_filter(t, found);
+    return found;
 }
 
 bool sharded_store::insert(const art::key_options& opts, art::value_type key,
@@ -137,7 +228,10 @@ bool sharded_store::insert(const art::key_options& opts, art::value_type key,
     std::optional<storage_release> release;
     auto t = route_locked<storage_release>(*this, key, release);
     if (!t) return false;
-    return t->opt_insert(opts, key, value, update, fc);
+    bool inserted = t->opt_insert(opts, key, value, update, fc);
+    // an update writes whether or not the key was there
+    if (inserted || update) log_written(spc, t, opts, key, value);
+    return inserted;
 }
 
 bool sharded_store::add(const art::key_options& opts, art::value_type key,
@@ -145,14 +239,18 @@ bool sharded_store::add(const art::key_options& opts, art::value_type key,
     std::optional<storage_release> release;
     auto t = route_locked<storage_release>(*this, key, release);
     if (!t) return false;
-    return t->insert(opts, key, value, false, fc);
+    bool inserted = t->insert(opts, key, value, false, fc);
+    if (inserted) log_written(spc, t, opts, key, value);
+    return inserted;
 }
 
 bool sharded_store::remove(art::value_type key, const art::NodeResult& fc) {
     std::optional<storage_release> release;
     auto t = route_locked<storage_release>(*this, key, release);
     if (!t) return false;
-    return t->remove(key, fc);
+    bool removed = t->remove(key, fc);
+    if (removed) log_removed(spc, t, key);
+    return removed;
 }
 
 bool sharded_store::update(art::value_type key, const updater_fn& updater) {
@@ -675,7 +773,7 @@ static bool scan_page(barch::scan_cursor& cursor, const barch::shard_ptr& shard,
                         td = tmp;
                     }
 
-                    if (1 == glob::stringmatchlen(spec.glob_expr, td, 0)) {
+                    if (1 == spec.matcher.match(td)) {
                         emit(l);
                     }
                     return advance(l, pos);
@@ -692,7 +790,74 @@ static bool scan_page(barch::scan_cursor& cursor, const barch::shard_ptr& shard,
     return keep_going;
 }
 
+/**
+ * a shard a glob or scan can walk by key: its keys are all in the tree. A shard with
+ * hashed keys keeps them out of it, so those are only found by the page scan
+ */
+static bool walkable(const shard_ptr& t) {
+    return t->opt_ordered_keys && t->get_hash_size() == 0;
+}
+
+/**
+ * the MATCH part of a scan for a shard whose pattern has a prefix, picking up from the
+ * range and key the cursor was left at. Like walk_glob, the leaves are copied out a chunk
+ * at a time under a read lock, and matched and given to cb after it is released.
+ * @return false if cb asked to stop
+ */
+static bool scan_ranges(barch::scan_cursor& cursor, const barch::shard_ptr& t,
+                        const art::scan_spec& spec, const glob_plan& plan,
+                        const sharded_store::scan_cb& cb) {
+    heap::vector<uint8_t> buffer;
+    heap::vector<size_t> offsets;
+    std::string tmp;
+    for (; cursor.range < plan.ranges.size(); ++cursor.range, cursor.after.clear()) {
+        const auto& range = plan.ranges[cursor.range];
+        for (;;) {
+            bool resumed = !cursor.after.empty();
+            std::string from = resumed ? cursor.after : plan.seek(range);
+            buffer.clear();
+            offsets.clear();
+            bool more = false;
+            {
+                read_lock release(t);
+                for (art::iterator i(t, art::value_type{from}); i.ok(); i.next()) {
+                    auto k = i.key();
+                    if (resumed) {
+                        resumed = false;
+                        if (k == art::value_type{from}) continue;   // given out already
+                    }
+                    if (!plan.in_range(k, range)) break;
+                    const art::leaf *l = i.l();
+                    if (l->is_tomb() || l->expired()) continue;
+                    offsets.push_back(buffer.size());
+                    buffer.insert(buffer.end(), (const uint8_t *) l, (const uint8_t *) l + l->byte_size());
+                    if (offsets.size() == glob_walk_chunk) {
+                        more = true;
+                        break;
+                    }
+                }
+            }
+            for (auto at : offsets) {
+                const auto *l = (const art::leaf *) (buffer.data() + at);
+                auto k = l->get_key();
+                cursor.after.assign(k.chars(), k.size);
+                art::value_type td;
+                if (!glob_subject(*l, tmp, td)) continue;
+                if (1 == spec.matcher.match(td) && !cb(k)) {
+                    return false;
+                }
+            }
+            if (!more) break;
+        }
+    }
+    return true;
+}
+
 bool sharded_store::scan(scan_cursor& cursor, const art::scan_spec& spec, const scan_cb& cb) const {
+    glob_plan walk_plan;
+    if (spec.is_match) {
+        walk_plan = plan(spec.glob_expr);
+    }
     while (!cursor.shards.empty()) {
         auto t = cursor.shards.back();
 
@@ -703,6 +868,21 @@ bool sharded_store::scan(scan_cursor& cursor, const art::scan_spec& spec, const
         }
 
         cursor.shard = t->get_shard_number();
+        // a pull source is left to the page scan, which already knows how not to report
+        // a key its shard shadows
+        bool is_source = t != cursor.space->get(cursor.shard);
+        if (cursor.walking || (walk_plan.walk && !is_source && cursor.page == 0
+                               && cursor.bytes == 0 && walkable(t))) {
+            cursor.walking = true;
+            if (!scan_ranges(cursor, t, spec, walk_plan, cb)) {
+                return false;
+            }
+            cursor.walking = false;
+            cursor.range = 0;
+            cursor.after.clear();
+            cursor.shards.pop_back();
+            continue;
+        }
         do {
             if (cursor.bytes == 0) {
                 cursor.buffer.clear();
@@ -726,7 +906,84 @@ bool sharded_store::scan(scan_cursor& cursor, const art::scan_spec& spec, const
     return true;
 }
 
-void sharded_store::glob(const art::keys_spec& spec, art::value_type pattern, bool by_value,
+glob_plan sharded_store::plan(art::value_type pattern) const {
+    return plan_glob(pattern, !spc->key_split.empty() || spc->key_split_re);
+}
+
+/**
+ * the keys of one shard, and of its pull sources, that fall in the plan's ranges and match
+ * the pattern. Each chunk of leaves is copied out under a read lock and matched after it
+ * is released, the way the page scan copies a page.
+ * @return false if cb asked to stop
+ */
+static bool walk_glob(const shard_ptr& t, const art::keys_spec& spec, art::value_type pattern,
+                      const glob::compiled& matcher, const glob_plan& plan,
+                      const sharded_store::leaf_cb& cb) {
+    if (auto src = t->sources()) {
+        bool go_on = true;
+        if (walkable(src)) {
+            go_on = walk_glob(src, spec, pattern, matcher, plan, cb);
+        } else {
+            // the page scan does not say whether cb stopped it, and cb may be called
+            // from its workers
+            std::atomic<bool> stopped{false};
+            src->glob(spec, pattern, false, [&](const art::leaf& l) -> bool {
+                if (cb(l)) return true;
+                stopped = true;
+                return false;
+            });
+            go_on = !stopped;
+        }
+        if (!go_on) return false;
+    }
+    int64_t counter = 0;
+    heap::vector<uint8_t> buffer;
+    heap::vector<size_t> offsets;
+    std::string tmp;
+    for (const auto& range : plan.ranges) {
+        std::string from = plan.seek(range);
+        bool resumed = false;
+        for (;;) {
+            if (spec.abandoned && spec.abandoned()) return false;
+            buffer.clear();
+            offsets.clear();
+            bool more = false;
+            {
+                read_lock release(t);
+                for (art::iterator i(t, art::value_type{from}); i.ok(); i.next()) {
+                    auto k = i.key();
+                    if (resumed) {
+                        resumed = false;
+                        if (k == art::value_type{from}) continue;
+                    }
+                    if (!plan.in_range(k, range)) break;
+                    const art::leaf *l = i.l();
+                    if (l->deleted() || l->expired() || l->is_tomb()) continue;
+                    if (!spec.count && ++counter > spec.max_count) return false;
+                    offsets.push_back(buffer.size());
+                    buffer.insert(buffer.end(), (const uint8_t *) l, (const uint8_t *) l + l->byte_size());
+                    if (offsets.size() == glob_walk_chunk) {
+                        from.assign(k.chars(), k.size);
+                        resumed = more = true;
+                        break;
+                    }
+                }
+            }
+            for (auto at : offsets) {
+                const auto *l = (const art::leaf *) (buffer.data() + at);
+                art::value_type td;
+                if (!glob_subject(*l, tmp, td)) continue;
+                if (1 == matcher.match(td) && !cb(*l)) {
+                    return false;
+                }
+            }
+            if (!more) break;
+        }
+    }
+    return true;
+}
+
+bool sharded_store::glob(const art::keys_spec& spec, art::value_type pattern, bool by_value,
                          const leaf_cb& cb, const glob_pages *only, glob_pages *hits) const {
     // deliberately unlocked - each shard copies the page it is matching into a working
     // buffer first, so a leaf is only valid inside cb, and cb runs on worker threads
@@ -735,14 +992,120 @@ void sharded_store::glob(const art::keys_spec& spec, art::value_type pattern, bo
         hits->clear();
         hits->resize(all.size());
     }
+    glob_plan walk_plan;
+    if (!by_value) {
+        walk_plan = plan(pattern);
+    }
+    glob::compiled own{};
+    const glob::compiled *matcher = spec.matcher;
+    if (!matcher) {
+        own = glob::compiled(pattern);
+        matcher = &own;
+    }
+    // a shard that stopped the glob stops it for the shards after it too
+    std::atomic<bool> stopped{false};
+    leaf_cb watched = [&](const art::leaf& l) -> bool {
+        if (cb(l)) return true;
+        stopped = true;
+        return false;
+    };
     static const art::glob_page_list none{};
     for (size_t i = 0; i < all.size(); ++i) {
+        if (walk_plan.walk && walkable(all[i])) {
+            if (!walk_glob(all[i], spec, pattern, *matcher, walk_plan, watched)) return false;
+            continue;
+        }
         const art::glob_page_list *shard_only = nullptr;
         if (only)
             shard_only = (i < only->size()) ? &(*only)[i] : &none;
         art::glob_page_list *shard_hits = hits ? &(*hits)[i] : nullptr;
-        all[i]->glob(spec, pattern, by_value, cb, shard_only, shard_hits);
+        all[i]->glob(spec, pattern, by_value, watched, shard_only, shard_hits);
+        if (stopped) return false;
+    }
+    return true;
+}
+
+
+// ---- write batch ----
+
+write_batch::write_batch(key_space_ptr space) : spc(std::move(space)) {
+    if (!spc) {
+        throw_exception<std::runtime_error>("write_batch: no key space");
+    }
+}
+
+art::value_type write_batch::key_of(const mutation& m) const {
+    return {(const char*) bytes.data() + m.key, m.key_size};
+}
+
+art::value_type write_batch::value_of(const mutation& m) const {
+    return {(const char*) bytes.data() + m.value, m.value_size};
+}
+
+void write_batch::put(art::value_type key, art::value_type value, const art::key_options& opts) {
+    mutation m;
+    m.key = bytes.size();
+    m.key_size = key.size;
+    bytes.insert(bytes.end(), key.bytes, key.bytes + key.size);
+    m.value = bytes.size();
+    m.value_size = value.size;
+    bytes.insert(bytes.end(), value.bytes, value.bytes + value.size);
+    m.opts = opts;
+    mutations.push_back(m);
+}
+
+void write_batch::clear() {
+    bytes.clear();
+    mutations.clear();
+}
+
+size_t write_batch::commit(const art::NodeResult& fc) {
+    sharded_store store(spc);
+    struct routed {
+        shard_ptr t{};
+        size_t at{};
+    };
+    heap::vector<routed> order;
+    order.reserve(mutations.size());
+    for (size_t i = 0; i < mutations.size(); ++i) {
+        auto t = store.shard_for(key_of(mutations[i]));
+        if (t) order.push_back({t, i});
+    }
+    // stable, so a key put twice is written in the order it was put and the last one wins
+    std::stable_sort(order.begin(), order.end(), [this](const routed& a, const routed& b) {
+        auto sa = a.t->get_shard_number(), sb = b.t->get_shard_number();
+        if (sa != sb) return sa < sb;
+        return key_of(mutations[a.at]) < key_of(mutations[b.at]);
+    });
+
+    size_t written = 0;
+    heap::vector<size_t> moved;
+    for (size_t start = 0; start < order.size();) {
+        auto t = order[start].t;
+        size_t end = start;
+        while (end < order.size() && order[end].t == t) ++end;
+        {
+            storage_release held(t);
+            for (size_t i = start; i < end; ++i) {
+                const auto& m = mutations[order[i].at];
+                if (spc->route_moved(key_of(m), t)) {
+                    moved.push_back(order[i].at);
+                    continue;
+                }
+                t->insert(m.opts, key_of(m), value_of(m), true, fc);
+                log_written(spc, t, m.opts, key_of(m), value_of(m));
+                ++written;
+            }
+        }
+        start = end;
+    }
+    // a boundary moved while these were waiting for their lock; route them one at a time
+    for (auto at : moved) {
+        const auto& m = mutations[at];
+        if (store.insert(m.opts, key_of(m), value_of(m), true, fc)) ++written;
     }
+    clear();
+    return written;
 }
 
 }
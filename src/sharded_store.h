@@ -9,6 +9,7 @@
 
 #include "art/art.h"
 #include "art/iterator.h"
+#include "glob_plan.h"
 #include "key_space.h"
 #include "keyspace_locks.h"
 
@@ -74,12 +75,18 @@ namespace barch {
         key_space_ptr space{};
         heap::vector<shard_ptr> shards{};
         heap::vector<uint8_t> buffer{};
+        // a MATCH whose prefix is walked through the tree keeps its place by key instead
+        // of by page: which of the plan's ranges, and the last key looked at in it
+        bool walking{};
+        size_t range{};
+        std::string after{};
 
         /** what this cursor costs: the page copy dominates, the shard list is pointers */
         [[nodiscard]] size_t memory() const {
             return sizeof(scan_cursor)
                  + buffer.capacity() * sizeof(uint8_t)
-                 + shards.capacity() * sizeof(shard_ptr);
+                 + shards.capacity() * sizeof(shard_ptr)
+                 + after.capacity();
         }
     };
     typedef std::shared_ptr<scan_cursor> scan_cursor_ptr;
@@ -127,6 +134,19 @@ namespace barch {
          */
         bool search(art::value_type key, const node_cb& cb) const;
 
+        /** what search_many found for keys[i], null if it is absent or a tombstone */
+        typedef std::function<void(size_t i, const art::node_ptr& found)> batch_cb;
+
+        /**
+         * find every one of keys and hand each result to cb in the order the keys were
+         * given, with a null leaf for a key that is not there. The keys are grouped by
+         * the shard that owns them and every shard involved is read locked, in shard
+         * number order, for the whole call. Each shard then looks its keys up together
+         * (abstract_shard::search_batch), which overlaps their cache misses instead of
+         * paying them one key at a time the way a loop over search() does.
+         */
+        void search_many(const art::value_type* keys, size_t count, const batch_cb& cb) const;
+
         /** true if key is present. does not read the value */
         [[nodiscard]] bool exists(art::value_type key) const;
 
@@ -259,9 +279,21 @@ namespace barch {
          * cb runs on worker threads and must serialise itself.
          */
         typedef heap::vector<art::glob_page_list> glob_pages;
-        void glob(const art::keys_spec& spec, art::value_type pattern, bool by_value,
+        /**
+         * A pattern with a literal prefix is answered by walking the key ranges it pins
+         * down in each shard instead of every page - see glob_plan. The walk copies what
+         * it finds out a chunk at a time under a read lock and matches after letting go,
+         * so the lifetime rule is the same as for the page scan; only and hits do not
+         * apply to a walked shard. A shard holding hashed keys is always scanned.
+         * @return false if cb, or the count or abandonment in spec, stopped the glob
+         * before the last shard, which is then not looked at
+         */
+        bool glob(const art::keys_spec& spec, art::value_type pattern, bool by_value,
                   const leaf_cb& cb, const glob_pages *only = nullptr, glob_pages *hits = nullptr) const;
 
+        /** how glob, or scan with MATCH, would go about a pattern */
+        [[nodiscard]] glob_plan plan(art::value_type pattern) const;
+
         // ---- scan ----
 
         /** false to stop the scan here; the cursor keeps its place for the next call */
@@ -286,6 +318,60 @@ namespace barch {
         key_space_ptr spc;
     };
 
+    /**
+     * Writes gathered up and applied together, one write lock per shard.
+     *
+     * A command writing many keys used to route and lock each key on its own. A batch
+     * takes every key first, sorts them by owning shard and then by key, and applies each
+     * shard's share under a single write lock - one shard at a time, in shard number
+     * order. Inserting in key order also means each insert walks down mostly the same
+     * path the one before it did, which is still in cache.
+     *
+     * Atomic per shard, not across shards: the same guarantee MSET has always given. A
+     * key whose shard moved between routing and locking is written on its own afterwards,
+     * routed again. Keys and values are copied by put, so the caller's buffers need not
+     * outlive the batch; a key put twice keeps the last value.
+     */
+    class write_batch {
+    public:
+        explicit write_batch(key_space_ptr space);
+
+        void put(art::value_type key, art::value_type value, const art::key_options& opts = {});
+        [[nodiscard]] size_t size() const { return mutations.size(); }
+        [[nodiscard]] bool empty() const { return mutations.empty(); }
+        void clear();
+
+        /**
+         * write every put and empty the batch
+         * @return how many keys were written
+         */
+        size_t commit(const art::NodeResult& fc);
+
+    private:
+        struct mutation {
+            size_t key{};
+            size_t key_size{};
+            size_t value{};
+            size_t value_size{};
+            art::key_options opts{};
+        };
+        [[nodiscard]] art::value_type key_of(const mutation& m) const;
+        [[nodiscard]] art::value_type value_of(const mutation& m) const;
+
+        key_space_ptr spc;
+        heap::vector<uint8_t> bytes{};
+        heap::vector<mutation> mutations{};
+    };
+
+    /**
+     * log a write or a removal by one of the commands that log what they do to each shard,
+     * see append_log.h. the caller holds t's write latch and spc is t's key space. the
+     * shard level writes of those commands call these, sharded_store's own already do
+     */
+    void log_written(const key_space_ptr& spc, const shard_ptr& t, const art::key_options& opts,
+                     art::value_type key, art::value_type value);
+    void log_removed(const key_space_ptr& spc, const shard_ptr& t, art::value_type key);
+
     /**
      * merge a shard with its pull sources into one ordered stream from lower
      */
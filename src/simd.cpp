@@ -19,6 +19,7 @@
 
 #include "simd.h"
 
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
@@ -83,87 +84,390 @@ unsigned simd::bits_oper16(const unsigned char *a, const unsigned char *b, unsig
     return bitfield;
 }
 
-size_t simd::first_byte_gt(const uint8_t *data, unsigned size, uint8_t ch) {
-    const uint8_t *ptr = data;
-    const uint8_t *end = data + size;
+// the x86 builds pick their kernels at run time. The avx2 and avx-512 ones are compiled
+// for those instruction sets with a target attribute rather than with -m flags, so the
+// rest of barch does not start using them where the cpu might not have them
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BARCH_SIMD_DISPATCH 1
+#include <immintrin.h>
+#endif
 #if defined(__i386__) || defined(__amd64__) || defined(__ARM_NEON__)
-    //size_t first = 0;
-    __m128i tocmp = _mm_set1_epi8(ch);
-    while (size >= 16) {
-        __builtin_prefetch(ptr + 16);
-        size_t diff = 16;
-        int mask = 0;
-        __m128i chunk = _mm_loadu_si128((__m128i const *) ptr);
-        __m128i results = _mm_cmpgt_epi8(chunk, tocmp);
-        mask = _mm_movemask_epi8(results);
-        if (mask) {
-            int lz = __builtin_ctz(mask);
-            return ptr - data + lz;
+#define BARCH_SIMD_SSE2 1
+#endif
+
+namespace {
+    // -------------------------------------------------------------------- plain loops
+    inline __attribute__((always_inline)) size_t scalar_gt(const uint8_t *data, size_t size, uint8_t ch) {
+        const uint8_t *ptr = data;
+        const uint8_t *end = data + size;
+        while (size >= 4) {
+            if (ptr[0] > ch || ptr[1] > ch || ptr[2] > ch || ptr[3] > ch) {
+                break;
+            }
+            ptr += 4;
+            size -= 4;
+        }
+        while (ptr != end) {
+            if (*ptr > ch) {
+                return ptr - data;
+            }
+            ++ptr;
+        }
+        return ptr - data;
+    }
+
+    inline __attribute__((always_inline)) size_t scalar_eq(const uint8_t *data, size_t size, uint8_t ch) {
+        const uint8_t *ptr = data;
+        const uint8_t *end = data + size;
+        while (size >= 8) {
+            if (ptr[0] == ch || ptr[1] == ch || ptr[2] == ch || ptr[3] == ch ||
+                ptr[4] == ch || ptr[5] == ch || ptr[6] == ch || ptr[7] == ch) {
+                break;
+            }
+            ptr += 8;
+            size -= 8;
         }
-        //first += diff;
-        ptr += diff;
-        size -= diff;
+        while (ptr != end) {
+            if (*ptr == ch) {
+                return ptr - data;
+            }
+            ++ptr;
+        }
+        return ptr - data;
     }
+
+    // eight bytes at a time as words: the xor of two words is zero up to the first byte
+    // that differs, and that byte is the lowest one set on a little endian machine
+    inline __attribute__((always_inline)) size_t scalar_mismatch(const uint8_t *a, const uint8_t *b, size_t size) {
+        size_t at = 0;
+        for (; at + 8 <= size; at += 8) {
+            uint64_t wa, wb;
+            memcpy(&wa, a + at, 8);
+            memcpy(&wb, b + at, 8);
+            if (wa != wb) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                return at + (__builtin_ctzll(wa ^ wb) >> 3);
+#else
+                break;
 #endif
-    while (size >= 4) {
-        if (ptr[0] > ch || ptr[1] > ch || ptr[2] > ch || ptr[3] > ch) {
-            break;
+            }
+        }
+        for (; at < size; ++at) {
+            if (a[at] != b[at]) return at;
         }
-        ptr += 4;
-        size -= 4;
+        return at;
     }
-    while (ptr != end) {
-        if (*ptr > ch) {
-            return ptr - data;
+
+    inline __attribute__((always_inline)) size_t scalar_find(const uint8_t *data, size_t size,
+                                                              const uint8_t *needle, size_t length) {
+        if (!length) return 0;
+        auto at = (const uint8_t *) memmem(data, size, needle, length);
+        return at ? at - data : size;
+    }
+
+#ifdef BARCH_SIMD_SSE2
+    // ------------------------------------------------------------ 16 bytes, sse2/neon
+    // sse2 only compares signed bytes. Flipping the top bit of both sides maps the
+    // unsigned order onto the signed one, so a byte over 0x7f is not taken for negative
+    inline __attribute__((always_inline)) size_t sse2_gt(const uint8_t *data, size_t size, uint8_t ch) {
+        const uint8_t *ptr = data;
+        const __m128i bias = _mm_set1_epi8((char) 0x80);
+        const __m128i tocmp = _mm_xor_si128(_mm_set1_epi8((char) ch), bias);
+        while (size >= 16) {
+            __m128i chunk = _mm_xor_si128(_mm_loadu_si128((__m128i const *) ptr), bias);
+            int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(chunk, tocmp));
+            if (mask) {
+                return ptr - data + __builtin_ctz(mask);
+            }
+            ptr += 16;
+            size -= 16;
         }
-        ++ptr;
+        return ptr - data + scalar_gt(ptr, size, ch);
     }
-    return ptr - data;
-}
 
-size_t simd::first_byte_eq(const uint8_t *data, unsigned size, uint8_t ch) {
-    const uint8_t *ptr = data;
-    const uint8_t *end = data + size;
-#if 1
-#if defined(__AVX__)
+    inline __attribute__((always_inline)) size_t sse2_eq(const uint8_t *data, size_t size, uint8_t ch) {
+        const uint8_t *ptr = data;
+        const __m128i tocmp = _mm_set1_epi8((char) ch);
+        while (size >= 16) {
+            __m128i chunk = _mm_loadu_si128((__m128i const *) ptr);
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, tocmp));
+            if (mask) {
+                return ptr - data + __builtin_ctz(mask);
+            }
+            ptr += 16;
+            size -= 16;
+        }
+        return ptr - data + scalar_eq(ptr, size, ch);
+    }
+
+    inline __attribute__((always_inline)) size_t sse2_mismatch(const uint8_t *a, const uint8_t *b, size_t size) {
+        size_t at = 0;
+        for (; at + 16 <= size; at += 16) {
+            __m128i ca = _mm_loadu_si128((__m128i const *) (a + at));
+            __m128i cb = _mm_loadu_si128((__m128i const *) (b + at));
+            unsigned differ = ~(unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(ca, cb)) & 0xffffu;
+            if (differ) {
+                return at + __builtin_ctz(differ);
+            }
+        }
+        return at + scalar_mismatch(a + at, b + at, size - at);
+    }
 
+    // a position is a candidate when both the needle's first byte and its last byte are
+    // where they would be if it started there. The middle is only compared for those
+    inline __attribute__((always_inline)) size_t sse2_find(const uint8_t *data, size_t size,
+                                                            const uint8_t *needle, size_t length) {
+        if (length < 2 || length > size) return scalar_find(data, size, needle, length);
+        const __m128i first = _mm_set1_epi8((char) needle[0]);
+        const __m128i last = _mm_set1_epi8((char) needle[length - 1]);
+        size_t at = 0;
+        for (; at + length - 1 + 16 <= size; at += 16) {
+            __m128i bf = _mm_loadu_si128((__m128i const *) (data + at));
+            __m128i bl = _mm_loadu_si128((__m128i const *) (data + at + length - 1));
+            unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bf),
+                                                                       _mm_cmpeq_epi8(last, bl)));
+            while (mask) {
+                unsigned bit = __builtin_ctz(mask);
+                if (memcmp(data + at + bit + 1, needle + 1, length - 2) == 0) {
+                    return at + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return at + scalar_find(data + at, size - at, needle, length);
+    }
 #endif
 
-#if defined(__i386__) || defined(__amd64__) || defined(__ARM_NEON__)
-    __m128i tocmp = _mm_set1_epi8(ch);
-    while (size >= 16) {
-        __builtin_prefetch(ptr + 16);
-        size_t diff = 16;
-        int mask = 0;
-        __m128i chunk = _mm_loadu_si128((__m128i const *) ptr);
-        __m128i results = _mm_cmpeq_epi8(chunk, tocmp);
-        mask = _mm_movemask_epi8(results);
-        if (mask) {
-            int lz = __builtin_ctz(mask);
-            return ptr - data + lz;
+#ifdef BARCH_SIMD_DISPATCH
+    // -------------------------------------------------------------------- 32 bytes, avx2
+    // only the comparisons of two runs of bytes are widened. The single byte scans of the
+    // nodes stay on sse2: they mostly stop within the first block, and simdbench has
+    // sse2 level with or ahead of 32 and 64 byte registers there
+    inline __attribute__((target("avx2"), always_inline))
+    size_t avx2_mismatch(const uint8_t *a, const uint8_t *b, size_t size) {
+        size_t at = 0;
+        for (; at + 32 <= size; at += 32) {
+            __m256i ca = _mm256_loadu_si256((__m256i const *) (a + at));
+            __m256i cb = _mm256_loadu_si256((__m256i const *) (b + at));
+            unsigned differ = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(ca, cb));
+            if (differ) {
+                return at + __builtin_ctz(differ);
+            }
         }
-        ptr += diff;
-        size -= diff;
+        return at + sse2_mismatch(a + at, b + at, size - at);
+    }
+
+    inline __attribute__((target("avx2"), always_inline))
+    size_t avx2_find(const uint8_t *data, size_t size, const uint8_t *needle, size_t length) {
+        if (length < 2 || length > size) return scalar_find(data, size, needle, length);
+        const __m256i first = _mm256_set1_epi8((char) needle[0]);
+        const __m256i last = _mm256_set1_epi8((char) needle[length - 1]);
+        size_t at = 0;
+        for (; at + length - 1 + 32 <= size; at += 32) {
+            __m256i bf = _mm256_loadu_si256((__m256i const *) (data + at));
+            __m256i bl = _mm256_loadu_si256((__m256i const *) (data + at + length - 1));
+            unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, bf),
+                                                                             _mm256_cmpeq_epi8(last, bl)));
+            while (mask) {
+                unsigned bit = __builtin_ctz(mask);
+                if (memcmp(data + at + bit + 1, needle + 1, length - 2) == 0) {
+                    return at + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return at + sse2_find(data + at, size - at, needle, length);
+    }
+
+    // ------------------------------------------------------------ 64 bytes, avx-512bw
+    // anything shorter than a register goes the avx2 way: a masked load for the tail
+    // measured slower than the 32 byte compares on the short spans a key mostly is (see
+    // test/simdbench.cpp)
+    __attribute__((target("avx512f,avx512bw")))
+    size_t avx512_mismatch(const uint8_t *a, const uint8_t *b, size_t size) {
+        size_t at = 0;
+        for (; at + 64 <= size; at += 64) {
+            __m512i ca = _mm512_loadu_si512((void const *) (a + at));
+            __m512i cb = _mm512_loadu_si512((void const *) (b + at));
+            __mmask64 differ = _mm512_cmpneq_epi8_mask(ca, cb);
+            if (differ) {
+                return at + __builtin_ctzll(differ);
+            }
+        }
+        return at + avx2_mismatch(a + at, b + at, size - at);
     }
 #endif
+
+    // the scans of one kind of node, which are timed apart from the other kernels
+    struct node_scan {
+        size_t (*gt)(const uint8_t *, size_t, uint8_t);
+        size_t (*eq)(const uint8_t *, size_t, uint8_t);
+    };
+
+    struct kernels {
+        simd::isa isa;
+        size_t (*gt)(const uint8_t *, size_t, uint8_t);
+        size_t (*eq)(const uint8_t *, size_t, uint8_t);
+        size_t (*mismatch)(const uint8_t *, const uint8_t *, size_t);
+        size_t (*find)(const uint8_t *, size_t, const uint8_t *, size_t);
+        node_scan node48;
+        node_scan node256;
+    };
+
+    kernels kernels_for(simd::isa i) {
+        switch (i) {
+#ifdef BARCH_SIMD_DISPATCH
+            // a literal search is mostly over the first few dozen bytes of a key, so it
+            // stays on the avx2 kernel: a 64 byte block seldom has 64 bytes to look at.
+            // The byte scans are sse2 on every isa, see the avx2 kernels above
+            case simd::isa::avx512:
+                return {i, sse2_gt, sse2_eq, avx512_mismatch, avx2_find,
+                        {sse2_gt, sse2_eq}, {sse2_gt, sse2_eq}};
+            case simd::isa::avx2:
+                return {i, sse2_gt, sse2_eq, avx2_mismatch, avx2_find,
+                        {sse2_gt, sse2_eq}, {sse2_gt, sse2_eq}};
+#endif
+#ifdef BARCH_SIMD_SSE2
+            case simd::isa::sse2:
+                return {i, sse2_gt, sse2_eq, sse2_mismatch, sse2_find,
+                        {sse2_gt, sse2_eq}, {sse2_gt, sse2_eq}};
 #endif
-#if 1
-    while (size >= 8) {
-        if (ptr[0] == ch || ptr[1] == ch || ptr[2] == ch || ptr[3] == ch ||
-            ptr[4] == ch || ptr[5] == ch || ptr[6] == ch || ptr[7] == ch) {
-            break;
+            default:
+                return {simd::isa::scalar, scalar_gt, scalar_eq, scalar_mismatch, scalar_find,
+                        {scalar_gt, scalar_eq}, {scalar_gt, scalar_eq}};
         }
-        ptr += 8;
-        size -= 8;
     }
+
+    kernels &active() {
+        static kernels k = kernels_for(simd::best_isa());
+        return k;
+    }
+}
+
+simd::isa simd::best_isa() {
+#ifdef BARCH_SIMD_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return isa::avx512;
+    if (__builtin_cpu_supports("avx2")) return isa::avx2;
+    return isa::sse2;
+#elif defined(BARCH_SIMD_SSE2)
+    return isa::sse2;
+#else
+    return isa::scalar;
+#endif
+}
+
+simd::isa simd::active_isa() {
+    return active().isa;
+}
+
+const char *simd::isa_name(isa i) {
+    switch (i) {
+        case isa::avx512: return "avx512";
+        case isa::avx2: return "avx2";
+        case isa::sse2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+bool simd::use_isa(isa i) {
+    if (i > best_isa()) return false;
+    active() = kernels_for(i);
+    return true;
+}
+
+size_t simd::first_byte_gt(const uint8_t *data, unsigned size, uint8_t ch) {
+    return active().gt(data, size, ch);
+}
+
+size_t simd::first_byte_eq(const uint8_t *data, unsigned size, uint8_t ch) {
+    return active().eq(data, size, ch);
+}
+
+size_t simd::node48_byte_gt(const uint8_t *data, unsigned size, uint8_t ch) {
+    return active().node48.gt(data, size, ch);
+}
+
+size_t simd::node48_byte_eq(const uint8_t *data, unsigned size, uint8_t ch) {
+    return active().node48.eq(data, size, ch);
+}
+
+size_t simd::node256_byte_gt(const uint8_t *data, unsigned size, uint8_t ch) {
+    return active().node256.gt(data, size, ch);
+}
+
+size_t simd::first_mismatch(const uint8_t *a, const uint8_t *b, size_t size) {
+    // a node keeps at most max_prefix_llength bytes of prefix, which two words compare
+    // faster than the call through the kernel table costs
+    if (size < 16) return scalar_mismatch(a, b, size);
+    return active().mismatch(a, b, size);
+}
+
+size_t simd::find_literal(const uint8_t *data, size_t size, const uint8_t *needle, size_t length) {
+    if (length == 1) return active().eq(data, size, needle[0]);
+    return active().find(data, size, needle, length);
+}
+
+unsigned simd::first_key_ge16(const uint8_t *keys, unsigned count, uint8_t ch) {
+    if (!count) return 0;
+#ifdef BARCH_SIMD_SSE2
+    // k >= ch exactly where max(k, ch) is k, which needs no signed compare at all
+    __m128i k = _mm_loadu_si128((__m128i const *) keys);
+    __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(k, _mm_set1_epi8((char) ch)), k);
+    unsigned mask = (unsigned) _mm_movemask_epi8(ge) & ((1u << count) - 1u);
+    return mask ? __builtin_ctz(mask) : count;
+#else
+    for (unsigned i = 0; i < count; ++i) {
+        if (keys[i] >= ch) return i;
+    }
+    return count;
 #endif
-    while (ptr != end) {
-        if (*ptr == ch) {
-            return ptr - data;
+}
+
+namespace {
+    uint32_t crc32c_table(const uint8_t *data, size_t size, uint32_t crc) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+                t[i] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
         }
-        ++ptr;
+        return ~crc;
     }
-    return ptr - data;
+#ifdef BARCH_SIMD_DISPATCH
+    __attribute__((target("sse4.2")))
+    uint32_t crc32c_sse42(const uint8_t *data, size_t size, uint32_t crc) {
+        uint64_t c = ~crc;
+        for (; size >= 8; size -= 8, data += 8) {
+            uint64_t word;
+            memcpy(&word, data, sizeof(word));
+            c = _mm_crc32_u64(c, word);
+        }
+        auto c32 = (uint32_t) c;
+        for (; size > 0; --size, ++data) {
+            c32 = _mm_crc32_u8(c32, *data);
+        }
+        return ~c32;
+    }
+#endif
+}
+
+uint32_t simd::crc32c(const uint8_t *data, size_t size, uint32_t crc) {
+#ifdef BARCH_SIMD_DISPATCH
+    static const bool hardware = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+    if (hardware) return crc32c_sse42(data, size, crc);
+#endif
+    return crc32c_table(data, size, crc);
 }
 
 #include "lzr_log.h"
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 enum OPERATION_BIT {
     eq = 1,
@@ -27,7 +29,73 @@ namespace simd {
 
     extern unsigned bits_oper16(const unsigned char *a, const unsigned char *b, unsigned mask, unsigned operbits);
 
+    /**
+     * the widest kernels the cpu the process runs on has. They are picked with cpuid the
+     * first time one is called, not when barch is compiled, so one build runs its best on
+     * every x86 it lands on. Everything that is not x86 gets sse2 through sse2neon, or
+     * the plain loops
+     */
+    enum class isa : uint8_t {
+        scalar = 0,
+        sse2 = 1,
+        avx2 = 2,
+        avx512 = 3
+    };
+
+    [[nodiscard]] extern isa active_isa();
+
+    [[nodiscard]] extern isa best_isa();
+
+    [[nodiscard]] extern const char *isa_name(isa i);
+
+    /**
+     * use the kernels of i instead of the best ones - for benchmarks and tests, which
+     * want to compare them on one machine. It is not synchronized with the kernels being
+     * called, so it must not be used while a shard is
+     * @return false if the cpu does not have i
+     */
+    extern bool use_isa(isa i);
+
+    /** position of the first byte greater than ch, or size. Bytes are unsigned */
     extern size_t first_byte_gt(const uint8_t *data, unsigned size, uint8_t ch);
 
+    /** position of the first byte equal to ch, or size */
     extern size_t first_byte_eq(const uint8_t *data, unsigned size, uint8_t ch);
+
+    /**
+     * first_byte_gt and first_byte_eq for the key index and types of a node48 and the
+     * types of a node256. Each node type has the kernel that is quickest on its own
+     * scans, which is not always the widest the cpu has
+     */
+    extern size_t node48_byte_gt(const uint8_t *data, unsigned size, uint8_t ch);
+
+    extern size_t node48_byte_eq(const uint8_t *data, unsigned size, uint8_t ch);
+
+    extern size_t node256_byte_gt(const uint8_t *data, unsigned size, uint8_t ch);
+
+    /** position of the first byte where a and b differ, or size */
+    extern size_t first_mismatch(const uint8_t *a, const uint8_t *b, size_t size);
+
+    /**
+     * position of the first occurrence of needle in data, or size. A block of candidate
+     * positions is found at once by comparing the needle's first and last bytes against
+     * the data, and only the candidates are compared in full - which is what makes it
+     * quicker than memmem for the short needles a glob's literal runs are
+     */
+    extern size_t find_literal(const uint8_t *data, size_t size, const uint8_t *needle, size_t length);
+
+    /**
+     * position of the first of the count leading keys of a node16 that is not less than
+     * ch, or count. keys must be all 16 bytes of the node's key array, since the whole
+     * array is compared at once - 16 bytes is one sse2 register, which is as wide as a
+     * node16 gets, so this one is not dispatched
+     */
+    extern unsigned first_key_ge16(const uint8_t *keys, unsigned count, uint8_t ch);
+
+    /**
+     * the crc32c (Castagnoli) of size bytes, continuing from crc. With the sse4.2 crc
+     * instruction where the cpu has it, picked the first time like the kernels above, and
+     * a table a byte at a time where it does not
+     */
+    extern uint32_t crc32c(const uint8_t *data, size_t size, uint32_t crc = 0);
 }
@@ -17,6 +17,8 @@ alignas(Alignment) std::atomic<uint64_t> statistics::last_vacuum_time = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::leaf_nodes_replaced = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::pages_evicted = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::keys_evicted = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::keys_evicted_lfu = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::keys_expired = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::pages_defragged = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::range_shard_keys_moved = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::vmm_pages_defragged = 0;
@@ -63,6 +65,22 @@ alignas(Alignment) std::atomic<uint64_t> statistics::foreign_coalesced = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::foreign_overloaded = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::foreign_cancelled = 0;
 alignas(Alignment) std::atomic<uint64_t> statistics::foreign_slow = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::globs_running = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::globs_refused = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::globs_abandoned = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::save_deltas = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::save_pages_unchanged = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::load_pages_mapped = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::snapshots_written = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::snapshot_bytes_raw = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::snapshot_bytes_written = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::snapshot_write_us = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::snapshot_last_bytes_per_sec = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::append_log_entries = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::append_log_bytes = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::append_log_fsyncs = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::append_log_write_errors = 0;
+alignas(Alignment) std::atomic<uint64_t> statistics::append_log_replayed = 0;
 
 /**
 * queue stats
@@ -89,6 +107,17 @@ namespace statistics::repl {
     alignas(Alignment) std::atomic<uint64_t> art_sessions = 0;
     alignas(Alignment) std::atomic<uint64_t> attempted_routes = 0;
     alignas(Alignment) std::atomic<uint64_t> routes_succeeded = 0;
+    alignas(Alignment) std::atomic<uint64_t> uring_sessions = 0;
+    alignas(Alignment) std::atomic<uint64_t> uring_submits = 0;
+    alignas(Alignment) std::atomic<uint64_t> uring_completions = 0;
+    alignas(Alignment) std::atomic<uint64_t> scattered_replies = 0;
+    alignas(Alignment) std::atomic<uint64_t> scattered_bytes_copied = 0;
+    alignas(Alignment) std::atomic<uint64_t> parallel_pipelines = 0;
+    alignas(Alignment) std::atomic<uint64_t> parallel_requests = 0;
+    alignas(Alignment) std::atomic<uint64_t> shard_cores = 0;
+    alignas(Alignment) std::atomic<uint64_t> core_forwarded_requests = 0;
+    alignas(Alignment) std::atomic<uint64_t> core_mailbox_sends = 0;
+    alignas(Alignment) std::atomic<uint64_t> core_mailbox_full = 0;
 
 }
 void statistics::reset_statistics() {
@@ -97,6 +126,8 @@ void statistics::reset_statistics() {
     value_bytes_compressed = 0;
     pages_evicted = 0;
     keys_evicted = 0;
+    keys_evicted_lfu = 0;
+    keys_expired = 0;
     pages_defragged = 0;
     range_shard_keys_moved = 0;
     vmm_pages_defragged = 0;
@@ -136,6 +167,22 @@ void statistics::reset_statistics() {
     foreign_overloaded = 0;
     foreign_cancelled = 0;
     foreign_slow = 0;
+    // globs_running counts what is in flight, so it is left alone
+    globs_refused = 0;
+    globs_abandoned = 0;
+    save_deltas = 0;
+    save_pages_unchanged = 0;
+    load_pages_mapped = 0;
+    snapshots_written = 0;
+    snapshot_bytes_raw = 0;
+    snapshot_bytes_written = 0;
+    snapshot_write_us = 0;
+    snapshot_last_bytes_per_sec = 0;
+    append_log_entries = 0;
+    append_log_bytes = 0;
+    append_log_fsyncs = 0;
+    append_log_write_errors = 0;
+    append_log_replayed = 0;
 
     queue_failures = 0;
     queue_added = 0;
@@ -152,4 +199,13 @@ void statistics::reset_statistics() {
     repl::request_errors = 0;
     repl::attempted_routes = 0;
     repl::routes_succeeded = 0;
+    repl::uring_submits = 0;
+    repl::uring_completions = 0;
+    repl::scattered_replies = 0;
+    repl::scattered_bytes_copied = 0;
+    repl::parallel_pipelines = 0;
+    repl::parallel_requests = 0;
+    repl::core_forwarded_requests = 0;
+    repl::core_mailbox_sends = 0;
+    repl::core_mailbox_full = 0;
 }
@@ -15,6 +15,10 @@ namespace statistics {
     extern std::atomic<uint64_t> value_bytes_compressed;
     extern std::atomic<uint64_t> pages_evicted;
     extern std::atomic<uint64_t> keys_evicted;
+    /** of those, the ones an lfu policy chose by frequency */
+    extern std::atomic<uint64_t> keys_evicted_lfu;
+    /** keys reclaimed by maintenance once their deadline passed */
+    extern std::atomic<uint64_t> keys_expired;
     extern std::atomic<uint64_t> pages_defragged;
     /** keys relocated between shards by the range sharding rebalancer */
     extern std::atomic<uint64_t> range_shard_keys_moved;
@@ -69,7 +73,44 @@ namespace statistics {
     extern std::atomic<uint64_t> foreign_coalesced;
     extern std::atomic<uint64_t> foreign_overloaded;
     extern std::atomic<uint64_t> foreign_cancelled;
+    /**
+     * KEYS and VALUES admission: globs scanning now, turned away because too many were
+     * already waiting for threads, and stopped because their client went away
+     */
+    extern std::atomic<uint64_t> globs_running;
+    extern std::atomic<uint64_t> globs_refused;
+    extern std::atomic<uint64_t> globs_abandoned;
     extern std::atomic<uint64_t> foreign_slow;
+    /**
+     * saves that wrote only the pages changed since the last one (max_save_deltas), and
+     * the pages those saves did not have to write
+     */
+    extern std::atomic<uint64_t> save_deltas;
+    extern std::atomic<uint64_t> save_pages_unchanged;
+    /**
+     * pages a load mapped from their snapshot instead of reading, which are only read from
+     * disk once something touches them
+     */
+    extern std::atomic<uint64_t> load_pages_mapped;
+    /**
+     * full snapshots written: the page bytes they held, what was written for them once
+     * compressed, and the time it took. the rate is the page bytes a second of the last one
+     */
+    extern std::atomic<uint64_t> snapshots_written;
+    extern std::atomic<uint64_t> snapshot_bytes_raw;
+    extern std::atomic<uint64_t> snapshot_bytes_written;
+    extern std::atomic<uint64_t> snapshot_write_us;
+    extern std::atomic<uint64_t> snapshot_last_bytes_per_sec;
+    /**
+     * writes put in the append log, the bytes written to it, the fsyncs that took them to
+     * disk, the writes or fsyncs of it that failed, and the entries replayed from it into
+     * snapshots that did not hold them yet
+     */
+    extern std::atomic<uint64_t> append_log_entries;
+    extern std::atomic<uint64_t> append_log_bytes;
+    extern std::atomic<uint64_t> append_log_fsyncs;
+    extern std::atomic<uint64_t> append_log_write_errors;
+    extern std::atomic<uint64_t> append_log_replayed;
     /**
      * queue stats
      */
@@ -102,6 +143,25 @@ namespace statistics {
         extern std::atomic<uint64_t> art_sessions;
         extern std::atomic<uint64_t> attempted_routes;
         extern std::atomic<uint64_t> routes_succeeded;
+        // resp connections served by an io_uring ring, the io_uring_submit calls that
+        // sent their work to the kernel, and the completions that came back
+        extern std::atomic<uint64_t> uring_sessions;
+        extern std::atomic<uint64_t> uring_submits;
+        extern std::atomic<uint64_t> uring_completions;
+        // large values sent from the leaf in one sendmsg with the replies ahead of them,
+        // and the bytes of those the socket could not take then, which were copied
+        extern std::atomic<uint64_t> scattered_replies;
+        extern std::atomic<uint64_t> scattered_bytes_copied;
+        // pipelines split by shard and run on the workers, and the requests in them
+        extern std::atomic<uint64_t> parallel_pipelines;
+        extern std::atomic<uint64_t> parallel_requests;
+        // a server started per core: how many cores own shards, the single key requests
+        // sent to the core that owns their shard, the mailbox sends that carried them
+        // there and back, and the sends that found a mailbox full
+        extern std::atomic<uint64_t> shard_cores;
+        extern std::atomic<uint64_t> core_forwarded_requests;
+        extern std::atomic<uint64_t> core_mailbox_sends;
+        extern std::atomic<uint64_t> core_mailbox_full;
     }
 
     /**
@@ -114,7 +174,7 @@ namespace statistics {
      *    describe what the server is holding right now. Zeroing them would not reset a
      *    statistic, it would make the server misreport its own state until the numbers
      *    drifted back.
-     *  - read_locks_active, write_locks_active, redis_sessions, art_sessions,
+     *  - read_locks_active, write_locks_active, redis_sessions, uring_sessions, art_sessions,
      *    push_connections_open, out_queue_size and foreign_waiters are incremented
      *    and later decremented. Zeroing one while it is non zero means the matching
      *    decrements wrap it to near UINT64_MAX, which is worse than merely wrong.
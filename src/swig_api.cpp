@@ -18,6 +18,16 @@
 #include "configuration.h"
 #include "rpc_caller.h"
 #include "rpc/server.h"
+#include "append_log.h"
+#include "latency.h"
+
+// a write goes to the replicas before it runs here, and into the append log as it runs:
+// pass the ticket returned to sc.call
+static barch::append_log::ticket replicate(rpc_caller& sc, const std::vector<std::string>& params) {
+    barch::repl::call(params);
+    if (sc.host) return {};
+    return barch::append_log::append_if_logged(sc.kspace()->get_canonical_name(), params);
+}
 
 void setConfiguration(const std::string& name, const std::string& value) {
     barch::set_configuration_value(name,value);
@@ -101,6 +111,29 @@ void start(const std::string &host, int port) {
 void start(int port) {
     start("127.0.0.1", std::to_string(port));
 }
+void start_uring(const std::string &host, int port, bool sqpoll) {
+    auto p = std::to_string(port);
+    std::vector<std::string_view> params = {"START", host, p, sqpoll ? "SQPOLL" : "URING"};
+    rpc_caller sc;
+    sc.remote = false; // causes inline restart
+    int r = sc.call(params, START);
+    if (r == 0) {
+        barch::log({"started server on", host, p, "using io_uring"});
+    }
+}
+void start_cores(const std::string &host, int port, int cores) {
+    auto p = std::to_string(port);
+    auto n = std::to_string(cores);
+    std::vector<std::string_view> params = {"START", host, p, "CORES"};
+    if (cores > 0)
+        params.emplace_back(n);
+    rpc_caller sc;
+    sc.remote = false; // causes inline restart
+    int r = sc.call(params, START);
+    if (r == 0) {
+        barch::log({"started server on", host, p, "per core"});
+    }
+}
 void stop() {
     std::vector<std::string_view> params = {"STOP"};
     rpc_caller sc;
@@ -187,14 +220,16 @@ void saveAll() {
 bool clearAll() {
     std::vector<std::string_view> params = {"CLEARALL"};
     rpc_caller sc;
-    int r = sc.call(params, ::CLEARALL);
+    auto logged = barch::append_log::append(sc.kspace()->get_canonical_name(), "CLEARALL", params);
+    int r = sc.call(params, ::CLEARALL, &logged);
     return r == 0;
 }
 
 bool clear() {
     std::vector<std::string_view> params = {"CLEAR"};
     rpc_caller sc;
-    int r = sc.call(params, ::CLEAR);
+    auto logged = barch::append_log::append(sc.kspace()->get_canonical_name(), "FLUSHDB", params);
+    int r = sc.call(params, ::CLEAR, &logged);
     return r == 0;
 }
 
@@ -210,8 +245,8 @@ long long List::push(const std::string &key, const std::vector<std::string> &ite
     std::unique_lock l(lock);
     params = {"LPUSH", key};
     params.insert(params.end(), items.begin(), items.end());
-    barch::repl::call(params);
-    int r = sc.call(params, LPUSH);
+    auto logged = replicate(sc, params);
+    int r = sc.call(params, LPUSH, &logged);
     if (r != 0) {
         barch::err({"set failed", key});
     }
@@ -250,8 +285,8 @@ std::vector<Value> List::pop(const std::string &key, long long count) {
     std::unique_lock l(lock);
     result.clear();
     params = {"LPOP", key, std::to_string(count)};
-    barch::repl::call(params);
-    int r = sc.call(params, LPOP);
+    auto logged = replicate(sc, params);
+    int r = sc.call(params, LPOP, &logged);
     if (r != 0) {
         barch::err({"pop failed", key});
     }
@@ -306,28 +341,28 @@ bool KeyValue::put(const std::string &key, const std::string& value) {
 Value KeyValue::set(const std::string &key, const std::string &value) {
     std::unique_lock l(lock);
     params = {"SET", key, value};
-    barch::repl::call(params);
-    return sc.callv(params, SET);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, SET, nullptr, &logged);
 }
 
 Value KeyValue::seti(long long key, long long value) {
     std::unique_lock l(lock);
     params = {"SET", Value{key}.s(), Value{value}.s()};
-    barch::repl::call(params);
-    return sc.callv(params, SET);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, SET, nullptr, &logged);
 }
 
 Value KeyValue::set(const std::string &key, long long value) {
     std::unique_lock l(lock);
     params = {"SET", key, Variable{value}.s()};
-    barch::repl::call(params);
-    return sc.callv(params, SET);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, SET, nullptr, &logged);
 }
 Value KeyValue::set(const std::string &key, double value) {
     std::unique_lock l(lock);
     params = {"SET", key, Variable{value}.s()};
-    barch::repl::call(params);
-    return sc.callv(params, SET);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, SET, nullptr, &logged);
 }
 std::string KeyValue::get(const std::string &key) const {
     std::unique_lock l(lock);
@@ -341,11 +376,58 @@ Value KeyValue::vget(const std::string &key) const {
     return sc.callv(params, ::GET);
 }
 
+std::vector<Value> KeyValue::mget(const std::vector<std::string> &keys) const {
+    std::unique_lock l(lock);
+    result.clear();
+    params = {"MGET"};
+    params.insert(params.end(), keys.begin(), keys.end());
+    sc.call(params, ::MGET);
+    sc.append_flat(result);
+    return result;
+}
+
+WriteBatch::WriteBatch() {
+}
+
+WriteBatch::WriteBatch(const std::string& keys_space) {
+    sc.set_kspace(barch::get_keyspace(keys_space));
+}
+
+WriteBatch::WriteBatch(const std::string& host, int port) {
+    sc.host = barch::repl::create(host,port);
+}
+
+void WriteBatch::put(const std::string &key, const std::string &value) {
+    std::unique_lock l(lock);
+    pending.push_back(key);
+    pending.push_back(value);
+}
+
+long long WriteBatch::size() const {
+    std::unique_lock l(lock);
+    return (long long) pending.size() / 2;
+}
+
+void WriteBatch::clear() {
+    std::unique_lock l(lock);
+    pending.clear();
+}
+
+Value WriteBatch::commit() {
+    std::unique_lock l(lock);
+    if (pending.empty()) return Value{"OK"};
+    params = {"MSET"};
+    params.insert(params.end(), pending.begin(), pending.end());
+    pending.clear();
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::MSET, nullptr, &logged);
+}
+
 Value KeyValue::erase(const std::string &key) {
     std::unique_lock l(lock);
     params = {"REM", key};
-    barch::repl::call(params);
-    return sc.callv(params, ::REM);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::REM, nullptr, &logged);
 }
 bool KeyValue::exists(const std::string &key) {
     std::unique_lock l(lock);
@@ -356,22 +438,22 @@ bool KeyValue::exists(const std::string &key) {
 long long KeyValue::append(const std::string& key, const std::string& value) {
     std::unique_lock l(lock);
     params = {"APPEND", key, value};
-    barch::repl::call(params);
-    return sc.callv(params, ::APPEND).i();// errors convert to 0
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::APPEND, nullptr, &logged).i();// errors convert to 0
 }
 
 long long KeyValue::prepend(const std::string& key, const std::string& value) {
     std::unique_lock l(lock);
     params = {"PREPEND", key, value};
-    barch::repl::call(params);
-    return sc.callv(params, ::PREPEND).i();
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::PREPEND, nullptr, &logged).i();
 }
 
 bool KeyValue::clear() {
     std::unique_lock l(lock);
     params = {"CLEAR"};
-    barch::repl::call(params);
-    return sc.callv(params, ::CLEAR) == "OK";
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::CLEAR, nullptr, &logged) == "OK";
 }
 
 bool KeyValue::expire(const std::string &key, long long sec, const std::string& flag) {
@@ -380,8 +462,8 @@ bool KeyValue::expire(const std::string &key, long long sec, const std::string&
         params = {"EXPIRE", key, std::to_string(sec)};
     }else
         params = {"EXPIRE", key, std::to_string(sec), flag};
-    barch::repl::call(params);
-    int r = sc.call(params, ::EXPIRE);
+    auto logged = replicate(sc, params);
+    int r = sc.call(params, ::EXPIRE, &logged);
     if (r == 0) {
         return sc.flat_empty() ? false: sc.flat_at(0).i() == 1;
     }
@@ -425,15 +507,15 @@ Value KeyValue::lastKey() const {
 Value KeyValue::incr(const std::string& key, double by) {
     std::unique_lock l(lock);
     params = {"INCRBY",key, Value((long long)by).s()};
-    barch::repl::call(params);
-    return sc.callv(params, ::INCRBY);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::INCRBY, nullptr, &logged);
 }
 
 Value KeyValue::decr(const std::string& key, double by) {
     std::unique_lock l(lock);
     params = {"DECRBY", key, Value((long long)by).s()};
-    barch::repl::call(params);
-    return sc.callv(params, ::DECRBY);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::DECRBY, nullptr, &logged);
 }
 Value KeyValue::decr(const std::string& key) {
     std::unique_lock l(lock);
@@ -443,8 +525,8 @@ Value KeyValue::decr(const std::string& key) {
 Value KeyValue::incr(const std::string& key, long long by) {
     std::unique_lock l(lock);
     params = {"INCRBY",key, Value(by).s()};
-    barch::repl::call(params);
-    return sc.callv(params, ::INCRBY);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::INCRBY, nullptr, &logged);
 }
 Value KeyValue::incr(const std::string& key) {
     return incr(key, 1ll);
@@ -453,8 +535,8 @@ Value KeyValue::incr(const std::string& key) {
 Value KeyValue::decr(const std::string& key, long long by) {
     std::unique_lock l(lock);
     params = {"DECRBY", key, Value{by}.s()};
-    barch::repl::call(params);
-    return sc.callv(params, ::DECRBY);
+    auto logged = replicate(sc, params);
+    return sc.callv(params, ::DECRBY, nullptr, &logged);
 
 }
 long long KeyValue::count(const std::string &start, const std::string &end) {
@@ -540,9 +622,39 @@ repl_statistics repl_stats() {
     r.attempted_routes = ar.attempted_routes;
     r.request_errors = ar.request_errors;
     r.barch_requests = ar.barch_requests;
+    r.repl_backlog = ar.repl_backlog;
+    r.repl_in_flight = ar.repl_in_flight;
+    r.repl_batches_sent = ar.repl_batches_sent;
+    r.repl_commands_acked = ar.repl_commands_acked;
+    r.repl_lag_ms = ar.repl_lag_ms;
+    r.repl_dropped = ar.repl_dropped;
     return r;
 }
 
+static std::vector<latency_statistics> to_latency_statistics(const heap::vector<barch::latency::summary>& from) {
+    std::vector<latency_statistics> r;
+    for (auto& s : from) {
+        latency_statistics l;
+        l.name = s.name;
+        l.count = (long long)s.count;
+        l.mean_usec = (double)s.total_ns / (double)s.count / 1000.0;
+        l.p50_usec = (double)s.p50_ns / 1000.0;
+        l.p99_usec = (double)s.p99_ns / 1000.0;
+        l.p999_usec = (double)s.p999_ns / 1000.0;
+        l.max_usec = (double)s.max_ns / 1000.0;
+        r.push_back(l);
+    }
+    return r;
+}
+
+std::vector<latency_statistics> latency_stats() {
+    return to_latency_statistics(barch::latency::commands());
+}
+
+std::vector<latency_statistics> latch_stats() {
+    return to_latency_statistics(barch::latency::latches());
+}
+
 ops_statistics ops_stats() {
     auto t =  barch::get_ops_statistics();
     ops_statistics r;
@@ -569,6 +681,8 @@ statistics_values stats() {
     r.heap_bytes_allocated = t.heap_bytes_allocated;
     r.vmm_bytes_allocated = t.vmm_bytes_allocated;
     r.keys_evicted = t.keys_evicted;
+    r.keys_evicted_lfu = t.keys_evicted_lfu;
+    r.keys_expired = t.keys_expired;
     r.last_vacuum_time = t.last_vacuum_time;
     r.leaf_nodes = t.leaf_nodes;
     r.leaf_nodes_replaced = t.leaf_nodes_replaced;
@@ -686,7 +800,11 @@ std::vector<Value> Caller::call(const std::string &method, const std::vector<Val
     if (ic->second.is_write()) {
         barch::repl::call(params);
     }
-    int r = sc.call(params, f);
+    barch::append_log::ticket logged{};
+    if (!sc.host) {
+        logged = barch::append_log::append_if_logged(sc.kspace()->get_canonical_name(), params);
+    }
+    int r = sc.call(params, f, &logged);
     if (r != 0) {
         result.insert(result.end(), sc.errors.begin(), sc.errors.end());
     }else {
@@ -705,8 +823,8 @@ void HashSet::set(const std::string &k, const std::vector<std::string>& members)
     std::unique_lock l(lock);
     params = {"HSET", k};
     params.insert(params.end(), members.begin(), members.end());
-    barch::repl::call(params);
-    int r = sc.call(params, ::HSET);
+    auto logged = replicate(sc, params);
+    int r = sc.call(params, ::HSET, &logged);
     if (r != 0) {
         barch::err({"set failed"});
     }
@@ -802,8 +920,8 @@ std::vector<Value> HashSet::expire(const std::string &k, const std::vector<std::
     params.emplace_back("FIELDS");
     params.emplace_back(std::to_string(fields.size()));
     params.insert(params.end(), fields.begin(), fields.end());
-    barch::repl::call(params);
-    sc.call(params, ::HEXPIRE);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::HEXPIRE, &logged);
     sc.append_flat(result);
     return result;
 }
@@ -820,8 +938,8 @@ Value HashSet::incrby(const std::string &k, const std::string& field, long long
     std::unique_lock l(lock);
     result.clear();
     params = {"HINCRBY", k, field, std::to_string(by)};
-    barch::repl::call(params);
-    sc.call(params, ::HINCRBY);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::HINCRBY, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
@@ -840,8 +958,8 @@ Value OrderedSet::add(const std::string &k, const std::vector<std::string>& flag
     params = {"ZADD", k};
     params.insert(params.end(), flags.begin(), flags.end());
     params.insert(params.end(), members.begin(), members.end());
-    barch::repl::call(params);
-    sc.call(params, ::ZADD);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZADD, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
@@ -921,8 +1039,8 @@ Value OrderedSet::remove(const std::string &k, const std::vector<std::string>& m
     result.clear();
     params = {"ZREM", k};
     params.insert(params.end(), members.begin(), members.end());
-    barch::repl::call(params);
-    sc.call(params, ::ZREM);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZREM, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
@@ -942,8 +1060,8 @@ Value OrderedSet::diffstore(const std::string &destkey, const std::vector<std::s
     result.clear();
     params = {"ZDIFFSTORE", destkey, std::to_string(keys.size())};
     params.insert(params.end(), keys.begin(), keys.end());
-    barch::repl::call(params);
-    sc.call(params, ::ZDIFFSTORE);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZDIFFSTORE, &logged);
     return sc.flat_at(0);
 }
 
@@ -951,8 +1069,8 @@ Value OrderedSet::incrby(const std::string &key, double val, const std::string &
     std::unique_lock l(lock);
     result.clear();
     params = {"ZINCRBY", key, std::to_string(val), field};
-    barch::repl::call(params);
-    sc.call(params, ::ZINCRBY);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZINCRBY, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
@@ -973,8 +1091,8 @@ Value OrderedSet::interstore(const std::string &destkey, const std::vector<std::
     result.clear();
     params = {"ZINTERSTORE", destkey, std::to_string(keys.size())};
     params.insert(params.end(), keys.begin(), keys.end());
-    barch::repl::call(params);
-    sc.call(params, ::ZINTERSTORE);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZINTERSTORE, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
@@ -984,8 +1102,8 @@ Value OrderedSet::intercard(const std::vector<std::string>& keys) {
     result.clear();
     params = {"ZINTERCARD", std::to_string(keys.size())};
     params.insert(params.end(), keys.begin(), keys.end());
-    barch::repl::call(params);
-    sc.call(params, ::ZINTERCARD);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZINTERCARD, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
@@ -994,8 +1112,8 @@ Value OrderedSet::remrangebylex(const std::string &key, const std::string& lower
     std::unique_lock l(lock);
     result.clear();
     params = {"ZREMRANGEBYLEX", key, lower, upper};
-    barch::repl::call(params);
-    sc.call(params, ::ZREMRANGEBYLEX);
+    auto logged = replicate(sc, params);
+    sc.call(params, ::ZREMRANGEBYLEX, &logged);
     if (sc.flat_empty()) return {nullptr};
     return sc.flat_at(0);
 }
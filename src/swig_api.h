@@ -15,6 +15,17 @@ void ping(const std::string &host, int port);
 void start(const std::string &host, const std::string& port);
 void start(const std::string &host, int port);
 void start(int port);
+/**
+ * start with the resp connections on io_uring rings, polled by a kernel thread when
+ * sqpoll is set. a build or kernel without io_uring falls back to asio
+ */
+void start_uring(const std::string &host, int port, bool sqpoll = false);
+/**
+ * start with every resp thread listening on the port itself and owning a share of the
+ * shards, which run the single key requests for them. There is one per hardware thread
+ * unless cores says how many
+ */
+void start_cores(const std::string &host, int port, int cores = 0);
 void stop();
 
 
@@ -46,6 +57,12 @@ struct repl_statistics {
     long long redis_sessions{};
     long long attempted_routes{};
     long long routes_succeeded{};
+    long long repl_backlog{};
+    long long repl_in_flight{};
+    long long repl_batches_sent{};
+    long long repl_commands_acked{};
+    long long repl_lag_ms{};
+    long long repl_dropped{};
 };
 struct ops_statistics {
     ops_statistics(){}
@@ -81,6 +98,8 @@ struct statistics_values {
     long long leaf_nodes_replaced {};
     long long pages_evicted {};
     long long keys_evicted {};
+    long long keys_evicted_lfu {};
+    long long keys_expired {};
     long long pages_defragged {};
     long long vmm_pages_defragged {};
     long long vmm_pages_popped {};
@@ -124,7 +143,24 @@ struct configuration_values {
     std::string bind_interface{"127.0.0.1"};
     int listen_port{12145};
 };
+/**
+ * a command's latency, or the waits for one shard's latch, as INFO latencystats has
+ * them. recorded while latency_tracking is on
+ */
+struct latency_statistics {
+    latency_statistics(){}
+    ~latency_statistics(){}
+    std::string name{};
+    long long count{};
+    double mean_usec{};
+    double p50_usec{};
+    double p99_usec{};
+    double p999_usec{};
+    double max_usec{};
+};
 configuration_values config();
+std::vector<latency_statistics> latency_stats();
+std::vector<latency_statistics> latch_stats();
 repl_statistics repl_stats();
 ops_statistics ops_stats();
 statistics_values stats();
@@ -326,6 +362,11 @@ public:
     bool put(const std::string &key, const std::string& value);
     std::string get(const std::string &key) const;
     Value vget(const std::string &key) const;
+    /**
+     * the values of several keys in one call, a nil Value for each one that is absent.
+     * the keys are looked up together, which is cheaper than a get per key
+     */
+    std::vector<Value> mget(const std::vector<std::string> &keys) const;
     Value incr(const std::string& key, double by);
     Value incr(const std::string& key, long long by);
     Value incr(const std::string& key);
@@ -352,6 +393,25 @@ public:
     long long prepend(const std::string& key, const std::string& value);
 };
 
+/**
+ * Puts gathered in the client and written with one MSET on commit, for bulk loads from
+ * an embedded interpreter. MSET applies them through a write batch, so each shard is
+ * locked once per commit instead of once per key. Nothing is visible until commit.
+ */
+class WriteBatch : public Caller {
+public:
+    WriteBatch();
+    WriteBatch(const std::string& keys_space);
+    WriteBatch(const std::string& host, int port);
+    void put(const std::string &key, const std::string &value);
+    long long size() const;
+    void clear();
+    /** write everything put since the last commit, OK or the error MSET gave */
+    Value commit();
+private:
+    std::vector<std::string> pending{};
+};
+
 /**
  * The has set like interface
  */
@@ -8,6 +8,7 @@
 #include "../external/include/valkeymodule.h"
 #include "keys.h"
 #include "module.h"
+#include "latency.h"
 struct vk_caller : caller {
     ~vk_caller() override = default;
     ValkeyModuleCtx *ctx = nullptr;
@@ -242,6 +243,7 @@ struct vk_caller : caller {
             args[i]= {k, klen};
         }
         int r = 0;
+        barch::latency::command_timer timed{std::string_view(args[0].chars(), args[0].size)};
         try {
             r = call(*this,args);
         }catch (const std::exception& e) {
@@ -0,0 +1,158 @@
+import glob
+import os
+import time
+
+import redis
+import barch
+
+# With append_log on every write is also written to a log, and LOAD replays what the log
+# holds past the snapshot it just read. This checks that what comes back is what was
+# written - counters counted once, expiries kept as deadlines, deletes, renames, list
+# moves and FLUSHDB replayed - with the log synced after every write and on an interval, and across a
+# SAVE that moves where the replay starts.
+
+PORT = 14700
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start append log test")
+
+
+def stats():
+    flat = r.execute_command("STATS")
+    out = {}
+    for i in range(0, len(flat) - 1, 2):
+        k = flat[i].decode() if isinstance(flat[i], bytes) else str(flat[i])
+        out[k] = int(flat[i + 1])
+    return out
+
+
+def resp_ok(reply):
+    return reply == b"OK" or reply == "OK"
+
+
+def text(v):
+    return v.decode() if isinstance(v, bytes) else v
+
+
+SEED = 2000
+expected = {}
+
+r.execute_command("USE", "appendlog")
+r.execute_command("FLUSHDB")
+# every shard gets keys, so that every shard has files for LOAD to read
+for i in range(SEED):
+    expected[f"seed:{i}"] = f"s{i}"
+    r.set(f"seed:{i}", f"s{i}")
+assert resp_ok(r.execute_command("SAVE"))
+
+r.config_set("append_fsync", "always")
+r.config_set("append_log", "on")
+before = stats()
+
+
+def check(when):
+    assert r.dbsize() == len(expected), f"{when}: {r.dbsize()} keys, expected {len(expected)}"
+    for k, v in expected.items():
+        if isinstance(v, dict):
+            for f, fv in v.items():
+                got = text(r.hget(k, f))
+                assert got == fv, f"{when}: {k}.{f} is {got}, expected {fv}"
+        elif isinstance(v, list):
+            got = [text(x) for x in r.lrange(k, 0, -1)]
+            assert got == v, f"{when}: {k} is {got}, expected {v}"
+        elif isinstance(v, tuple):
+            for m, score in v:
+                got = r.zscore(k, m)
+                assert got == score, f"{when}: {k} {m} scores {got}, expected {score}"
+        else:
+            got = text(r.get(k))
+            assert got == v, f"{when}: {k} is {got}, expected {v}"
+
+
+def write(round):
+    for i in range(round, SEED, 97):
+        expected[f"seed:{i}"] = f"r{round}:{i}"
+        r.set(f"seed:{i}", f"r{round}:{i}")
+    for i in range(round + 40, SEED, 301):
+        if f"seed:{i}" in expected:
+            del expected[f"seed:{i}"]
+            r.delete(f"seed:{i}")
+    for _ in range(25):
+        r.incr(f"counter:{round}")
+    expected[f"counter:{round}"] = "25"
+    r.hset(f"hash:{round}", mapping={"a": f"{round}a", "b": f"{round}b"})
+    expected[f"hash:{round}"] = {"a": f"{round}a", "b": f"{round}b"}
+    r.zadd(f"zset:{round}", {"x": 1.0, "y": round + 0.5})
+    expected[f"zset:{round}"] = (("x", 1.0), ("y", round + 0.5))
+
+
+write(1)
+r.set("expiring", "soon", ex=1000)
+expected["expiring"] = "soon"
+assert resp_ok(r.execute_command("LOAD"))
+check("after replaying the log")
+ttl = r.ttl("expiring")
+assert 990 <= ttl <= 1000, f"the expiry was replayed as {ttl} seconds"
+
+# a save moves where the replay starts, so what it holds is not replayed again
+assert resp_ok(r.execute_command("SAVE"))
+write(2)
+assert resp_ok(r.execute_command("LOAD"))
+check("after a save and more writes")
+assert r.get("counter:1") == b"25", "entries the snapshot held were replayed again"
+
+# synced on an interval rather than after every write
+r.config_set("append_fsync", "10")
+write(3)
+time.sleep(0.1)
+assert resp_ok(r.execute_command("LOAD"))
+check("with the log synced every 10ms")
+
+# the commands that write more than one shard are logged as what they did to each one,
+# which replays the same whether or not the other shards' snapshots already hold it
+r.config_set("append_fsync", "always")
+r.mset({f"multi:{i}": f"m{i}" for i in range(50)})
+for i in range(50):
+    expected[f"multi:{i}"] = f"m{i}"
+for i in range(0, 50, 5):
+    r.rename(f"multi:{i}", f"renamed:{i}")
+    expected[f"renamed:{i}"] = expected.pop(f"multi:{i}")
+r.rpush("source", "a", "b", "c")
+r.execute_command("LMOVE", "source", "target", "LEFT", "RIGHT")
+r.execute_command("RPOPLPUSH", "source", "target")
+expected["source"] = ["b"]
+expected["target"] = ["c", "a"]
+gone = [f"multi:{i}" for i in range(1, 50, 5)]
+r.delete(*gone)
+for k in gone:
+    del expected[k]
+assert resp_ok(r.execute_command("LOAD"))
+check("after replaying commands that span shards")
+
+after = stats()
+assert after["append_log_entries"] > before["append_log_entries"], "nothing was logged"
+assert after["append_log_bytes"] > before["append_log_bytes"], "nothing was written"
+assert after["append_log_fsyncs"] > before["append_log_fsyncs"], "the log was never synced"
+assert after["append_log_replayed"] > before["append_log_replayed"], "nothing was replayed"
+
+info = r.execute_command("INFO", "persistence")
+if isinstance(info, dict):
+    assert int(info.get("append_log_enabled", 0)) == 1, info
+else:
+    assert "append_log_enabled:1" in text(info), info
+
+# a FLUSHDB is replayed too, so the snapshot's keys do not come back from under it
+r.execute_command("FLUSHDB")
+r.set("after_flush", "1")
+expected = {"after_flush": "1"}
+assert resp_ok(r.execute_command("LOAD"))
+check("after a logged FLUSHDB")
+
+r.config_set("append_log", "off")
+r.execute_command("FLUSHDB")
+for segment in glob.glob("barch_append_*.log"):
+    os.remove(segment)
+print("append log test passed")
+barch.stop()
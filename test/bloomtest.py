@@ -0,0 +1,130 @@
+import time
+
+import redis
+import barch
+
+# The key filter each shard reads before it looks for a key (src/key_filter.h).
+#
+# A filter is only worth having if it rules keys out and never rules out a key that is
+# there, so this checks the counters that say which it did, that a shard grown past what
+# its filter was sized for is given a new one by maintenance, that the filter saved with a
+# shard is the one read back by LOAD rather than one rebuilt from the keys, and that a
+# key space pulling from another is filtered by both.
+
+PORT = 14870
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start bloom filter test")
+
+
+def stats():
+    flat = r.execute_command("STATS")
+    out = {}
+    for i in range(0, len(flat) - 1, 2):
+        k = flat[i].decode() if isinstance(flat[i], bytes) else str(flat[i])
+        out[k] = int(flat[i + 1])
+    return out
+
+
+def shard_info(key):
+    text = r.execute_command("INFO", "SHARD", key)
+    if isinstance(text, bytes):
+        text = text.decode()
+    out = {}
+    for line in text.splitlines():
+        if ":" in line:
+            k, v = line.split(":", 1)
+            out[k] = v
+    return out
+
+
+def resp_ok(reply):
+    return reply == b"OK" or reply == "OK"
+
+
+r.execute_command("CONFIG", "SET", "static_bloom_filter", "yes")
+r.execute_command("CONFIG", "SET", "max_save_deltas", "0")
+r.execute_command("USE", "bloom")
+r.execute_command("FLUSHDB")
+
+# --- the counters -----------------------------------------------------------------
+N = 50000
+for start in range(0, N, 5000):
+    r.mset({f"bloom:{i}": "v" for i in range(start, start + 5000)})
+
+before = stats()
+for i in range(0, 2000):
+    assert r.get(f"absent:{i}") is None
+after = stats()
+ruled_out = after["bloom_ruled_out"] - before["bloom_ruled_out"]
+passed = after["bloom_passed"] - before["bloom_passed"]
+false_positives = after["bloom_false_positives"] - before["bloom_false_positives"]
+assert ruled_out > 1800, f"only {ruled_out} of 2000 absent keys were ruled out"
+assert passed == false_positives, "an absent key that passed the filter has to be a false positive"
+assert ruled_out + passed == 2000, f"{ruled_out} ruled out and {passed} passed of 2000 lookups"
+
+before = stats()
+for i in range(0, 2000):
+    assert r.get(f"bloom:{i}") == b"v", f"bloom:{i} was ruled out"
+after = stats()
+assert after["bloom_passed"] - before["bloom_passed"] == 2000, "every present key has to pass"
+assert after["bloom_false_positives"] == before["bloom_false_positives"]
+assert after["bloom_ruled_out"] == before["bloom_ruled_out"]
+
+# --- the rebuild ------------------------------------------------------------------
+# the shard's filter was sized for an empty shard, which it has long outgrown. Maintenance
+# has to notice and build a bigger one
+deadline = time.time() + 60
+info = shard_info("bloom:1")
+while int(info["bloom_rebuilds"]) == 0 and time.time() < deadline:
+    time.sleep(0.2)
+    info = shard_info("bloom:1")
+assert int(info["bloom_rebuilds"]) > 0, "a filter far past its capacity was never rebuilt"
+assert int(info["bloom_capacity"]) >= int(info["size"]), "the rebuilt filter is still too small"
+# a rebuild loses nothing that is there
+for i in range(0, N, 7):
+    assert r.exists(f"bloom:{i}") == 1, f"bloom:{i} was lost by a rebuild"
+
+# --- the saved filter -------------------------------------------------------------
+# the rebuilt filter left room to grow into, so one sized for the keys on load would have
+# a different capacity: the same capacity and contents after LOAD means it was read back
+time.sleep(1)
+saved = shard_info("bloom:1")
+assert resp_ok(r.execute_command("SAVE"))
+assert resp_ok(r.execute_command("LOAD"))
+loaded = shard_info("bloom:1")
+for field in ("bloom_capacity", "bloom_bytes", "bloom_added"):
+    assert loaded[field] == saved[field], f"{field} was {saved[field]} before LOAD and {loaded[field]} after"
+for i in range(0, N, 7):
+    assert r.get(f"bloom:{i}") == b"v", f"bloom:{i} was ruled out by the loaded filter"
+before = stats()
+for i in range(0, 2000):
+    assert r.get(f"absent:{i}") is None
+assert stats()["bloom_ruled_out"] - before["bloom_ruled_out"] > 1800, "the loaded filter rules nothing out"
+
+# --- a key space with a source ----------------------------------------------------
+# a key only the source has must still be found through the dependent space, and a key
+# neither has is ruled out by both filters
+r.execute_command("USE", "bloomsrc")
+r.execute_command("FLUSHDB")
+r.set("upstream", "u")
+r.execute_command("USE", "bloomdep")
+r.execute_command("FLUSHDB")
+r.set("local", "l")
+r.execute_command("SPACES DEPENDS bloomdep ON bloomsrc")
+assert r.get("upstream") == b"u", "a key only in the source was ruled out"
+assert r.get("local") == b"l"
+before = stats()
+for i in range(0, 500):
+    assert r.get(f"nowhere:{i}") is None
+assert stats()["bloom_ruled_out"] - before["bloom_ruled_out"] > 400, "a space with a source is not filtered"
+r.execute_command("SPACES DROP bloomdep")
+r.execute_command("SPACES DROP bloomsrc")
+
+r.execute_command("USE", "bloom")
+r.execute_command("FLUSHDB")
+r.close()
+barch.stop()
+print("complete bloom filter test")
@@ -0,0 +1,92 @@
+import socket
+import time
+
+import redis
+import barch
+
+# Connections borrow the buffer they read requests into from a shared pool, and give it
+# back once nothing in it is waiting to be parsed, so idle connections hold none. Reads
+# grow while they keep filling what they were given. This checks that many idle
+# connections leave little lent, that a bulk write grows the read size CLIENT INFO
+# reports, that INFO memory counts loans coming back out of the pool, and that a request
+# split right after a '\r' is not finished by what a reused buffer held before.
+
+PORT = 14850
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start read buffer pool test")
+
+
+def memory_info():
+    info = r.execute_command("INFO", "MEMORY")
+    info = info.decode() if isinstance(info, bytes) else info
+    out = {}
+    for line in info.splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            out[k] = v
+    return out
+
+
+def client_fields(c):
+    info = c.execute_command("CLIENT", "INFO")
+    info = info.decode() if isinstance(info, bytes) else info
+    return dict(f.split("=", 1) for f in info.split() if "=" in f)
+
+
+r.execute_command("CONFIG", "RESETSTAT")
+IDLE = 200
+clients = [redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2) for _ in range(IDLE)]
+for n, c in enumerate(clients):
+    assert c.set(f"pool:{n}", n)
+
+info = memory_info()
+lent = int(info["barch_read_buffers_lent_bytes"])
+# only the connection asking is holding a buffer while it is answered
+assert lent < IDLE * 4096 // 4, f"{lent} bytes lent with {IDLE} idle connections"
+assert int(info["barch_read_buffers_reused"]) > 0, "no loan came out of the pool"
+
+fields = client_fields(r)
+assert int(fields["qbuf"]) == 0, f"qbuf {fields['qbuf']} with nothing waiting"
+small = int(fields["rbs"])
+
+value = b"x" * (4 * 1024 * 1024)
+r.set("pool:big", value)
+assert r.get("pool:big") == value
+fields = client_fields(r)
+assert int(fields["rbp"]) > small, f"reads did not grow for a bulk write: rbp {fields['rbp']}, rbs was {small}"
+
+# the first request leaves "\r\n" where the second is cut, in the buffer the second is
+# read into. Only what was received may end a line
+raw = socket.create_connection(("127.0.0.1", PORT))
+request = b"*2\r\n$3\r\nGET\r\n$6\r\npool:1\r\n"
+answer = b"$1\r\n1\r\n"
+
+
+def read_answer():
+    got = b""
+    while len(got) < len(answer):
+        chunk = raw.recv(4096)
+        assert chunk, "the connection closed"
+        got += chunk
+    return got
+
+
+for cut in (3, 7, 12, 16, 24):
+    raw.sendall(request)
+    assert read_answer() == answer
+    assert request[cut - 1:cut] == b"\r", f"request is not cut after a CR at {cut}"
+    raw.sendall(request[:cut])
+    time.sleep(0.1)
+    raw.sendall(request[cut:])
+    got = read_answer()
+    assert got == answer, f"a request cut after byte {cut} was answered with {got!r}"
+raw.close()
+
+for c in clients:
+    c.close()
+r.execute_command("FLUSHDB")
+print("read buffer pool test passed")
+barch.stop()
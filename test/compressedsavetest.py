@@ -0,0 +1,134 @@
+import glob
+import os
+import shutil
+
+import redis
+import barch
+
+# With save_compression_level set a snapshot is written as zstd compressed pages, each
+# behind a crc32c, by a few threads while it is written out. This checks that it is
+# smaller than the pages it holds, that LOAD reads it back as it was saved, and that
+# INFO persistence reports it. The page image and the delta files carry a crc32c per page
+# as well, and a LOAD of a file with a damaged page fails rather than serve it.
+
+PORT = 14600
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start compressed save test")
+
+
+def stats():
+    flat = r.execute_command("STATS")
+    out = {}
+    for i in range(0, len(flat) - 1, 2):
+        k = flat[i].decode() if isinstance(flat[i], bytes) else str(flat[i])
+        out[k] = int(flat[i + 1])
+    return out
+
+
+def resp_ok(reply):
+    return reply == b"OK" or reply == "OK"
+
+
+N = 30000
+
+r.execute_command("USE", "compressedsave")
+r.execute_command("FLUSHDB")
+r.config_set("save_compression_level", "3")
+
+expected = {}
+for i in range(N):
+    expected[f"z:{i}"] = f"value {i} " * 4
+    r.set(f"z:{i}", expected[f"z:{i}"])
+
+before = stats()
+assert resp_ok(r.execute_command("SAVE"))
+after = stats()
+raw = after["snapshot_bytes_raw"] - before["snapshot_bytes_raw"]
+written = after["snapshot_bytes_written"] - before["snapshot_bytes_written"]
+assert raw > 0, "nothing was saved"
+assert written < raw, f"{written} bytes written for {raw} bytes of pages"
+
+info = r.execute_command("INFO", "persistence")
+if isinstance(info, dict):
+    assert int(info.get("snapshot_compression_level", 0)) == 3, info
+    assert "snapshot_last_bytes_per_sec" in info, info
+else:
+    info = info.decode() if isinstance(info, bytes) else info
+    assert "snapshot_compression_level:3" in info, info
+    assert "snapshot_last_bytes_per_sec:" in info, info
+
+assert resp_ok(r.execute_command("LOAD"))
+assert r.dbsize() == N, f"{r.dbsize()} keys, expected {N}"
+for k, v in expected.items():
+    got = r.get(k)
+    assert got is not None and got.decode() == v, f"{k} is {got}, expected {v}"
+
+# and back to the page image, which loads the same
+r.config_set("save_compression_level", "0")
+assert resp_ok(r.execute_command("SAVE"))
+assert resp_ok(r.execute_command("LOAD"))
+assert r.dbsize() == N
+
+PAGE = 262144
+
+
+def damage(pattern, at):
+    # flips a byte of the first page after the header in every file big enough to have one
+    damaged = []
+    for f in glob.glob(pattern):
+        if os.path.getsize(f) <= at:
+            continue
+        shutil.copyfile(f, f + ".good")
+        with open(f, "r+b") as fh:
+            fh.seek(at)
+            b = fh.read(1)
+            fh.seek(at)
+            fh.write(bytes([b[0] ^ 0x5a]))
+        damaged.append(f)
+    return damaged
+
+
+def repair(damaged):
+    for f in damaged:
+        os.replace(f + ".good", f)
+
+
+def load_fails():
+    try:
+        reply = r.execute_command("LOAD")
+    except redis.ResponseError:
+        return True
+    return not resp_ok(reply)
+
+
+# the image starts on the first page boundary after its header, and page 0 is never used
+damaged = damage("*.dat", 2 * PAGE + 100)
+assert damaged, "no snapshot was big enough to damage"
+assert load_fails(), "a snapshot with a damaged page was loaded"
+repair(damaged)
+assert resp_ok(r.execute_command("LOAD"))
+assert r.dbsize() == N
+
+# a delta holds page records, each behind the crc32c of its page
+r.config_set("max_save_deltas", "2")
+assert resp_ok(r.execute_command("SAVE"))
+for i in range(0, N, 101):
+    expected[f"z:{i}"] = f"changed {i}"
+    r.set(f"z:{i}", expected[f"z:{i}"])
+assert resp_ok(r.execute_command("SAVE"))
+damaged = damage("*.delta", os.path.getsize(glob.glob("*.delta")[0]) - 1000) if glob.glob("*.delta") else []
+assert damaged, "the second save wrote no delta"
+assert load_fails(), "a delta with a damaged page was loaded"
+repair(damaged)
+assert resp_ok(r.execute_command("LOAD"))
+assert r.dbsize() == N
+for i in range(0, N, 101):
+    assert r.get(f"z:{i}").decode() == expected[f"z:{i}"]
+r.config_set("max_save_deltas", "0")
+
+r.execute_command("FLUSHDB")
+print("compressed save test passed")
+barch.stop()
@@ -16,17 +16,21 @@ PORT = 14000
 # that a variable added to the server without being added to the reflection - or the
 # other way round - shows up as a failure instead of being quietly skipped.
 EXPECTED = {
-    "active_defrag", "compression", "db_number_prefix", "eviction_policy",
+    "active_defrag", "append_fsync", "append_log", "append_segment_size", "compression", "db_number_prefix", "eviction_policy",
     "external_host", "foreign_pool_max_age_ms", "foreign_script_insns",
     "foreign_timeout_ms",
-    "iteration_worker_count", "listen_port", "log_page_access_trace",
-    "maintenance_poll_delay", "max_defrag_page_count", "max_memory_bytes",
-    "max_modifications_before_save", "max_resp_connections", "max_scan_iterators",
+    "iteration_worker_count", "latency_tracking", "lfu_decay_time", "lfu_log_factor",
+    "listen_port", "lock_profiling", "log_page_access_trace",
+    "maintenance_poll_delay", "maintenance_threads", "max_defrag_page_count",
+    "max_glob_queue", "max_glob_workers", "max_memory_bytes",
+    "max_modifications_before_save", "max_resp_connections", "max_save_deltas",
+    "max_scan_iterators",
     "min_compressed_size", "min_fragmentation_ratio", "ordered_keys",
-    "pre_evict_thresh", "rpc_client_max_wait_ms", "rpc_max_buffer", "save_interval",
-    "server_binding", "server_port", "static_bloom_filter",
+    "pre_evict_thresh", "repl_backoff_max_ms", "repl_backpressure", "repl_queue_max",
+    "rpc_client_max_wait_ms", "rpc_max_buffer", "save_compression_level",
+    "save_interval", "server_binding", "server_port", "static_bloom_filter",
     "tls_pem_certificate_chain_file", "tls_private_key_file", "tls_tmp_dh_file",
-    "use_vmm_mem",
+    "use_vmm_mem", "verify_mapped_pages",
 }
 
 # the redis names barch also answers to, and the barch variable each one means. A
@@ -60,6 +64,10 @@ ALIASES_WRITTEN = {n: b for n, b in REDIS_ALIASES.items() if b not in {"server_p
 # an enum.
 NEW_VALUE = {
     "active_defrag": "off",
+    # turning the log on opens it in the working directory and replays what is there
+    "append_fsync": "always",
+    "append_log": "on",
+    "append_segment_size": "1048576",
     "compression": "zstd",
     # what SELECT <n> puts before the number to name the space. Any word without a colon
     # or a space in it is accepted; ':' is refused because it separates the key space
@@ -71,25 +79,38 @@ NEW_VALUE = {
     "foreign_script_insns": "2000000",
     "foreign_timeout_ms": "120000",
     "iteration_worker_count": "6",
+    "latency_tracking": "on",
+    "lfu_decay_time": "2",
+    "lfu_log_factor": "20",
+    "lock_profiling": "on",
     "log_page_access_trace": "on",
     "maintenance_poll_delay": "120",
+    "maintenance_threads": "3",
     "max_defrag_page_count": "16",
+    "max_glob_queue": "32",
+    "max_glob_workers": "4",
     "max_memory_bytes": "34359738368",
     "max_modifications_before_save": "500000",
     "max_resp_connections": "1500",
+    "max_save_deltas": "4",
     "max_scan_iterators": "64",
     "min_compressed_size": "128",
     "min_fragmentation_ratio": "0.4",
     "ordered_keys": "off",
     "pre_evict_thresh": "0.75",
+    "repl_backoff_max_ms": "10000",
+    "repl_backpressure": "drop-oldest",
+    "repl_queue_max": "500000",
     "rpc_client_max_wait_ms": "15000",
     "rpc_max_buffer": "262144",
+    "save_compression_level": "3",
     "save_interval": "600000",
     "static_bloom_filter": "off",
     "tls_pem_certificate_chain_file": "other.crt",
     "tls_private_key_file": "other.key",
     "tls_tmp_dh_file": "other.dh",
     "use_vmm_mem": "off",
+    "verify_mapped_pages": "on",
 }
 
 # these decide where the server listens, so changing them out from under a live
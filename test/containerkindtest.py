@@ -1,3 +1,4 @@
+import time
 import redis
 import barch
 
@@ -185,4 +186,38 @@ assert ok("ZRANK", "ck:once", "n") == 1
 assert ok("ZREM", "ck:once", "m") == 1
 assert ok("ZRANGE", "ck:once", "0", "-1") == [b"n"]
 
+# --- HLEN and ZCARD are kept by the shard, so every way a member goes has to count ---
+ok("HSET", "ck:cnt", "a", "1", "b", "2", "c", "3", "d", "4")
+assert ok("HLEN", "ck:cnt") == 4
+ok("HSET", "ck:cnt", "a", "a much longer value than the one it replaces")
+assert ok("HLEN", "ck:cnt") == 4, "overwriting a field changed the count"
+assert ok("HDEL", "ck:cnt", "a", "nope") == 1
+assert ok("HLEN", "ck:cnt") == 3
+ok("HGETDEL", "ck:cnt", "FIELDS", "b")
+assert ok("HLEN", "ck:cnt") == 2
+ok("HEXPIRE", "ck:cnt", "1", "FIELDS", "1", "c")
+for i in range(40):
+    if ok("HLEN", "ck:cnt") == 1:
+        break
+    time.sleep(0.1)
+assert ok("HLEN", "ck:cnt") == 1, "an expired field was still counted"
+ok("DEL", "ck:cnt")
+assert ok("HLEN", "ck:cnt") == 0
+ok("HSET", "ck:cnt", "again", "1")
+assert ok("HLEN", "ck:cnt") == 1, "a hash made again under a deleted name kept the old count"
+ok("HSET", "12345", "f", "v", "g", "w")
+assert ok("HLEN", "12345") == 2, "a numeric name"
+
+ok("ZADD", "ck:zcnt", "1", "a", "2", "b", "3", "c", "4", "d")
+assert ok("ZCARD", "ck:zcnt") == 4
+ok("ZADD", "ck:zcnt", "10", "a")
+ok("ZINCRBY", "ck:zcnt", "5", "b")
+assert ok("ZCARD", "ck:zcnt") == 4, "changing a score changed the count"
+assert ok("ZREM", "ck:zcnt", "c") == 1
+assert ok("ZCARD", "ck:zcnt") == 3
+ok("ZPOPMIN", "ck:zcnt")
+assert ok("ZCARD", "ck:zcnt") == 2
+ok("DEL", "ck:zcnt")
+assert ok("ZCARD", "ck:zcnt") == 0
+
 print("container kind test passed")
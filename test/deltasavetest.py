@@ -0,0 +1,95 @@
+import redis
+import barch
+
+# With max_save_deltas on, a save after the first writes only the pages that changed since
+# the one before it, to a delta file beside the shard's snapshot, and LOAD reads the
+# snapshot and then every delta in order. This checks that what comes back is what was
+# saved last - changed keys, deleted keys and untouched ones - through a few deltas and
+# through the full snapshot that replaces them once there are max_save_deltas of them.
+
+PORT = 14400
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start delta save test")
+
+
+def stats():
+    flat = r.execute_command("STATS")
+    out = {}
+    for i in range(0, len(flat) - 1, 2):
+        k = flat[i].decode() if isinstance(flat[i], bytes) else str(flat[i])
+        out[k] = int(flat[i + 1])
+    return out
+
+
+def resp_ok(reply):
+    return reply == b"OK" or reply == "OK"
+
+
+N = 20000
+DELTAS = 3
+
+r.execute_command("USE", "deltasave")
+r.execute_command("FLUSHDB")
+r.config_set("max_save_deltas", str(DELTAS))
+
+expected = {}
+for i in range(N):
+    expected[f"d:{i}"] = f"v{i}"
+    r.set(f"d:{i}", f"v{i}")
+# the first save is always a full snapshot, it is what the deltas are taken against
+assert resp_ok(r.execute_command("SAVE"))
+before = stats()
+
+
+def change(round):
+    for i in range(round, N, 997):
+        expected[f"d:{i}"] = f"r{round}:{i}"
+        r.set(f"d:{i}", f"r{round}:{i}")
+    for i in range(round + 500, N, 1999):
+        if f"d:{i}" in expected:
+            del expected[f"d:{i}"]
+            r.delete(f"d:{i}")
+    expected[f"new:{round}"] = f"n{round}"
+    r.set(f"new:{round}", f"n{round}")
+
+
+def check(when):
+    assert r.dbsize() == len(expected), f"{when}: {r.dbsize()} keys, expected {len(expected)}"
+    for i in range(0, N, 13):
+        k = f"d:{i}"
+        got = r.get(k)
+        want = expected.get(k)
+        assert (got.decode() if got is not None else None) == want, f"{when}: {k} is {got}, expected {want}"
+    for k, v in expected.items():
+        if k.startswith("new:"):
+            assert r.get(k).decode() == v, f"{when}: {k}"
+
+
+change(1)
+assert resp_ok(r.execute_command("SAVE"))
+after = stats()
+assert after["save_deltas"] > before["save_deltas"], "a save of a few changed keys wrote a snapshot"
+assert after["save_pages_unchanged"] > before["save_pages_unchanged"], "a delta wrote every page"
+assert resp_ok(r.execute_command("LOAD"))
+check("after one delta")
+
+# the rest of the deltas, then the full snapshot that takes their place
+for round in range(2, DELTAS + 3):
+    change(round)
+    assert resp_ok(r.execute_command("SAVE"))
+    assert resp_ok(r.execute_command("LOAD"))
+    check(f"after save {round}")
+
+# and back to writing every save in full
+r.config_set("max_save_deltas", "0")
+change(DELTAS + 3)
+assert resp_ok(r.execute_command("SAVE"))
+assert resp_ok(r.execute_command("LOAD"))
+check("after a full save")
+
+r.execute_command("FLUSHDB")
+print("delta save test passed")
+barch.stop()
@@ -35,4 +35,22 @@ stats = barch.stats()
 print(stats.oom_avoided_inserts)
 print(f"stats.keys_evicted {stats.keys_evicted}")
 assert(stats.keys_evicted > MAXK/3)
-assert(barch.size() <  MAXK)
\ No newline at end of file
+assert(barch.size() <  MAXK)
+# without any memory pressure, short lived keys are reclaimed close to their deadline
+barch.clear()
+barch.setConfiguration("max_memory_bytes","300m")
+SHORT = 50000
+expired_before = barch.stats().keys_expired
+for i in range(SHORT):
+    k.set("short"+str(i),str(i))
+    k.expire("short"+str(i),2)
+for i in range(100):
+    k.set("long"+str(i),str(i))
+assert(barch.size() == SHORT + 100)
+for i in range(40):
+    if barch.size() == 100:
+        break
+    time.sleep(0.25)
+print("after expiry", barch.size())
+assert(barch.size() == 100)
+assert(barch.stats().keys_expired - expired_before >= SHORT)
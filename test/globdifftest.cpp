@@ -10,6 +10,11 @@
 // Any disagreement reported here is a bug in the optimised path - the reference
 // side is the same code redis ships.
 //
+// glob::compiled, the matcher KEYS, VALUES and SCAN compile a pattern into once, is
+// held to the same reference, over the same corpora and over one with classes in it.
+// Run with `bench` it times the three of them instead, over the two corpora
+// globperftest.py uses: filler that avoids the searched for letters, and JSON.
+//
 
 // the heavy headers go in first, then glob's private section is reopened so the
 // reference matcher can be called directly. access specifiers do not change the
@@ -20,7 +25,10 @@
 #undef private
 
 #include <cctype>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -58,6 +66,7 @@ void check(const std::string &pat, const std::string &str, int nocase) {
     if (samples.size() < 4000) samples.push_back({pat, str, nocase, want, got});
 }
 
+
 // every string over the alphabet up to maxLen, the empty one included
 void expand(const std::string &alphabet, size_t maxLen, std::vector<std::string> &out) {
     out.emplace_back("");
@@ -86,6 +95,84 @@ std::string upper(const std::string &s) {
     return r;
 }
 
+long long compiled_failed = 0;
+long long compiled_checked = 0;
+
+// one compiled matcher per pattern against every subject, which is how a scan uses it
+void check_compiled(const std::string &pat, const std::vector<std::string> &subjects, int nocase,
+                    bool fold_subjects = false) {
+    glob::compiled m(art::value_type(pat.data(), pat.size()), nocase);
+    for (const auto &s : subjects) {
+        std::string str = fold_subjects ? upper(s) : s;
+        ++compiled_checked;
+        int want = reference(pat, str, nocase);
+        int got = m.match(art::value_type(str.data(), str.size()));
+        if (want == got) continue;
+        if (compiled_failed++ < 12) {
+            printf("    compiled: pattern %-12s subject %-10s nocase=%d reference=%d compiled=%d\n",
+                   show(pat).c_str(), show(str).c_str(), nocase, want, got);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------- bench
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the two corpora of globperftest.py, built the same way: values of a thousand bytes
+// drawn from filler that never holds the searched for letters, and JSON documents
+std::vector<std::string> perf_corpus(bool json, size_t entries) {
+    std::mt19937_64 rng(42);
+    std::vector<std::string> out;
+    out.reserve(entries);
+    const std::string filler = "abcdefghiklmnoprstuvy0123456789 ";
+    for (size_t i = 0; i < entries; ++i) {
+        std::string v;
+        if (!json) {
+            while (v.size() < 1000) v.push_back(filler[rng() % filler.size()]);
+        } else {
+            v = "{";
+            while (v.size() < 980) {
+                v += "\"field" + std::to_string(rng() % 50) + "\": \"" + std::to_string(rng()) + "\", ";
+            }
+            v += "\"end\": 1}";
+        }
+        if (i % 100 == 0) v.replace(500, 5, "zqxjw");
+        out.push_back(std::move(v));
+    }
+    return out;
+}
+
+void bench_one(const char *corpus_name, const std::vector<std::string> &corpus, const std::string &pattern) {
+    art::value_type pat(pattern.data(), pattern.size());
+    long long hits[3] = {};
+    double took[3] = {};
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &v : corpus) hits[0] += reference(pattern, v, 0);
+    took[0] = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    for (const auto &v : corpus) hits[1] += glob::stringmatchlen(pat, art::value_type(v.data(), v.size()), 0);
+    took[1] = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    glob::compiled m(pat, 0);
+    for (const auto &v : corpus) hits[2] += m.match(art::value_type(v.data(), v.size()));
+    took[2] = seconds_since(start);
+    printf("  %-6s %-18s reference %8.2f ms  stringmatchlen %8.2f ms  compiled %8.2f ms  %s\n",
+           corpus_name, pattern.c_str(), took[0] * 1e3, took[1] * 1e3, took[2] * 1e3,
+           (hits[0] == hits[1] && hits[1] == hits[2]) ? "" : "DISAGREE");
+}
+
+int bench(size_t entries) {
+    auto filler = perf_corpus(false, entries);
+    auto json = perf_corpus(true, entries);
+    const char *patterns[] = {"*zqxjw*", "*zqxj[w]*", "*z?xjw*", "*[x-z]qxjw*", "*\"field4\": \"1*", "*:*end*"};
+    printf("glob bench: %zu values of about a thousand bytes per corpus\n\n", entries);
+    for (auto p : patterns) bench_one("filler", filler, p);
+    for (auto p : patterns) bench_one("json", json, p);
+    return 0;
+}
+
 void report_group(const char *title, bool nocase_wanted, bool with_star_question) {
     std::vector<std::string> seen;
     int shown = 0;
@@ -108,7 +195,10 @@ void report_group(const char *title, bool nocase_wanted, bool with_star_question
 
 } // namespace
 
-int main() {
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return bench(argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000);
+    }
     // stage 1 - every construct the optimised path can see, against a two letter
     // subject alphabet. small alphabets are what make the shortcuts collide
     std::vector<std::string> patterns, subjects;
@@ -217,6 +307,25 @@ int main() {
         }
     }
 
+    // stage 6 - the compiled matcher, over the corpora above and one with classes
+    for (const auto &p : patterns) check_compiled(p, subjects, 0);
+    for (const auto &p : patterns2) check_compiled(p, subjects2, 0);
+    for (const auto &p : patterns2) check_compiled(p, subjects2, 1, true);
+    {
+        std::vector<std::string> class_patterns, class_subjects;
+        expand("ab*?[]^-\\", 5, class_patterns);
+        expand("ab-]", 4, class_subjects);
+        for (const auto &p : class_patterns) {
+            check_compiled(p, class_subjects, 0);
+            check_compiled(p, class_subjects, 1, true);
+        }
+        for (auto &pr : pairs) {
+            std::vector<std::string> one{pr[1], upper(pr[1])};
+            check_compiled(pr[0], one, 0);
+            check_compiled(pr[0], one, 1);
+        }
+    }
+
     printf("glob differential: optimised asterisk_impl against the reference matcher\n\n");
     printf("  stage 1  literals/*/?/backslash x ab   %9lld checked %8lld disagreements\n",
            count1, after1);
@@ -230,6 +339,13 @@ int main() {
            16, unterminated_failures);
     printf("  total                                  %9lld checked %8lld disagreements\n\n",
            checked, failed);
+    printf("  stage 6  glob::compiled, with classes  %9lld checked %8lld disagreements\n\n",
+           compiled_checked, compiled_failed);
+
+    if (compiled_failed) {
+        printf("FAILED: the compiled matcher does not agree with the reference matcher\n");
+        return 1;
+    }
 
     if (unterminated_failures) {
         printf("FAILED: a pattern that is not NUL terminated is read past its end\n");
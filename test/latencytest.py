@@ -0,0 +1,114 @@
+import threading
+import time
+
+import redis
+import barch
+
+# With latency_tracking on every call is timed into a histogram of its thread, and so is
+# every wait for a shard's latch. INFO latencystats merges them into percentiles per
+# command and per shard. This checks that the calls made show up with percentiles in
+# order, that a latch had at once is not counted as a wait and one that was waited for
+# is, that nothing is recorded while it is off, and that CONFIG RESETSTAT clears it.
+
+PORT = 14800
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start latency stats test")
+
+
+def latencystats():
+    """INFO latencystats as {name: {field: value}}"""
+    info = r.execute_command("INFO", "latencystats")
+    out = {}
+    if isinstance(info, dict):
+        for k, v in info.items():
+            out[k] = v if isinstance(v, dict) else {"value": v}
+        return out
+    info = info.decode() if isinstance(info, bytes) else info
+    for line in info.splitlines():
+        if ":" not in line or line.startswith("#"):
+            continue
+        k, v = line.split(":", 1)
+        fields = {}
+        for part in v.split(","):
+            if "=" in part:
+                f, n = part.split("=", 1)
+                fields[f] = float(n)
+            else:
+                fields["value"] = part
+        out[k] = fields
+    return out
+
+
+N = 5000
+
+r.config_set("latency_tracking", "on")
+assert r.execute_command("CONFIG", "RESETSTAT") in (b"OK", "OK")
+for i in range(N):
+    r.set(f"lat:{i}", f"v{i}")
+for i in range(N):
+    r.get(f"lat:{i}")
+
+stats = latencystats()
+for cmd in ("set", "get"):
+    line = stats.get(f"latency_percentiles_usec_{cmd}")
+    assert line is not None, f"no latency recorded for {cmd}: {sorted(stats)}"
+    assert 0 < line["p50"] <= line["p99"] <= line["p99.9"], f"{cmd} percentiles out of order: {line}"
+
+
+def latch_waits(stats):
+    return sum(v["waits"] for k, v in stats.items() if k.startswith("latch_wait_usec_"))
+
+
+# one client at a time finds every latch free, and only maintenance can have been in the way
+waits = latch_waits(stats)
+assert waits < N, f"{waits} latch waits recorded for {2 * N} calls that had no one to wait for"
+
+# writers that keep a shard's latch to themselves for a whole MSET make the others wait
+stop = threading.Event()
+
+
+def writer(w):
+    c = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+    batch = {f"lat:{i}": f"w{w}" for i in range(2000)}
+    while not stop.is_set():
+        c.mset(batch)
+    c.close()
+
+
+writers = [threading.Thread(target=writer, args=(w,)) for w in range(4)]
+for t in writers:
+    t.start()
+deadline = time.time() + 30
+while latch_waits(latencystats()) == waits and time.time() < deadline:
+    time.sleep(0.2)
+stop.set()
+for t in writers:
+    t.join()
+stats = latencystats()
+latches = {k: v for k, v in stats.items() if k.startswith("latch_wait_usec_")}
+assert latches, "no latch waits were recorded"
+assert latch_waits(stats) > waits, "writers contending for the same shards never waited"
+
+# the same through the binding, which reads the same histograms
+by_name = {s.name: s for s in barch.latency_stats()}
+assert by_name["set"].count >= N, f"the binding saw {by_name['set'].count} SETs"
+assert by_name["set"].p50_usec <= by_name["set"].p99_usec <= by_name["set"].max_usec
+assert len(barch.latch_stats()) == len(latches)
+
+# nothing is recorded while it is off
+r.config_set("latency_tracking", "off")
+before = {s.name: s.count for s in barch.latency_stats()}
+for i in range(100):
+    r.get(f"lat:{i}")
+after = {s.name: s.count for s in barch.latency_stats()}
+assert after.get("get") == before.get("get"), "GET was timed with latency_tracking off"
+
+assert r.execute_command("CONFIG", "RESETSTAT") in (b"OK", "OK")
+assert not barch.latency_stats(), "CONFIG RESETSTAT left latencies behind"
+
+r.execute_command("FLUSHDB")
+print("latency stats test passed")
+barch.stop()
@@ -0,0 +1,37 @@
+import barch
+import time
+MAXK = 100000
+HOT = 1000
+barch.clear()
+barch.save()
+barch.setConfiguration("max_memory_bytes","300m")
+barch.setConfiguration("eviction_policy","allkeys-lfu")
+# every access counts, so the hot keys are well clear of the cold ones
+barch.setConfiguration("lfu_log_factor","1")
+k = barch.KeyValue()
+for i in range(MAXK):
+    k.set(str(i),str(i))
+assert(barch.size() == MAXK)
+# a scan touches every key once, the hot set is used over and over
+for i in range(MAXK):
+    k.get(str(i))
+for r in range(10):
+    for i in range(HOT):
+        k.get(str(i))
+
+barch.setConfiguration("max_memory_bytes","1m")
+print("evicting")
+for i in range(120):
+    if barch.size() < MAXK * 0.6:
+        break
+    time.sleep(0.5)
+print(barch.size())
+assert(barch.size() < MAXK * 0.6)
+barch.setConfiguration("max_memory_bytes","300m")
+
+hot = sum(1 for i in range(HOT) if k.exists(str(i)))
+cold = sum(1 for i in range(HOT, MAXK) if k.exists(str(i)))
+print("hot", hot, "of", HOT, "cold", cold, "of", MAXK - HOT)
+assert(hot >= HOT * 0.9)
+assert(hot / HOT > cold / (MAXK - HOT))
+assert(barch.stats().keys_evicted_lfu > 0)
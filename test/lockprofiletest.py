@@ -0,0 +1,89 @@
+import redis
+import barch
+
+# Every shard latch counts its unique acquisitions and the ones that had to wait. With
+# lock_profiling on it also counts shared acquisitions, times waits and holds and
+# samples where writers held it from. INFO locks ranks the latches, and LOCKS returns the hottest as arrays. This
+# checks that the calls made are counted, that nothing is timed while it is off, and
+# that CONFIG RESETSTAT clears it.
+
+PORT = 14810
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start lock profile test")
+
+
+def locks():
+    """INFO locks as {name: {field: value}}"""
+    info = r.execute_command("INFO", "locks")
+    info = info.decode() if isinstance(info, bytes) else info
+    out = {}
+    for line in info.splitlines():
+        if ":" not in line or line.startswith("#"):
+            continue
+        k, v = line.split(":", 1)
+        fields = {}
+        for part in v.split(","):
+            if "=" in part:
+                f, n = part.split("=", 1)
+                try:
+                    fields[f] = float(n)
+                except ValueError:
+                    fields[f] = n
+            else:
+                fields["value"] = part
+        out[k] = fields
+    return out
+
+
+N = 5000
+
+r.config_set("lock_profiling", "off")
+assert r.execute_command("CONFIG", "RESETSTAT") in (b"OK", "OK")
+for i in range(N):
+    r.set(f"lock:{i}", f"v{i}")
+for i in range(N):
+    r.get(f"lock:{i}")
+
+stats = locks()
+assert stats["lock_profiling"]["value"] == "0"
+latches = {k: v for k, v in stats.items() if k.startswith("latch_") and not k.startswith("latch_site_")}
+assert latches, "no latch was counted"
+assert len(latches) == int(stats["latches_used"]["value"])
+unique = sum(v["unique"] for v in latches.values())
+assert unique >= N, f"{unique} unique latch acquisitions counted for {N} SETs"
+# maintenance reads a latch now and then, a GET is not counted
+shared = sum(v["shared"] for v in latches.values())
+assert shared < N, f"{shared} shared latch acquisitions counted with lock_profiling off"
+assert all(v["hold_usec"] == 0 for v in latches.values()), "holds were timed with lock_profiling off"
+
+# counted, timed, and the writers' stacks sampled, while it is on
+r.config_set("lock_profiling", "on")
+for i in range(N):
+    r.set(f"lock:{i}", f"w{i}")
+for i in range(N):
+    r.get(f"lock:{i}")
+stats = locks()
+assert stats["lock_profiling"]["value"] == "1"
+latches = {k: v for k, v in stats.items() if k.startswith("latch_") and not k.startswith("latch_site_")}
+assert sum(v["hold_usec"] for v in latches.values()) > 0, "no hold was timed with lock_profiling on"
+shared_now = sum(v["shared"] for v in latches.values())
+assert shared_now - shared >= N, f"{shared_now - shared} shared latch acquisitions counted for {N} GETs"
+
+hottest = r.execute_command("LOCKS", 3)
+assert 0 < len(hottest) <= 3, f"LOCKS 3 returned {len(hottest)} latches"
+first = dict(zip(hottest[0][::2], hottest[0][1::2]))
+assert b"latch" in first and b"wait_us" in first, f"LOCKS returned {first}"
+
+r.config_set("lock_profiling", "off")
+assert r.execute_command("CONFIG", "RESETSTAT") in (b"OK", "OK")
+# maintenance may take a latch or two in between, but not what the calls above did
+left = sum(v["shared"] + v["unique"] for k, v in locks().items()
+           if k.startswith("latch_") and not k.startswith("latch_site_"))
+assert left < N, f"CONFIG RESETSTAT left {left} latch acquisitions behind"
+
+r.execute_command("FLUSHDB")
+print("lock profile test passed")
+barch.stop()
@@ -377,6 +377,46 @@ void test_upgrade_from_shared_does_not_deadlock_with_writer() {
     expect(writer_in.load(), "unique ran after the reader unlocked");
 }
 
+void test_contention_counts() {
+    debuggable_server_lock lk;
+    lk.lock_shared();
+    lk.unlock_shared();
+    lk.lock();
+    lk.unlock();
+    auto r = lk.contention();
+    expect(r.unique_acquired == 1, "unique acquisitions counted while not profiling");
+    expect(r.shared_acquired == 0, "shared acquisitions not counted while not profiling");
+    expect(r.shared_waits == 0 && r.unique_waits == 0, "a free lock is not counted as waited on");
+    expect(r.hold_ns == 0, "holds not timed while not profiling");
+
+    lk.lock_shared();
+    expect(!lk.try_lock_for(std::chrono::milliseconds(10)), "unique times out behind a reader");
+    lk.unlock_shared();
+    r = lk.contention();
+    expect(r.timeouts == 1, "a unique wait that gave up counts as a timeout");
+
+    debuggable_server_lock::profiling = true;
+    lk.lock_shared();
+    lk.unlock_shared();
+    expect(lk.contention().shared_acquired == 1, "shared acquisitions counted while profiling");
+    for (uint64_t i = 0; i < debuggable_server_lock::site_sample_every; ++i) {
+        lk.lock();
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+        lk.unlock();
+    }
+    debuggable_server_lock::profiling = false;
+    r = lk.contention();
+    expect(r.hold_ns > 0 && r.max_hold_ns <= r.hold_ns, "holds timed while profiling");
+#if defined(__linux__) && defined(__GLIBC__)
+    expect(!r.sites.empty() && r.sites[0].samples > 0, "a writer's hold site was sampled");
+#endif
+
+    lk.reset_contention();
+    r = lk.contention();
+    expect(r.shared_acquired == 0 && r.unique_acquired == 0 && r.timeouts == 0 && r.sites.empty(),
+           "reset forgets what was counted");
+}
+
 void test_perf() {
     constexpr int ms = 400;
     debuggable_server_lock ours;
@@ -426,6 +466,7 @@ int main() {
     test_upgrade_to_write_excludes_readers();
     test_upgrade_from_shared();
     test_upgrade_from_shared_does_not_deadlock_with_writer();
+    test_contention_counts();
 #ifdef BARCH_LOCK_DEBUG
     test_snapshot();
 #endif
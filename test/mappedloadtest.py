@@ -0,0 +1,98 @@
+import glob
+import os
+import time
+
+import redis
+import barch
+
+# A snapshot is a page image now, and LOAD maps it instead of reading it: the pages are
+# read from disk when something touches them, and copied when something changes them.
+# This checks that what a mapped load serves is what was saved, and that the shard can
+# change and grow past the image it was mapped from - without writing to that image - and
+# be saved and loaded again. A load that did not read the leaves leaves their expiries
+# for maintenance to schedule, so keys saved with a deadline still go when it passes.
+
+PORT = 14500
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start mapped load test")
+
+
+def stats():
+    flat = r.execute_command("STATS")
+    out = {}
+    for i in range(0, len(flat) - 1, 2):
+        k = flat[i].decode() if isinstance(flat[i], bytes) else str(flat[i])
+        out[k] = int(flat[i + 1])
+    return out
+
+
+def resp_ok(reply):
+    return reply == b"OK" or reply == "OK"
+
+
+N = 30000
+
+r.execute_command("USE", "mappedload")
+r.execute_command("FLUSHDB")
+
+expected = {}
+for i in range(N):
+    expected[f"m:{i}"] = f"v{i}"
+    r.set(f"m:{i}", f"v{i}")
+assert resp_ok(r.execute_command("SAVE"))
+before = stats()
+assert resp_ok(r.execute_command("LOAD"))
+assert stats()["load_pages_mapped"] > before["load_pages_mapped"], "the load read its pages"
+
+
+def check(when):
+    assert r.dbsize() == len(expected), f"{when}: {r.dbsize()} keys, expected {len(expected)}"
+    for k, v in expected.items():
+        got = r.get(k)
+        assert got is not None and got.decode() == v, f"{when}: {k} is {got}, expected {v}"
+
+
+check("after a mapped load")
+
+
+def snapshots():
+    return {f: (os.stat(f).st_size, os.stat(f).st_mtime_ns) for f in glob.glob("*.dat")}
+
+
+mapped_from = snapshots()
+
+# change some of what was mapped, and add enough to need pages past the image
+for i in range(0, N, 7):
+    expected[f"m:{i}"] = f"c{i}"
+    r.set(f"m:{i}", f"c{i}")
+for i in range(0, N, 11):
+    if f"m:{i}" in expected:
+        del expected[f"m:{i}"]
+        r.delete(f"m:{i}")
+for i in range(N):
+    expected[f"g:{i}"] = f"grown {i}"
+    r.set(f"g:{i}", f"grown {i}")
+check("after changing the mapped pages")
+assert snapshots() == mapped_from, "growing the mapped shard wrote to the snapshot it was mapped from"
+
+assert resp_ok(r.execute_command("SAVE"))
+assert resp_ok(r.execute_command("LOAD"))
+check("after saving and loading again")
+
+# keys saved with a deadline are reclaimed when it passes, without being read
+for i in range(500):
+    r.set(f"short:{i}", "s", px=3000)
+assert resp_ok(r.execute_command("SAVE"))
+assert resp_ok(r.execute_command("LOAD"))
+before = stats()["keys_expired"]
+deadline = time.time() + 30
+while time.time() < deadline and stats()["keys_expired"] - before < 500:
+    time.sleep(0.2)
+assert stats()["keys_expired"] - before == 500, "expiries saved with the shard were not scheduled after a mapped load"
+
+r.execute_command("FLUSHDB")
+print("mapped load test passed")
+barch.stop()
@@ -0,0 +1,82 @@
+import redis
+import barch
+
+# A long pipeline of single key commands is split into groups of shards that run in
+# parallel on the workers, and the replies are put back in the order they were asked
+# for. This checks that order holds, that requests for one key see each other in the
+# order they were sent, and that MULTI, EXEC and the commands around them are not
+# reordered into the parallel part.
+
+PORT = 14840
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start parallel pipeline test")
+
+
+def server_info():
+    info = r.execute_command("INFO", "SERVER")
+    info = info.decode() if isinstance(info, bytes) else info
+    out = {}
+    for line in info.splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            out[k] = v
+    return out
+
+
+r.execute_command("CONFIG", "RESETSTAT")
+N = 2000
+
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.set(f"fan:{i}", f"v{i}")
+assert all(p.execute())
+
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.get(f"fan:{i}")
+assert p.execute() == [f"v{i}".encode() for i in range(N)], "replies came back out of order"
+
+# the same key, over and over, has to see its own writes in the order they were sent
+p = r.pipeline(transaction=False)
+expect = []
+for i in range(N):
+    p.incr("fan:counter")
+    expect.append(i + 1)
+    p.get(f"fan:{i}")
+    expect.append(f"v{i}".encode())
+got = p.execute()
+assert got == expect, "requests for one key were reordered"
+
+# a command that is not single key ends the parallel run and keeps its place
+p = r.pipeline(transaction=False)
+expect = []
+for i in range(N):
+    if i % 500 == 250:
+        p.ping()
+        expect.append(True)
+        p.mget(f"fan:{i}", f"fan:{i + 1}")
+        expect.append([f"v{i}".encode(), f"v{i + 1}".encode()])
+    p.set(f"fan:{i}", f"w{i}")
+    expect.append(True)
+    p.get(f"fan:{i}")
+    expect.append(f"w{i}".encode())
+assert p.execute() == expect, "a mixed pipeline came back wrong"
+
+# MULTI queues, and EXEC answers with what was queued, in order
+p = r.pipeline(transaction=True)
+for i in range(200):
+    p.set(f"fan:tx:{i}", i)
+    p.get(f"fan:tx:{i}")
+got = p.execute()
+assert got == [x for i in range(200) for x in (True, str(i).encode())], "a transaction came back wrong"
+
+info = server_info()
+assert int(info["parallel_pipelines"]) > 0, "no pipeline was run in parallel"
+assert int(info["parallel_requests"]) >= N, "fewer requests ran in parallel than were sent"
+
+r.execute_command("FLUSHDB")
+print("parallel pipeline test passed")
+barch.stop()
@@ -1,4 +1,5 @@
 import re
+import time
 import redis
 import barch
 
@@ -198,6 +199,18 @@ assert info_memory(r)["maxmemory_policy"] == "noeviction"
 # the other sections still work and an unknown one is still rejected
 assert parse_info(r.execute_command("INFO SERVER"))[0] == "Server"
 assert parse_info(r.execute_command("INFO SHARD 0"))[0] == "Shard"
+
+# shard maintenance runs on the shared pool and each shard reports what it cost
+shard = {}
+for _ in range(100):
+    shard = parse_info(r.execute_command("INFO SHARD #0"))[1]
+    if int(shard["maintenance_runs"]) > 0:
+        break
+    time.sleep(0.1)
+assert int(shard["maintenance_runs"]) > 0, "shard 0 was never maintained"
+assert int(shard["maintenance_total_us"]) >= int(shard["maintenance_last_us"])
+assert int(shard["maintenance_max_us"]) >= int(shard["maintenance_last_us"])
+assert "maintenance_urgency" in shard
 try:
     r.execute_command("INFO NOSUCHSECTION")
     assert False, "an unknown INFO section should have been rejected"
@@ -24,7 +24,14 @@ while (barch.calls("SET") < COUNT):
 while (barch.calls("REM") < COUNT/10):
     time.sleep(1)
 
+# acks are read back asynchronously, so they can trail the remote call counters
+while (barch.repl_stats().repl_commands_acked < COUNT):
+    time.sleep(1)
+
 stats = barch.repl_stats()
+# the stream is framed, many commands to a frame
+assert stats.repl_batches_sent > 0
+assert stats.repl_batches_sent < stats.repl_commands_acked
 assert barch.calls("SET") > 0
 assert barch.calls("REM") > 0
 assert stats.barch_requests > 0
@@ -35,5 +42,19 @@ assert(stats.instructions_failed == 0)
 
 #print(barch.repl_stats().bytes_recv)
 
+# a replica that is not there has a sender of its own, so it neither holds up the one
+# above nor the writes here. With drop-oldest its queue stays bounded by throwing away
+# what it cannot hold
+barch.setConfiguration("repl_backpressure", "drop-oldest")
+barch.setConfiguration("repl_queue_max", "100")
+barch.publish("127.0.0.1", "13999")
+acked = barch.repl_stats().repl_commands_acked
+for i in range(1000):
+    k.set("dropped" + str(i), str(i))
+while (barch.repl_stats().repl_commands_acked < acked + 1000):
+    time.sleep(1)
+assert barch.repl_stats().repl_dropped > 0
+barch.setConfiguration("repl_backpressure", "resync")
+
 barch.save()
 barch.stop()
\ No newline at end of file
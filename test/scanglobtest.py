@@ -228,6 +228,147 @@ if anchored:
 
 assert not anchored, "SCAN MATCH does not honour patterns anchored at the end of the key"
 
+# --- patterns with a literal prefix walk the tree --------------------------------
+# Those are answered from the key ranges the prefix pins down instead of from every
+# page, which must not change what comes back. A container is matched by its name.
+r.hset("foo:hash", mapping={"f1": "1", "f2": "2"})
+r.rpush("foo:list", "a", "b")
+walked = ["foo*", "foo:*", "foo:bar:*", "miss*", "ban*", "key:*", "abc*", "[ab]*",
+          "foo[:b]*", "hello*", "v12*"]
+for pattern in walked:
+    plan = r.execute_command("SCAN", "0", "MATCH", pattern, "EXPLAIN")
+    plan = plan.decode() if isinstance(plan, bytes) else plan
+    literal = pattern.split("*")[0].split("[")[0]
+    wanted = {k for k in SUBJECTS + ["foo:hash", "foo:list"] if k.startswith(literal)}
+    if "[" in pattern:
+        after = pattern[len(literal) + 1:pattern.index("]")]
+        wanted = {k for k in wanted if len(k) > len(literal) and k[len(literal)] in after}
+    for count in (1, 1000):
+        got = scan_all(r, match=pattern, count=count)[0]
+        assert len(got) == len(set(got)), f"SCAN MATCH {pattern!r} returned duplicates ({plan})"
+        assert set(got) == wanted, f"SCAN MATCH {pattern!r} ({plan}) gave {sorted(got)}"
+    got = {k.decode() for k in r.keys(pattern)}
+    assert got == wanted, f"KEYS {pattern!r} ({plan}) gave {sorted(got)}"
+
+def explain(*args):
+    s = r.execute_command(*args, "EXPLAIN")
+    return s.decode() if isinstance(s, bytes) else s
+
+assert explain("KEYS", "foo:*").startswith("walk"), explain("KEYS", "foo:*")
+assert explain("SCAN", "0", "MATCH", "foo:*").startswith("walk")
+assert explain("KEYS", "*foo").startswith("scan all pages")
+assert explain("KEYS", "1*").startswith("scan all pages"), "a prefix that reads as a number is scanned"
+assert explain("KEYS", "hello w*").startswith("scan all pages"), "a prefix with a space is scanned"
+assert explain("SCAN", "0").startswith("scan all pages")
+r.delete("foo:hash", "foo:list")
+
+# --- KEYS running side by side ----------------------------------------------------
+# globs share max_glob_workers scanning threads instead of queueing on one lock, so
+# several at once must each still see the whole answer
+import threading
+
+r.execute_command("CONFIG", "SET", "max_glob_workers", "2")
+assert r.execute_command("CONFIG", "GET", "max_glob_workers")[1] in (b"2", "2")
+failures = []
+
+
+def keys_worker():
+    conn = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+    for _ in range(20):
+        got = sorted(k.decode() for k in conn.keys("*"))
+        if got != sorted(SUBJECTS):
+            failures.append(got)
+    conn.close()
+
+
+workers = [threading.Thread(target=keys_worker) for _ in range(6)]
+for w in workers:
+    w.start()
+for w in workers:
+    w.join()
+assert not failures, f"{len(failures)} concurrent KEYS gave a short or wrong answer"
+r.execute_command("CONFIG", "SET", "max_glob_workers", "0")
+
+# --- KEYS past the queue, and KEYS nobody waits for any more ------------------------
+# one scanning thread kept busy by a KEYS that matches nothing in a large keyspace, so
+# the globs after it have to wait for it - or are refused when no one may wait
+import socket
+import time
+
+
+def stats():
+    flat = r.execute_command("STATS")
+    out = {}
+    for i in range(0, len(flat) - 1, 2):
+        k = flat[i].decode() if isinstance(flat[i], bytes) else str(flat[i])
+        out[k] = int(flat[i + 1])
+    return out
+
+
+BIG = 300000
+for start in range(0, BIG, 10000):
+    r.mset({f"big:{i}": "x" for i in range(start, start + 10000)})
+
+busy = threading.Event()
+done = threading.Event()
+
+
+def blocker():
+    conn = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+    while not done.is_set():
+        try:
+            conn.keys("*qqqq*")
+            busy.set()
+        except redis.exceptions.ResponseError:
+            pass  # refused in turn while the test held the thread
+    conn.close()
+
+
+r.execute_command("CONFIG", "SET", "max_glob_workers", "1")
+r.execute_command("CONFIG", "SET", "max_glob_queue", "0")
+hog = threading.Thread(target=blocker)
+hog.start()
+assert busy.wait(30), "the blocking KEYS never finished once"
+
+before = stats()
+refused = 0
+for _ in range(500):
+    try:
+        r.keys("*qqqq*")
+    except redis.exceptions.ResponseError as e:
+        assert "too many KEYS/VALUES waiting" in str(e), f"unexpected error {e}"
+        refused += 1
+        break
+assert refused, "no KEYS was refused with max_glob_queue 0 and the only thread busy"
+assert stats()["globs_refused"] > before["globs_refused"], "globs_refused did not count the refusal"
+
+# a client that hangs up while its KEYS waits for the thread gives up its place
+r.execute_command("CONFIG", "SET", "max_glob_queue", "4")
+before = stats()
+request = b"*2\r\n$4\r\nKEYS\r\n$6\r\n*qqqq*\r\n"
+abandoned = False
+for _ in range(50):
+    s = socket.create_connection(("127.0.0.1", PORT))
+    s.sendall(request)
+    s.close()
+    deadline = time.time() + 2
+    while time.time() < deadline:
+        if stats()["globs_abandoned"] > before["globs_abandoned"]:
+            abandoned = True
+            break
+        time.sleep(0.05)
+    if abandoned:
+        break
+assert abandoned, "a KEYS whose client hung up was not abandoned"
+
+done.set()
+hog.join()
+r.execute_command("CONFIG", "SET", "max_glob_queue", "64")
+r.execute_command("CONFIG", "SET", "max_glob_workers", "0")
+for start in range(0, BIG, 10000):
+    r.delete(*[f"big:{i}" for i in range(start, start + 10000)])
+assert sorted(k.decode() for k in r.keys("*")) == sorted(SUBJECTS)
+
 r.close()
 barch.stop()
 print("complete scan glob test")
\ No newline at end of file
@@ -0,0 +1,78 @@
+import socket
+import time
+import redis
+import barch
+
+# A GET of a large value is sent from the leaf to the socket in one sendmsg, behind the
+# replies already encoded for the same pipeline, instead of being copied into the reply
+# stream first. Whatever the socket cannot take at that moment is copied after all.
+# This checks the replies still arrive whole and in order both ways: from a client that
+# reads as it goes, and from one that lets the socket fill before it reads anything.
+
+PORT = 14830
+
+barch.start("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start scattered reply test")
+
+
+def server_info():
+    info = r.execute_command("INFO", "SERVER")
+    info = info.decode() if isinstance(info, bytes) else info
+    out = {}
+    for line in info.splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            out[k] = v
+    return out
+
+
+r.execute_command("CONFIG", "RESETSTAT")
+sizes = [16 * 1024 - 1, 16 * 1024, 100 * 1024 + 3, 1024 * 1024]
+values = {}
+for size in sizes:
+    values[size] = bytes((i * 17 + size) % 251 for i in range(size))
+    r.set(f"scatter:{size}", values[size])
+r.set("scatter:small", "s")
+
+for size in sizes:
+    assert r.get(f"scatter:{size}") == values[size], f"a {size} byte value did not survive"
+
+# small replies ahead of and between the large ones must keep their places
+p = r.pipeline(transaction=False)
+expect = []
+for _ in range(4):
+    for size in sizes:
+        p.get("scatter:small")
+        expect.append(b"s")
+        p.get(f"scatter:{size}")
+        expect.append(values[size])
+assert p.execute() == expect, "pipelined large and small GETs came back wrong or out of order"
+
+info = server_info()
+assert int(info["scattered_replies"]) > 0, "no large value was sent from the leaf"
+
+# a client that does not read: the socket fills, and what it cannot take is copied
+raw = socket.create_connection(("127.0.0.1", PORT))
+big = f"scatter:{sizes[-1]}"
+request = f"*2\r\n$3\r\nGET\r\n${len(big)}\r\n{big}\r\n".encode()
+count = 16
+raw.sendall(request * count)
+time.sleep(0.5)
+one = f"${sizes[-1]}\r\n".encode() + values[sizes[-1]] + b"\r\n"
+want = one * count
+got = bytearray()
+while len(got) < len(want):
+    chunk = raw.recv(1024 * 1024)
+    assert chunk, "the server closed the connection"
+    got += chunk
+assert bytes(got) == want, "replies to a client that fell behind came back wrong"
+raw.close()
+
+info = server_info()
+assert int(info["scattered_bytes_copied"]) > 0, "a full socket should have left bytes to copy"
+
+r.execute_command("FLUSHDB")
+print("scattered reply test passed")
+barch.stop()
@@ -0,0 +1,112 @@
+import redis
+import barch
+
+# START ... CORES gives every resp thread a listener of its own on the port and a share
+# of the shards, and a single key request read by one core is run by the core that owns
+# its shard. This checks that replies keep their order whichever cores ran them, that
+# connections see each other's writes, that a binary protocol connection is still served
+# by the accept threads, and that INFO server counts the forwarding. The core count is
+# given, so there is more than one to forward between on a machine with one CPU.
+
+PORT = 14860
+CORES = 4
+
+barch.start_cores("0.0.0.0", PORT, CORES)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start shard per core test")
+
+
+def server_info():
+    info = r.execute_command("INFO", "SERVER")
+    info = info.decode() if isinstance(info, bytes) else info
+    out = {}
+    for line in info.splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            out[k] = v
+    return out
+
+
+r.execute_command("CONFIG", "RESETSTAT")
+N = 2000
+
+# one request at a time, each on whichever core owns its key
+for i in range(200):
+    assert r.set(f"core:{i}", f"v{i}")
+for i in range(200):
+    assert r.get(f"core:{i}") == f"v{i}".encode()
+
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.set(f"core:{i}", f"w{i}")
+assert all(p.execute())
+
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.get(f"core:{i}")
+assert p.execute() == [f"w{i}".encode() for i in range(N)], "replies came back out of order"
+
+# the same key, over and over, has to see its own writes in the order they were sent
+p = r.pipeline(transaction=False)
+expect = []
+for i in range(N):
+    p.incr("core:counter")
+    expect.append(i + 1)
+    p.get(f"core:{i}")
+    expect.append(f"w{i}".encode())
+assert p.execute() == expect, "requests for one key were reordered"
+
+# a command that is not single key keeps its place between forwarded ones
+p = r.pipeline(transaction=False)
+expect = []
+for i in range(0, N, 2):
+    p.mget(f"core:{i}", f"core:{i + 1}")
+    expect.append([f"w{i}".encode(), f"w{i + 1}".encode()])
+    p.get(f"core:{i}")
+    expect.append(f"w{i}".encode())
+assert p.execute() == expect, "a mixed pipeline came back wrong"
+
+p = r.pipeline(transaction=True)
+for i in range(200):
+    p.set(f"core:tx:{i}", i)
+    p.get(f"core:tx:{i}")
+assert p.execute() == [x for i in range(200) for x in (True, str(i).encode())], "a transaction came back wrong"
+
+# connections land on different cores and still share every key
+others = [redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2) for _ in range(16)]
+for n, c in enumerate(others):
+    assert c.set(f"core:conn:{n}", n)
+for c in others:
+    for n in range(len(others)):
+        assert c.get(f"core:conn:{n}") == str(n).encode(), "a connection missed another's write"
+    c.close()
+
+# the binary protocol is told apart by its first byte and handed to the accept threads
+remote = barch.KeyValue("127.0.0.1", PORT)
+for i in range(100):
+    remote.set(f"core:bin:{i}", f"b{i}")
+for i in range(100):
+    assert r.get(f"core:bin:{i}") == f"b{i}".encode(), "a binary protocol write was not seen over resp"
+    assert remote.get(f"core:{i}") == f"w{i}", "a binary protocol read missed a resp write"
+assert r.execute_command("RPING", "127.0.0.1", PORT) in (b"OK", "OK")
+
+info = server_info()
+cores = int(info["shard_cores"])
+assert cores == CORES, f"{cores} cores serving, {CORES} asked for"
+assert int(info["core_forwarded_requests"]) > 0, "nothing was run by the core that owns it"
+assert int(info["core_mailbox_sends"]) > 0, "no mailbox was used between cores"
+
+# a restart stops the cores with whatever their mailboxes held, and starts others
+r.close()
+barch.start_cores("0.0.0.0", PORT, 2)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+assert int(server_info()["shard_cores"]) == 2
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.get(f"core:{i}")
+assert p.execute() == [f"w{i}".encode() for i in range(N)], "replies came back wrong after a restart"
+
+r.execute_command("FLUSHDB")
+print("shard per core test passed")
+barch.stop()
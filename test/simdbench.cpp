@@ -0,0 +1,220 @@
+//
+// Microbenchmark for the child search kernels in src/simd.cpp.
+//
+// The kernels are picked with cpuid when barch starts, so one machine can run every one
+// of them up to the widest it has. This times each against the searches the art nodes
+// make - a node16's sorted keys, a node48's 256 byte key index and its free slot scan, a
+// node256's type array, and the prefix and key comparisons - and checks every kernel
+// gives the answer the plain loop gives. A disagreement fails the run; the timings are
+// only printed.
+//
+// simdbench [rounds]   rounds is in thousands and defaults to 2000, ctest runs it small
+//
+
+#include "simd.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+long long failed = 0;
+volatile size_t sink = 0; // keeps the searches from being optimised away
+
+size_t reference_gt(const uint8_t *data, size_t size, uint8_t ch) {
+    for (size_t i = 0; i < size; ++i) if (data[i] > ch) return i;
+    return size;
+}
+
+size_t reference_eq(const uint8_t *data, size_t size, uint8_t ch) {
+    for (size_t i = 0; i < size; ++i) if (data[i] == ch) return i;
+    return size;
+}
+
+size_t reference_mismatch(const uint8_t *a, const uint8_t *b, size_t size) {
+    for (size_t i = 0; i < size; ++i) if (a[i] != b[i]) return i;
+    return size;
+}
+
+size_t reference_find(const uint8_t *data, size_t size, const uint8_t *needle, size_t length) {
+    if (!length) return 0;
+    for (size_t i = 0; i + length <= size; ++i) {
+        if (memcmp(data + i, needle, length) == 0) return i;
+    }
+    return size;
+}
+
+void check(const char *what, simd::isa isa, size_t want, size_t got) {
+    if (want == got) return;
+    if (++failed < 20) {
+        fprintf(stderr, "%s with %s: wanted %zu got %zu\n", what, simd::isa_name(isa), want, got);
+    }
+}
+
+template<typename F>
+double time_ns(long long rounds, F &&f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (long long r = 0; r < rounds; ++r) {
+        sink = sink + f(r);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (double) rounds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    long long rounds = 1000LL * (argc > 1 ? atoll(argv[1]) : 2000);
+    if (rounds <= 0) rounds = 1000;
+    std::mt19937 rng(1234);
+
+    // a node16: sorted keys, some of them unused at the end
+    std::vector<uint8_t> keys16(16);
+    // a node48 key index: 256 entries, 48 of them a slot number, the rest zero
+    std::vector<uint8_t> keys48(256, 0);
+    // a node48's types: the first free slot is somewhere in the 48
+    std::vector<uint8_t> types48(48, 1);
+    // a node256 just above where it shrinks back to a node48, so most slots are empty
+    std::vector<uint8_t> types256(256, 0);
+    // prefixes the length a node keeps and keys the length of a long composite
+    std::vector<uint8_t> short_a(10), short_b(10), long_a(256), long_b(256);
+
+    for (unsigned i = 0; i < 16; ++i) keys16[i] = (uint8_t) (i * 15 + 7);
+    for (unsigned i = 0, at = 0; i < 48; ++i) {
+        at += 1 + rng() % 9;
+        if (at < 256) keys48[at] = (uint8_t) (i + 1);
+    }
+    types48[rng() % 48] = 0;
+    for (unsigned i = 0; i < 40; ++i) types256[rng() % 256] = 1 + (rng() & 1);
+    for (unsigned i = 0; i < 256; ++i) long_a[i] = long_b[i] = (uint8_t) rng();
+    for (unsigned i = 0; i < 10; ++i) short_a[i] = short_b[i] = (uint8_t) rng();
+    std::vector<uint8_t> probes(1024);
+    for (auto &p: probes) p = (uint8_t) rng();
+
+    printf("%-28s", "kernel (ns per search)");
+    for (int i = 0; i <= (int) simd::best_isa(); ++i) printf("%10s", simd::isa_name((simd::isa) i));
+    printf("\n");
+
+    auto row = [&](const char *name, auto &&search, auto &&reference) {
+        printf("%-28s", name);
+        for (int i = 0; i <= (int) simd::best_isa(); ++i) {
+            auto isa = (simd::isa) i;
+            simd::use_isa(isa);
+            for (long long r = 0; r < 1024; ++r) {
+                check(name, isa, reference(r), search(r));
+            }
+            printf("%10.2f", time_ns(rounds, search));
+        }
+        printf("\n");
+    };
+
+    row("node16 lower bound",
+        [&](long long r) { return (size_t) simd::first_key_ge16(keys16.data(), 13, probes[r & 1023]); },
+        [&](long long r) {
+            uint8_t c = probes[r & 1023];
+            for (unsigned i = 0; i < 13; ++i) if (keys16[i] >= c) return (size_t) i;
+            return (size_t) 13;
+        });
+    row("node48 lower bound",
+        [&](long long r) {
+            uint8_t c = probes[r & 1023];
+            return c + simd::node48_byte_gt(keys48.data() + c, 256 - c, 0);
+        },
+        [&](long long r) {
+            uint8_t c = probes[r & 1023];
+            return c + reference_gt(keys48.data() + c, 256 - c, 0);
+        });
+    row("node48 free slot",
+        [&](long long) { return simd::node48_byte_eq(types48.data(), 48, 0); },
+        [&](long long) { return reference_eq(types48.data(), 48, 0); });
+    row("node256 next child",
+        [&](long long r) {
+            uint8_t c = probes[r & 1023];
+            return c + simd::node256_byte_gt(types256.data() + c, 256 - c, 0);
+        },
+        [&](long long r) {
+            uint8_t c = probes[r & 1023];
+            return c + reference_gt(types256.data() + c, 256 - c, 0);
+        });
+    row("node prefix (10 bytes)",
+        [&](long long r) {
+            short_b[r % 10] ^= 1;
+            size_t at = simd::first_mismatch(short_a.data(), short_b.data(), 10);
+            short_b[r % 10] ^= 1;
+            return at;
+        },
+        [&](long long r) {
+            short_b[r % 10] ^= 1;
+            size_t at = reference_mismatch(short_a.data(), short_b.data(), 10);
+            short_b[r % 10] ^= 1;
+            return at;
+        });
+    row("leaf key (up to 256 bytes)",
+        [&](long long r) {
+            size_t len = 1 + (r & 255);
+            long_b[len - 1] ^= 1;
+            size_t at = simd::first_mismatch(long_a.data(), long_b.data(), len);
+            long_b[len - 1] ^= 1;
+            return at;
+        },
+        [&](long long r) {
+            size_t len = 1 + (r & 255);
+            long_b[len - 1] ^= 1;
+            size_t at = reference_mismatch(long_a.data(), long_b.data(), len);
+            long_b[len - 1] ^= 1;
+            return at;
+        });
+
+    // the edges every kernel has to get right whatever the input: no bytes, a match in
+    // the last byte, and bytes over 0x7f, which a signed compare would put first
+    for (int i = 0; i <= (int) simd::best_isa(); ++i) {
+        auto isa = (simd::isa) i;
+        simd::use_isa(isa);
+        std::vector<uint8_t> v(200, 0x10);
+        check("empty gt", isa, 0, simd::first_byte_gt(v.data(), 0, 0));
+        check("empty mismatch", isa, 0, simd::first_mismatch(v.data(), v.data(), 0));
+        for (size_t len = 1; len < v.size(); ++len) {
+            v[len - 1] = 0x90;
+            check("high byte gt", isa, len - 1, simd::first_byte_gt(v.data(), (unsigned) len, 0x7f));
+            check("node48 high byte gt", isa, len - 1, simd::node48_byte_gt(v.data(), (unsigned) len, 0x7f));
+            check("node256 high byte gt", isa, len - 1, simd::node256_byte_gt(v.data(), (unsigned) len, 0x7f));
+            check("last byte eq", isa, len - 1, simd::first_byte_eq(v.data(), (unsigned) len, 0x90));
+            v[len - 1] = 0x10;
+            check("no byte gt", isa, len, simd::first_byte_gt(v.data(), (unsigned) len, 0x10));
+        }
+    }
+
+    // the literal search a compiled glob runs: needles that straddle the register
+    // boundary, that only match at the very end, and near misses on first and last byte
+    for (int i = 0; i <= (int) simd::best_isa(); ++i) {
+        auto isa = (simd::isa) i;
+        simd::use_isa(isa);
+        std::vector<uint8_t> hay(300);
+        for (auto &b : hay) b = (uint8_t) ('a' + rng() % 3);
+        for (size_t length = 1; length < 40; ++length) {
+            for (size_t trial = 0; trial < 40; ++trial) {
+                size_t size = rng() % hay.size();
+                std::vector<uint8_t> needle(length);
+                if (size >= length && trial % 2) {
+                    size_t at = rng() % (size - length + 1);
+                    memcpy(needle.data(), hay.data() + at, length);
+                } else {
+                    for (auto &b : needle) b = (uint8_t) ('a' + rng() % 3);
+                }
+                check("find literal", isa, reference_find(hay.data(), size, needle.data(), length),
+                      simd::find_literal(hay.data(), size, needle.data(), length));
+            }
+        }
+    }
+
+    if (failed) {
+        fprintf(stderr, "%lld searches disagreed with the plain loop\n", failed);
+        return 1;
+    }
+    printf("all kernels agree, barch uses %s on this cpu\n", simd::isa_name(simd::best_isa()));
+    return 0;
+}
@@ -36,6 +36,23 @@ assert(k.count("2","3") == 1)
 assert(k.size()==3)
 assert(k.size()<=barch.sizeAll())
 assert(k.get("1") == "one")
+m = k.mget(["1","nope","3","2"])
+assert(len(m) == 4)
+assert(m[0].s() == "one" and m[2].s() == "three" and m[3].s() == "two")
+assert(m[1].t() == "null")
+wb = barch.WriteBatch()
+assert(wb.use("test"))
+for i in range(100):
+    wb.put("wb" + str(i), str(i))
+wb.put("wb7", "seven")
+assert(wb.size() == 101)
+assert(not k.exists("wb0"))
+assert(wb.commit().s() == "OK")
+assert(wb.size() == 0)
+assert(k.get("wb99") == "99")
+assert(k.get("wb7") == "seven")
+for i in range(100):
+    k.erase("wb" + str(i))
 assert k.set('one',"1") == "OK"
 assert k.incr('one',1) == 2
 assert(k.get('one') == "2")
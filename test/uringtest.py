@@ -0,0 +1,101 @@
+import socket
+import time
+
+import redis
+import barch
+
+# START ... URING serves plain tcp connections from io_uring rings: one multishot
+# receive per connection into buffers the ring provides, and sends submitted together.
+# This checks that pipelines, values larger than a ring buffer and many connections get
+# the same answers they get from asio, that replies the kernel sends a part at a time
+# out of the session's own buffers arrive whole while the session goes on to the next
+# batch, and that INFO server counts the ring's work. A kernel without io_uring falls
+# back to asio, which must answer the same.
+
+PORT = 14820
+
+barch.start_uring("0.0.0.0", PORT)
+r = redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2)
+
+print("start io_uring server test")
+
+
+def server_info():
+    info = r.execute_command("INFO", "SERVER")
+    info = info.decode() if isinstance(info, bytes) else info
+    out = {}
+    for line in info.splitlines():
+        if ":" in line and not line.startswith("#"):
+            k, v = line.split(":", 1)
+            out[k] = v
+    return out
+
+
+N = 5000
+
+# a pipeline arrives as many requests in one receive, and leaves as many replies
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.set(f"uring:{i}", f"v{i}")
+assert all(p.execute())
+p = r.pipeline(transaction=False)
+for i in range(N):
+    p.get(f"uring:{i}")
+got = p.execute()
+assert got == [f"v{i}".encode() for i in range(N)], "pipelined GETs came back wrong or out of order"
+
+# larger than a ring buffer, and larger than what a connection may hold unread
+for size in (1, 16 * 1024 + 7, 300 * 1024):
+    value = bytes((i * 31) % 251 for i in range(size))
+    r.set("uring:big", value)
+    assert r.get("uring:big") == value, f"a {size} byte value did not survive"
+
+# a slow reader with a small receive buffer: the sends go out a part at a time while the
+# next pipelines are read and answered, each from a buffer of its own
+value = bytes((i * 17) % 253 for i in range(200 * 1024))
+r.set("uring:big", value)
+reply = b"$%d\r\n" % len(value) + value + b"\r\n"
+slow = socket.create_connection(("127.0.0.1", PORT))
+slow.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+BATCHES, PER_BATCH = 4, 8
+for _ in range(BATCHES):
+    slow.sendall(b"*2\r\n$3\r\nGET\r\n$9\r\nuring:big\r\n" * PER_BATCH)
+    time.sleep(0.05)
+want = reply * (BATCHES * PER_BATCH)
+got = bytearray()
+while len(got) < len(want):
+    chunk = slow.recv(65536)
+    assert chunk, f"the connection closed after {len(got)} of {len(want)} bytes"
+    got += chunk
+assert bytes(got) == want, "replies sent a part at a time came back changed"
+slow.close()
+
+# a client that goes while a reply is still being sent takes nothing else down with it
+gone = socket.create_connection(("127.0.0.1", PORT))
+gone.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+gone.sendall(b"*2\r\n$3\r\nGET\r\n$9\r\nuring:big\r\n" * PER_BATCH)
+time.sleep(0.05)
+gone.close()
+assert r.get("uring:big") == value
+
+clients = [redis.Redis(host="127.0.0.1", port=PORT, db=0, protocol=2) for _ in range(32)]
+for n, c in enumerate(clients):
+    c.set(f"uring:client:{n}", n)
+for n, c in enumerate(clients):
+    assert int(c.get(f"uring:client:{n}")) == n
+
+info = server_info()
+sessions = int(info["io_uring_sessions"])
+if sessions == 0:
+    print("io_uring is not available here, asio answered instead")
+else:
+    assert sessions >= len(clients), f"{sessions} connections on rings, {len(clients) + 1} open"
+    submits = int(info["io_uring_submits"])
+    completions = int(info["io_uring_completions"])
+    assert submits > 0 and completions > 0, f"{submits} submits and {completions} completions"
+
+for c in clients:
+    c.close()
+r.execute_command("FLUSHDB")
+print("io_uring server test passed")
+barch.stop()